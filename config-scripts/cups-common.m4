@@ -200,6 +200,18 @@ AC_CHECK_FUNCS(sigaction)
 dnl Checks for wait functions.
 AC_CHECK_FUNCS(waitpid wait3)
 
+dnl Check for posix_spawn function.
+AC_CHECK_FUNCS(posix_spawn)
+
+dnl Checks for zero-copy I/O functions (Linux sendfile and splice).
+AC_CHECK_HEADER(sys/sendfile.h,
+	AC_DEFINE(HAVE_SYS_SENDFILE_H)
+	AC_CHECK_FUNCS(sendfile))
+AC_CHECK_FUNCS(splice)
+
+dnl Check for inotify (Linux).
+AC_CHECK_HEADER(sys/inotify.h, AC_DEFINE(HAVE_SYS_INOTIFY_H))
+
 dnl See if the tm structure has the tm_gmtoff member...
 AC_MSG_CHECKING(for tm_gmtoff member in tm structure)
 AC_TRY_COMPILE([#include <time.h>],[struct tm t;
@@ -143,6 +143,8 @@ extern "C" {
 #define _HTTP_RESOLVE_FQDN	2	/* Resolve to a FQDN */
 #define _HTTP_RESOLVE_FAXOUT	4	/* Resolve FaxOut service? */
 
+#define _HTTP_MAX_SBUFFER	32768	/* Max size of grown data buffers */
+
 
 /*
  * Types and functions for SSL support...
@@ -236,8 +238,7 @@ struct _http_s				/**** HTTP connection structure ****/
   http_encoding_t	data_encoding;	/* Chunked or not */
   int			_data_remaining;/* Number of bytes left (deprecated) */
   int			used;		/* Number of bytes used in buffer */
-  char			buffer[HTTP_MAX_BUFFER];
-					/* Buffer for incoming data */
+  char			*buffer;	/* Buffer for incoming data */
   int			_auth_type;	/* Authentication in use (deprecated) */
   _cups_md5_state_t	md5_state;	/* MD5 state */
   char			nonce[HTTP_MAX_VALUE];
@@ -262,8 +263,7 @@ struct _http_s				/**** HTTP connection structure ****/
   off_t			data_remaining;	/* Number of bytes left */
   http_addr_t		*hostaddr;	/* Current host address and port */
   http_addrlist_t	*addrlist;	/* List of valid addresses */
-  char			wbuffer[HTTP_MAX_BUFFER];
-					/* Buffer for outgoing data */
+  char			*wbuffer;	/* Buffer for outgoing data */
   int			wused;		/* Write buffer bytes used */
 
   /**** New in CUPS 1.3 ****/
@@ -306,6 +306,10 @@ struct _http_s				/**** HTTP connection structure ****/
   z_stream		stream;		/* (De)compression stream */
   Bytef			*dbuffer;	/* Decompression buffer */
 #  endif /* HAVE_LIBZ */
+
+  /**** New in CUPS 2.0 ****/
+  size_t		bufsize,	/* Size of input buffer */
+			wbufsize;	/* Size of output buffer */
 };
 #  endif /* !_HTTP_NO_PRIVATE */
 
@@ -379,6 +383,7 @@ extern const char	*_httpResolveURI(const char *uri, char *resolved_uri,
 			                 size_t resolved_size, int options,
 					 int (*cb)(void *context),
 					 void *context);
+extern ssize_t		_httpSendFile(http_t *http, int fd, size_t length);
 extern const char	*_httpStatus(cups_lang_t *lang, http_status_t status);
 extern int		_httpUpdate(http_t *http, http_status_t *status);
 extern int		_httpWait(http_t *http, int msec, int usessl);
@@ -25,13 +25,23 @@
 #include "cups-private.h"
 #include <fcntl.h>
 #include <math.h>
+#include <sys/stat.h>
 #ifdef WIN32
 #  include <tchar.h>
+struct iovec				/* Data for http_writev() */
+{
+  void		*iov_base;		/* Pointer to data */
+  size_t	iov_len;		/* Length of data */
+};
 #else
 #  include <signal.h>
 #  include <sys/time.h>
 #  include <sys/resource.h>
+#  include <sys/uio.h>
 #endif /* WIN32 */
+#ifdef HAVE_SYS_SENDFILE_H
+#  include <sys/sendfile.h>
+#endif /* HAVE_SYS_SENDFILE_H */
 #ifdef HAVE_POLL
 #  include <poll.h>
 #endif /* HAVE_POLL */
@@ -61,8 +71,10 @@ static int		http_send(http_t *http, http_state_t request,
 			          const char *uri);
 static ssize_t		http_write(http_t *http, const char *buffer,
 			           size_t length);
-static ssize_t		http_write_chunk(http_t *http, const char *buffer,
-			                 size_t length);
+static ssize_t		http_write_data(http_t *http, const char *buffer,
+			                size_t length);
+static ssize_t		http_writev(http_t *http, struct iovec *iov,
+			            int iovcnt);
 static off_t		http_set_length(http_t *http);
 static void		http_set_timeout(int fd, double timeout);
 static void		http_set_wait(http_t *http);
@@ -399,6 +411,8 @@ httpClose(http_t *http)			/* I - HTTP connection */
   if (http->authstring && http->authstring != http->_authstring)
     free(http->authstring);
 
+  free(http->buffer);
+  free(http->wbuffer);
   free(http);
 }
 
@@ -718,12 +732,7 @@ httpFlushWrite(http_t *http)		/* I - HTTP connection */
     return (0);
   }
 
-  if (http->data_encoding == HTTP_ENCODING_CHUNKED)
-    bytes = http_write_chunk(http, http->wbuffer, http->wused);
-  else
-    bytes = http_write(http, http->wbuffer, http->wused);
-
-  http->wused = 0;
+  bytes = (int)http_write_data(http, NULL, 0);
 
   DEBUG_printf(("1httpFlushWrite: Returning %d, errno=%d.", bytes, errno));
 
@@ -1230,7 +1239,7 @@ httpGets(char   *line,			/* I - Line to read into */
       }
 
       bytes = http_read(http, http->buffer + http->used,
-                        HTTP_MAX_BUFFER - http->used);
+                        http->bufsize - (size_t)http->used);
 
       DEBUG_printf(("4httpGets: read %d bytes.", bytes));
 
@@ -1757,8 +1766,8 @@ httpPeek(http_t *http,			/* I - HTTP connection */
       }
     }
 
-    if (http->data_remaining > sizeof(http->buffer))
-      buflen = sizeof(http->buffer);
+    if (http->data_remaining > (off_t)http->bufsize)
+      buflen = http->bufsize;
     else
       buflen = http->data_remaining;
 
@@ -2500,6 +2509,128 @@ httpReconnect2(http_t *http,		/* I - HTTP connection */
 }
 
 
+/*
+ * '_httpSendFile()' - Send data from a file or pipe to a HTTP connection.
+ *
+ * Unencrypted, uncompressed, non-chunked data is sent without copying it
+ * using sendfile() for files and splice() for pipes.  Otherwise the data is
+ * read and written using httpWrite2().
+ */
+
+ssize_t					/* O - Bytes sent, 0 on EOF, -1 on error */
+_httpSendFile(http_t *http,		/* I - HTTP connection */
+              int    fd,		/* I - File or pipe to send from */
+	      size_t length)		/* I - Maximum number of bytes to send */
+{
+  ssize_t	bytes;			/* Bytes sent */
+  int		zerocopy;		/* Send without copying? */
+  char		buffer[32768];		/* Copy buffer */
+
+
+  DEBUG_printf(("_httpSendFile(http=%p, fd=%d, length=" CUPS_LLFMT ")", http,
+                fd, CUPS_LLCAST length));
+
+  if (!http || fd < 0)
+    return (-1);
+
+  zerocopy = http->data_encoding == HTTP_ENCODING_LENGTH &&
+             http->data_remaining > 0;
+#ifdef HAVE_SSL
+  if (http->tls)
+    zerocopy = 0;
+#endif /* HAVE_SSL */
+#ifdef HAVE_LIBZ
+  if (http->coding)
+    zerocopy = 0;
+#endif /* HAVE_LIBZ */
+
+#if defined(HAVE_SENDFILE) || defined(HAVE_SPLICE)
+  if (zerocopy)
+  {
+    struct stat	fileinfo;		/* File information */
+
+
+    if ((off_t)length > http->data_remaining)
+      length = (size_t)http->data_remaining;
+
+    if (fstat(fd, &fileinfo))
+      return (-1);
+
+   /*
+    * Send any buffered data (usually the response header) first...
+    */
+
+    if (http->wused && httpFlushWrite(http) < 0)
+      return (-1);
+
+    http->activity = time(NULL);
+
+#  ifdef HAVE_SPLICE
+    if (S_ISFIFO(fileinfo.st_mode))
+    {
+      while ((bytes = splice(fd, NULL, http->fd, NULL, length,
+                             SPLICE_F_MOVE)) < 0 && errno == EINTR);
+    }
+    else
+#  endif /* HAVE_SPLICE */
+#  ifdef HAVE_SENDFILE
+    if (S_ISREG(fileinfo.st_mode))
+    {
+      while ((bytes = sendfile(http->fd, fd, NULL, length)) < 0 &&
+             errno == EINTR);
+    }
+    else
+#  endif /* HAVE_SENDFILE */
+    bytes = -2;
+
+    if (bytes != -2)
+    {
+      DEBUG_printf(("1_httpSendFile: Sent " CUPS_LLFMT " bytes without "
+                    "copying.", CUPS_LLCAST bytes));
+
+      if (bytes < 0)
+      {
+        http->error = errno;
+	return (-1);
+      }
+
+      http->data_remaining -= bytes;
+
+      if (http->data_remaining <= INT_MAX)
+	http->_data_remaining = (int)http->data_remaining;
+      else
+	http->_data_remaining = INT_MAX;
+
+     /*
+      * Do end-of-request processing once everything has been sent...
+      */
+
+      if (http->data_remaining == 0 && httpWrite2(http, "", 0) < 0)
+        return (-1);
+
+      return (bytes);
+    }
+  }
+#else
+  (void)zerocopy;
+#endif /* HAVE_SENDFILE || HAVE_SPLICE */
+
+ /*
+  * Copy the data the hard way...
+  */
+
+  if (length > sizeof(buffer))
+    length = sizeof(buffer);
+
+  while ((bytes = read(fd, buffer, length)) < 0 && errno == EINTR);
+
+  if (bytes > 0 && httpWrite2(http, buffer, (size_t)bytes) < 0)
+    return (-1);
+
+  return (bytes);
+}
+
+
 /*
  * 'httpSetAuthString()' - Set the current authorization string.
  *
@@ -3344,11 +3475,11 @@ httpWrite2(http_t     *http,		/* I - HTTP connection */
       http->stream.next_in   = (Bytef *)buffer;
       http->stream.avail_in  = length;
       http->stream.next_out  = (Bytef *)http->wbuffer + http->wused;
-      http->stream.avail_out = sizeof(http->wbuffer) - http->wused;
+      http->stream.avail_out = http->wbufsize - http->wused;
 
       while (deflate(&(http->stream), Z_NO_FLUSH) == Z_OK)
       {
-	http->wused = sizeof(http->wbuffer) - http->stream.avail_out;
+	http->wused = (int)(http->wbufsize - http->stream.avail_out);
 
         if (http->stream.avail_out == 0)
         {
@@ -3359,11 +3490,11 @@ httpWrite2(http_t     *http,		/* I - HTTP connection */
 	  }
 
 	  http->stream.next_out  = (Bytef *)http->wbuffer;
-	  http->stream.avail_out = sizeof(http->wbuffer);
+	  http->stream.avail_out = http->wbufsize;
 	}
       }
 
-      http->wused = sizeof(http->wbuffer) - http->stream.avail_out;
+      http->wused = (int)(http->wbufsize - http->stream.avail_out);
       bytes       = length;
     }
   }
@@ -3371,16 +3502,33 @@ httpWrite2(http_t     *http,		/* I - HTTP connection */
 #endif /* HAVE_LIBZ */
   if (length > 0)
   {
-    if (http->wused && (length + http->wused) > sizeof(http->wbuffer))
+    if ((length + (size_t)http->wused) > http->wbufsize &&
+        http->wbufsize < _HTTP_MAX_SBUFFER)
     {
-      DEBUG_printf(("2httpWrite2: Flushing buffer (wused=%d, length="
-                    CUPS_LLFMT ")", http->wused, CUPS_LLCAST length));
+     /*
+      * Grow the write buffer for bulk transfers...
+      */
+
+      size_t	wbufsize = http->wbufsize;
+					/* New size of buffer */
+      char	*wbuffer;		/* New buffer */
+
+      while (wbufsize < (length + (size_t)http->wused) &&
+             wbufsize < _HTTP_MAX_SBUFFER)
+        wbufsize *= 2;
 
-      httpFlushWrite(http);
+      DEBUG_printf(("2httpWrite2: Growing wbuffer to " CUPS_LLFMT " bytes.",
+                    CUPS_LLCAST wbufsize));
+
+      if ((wbuffer = realloc(http->wbuffer, wbufsize)) != NULL)
+      {
+        http->wbuffer  = wbuffer;
+	http->wbufsize = wbufsize;
+      }
     }
 
-    if ((length + http->wused) <= sizeof(http->wbuffer) &&
-        length < sizeof(http->wbuffer))
+    if ((length + (size_t)http->wused) <= http->wbufsize &&
+        length < http->wbufsize)
     {
      /*
       * Write to buffer...
@@ -3396,16 +3544,16 @@ httpWrite2(http_t     *http,		/* I - HTTP connection */
     else
     {
      /*
-      * Otherwise write the data directly...
+      * Otherwise write the buffered and new data directly...
       */
 
-      DEBUG_printf(("2httpWrite2: Writing " CUPS_LLFMT " bytes to socket...",
-                    CUPS_LLCAST length));
+      DEBUG_printf(("2httpWrite2: Writing " CUPS_LLFMT " bytes to socket "
+                    "(wused=%d)...", CUPS_LLCAST length, http->wused));
 
-      if (http->data_encoding == HTTP_ENCODING_CHUNKED)
-	bytes = (ssize_t)http_write_chunk(http, buffer, (int)length);
+      if (http_write_data(http, buffer, length) < 0)
+        bytes = -1;
       else
-	bytes = (ssize_t)http_write(http, buffer, (int)length);
+        bytes = (ssize_t)length;
 
       DEBUG_printf(("2httpWrite2: Wrote " CUPS_LLFMT " bytes...",
                     CUPS_LLCAST bytes));
@@ -3612,15 +3760,15 @@ httpWriteResponse(http_t        *http,	/* I - HTTP connection */
     return (-1);
   }
 
-  if (httpFlushWrite(http) < 0)
-  {
-    http->status = HTTP_STATUS_ERROR;
-    return (-1);
-  }
-
   if (status == HTTP_STATUS_CONTINUE ||
       status == HTTP_STATUS_SWITCHING_PROTOCOLS)
   {
+    if (httpFlushWrite(http) < 0)
+    {
+      http->status = HTTP_STATUS_ERROR;
+      return (-1);
+    }
+
    /*
     * Restore the old data_encoding and data_length values...
     */
@@ -3643,6 +3791,12 @@ httpWriteResponse(http_t        *http,	/* I - HTTP connection */
     DEBUG_printf(("1httpWriteResponse: Resetting state to HTTP_STATE_WAITING, "
                   "was %s.", httpStateString(http->state)));
     http->state = HTTP_STATE_WAITING;
+
+    if (httpFlushWrite(http) < 0)
+    {
+      http->status = HTTP_STATUS_ERROR;
+      return (-1);
+    }
   }
   else
   {
@@ -3658,9 +3812,38 @@ httpWriteResponse(http_t        *http,	/* I - HTTP connection */
       DEBUG_printf(("1httpWriteResponse: Resetting state to HTTP_STATE_WAITING, "
                     "was %s.", httpStateString(http->state)));
       http->state = HTTP_STATE_WAITING;
+
+      if (httpFlushWrite(http) < 0)
+      {
+	http->status = HTTP_STATUS_ERROR;
+	return (-1);
+      }
+
       return (0);
     }
 
+   /*
+    * Plain content follows the header, so leave the header in the write
+    * buffer to be sent along with the first part of the content.  Otherwise
+    * send it now as-is, since http_set_length() has already selected any
+    * chunking and content coding...
+    */
+
+    if ((http->data_encoding != HTTP_ENCODING_LENGTH ||
+         httpGetField(http, HTTP_FIELD_CONTENT_ENCODING)[0]) && http->wused)
+    {
+      ssize_t	bytes = http_write(http, http->wbuffer, (size_t)http->wused);
+					/* Bytes written */
+
+      http->wused = 0;
+
+      if (bytes < 0)
+      {
+	http->status = HTTP_STATUS_ERROR;
+	return (-1);
+      }
+    }
+
 #ifdef HAVE_LIBZ
    /*
     * Then start any content encoding...
@@ -3700,12 +3883,12 @@ http_content_coding_finish(
         do
         {
           http->stream.next_out  = (Bytef *)http->wbuffer + http->wused;
-          http->stream.avail_out = sizeof(http->wbuffer) - http->wused;
+          http->stream.avail_out = http->wbufsize - http->wused;
 
           zerr = deflate(&(http->stream), Z_FINISH);
 
-          http->wused = sizeof(http->wbuffer) - http->stream.avail_out;
-          if (http->wused == sizeof(http->wbuffer))
+          http->wused = (int)(http->wbufsize - http->stream.avail_out);
+          if ((size_t)http->wused == http->wbufsize)
             httpFlushWrite(http);
         }
         while (zerr == Z_OK);
@@ -3915,6 +4098,23 @@ http_create(
     return (NULL);
   }
 
+ /*
+  * Start with small data buffers; they grow as needed for bulk transfers...
+  */
+
+  if ((http->buffer = malloc(HTTP_MAX_BUFFER)) == NULL ||
+      (http->wbuffer = malloc(HTTP_MAX_BUFFER)) == NULL)
+  {
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
+    httpAddrFreeList(myaddrlist);
+    free(http->buffer);
+    free(http);
+    return (NULL);
+  }
+
+  http->bufsize  = HTTP_MAX_BUFFER;
+  http->wbufsize = HTTP_MAX_BUFFER;
+
  /*
   * Initialize the HTTP data...
   */
@@ -4156,7 +4356,53 @@ http_read_buffered(http_t *http,	/* I - HTTP connection */
       memmove(http->buffer, http->buffer + bytes, http->used);
   }
   else
-    bytes = http_read(http, buffer, length);
+  {
+    if (length >= http->bufsize && http->bufsize < _HTTP_MAX_SBUFFER)
+    {
+     /*
+      * Grow the input buffer for bulk transfers...
+      */
+
+      size_t	bufsize = http->bufsize;/* New size of buffer */
+      char	*newbuffer;		/* New buffer */
+
+      while (bufsize <= length && bufsize < _HTTP_MAX_SBUFFER)
+        bufsize *= 2;
+
+      if ((newbuffer = realloc(http->buffer, bufsize)) != NULL)
+      {
+	http->buffer  = newbuffer;
+	http->bufsize = bufsize;
+
+	DEBUG_printf(("2http_read_buffered: Grew buffer to %d bytes.",
+		      (int)bufsize));
+      }
+    }
+
+    if (length < http->bufsize)
+    {
+     /*
+      * Read ahead into the input buffer so that small reads (IPP attributes,
+      * chunk headers, etc.) don't each need a system call...
+      */
+
+      if ((bytes = http_read(http, http->buffer, http->bufsize)) > 0)
+      {
+	http->used = (int)bytes;
+
+	if ((size_t)bytes > length)
+	  bytes = (ssize_t)length;
+
+	memcpy(buffer, http->buffer, (size_t)bytes);
+	http->used -= (int)bytes;
+
+	if (http->used > 0)
+	  memmove(http->buffer, http->buffer + bytes, (size_t)http->used);
+      }
+    }
+    else
+      bytes = http_read(http, buffer, length);
+  }
 
   return (bytes);
 }
@@ -4751,45 +4997,151 @@ http_write(http_t     *http,		/* I - HTTP connection */
 
 
 /*
- * 'http_write_chunk()' - Write a chunked buffer.
+ * 'http_write_data()' - Write buffered and new data to a HTTP connection.
+ *
+ * Any data in the write buffer is sent ahead of the new data, as a single
+ * chunk when using chunked encoding.
  */
 
-static ssize_t				/* O - Number bytes written */
-http_write_chunk(http_t     *http,	/* I - HTTP connection */
-                 const char *buffer,	/* I - Buffer to write */
-		 size_t        length)	/* I - Length of buffer */
+static ssize_t				/* O - Number of bytes written or -1 on error */
+http_write_data(http_t     *http,	/* I - HTTP connection */
+                const char *buffer,	/* I - New data or NULL */
+		size_t     length)	/* I - Length of new data */
 {
+  struct iovec	iov[4];			/* Data to write */
+  int		iovcnt = 0;		/* Number of data vectors */
   char		header[16];		/* Chunk header */
-  ssize_t	bytes;			/* Bytes written */
+  size_t	total;			/* Total bytes of data */
 
 
-  DEBUG_printf(("7http_write_chunk(http=%p, buffer=%p, length=" CUPS_LLFMT ")",
-                http, buffer, CUPS_LLCAST length));
+  DEBUG_printf(("7http_write_data(http=%p, buffer=%p, length=" CUPS_LLFMT
+                ") wused=%d", http, buffer, CUPS_LLCAST length, http->wused));
+
+  total = (size_t)http->wused + length;
 
  /*
-  * Write the chunk header, data, and trailer.
+  * Write the chunk header, buffered data, new data, and chunk trailer...
   */
 
-  snprintf(header, sizeof(header), "%x\r\n", (unsigned)length);
-  if (http_write(http, header, strlen(header)) < 0)
+  if (http->data_encoding == HTTP_ENCODING_CHUNKED)
   {
-    DEBUG_puts("8http_write_chunk: http_write of length failed.");
-    return (-1);
+    snprintf(header, sizeof(header), "%x\r\n", (unsigned)total);
+
+    iov[iovcnt].iov_base = header;
+    iov[iovcnt].iov_len  = strlen(header);
+    iovcnt ++;
   }
 
-  if ((bytes = http_write(http, buffer, length)) < 0)
+  if (http->wused > 0)
   {
-    DEBUG_puts("8http_write_chunk: http_write of buffer failed.");
-    return (-1);
+    iov[iovcnt].iov_base = http->wbuffer;
+    iov[iovcnt].iov_len  = (size_t)http->wused;
+    iovcnt ++;
   }
 
-  if (http_write(http, "\r\n", 2) < 0)
+  if (length > 0)
   {
-    DEBUG_puts("8http_write_chunk: http_write of CR LF failed.");
+    iov[iovcnt].iov_base = (void *)buffer;
+    iov[iovcnt].iov_len  = length;
+    iovcnt ++;
+  }
+
+  if (http->data_encoding == HTTP_ENCODING_CHUNKED)
+  {
+    iov[iovcnt].iov_base = (void *)"\r\n";
+    iov[iovcnt].iov_len  = 2;
+    iovcnt ++;
+  }
+
+  http->wused = 0;
+
+  if (http_writev(http, iov, iovcnt) < 0)
+  {
+    DEBUG_puts("8http_write_data: http_writev failed.");
     return (-1);
   }
 
-  return (bytes);
+  return ((ssize_t)total);
+}
+
+
+/*
+ * 'http_writev()' - Write multiple buffers to a HTTP connection.
+ *
+ * Unencrypted data is written using writev() when the socket is ready; anything
+ * left over is written using http_write() so that timeouts and errors are
+ * handled the same way.
+ */
+
+static ssize_t				/* O - Number of bytes written or -1 on error */
+http_writev(http_t       *http,		/* I - HTTP connection */
+            struct iovec *iov,		/* I - Data to write */
+	    int          iovcnt)	/* I - Number of data vectors */
+{
+  ssize_t	tbytes = 0,		/* Total bytes written */
+		bytes;			/* Bytes written */
+
+
+#ifndef WIN32
+#  ifdef HAVE_SSL
+  if (!http->tls)
+#  endif /* HAVE_SSL */
+  {
+#  ifdef HAVE_POLL
+    struct pollfd	pfd;		/* Polled file descriptor */
+#  endif /* HAVE_POLL */
+
+#  ifdef HAVE_POLL
+    pfd.fd     = http->fd;
+    pfd.events = POLLOUT;
+
+    if (!http->timeout_cb || poll(&pfd, 1, 0) > 0)
+#  else
+    if (!http->timeout_cb)
+#  endif /* HAVE_POLL */
+    {
+      while ((bytes = writev(http->fd, iov, iovcnt)) < 0 && errno == EINTR);
+
+      DEBUG_printf(("3http_writev: writev of %d vectors returned " CUPS_LLFMT
+                    ".", iovcnt, CUPS_LLCAST bytes));
+
+      if (bytes > 0)
+      {
+       /*
+        * Skip the data that was written...
+	*/
+
+        tbytes = bytes;
+
+	while (iovcnt > 0 && (size_t)bytes >= iov->iov_len)
+	{
+	  bytes -= (ssize_t)iov->iov_len;
+	  iov ++;
+	  iovcnt --;
+	}
+
+	if (iovcnt > 0)
+	{
+	  iov->iov_base = (char *)iov->iov_base + bytes;
+	  iov->iov_len  -= (size_t)bytes;
+	}
+      }
+    }
+  }
+#endif /* !WIN32 */
+
+  for (; iovcnt > 0; iov ++, iovcnt --)
+  {
+    if (iov->iov_len == 0)
+      continue;
+
+    if ((bytes = http_write(http, iov->iov_base, iov->iov_len)) < 0)
+      return (-1);
+
+    tbytes += bytes;
+  }
+
+  return (tbytes);
 }
 
 
@@ -40,12 +40,25 @@ extern "C" {
 
 #  define IPP_BUF_SIZE	(IPP_MAX_LENGTH + 2)
 					/* Size of buffer */
+#  define IPP_INDEX_MIN	32		/* Attributes scanned before a
+					 * message gets a name index */
+#  define IPP_INDEX_HASH	256		/* Size of name index hash */
+#  define IPP_ARENA_SIZE	16384		/* Size of arena blocks */
+#  define IPP_ARENA_ALIGN(n) (((n) + 7) & ~(size_t)7)
+					/* Round up to arena alignment */
 
 
 /*
  * Structures...
  */
 
+typedef struct _ipp_arena_s		/**** Arena memory block ****/
+{
+  struct _ipp_arena_s	*next;		/* Next (older) block */
+  size_t		used,		/* Bytes used in block */
+			size;		/* Bytes available in block */
+} _ipp_arena_t;
+
 typedef struct				/**** Attribute mapping data ****/
 {
   int		multivalue;		/* Option has multiple values? */
@@ -65,6 +78,8 @@ typedef struct				/**** Attribute mapping data ****/
 #ifdef DEBUG
 extern const char	*_ippCheckOptions(void);
 #endif /* DEBUG */
+extern ipp_attribute_t	*_ippAddEncoded(ipp_t *ipp, ipp_tag_t group,
+			                const ipp_uchar_t *data, int datalen);
 extern _ipp_option_t	*_ippFindOption(const char *name);
 
 /*
@@ -228,7 +228,8 @@ static const char * const ipp_std_ops[] =
 		},
 		* const ipp_cups_ops2[] =
 		{
-		  "CUPS-Get-Document"
+		  "CUPS-Get-Document",
+		  "CUPS-Get-Statistics"
 		},
 		* const ipp_tag_names[] =
 		{			/* Value/group tag names */
@@ -1580,6 +1581,7 @@ ippCreateRequestedArray(ipp_t *request)	/* I - IPP request */
     "requesting-user-name-allowed",	/* CUPS extension */
     "requesting-user-name-denied",	/* CUPS extension */
     "requesting-user-uri-supported",
+    "spool-compression",		/* CUPS extension */
     "subordinate-printers-supported",
     "urf-supported",			/* CUPS extension */
     "uri-authentication-supported",
@@ -2027,8 +2029,8 @@ ippOpString(ipp_op_t op)		/* I - Operation ID */
     return ("windows-ext");
   else if (op >= IPP_OP_CUPS_GET_DEFAULT && op <= IPP_OP_CUPS_GET_PPD)
     return (ipp_cups_ops[op - IPP_OP_CUPS_GET_DEFAULT]);
-  else if (op == IPP_OP_CUPS_GET_DOCUMENT)
-    return (ipp_cups_ops2[0]);
+  else if (op >= IPP_OP_CUPS_GET_DOCUMENT && op <= IPP_OP_CUPS_GET_STATISTICS)
+    return (ipp_cups_ops2[op - IPP_OP_CUPS_GET_DOCUMENT]);
 
  /*
   * No, build an "0xxxxx" operation string...
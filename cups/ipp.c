@@ -18,6 +18,7 @@
  *
  *   _cupsBufferGet()	     - Get a read/write buffer.
  *   _cupsBufferRelease()    - Release a read/write buffer.
+ *   _ippAddEncoded()	     - Add pre-encoded attributes to an IPP message.
  *   ippAddBoolean()	     - Add a boolean attribute to an IPP message.
  *   ippAddBooleans()	     - Add an array of boolean values.
  *   ippAddCollection()      - Add a collection value.
@@ -73,6 +74,8 @@
  *   ippLength()	     - Compute the length of an IPP message.
  *   ippNextAttribute()      - Return the next attribute in the message.
  *   ippNew()		     - Allocate a new IPP message.
+ *   ippNewArena()	     - Allocate a new IPP message that uses a memory
+ *			       arena.
  *   ippNewRequest()	     - Allocate a new IPP request message.
  *   ippNewResponse()	     - Allocate a new IPP response message.
  *   ippRead()		     - Read data for an IPP message from a HTTP
@@ -106,9 +109,16 @@
  *   ippWriteFile()	     - Write data for an IPP message to a file.
  *   ippWriteIO()	     - Write data for an IPP message.
  *   ipp_add_attr()	     - Add a new attribute to the message.
+ *   ipp_arena_alloc()	     - Allocate zeroed memory from a message's arena.
+ *   ipp_arena_strdup()      - Copy a string into a message's arena.
  *   ipp_free_values()	     - Free attribute values.
+ *   ipp_compare_names()     - Compare two attribute names for the index.
  *   ipp_get_code()	     - Convert a C locale/charset name into an IPP
  *			       language/charset code.
+ *   ipp_hash_name()	     - Hash an attribute name for the index.
+ *   ipp_index_build()	     - Build the attribute name index for a message.
+ *   ipp_index_clear()	     - Discard the attribute name index for a
+ *			       message.
  *   ipp_lang_code()	     - Convert a C locale name into an IPP language
  *			       code.
  *   ipp_length()	     - Compute the length of an IPP message or
@@ -139,8 +149,15 @@
 static ipp_attribute_t	*ipp_add_attr(ipp_t *ipp, const char *name,
 			              ipp_tag_t  group_tag, ipp_tag_t value_tag,
 			              int num_values);
+static void		*ipp_arena_alloc(ipp_t *ipp, size_t bytes);
+static char		*ipp_arena_strdup(ipp_t *ipp, const char *s);
+static int		ipp_compare_names(ipp_attribute_t *a,
+			                  ipp_attribute_t *b);
 static void		ipp_free_values(ipp_attribute_t *attr, int element,
 			                int count);
+static int		ipp_hash_name(ipp_attribute_t *attr);
+static void		ipp_index_build(ipp_t *ipp);
+static void		ipp_index_clear(ipp_t *ipp);
 static char		*ipp_get_code(const char *locale, char *buffer,
 			              size_t bufsize)
 			              __attribute__((nonnull(1,2)));
@@ -211,6 +228,53 @@ _cupsBufferRelease(char *b)		/* I - Buffer to release */
 }
 
 
+/*
+ * '_ippAddEncoded()' - Add pre-encoded attributes to an IPP message.
+ *
+ * The data must contain one or more complete attributes (value tag, name,
+ * and values) in wire format, all in the named group.  The data is copied
+ * and written as-is by @link ippWriteIO@; the attribute has no name, so it
+ * is not seen by @link ippFindAttribute@.
+ */
+
+ipp_attribute_t	*			/* O - New attribute */
+_ippAddEncoded(ipp_t             *ipp,	/* I - IPP message */
+               ipp_tag_t         group,	/* I - IPP group */
+               const ipp_uchar_t *data,	/* I - Encoded attributes */
+	       int               datalen)
+					/* I - Length of encoded attributes */
+{
+  ipp_attribute_t	*attr;		/* New attribute */
+
+
+  if (!ipp || group <= IPP_TAG_ZERO || group == IPP_TAG_END ||
+      group >= IPP_TAG_UNSUPPORTED_VALUE || !data || datalen <= 0)
+    return (NULL);
+
+  if ((attr = ipp_add_attr(ipp, NULL, group, IPP_TAG_EXTENSION, 1)) == NULL)
+    return (NULL);
+
+  if (ipp->arena)
+  {
+    attr->value_tag              = IPP_TAG_EXTENSION | IPP_TAG_CUPS_CONST;
+    attr->values[0].unknown.data = ipp_arena_alloc(ipp, (size_t)datalen);
+  }
+  else
+    attr->values[0].unknown.data = malloc((size_t)datalen);
+
+  if (!attr->values[0].unknown.data)
+  {
+    ippDeleteAttribute(ipp, attr);
+    return (NULL);
+  }
+
+  memcpy(attr->values[0].unknown.data, data, (size_t)datalen);
+  attr->values[0].unknown.length = datalen;
+
+  return (attr);
+}
+
+
 /*
  * 'ippAddBoolean()' - Add a boolean attribute to an IPP message.
  *
@@ -1079,6 +1143,27 @@ ippAddString(ipp_t      *ipp,		/* I - IPP message */
     attr->values[0].string.language = (char *)language;
     attr->values[0].string.text     = (char *)value;
   }
+  else if (ipp->arena && value)
+  {
+   /*
+    * Copy the strings into the arena; they are freed with the message...
+    */
+
+    attr->value_tag = (ipp_tag_t)(value_tag | IPP_TAG_CUPS_CONST);
+
+    if (language)
+      attr->values[0].string.language =
+          ipp_arena_strdup(ipp, ipp_lang_code(language, code, sizeof(code)));
+
+    if (value_tag == IPP_TAG_CHARSET)
+      attr->values[0].string.text =
+          ipp_arena_strdup(ipp, ipp_get_code(value, code, sizeof(code)));
+    else if (value_tag == IPP_TAG_LANGUAGE)
+      attr->values[0].string.text =
+          ipp_arena_strdup(ipp, ipp_lang_code(value, code, sizeof(code)));
+    else
+      attr->values[0].string.text = ipp_arena_strdup(ipp, value);
+  }
   else
   {
     if (language)
@@ -1419,6 +1504,40 @@ ippAddStrings(
   if ((attr = ipp_add_attr(ipp, name, group, value_tag, num_values)) == NULL)
     return (NULL);
 
+  if (ipp->arena && values && !((int)value_tag & IPP_TAG_CUPS_CONST))
+  {
+   /*
+    * Copy the strings into the arena; they are freed with the message...
+    */
+
+    attr->value_tag = (ipp_tag_t)(value_tag | IPP_TAG_CUPS_CONST);
+
+    for (i = num_values, value = attr->values;
+	 i > 0;
+	 i --, value ++)
+    {
+      if (language)
+      {
+	if (value == attr->values)
+	  value->string.language =
+	      ipp_arena_strdup(ipp, ipp_lang_code(language, code, sizeof(code)));
+	else
+	  value->string.language = attr->values[0].string.language;
+      }
+
+      if (value_tag == IPP_TAG_CHARSET)
+	value->string.text =
+	    ipp_arena_strdup(ipp, ipp_get_code(*values++, code, sizeof(code)));
+      else if (value_tag == IPP_TAG_LANGUAGE)
+	value->string.text =
+	    ipp_arena_strdup(ipp, ipp_lang_code(*values++, code, sizeof(code)));
+      else
+	value->string.text = ipp_arena_strdup(ipp, *values++);
+    }
+
+    return (attr);
+  }
+
  /*
   * Initialize the attribute data...
   */
@@ -1942,6 +2061,8 @@ ippDelete(ipp_t *ipp)			/* I - IPP message */
 {
   ipp_attribute_t	*attr,		/* Current attribute */
 			*next;		/* Next attribute */
+  _ipp_arena_t		*block,		/* Current arena block */
+			*nextblock;	/* Next arena block */
 
 
   DEBUG_printf(("ippDelete(ipp=%p)", ipp));
@@ -1959,12 +2080,23 @@ ippDelete(ipp_t *ipp)			/* I - IPP message */
 
     ipp_free_values(attr, 0, attr->num_values);
 
+    if (ipp->arena)
+      continue;
+
     if (attr->name)
       _cupsStrFree(attr->name);
 
     free(attr);
   }
 
+  for (block = ipp->arena; block; block = nextblock)
+  {
+    nextblock = block->next;
+    free(block);
+  }
+
+  ipp_index_clear(ipp);
+
   free(ipp);
 }
 
@@ -2022,6 +2154,8 @@ ippDeleteAttribute(
 
     if (!current)
       return;
+
+    ipp_index_clear(ipp);
   }
 
  /*
@@ -2030,6 +2164,9 @@ ippDeleteAttribute(
 
   ipp_free_values(attr, 0, attr->num_values);
 
+  if (ipp && ipp->arena)
+    return;
+
   if (attr->name)
     _cupsStrFree(attr->name);
 
@@ -2096,6 +2233,12 @@ ippFindAttribute(ipp_t      *ipp,	/* I - IPP message */
                  const char *name,	/* I - Name of attribute */
 		 ipp_tag_t  type)	/* I - Type of attribute */
 {
+  ipp_attribute_t	*attr,		/* Current attribute */
+			key;		/* Search key */
+  ipp_tag_t		value_tag;	/* Value tag */
+  int			count;		/* Number of attributes scanned */
+
+
   DEBUG_printf(("2ippFindAttribute(ipp=%p, name=\"%s\", type=%02x(%s))", ipp,
                 name, type, ippTagString(type)));
 
@@ -2107,12 +2250,70 @@ ippFindAttribute(ipp_t      *ipp,	/* I - IPP message */
   */
 
   ipp->current = NULL;
+  ipp->prev    = NULL;
+
+  if (ipp->index)
+  {
+   /*
+    * Look the name up in the index; attributes with the same name are kept
+    * in message order.  The previous attribute is not known here, so
+    * ipp->prev is left NULL and callers that need it search the list...
+    */
+
+    key.name = (char *)name;
+
+    for (attr = (ipp_attribute_t *)cupsArrayFind(ipp->index, &key);
+         attr && !_cups_strcasecmp(attr->name, name);
+	 attr = (ipp_attribute_t *)cupsArrayNext(ipp->index))
+    {
+      value_tag = (ipp_tag_t)(attr->value_tag & IPP_TAG_CUPS_MASK);
+
+      if (value_tag == type || type == IPP_TAG_ZERO ||
+	  (value_tag == IPP_TAG_TEXTLANG && type == IPP_TAG_TEXT) ||
+	  (value_tag == IPP_TAG_NAMELANG && type == IPP_TAG_NAME))
+      {
+        ipp->current = attr;
+
+        return (attr);
+      }
+    }
+
+    return (NULL);
+  }
 
  /*
-  * Search for the attribute...
+  * Search for the attribute, counting how many attributes we had to look at
+  * before finding it...
   */
 
-  return (ippFindNextAttribute(ipp, name, type));
+  for (attr = ipp->attrs, count = 0; attr != NULL; attr = attr->next, count ++)
+  {
+    value_tag = (ipp_tag_t)(attr->value_tag & IPP_TAG_CUPS_MASK);
+
+    if (attr->name != NULL && _cups_strcasecmp(attr->name, name) == 0 &&
+        (value_tag == type || type == IPP_TAG_ZERO ||
+	 (value_tag == IPP_TAG_TEXTLANG && type == IPP_TAG_TEXT) ||
+	 (value_tag == IPP_TAG_NAMELANG && type == IPP_TAG_NAME)))
+    {
+      ipp->current = attr;
+      break;
+    }
+
+    ipp->prev = attr;
+  }
+
+  if (!attr)
+    ipp->prev = NULL;
+
+ /*
+  * Large messages like printer and job attributes get looked up over and
+  * over, so index them once a lookup has become expensive...
+  */
+
+  if (count >= IPP_INDEX_MIN)
+    ipp_index_build(ipp);
+
+  return (attr);
 }
 
 
@@ -2755,6 +2956,48 @@ ippNew(void)
 }
 
 
+/*
+ * 'ippNewArena()' - Allocate a new IPP message that uses a memory arena.
+ *
+ * Attributes, names, and string values added to the message are allocated
+ * from large blocks that are all freed at once by @link ippDelete@, which is
+ * much faster for short-lived messages with many attributes.  Attributes in
+ * the message must be deleted using @link ippDeleteAttribute@ with the
+ * message argument, and strings added with @code IPP_TAG_CUPS_CONST@ or
+ * copied from the message with @link ippCopyAttribute@'s "quickcopy" option
+ * are only valid until the message is deleted.
+ *
+ * @since CUPS 2.0@
+ */
+
+ipp_t *					/* O - New IPP message */
+ippNewArena(void)
+{
+  ipp_t	*temp;				/* New IPP message */
+
+
+  DEBUG_puts("ippNewArena()");
+
+  if ((temp = ippNew()) != NULL)
+  {
+    if ((temp->arena = malloc(IPP_ARENA_ALIGN(sizeof(_ipp_arena_t)) +
+                              IPP_ARENA_SIZE)) == NULL)
+    {
+      free(temp);
+      return (NULL);
+    }
+
+    temp->arena->next = NULL;
+    temp->arena->used = 0;
+    temp->arena->size = IPP_ARENA_SIZE;
+  }
+
+  DEBUG_printf(("1ippNewArena: Returning %p", temp));
+
+  return (temp);
+}
+
+
 /*
  *  'ippNewRequest()' - Allocate a new IPP request message.
  *
@@ -3670,7 +3913,12 @@ ippReadIO(void       *src,		/* I - Data source */
 		}
 
 		buffer[n] = '\0';
-		attr->name = _cupsStrAlloc((char *)buffer);
+		if (ipp->arena)
+		  attr->name = ipp_arena_strdup(ipp, (char *)buffer);
+		else
+		  attr->name = _cupsStrAlloc((char *)buffer);
+
+		ipp_index_clear(ipp);
 
                /*
 	        * Since collection members are encoded differently than
@@ -3989,7 +4237,12 @@ ippSetName(ipp_t           *ipp,	/* I  - IPP message */
   * Set the value and return...
   */
 
-  if ((temp = _cupsStrAlloc(name)) != NULL)
+  if (ipp->arena)
+  {
+    if ((temp = ipp_arena_strdup(ipp, name)) != NULL)
+      (*attr)->name = temp;
+  }
+  else if ((temp = _cupsStrAlloc(name)) != NULL)
   {
     if ((*attr)->name)
       _cupsStrFree((*attr)->name);
@@ -3997,6 +4250,9 @@ ippSetName(ipp_t           *ipp,	/* I  - IPP message */
     (*attr)->name = temp;
   }
 
+  if (temp)
+    ipp_index_clear(ipp);
+
   return (temp != NULL);
 }
 
@@ -4329,17 +4585,21 @@ ippSetString(ipp_t           *ipp,	/* I  - IPP message */
 {
   char		*temp;			/* Temporary string */
   _ipp_value_t	*value;			/* Current value */
+  ipp_tag_t	value_tag;		/* Value tag */
 
 
  /*
   * Range check input...
   */
 
+  if (attr && *attr)
+    value_tag = (*attr)->value_tag & IPP_TAG_CUPS_MASK;
+  else
+    value_tag = IPP_TAG_ZERO;
+
   if (!ipp || !attr || !*attr ||
-      ((*attr)->value_tag != IPP_TAG_TEXTLANG &&
-      (*attr)->value_tag != IPP_TAG_NAMELANG &&
-       ((*attr)->value_tag < IPP_TAG_TEXT ||
-        (*attr)->value_tag > IPP_TAG_MIMETYPE)) ||
+      (value_tag != IPP_TAG_TEXTLANG && value_tag != IPP_TAG_NAMELANG &&
+       (value_tag < IPP_TAG_TEXT || value_tag > IPP_TAG_MIMETYPE)) ||
       element < 0 || element > (*attr)->num_values || !strvalue)
     return (0);
 
@@ -4353,7 +4613,8 @@ ippSetString(ipp_t           *ipp,	/* I  - IPP message */
       value->string.language = (*attr)->values[0].string.language;
 
     if ((int)((*attr)->value_tag) & IPP_TAG_CUPS_CONST)
-      value->string.text = (char *)strvalue;
+      value->string.text = ipp->arena ? ipp_arena_strdup(ipp, strvalue) :
+                                        (char *)strvalue;
     else if ((temp = _cupsStrAlloc(strvalue)) != NULL)
     {
       if (value->string.text)
@@ -5631,6 +5892,28 @@ ippWriteIO(void       *dst,		/* I - Destination */
 	    }
 	    else if (attr->group_tag == IPP_TAG_ZERO)
 	      continue;
+
+	    if (!attr->name)
+	    {
+	     /*
+	      * Write pre-encoded attributes as-is...
+	      */
+
+	      if ((bufptr > buffer &&
+	           (*cb)(dst, buffer, (int)(bufptr - buffer)) < 0) ||
+	          (*cb)(dst, attr->values[0].unknown.data,
+		        attr->values[0].unknown.length) < 0)
+	      {
+		DEBUG_puts("1ippWriteIO: Could not write IPP attribute...");
+		_cupsBufferRelease((char *)buffer);
+		return (IPP_STATE_ERROR);
+	      }
+
+	      if (!blocking && ipp->current)
+		break;
+	      else
+		continue;
+	    }
 	  }
 
 	  DEBUG_printf(("1ippWriteIO: %s (%s%s)", attr->name,
@@ -6439,8 +6722,12 @@ ipp_add_attr(ipp_t      *ipp,		/* I - IPP message */
   else
     alloc_values = (num_values + IPP_MAX_VALUES - 1) & ~(IPP_MAX_VALUES - 1);
 
-  attr = calloc(sizeof(ipp_attribute_t) +
-                (alloc_values - 1) * sizeof(_ipp_value_t), 1);
+  if (ipp->arena)
+    attr = ipp_arena_alloc(ipp, sizeof(ipp_attribute_t) +
+                                (alloc_values - 1) * sizeof(_ipp_value_t));
+  else
+    attr = calloc(sizeof(ipp_attribute_t) +
+                  (alloc_values - 1) * sizeof(_ipp_value_t), 1);
 
   if (attr)
   {
@@ -6449,7 +6736,8 @@ ipp_add_attr(ipp_t      *ipp,		/* I - IPP message */
     */
 
     if (name)
-      attr->name = _cupsStrAlloc(name);
+      attr->name = ipp->arena ? ipp_arena_strdup(ipp, name) :
+                                _cupsStrAlloc(name);
 
     attr->group_tag  = group_tag;
     attr->value_tag  = value_tag;
@@ -6466,6 +6754,13 @@ ipp_add_attr(ipp_t      *ipp,		/* I - IPP message */
 
     ipp->prev = ipp->last;
     ipp->last = ipp->current = attr;
+
+   /*
+    * Keep any name index current...
+    */
+
+    if (ipp->index && attr->name)
+      cupsArrayAdd(ipp->index, attr);
   }
 
   DEBUG_printf(("5ipp_add_attr: Returning %p", attr));
@@ -6474,6 +6769,94 @@ ipp_add_attr(ipp_t      *ipp,		/* I - IPP message */
 }
 
 
+/*
+ * 'ipp_arena_alloc()' - Allocate zeroed memory from a message's arena.
+ */
+
+static void *				/* O - Memory or @code NULL@ on error */
+ipp_arena_alloc(ipp_t  *ipp,		/* I - IPP message */
+                size_t bytes)		/* I - Number of bytes */
+{
+  _ipp_arena_t	*block;			/* Arena block */
+  char		*ptr;			/* Allocated memory */
+
+
+  bytes = IPP_ARENA_ALIGN(bytes);
+  block = ipp->arena;
+
+  if (block->used + bytes > block->size)
+  {
+   /*
+    * Allocate a new block; large requests get a block of their own that is
+    * linked in behind the current one so the rest of it can still be used...
+    */
+
+    size_t size = bytes > IPP_ARENA_SIZE / 4 ? bytes : IPP_ARENA_SIZE;
+					/* Size of new block */
+
+    if ((block = malloc(IPP_ARENA_ALIGN(sizeof(_ipp_arena_t)) + size)) == NULL)
+    {
+      DEBUG_printf(("5ipp_arena_alloc: Unable to allocate %d bytes.",
+                    (int)size));
+      return (NULL);
+    }
+
+    block->used = 0;
+    block->size = size;
+
+    if (size == IPP_ARENA_SIZE)
+    {
+      block->next = ipp->arena;
+      ipp->arena  = block;
+    }
+    else
+    {
+      block->next      = ipp->arena->next;
+      ipp->arena->next = block;
+    }
+  }
+
+  ptr         = (char *)block + IPP_ARENA_ALIGN(sizeof(_ipp_arena_t)) +
+                block->used;
+  block->used += bytes;
+
+  memset(ptr, 0, bytes);
+
+  return (ptr);
+}
+
+
+/*
+ * 'ipp_arena_strdup()' - Copy a string into a message's arena.
+ */
+
+static char *				/* O - Copy of string */
+ipp_arena_strdup(ipp_t      *ipp,	/* I - IPP message */
+                 const char *s)		/* I - String to copy */
+{
+  size_t	bytes = strlen(s) + 1;	/* Length of string */
+  char		*copy;			/* Copy of string */
+
+
+  if ((copy = ipp_arena_alloc(ipp, bytes)) != NULL)
+    memcpy(copy, s, bytes);
+
+  return (copy);
+}
+
+
+/*
+ * 'ipp_compare_names()' - Compare two attribute names for the index.
+ */
+
+static int				/* O - Result of comparison */
+ipp_compare_names(ipp_attribute_t *a,	/* I - First attribute */
+                  ipp_attribute_t *b)	/* I - Second attribute */
+{
+  return (_cups_strcasecmp(a->name, b->name));
+}
+
+
 /*
  * 'ipp_free_values()' - Free attribute values.
  */
@@ -6616,6 +6999,67 @@ ipp_get_code(const char *value,		/* I - Locale/charset string */
 }
 
 
+/*
+ * 'ipp_hash_name()' - Hash an attribute name for the index.
+ */
+
+static int				/* O - Hash value */
+ipp_hash_name(ipp_attribute_t *attr)	/* I - Attribute */
+{
+  unsigned	hash;			/* Hash value */
+  const char	*name;			/* Pointer into name */
+
+
+  for (hash = 0, name = attr->name; *name; name ++)
+    hash = 31 * hash + (unsigned)_cups_tolower(*name);
+
+  return ((int)(hash % IPP_INDEX_HASH));
+}
+
+
+/*
+ * 'ipp_index_build()' - Build the attribute name index for a message.
+ */
+
+static void
+ipp_index_build(ipp_t *ipp)		/* I - IPP message */
+{
+  ipp_attribute_t	*attr;		/* Current attribute */
+
+
+  if ((ipp->index = cupsArrayNew2((cups_array_func_t)ipp_compare_names, NULL,
+                                  (cups_ahash_func_t)ipp_hash_name,
+				  IPP_INDEX_HASH)) == NULL)
+    return;
+
+ /*
+  * Adding in message order keeps attributes with the same name (in different
+  * groups, typically) in message order as well...
+  */
+
+  for (attr = ipp->attrs; attr; attr = attr->next)
+    if (attr->name)
+      cupsArrayAdd(ipp->index, attr);
+}
+
+
+/*
+ * 'ipp_index_clear()' - Discard the attribute name index for a message.
+ *
+ * The index is rebuilt by the next expensive @link ippFindAttribute@ call.
+ */
+
+static void
+ipp_index_clear(ipp_t *ipp)		/* I - IPP message */
+{
+  if (ipp->index)
+  {
+    cupsArrayDelete(ipp->index);
+    ipp->index = NULL;
+  }
+}
+
+
 /*
  * 'ipp_lang_code()' - Convert a C locale name into an IPP language code.
  *
@@ -6689,7 +7133,13 @@ ipp_length(ipp_t *ipp,			/* I - IPP message or collection */
     }
 
     if (!attr->name)
+    {
+      if (attr->group_tag != IPP_TAG_ZERO && !collection)
+        bytes += attr->values[0].unknown.length;
+					/* Pre-encoded attributes */
+
       continue;
+    }
 
     DEBUG_printf(("5ipp_length: attr->name=\"%s\", attr->num_values=%d, "
                   "bytes=" CUPS_LLFMT, attr->name, attr->num_values, CUPS_LLCAST bytes));
@@ -6928,7 +7378,8 @@ ipp_set_value(ipp_t           *ipp,	/* IO - IPP message */
   ipp_attribute_t	*temp,		/* New attribute pointer */
 			*current,	/* Current attribute in list */
 			*prev;		/* Previous attribute in list */
-  int			alloc_values;	/* Allocated values */
+  int			alloc_values,	/* Allocated values */
+			old_values;	/* Previously allocated values */
 
 
  /*
@@ -6956,6 +7407,8 @@ ipp_set_value(ipp_t           *ipp,	/* IO - IPP message */
   * values when num_values > 1.
   */
 
+  old_values = alloc_values;
+
   if (alloc_values < IPP_MAX_VALUES)
     alloc_values = IPP_MAX_VALUES;
   else
@@ -6968,8 +7421,23 @@ ipp_set_value(ipp_t           *ipp,	/* IO - IPP message */
   * Reallocate memory...
   */
 
-  if ((temp = realloc(temp, sizeof(ipp_attribute_t) +
-			    (alloc_values - 1) * sizeof(_ipp_value_t))) == NULL)
+  if (ipp->arena)
+  {
+   /*
+    * Arena memory cannot be resized, so copy to a new, larger attribute...
+    */
+
+    if ((temp = ipp_arena_alloc(ipp, sizeof(ipp_attribute_t) +
+                                     (alloc_values - 1) *
+				     sizeof(_ipp_value_t))) != NULL)
+      memcpy(temp, *attr, sizeof(ipp_attribute_t) +
+                          (old_values - 1) * sizeof(_ipp_value_t));
+  }
+  else
+    temp = realloc(temp, sizeof(ipp_attribute_t) +
+			 (alloc_values - 1) * sizeof(_ipp_value_t));
+
+  if (!temp)
   {
     _cupsSetHTTPError(HTTP_STATUS_ERROR);
     DEBUG_puts("4ipp_set_value: Unable to resize attribute.");
@@ -7032,6 +7500,8 @@ ipp_set_value(ipp_t           *ipp,	/* IO - IPP message */
     if (ipp->last == *attr)
       ipp->last = temp;
 
+    ipp_index_clear(ipp);
+
     *attr = temp;
   }
 
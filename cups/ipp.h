@@ -309,7 +309,8 @@ typedef enum ipp_op_e			/**** IPP operations ****/
   IPP_OP_CUPS_MOVE_JOB,			/* Move a job to a different printer */
   IPP_OP_CUPS_AUTHENTICATE_JOB,		/* Authenticate a job @since CUPS 1.2/OS X 10.5@ */
   IPP_OP_CUPS_GET_PPD,			/* Get a PPD file @since CUPS 1.3/OS X 10.5@ */
-  IPP_OP_CUPS_GET_DOCUMENT = 0x4027	/* Get a document file @since CUPS 1.4/OS X 10.6@ */
+  IPP_OP_CUPS_GET_DOCUMENT = 0x4027,	/* Get a document file @since CUPS 1.4/OS X 10.6@ */
+  IPP_OP_CUPS_GET_STATISTICS		/* Get scheduler statistics @since CUPS 2.0@ */
 
 #  ifndef _CUPS_NO_DEPRECATED
 #    define IPP_PRINT_JOB			IPP_OP_PRINT_JOB
@@ -387,6 +388,7 @@ typedef enum ipp_op_e			/**** IPP operations ****/
 #    define CUPS_AUTHENTICATE_JOB		IPP_OP_CUPS_AUTHENTICATE_JOB
 #    define CUPS_GET_PPD			IPP_OP_CUPS_GET_PPD
 #    define CUPS_GET_DOCUMENT			IPP_OP_CUPS_GET_DOCUMENT
+#    define CUPS_GET_STATISTICS		IPP_OP_CUPS_GET_STATISTICS
      /* Legacy names */
 #    define CUPS_ADD_PRINTER			IPP_OP_CUPS_ADD_MODIFY_PRINTER
 #    define CUPS_ADD_CLASS			IPP_OP_CUPS_ADD_MODIFY_CLASS
@@ -788,6 +790,10 @@ struct _ipp_s				/**** IPP Request/Response/Notification ****/
 
 /**** New in CUPS 1.4.4 ****/
   int			use;		/* Use count @since CUPS 1.4.4/OS X 10.6.?@ */
+
+/**** New in CUPS 2.0 ****/
+  cups_array_t		*index;		/* Attribute name index @private@ */
+  struct _ipp_arena_s	*arena;		/* Memory arena @private@ */
 };
 #  endif /* _IPP_PRIVATE_STRUCTURES */
 
@@ -983,6 +989,7 @@ extern int		ippValidateAttributes(ipp_t *ipp) _CUPS_API_1_7;
 
 
 /**** New in CUPS 2.0 ****/
+extern ipp_t		*ippNewArena(void) _CUPS_API_2_0;
 extern const char	*ippStateString(ipp_state_t state) _CUPS_API_2_0;
 
 
@@ -17,6 +17,8 @@
  *
  *   _ppdCacheCreateWithFile() - Create PPD cache and mapping data from a
  *                               written file.
+ *   _ppdCacheCreateWithFile2() - Create PPD cache and mapping data from a
+ *                                written file, optionally reading it.
  *   _ppdCacheCreateWithPPD()  - Create PWG mapping data from a PPD file.
  *   _ppdCacheDestroy()        - Free all memory used for PWG mapping data.
  *   _ppdCacheGetBin()         - Get the PWG output-bin keyword associated with
@@ -41,6 +43,15 @@
  *   _pwgMediaTypeForType()    - Get the MediaType name for the given PWG
  *                               media-type.
  *   _pwgPageSizeForMedia()    - Get the PageSize name for the given media.
+ *   ppd_cache_add()           - Add data to a cache file buffer.
+ *   ppd_cache_add_options()   - Add options to the options table.
+ *   ppd_cache_add_string()    - Add a string to the string table.
+ *   ppd_cache_compare_strings() - Compare two strings in the string table.
+ *   ppd_cache_options()       - Validate a range of the options table.
+ *   ppd_cache_read_cb()       - Read IPP data from a cache file.
+ *   ppd_cache_string()        - Get a string from the string table.
+ *   ppd_cache_table()         - Get a table from a cache file.
+ *   ppd_cache_write_cb()      - Write IPP data to a cache file buffer.
  *   pwg_ppdize_name()         - Convert an IPP keyword to a PPD keyword.
  *   pwg_unppdize_name()       - Convert a PPD keyword to a lowercase IPP
  *                               keyword.
@@ -52,6 +63,11 @@
 
 #include "cups-private.h"
 #include <math.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifndef WIN32
+#  include <sys/mman.h>
+#endif /* !WIN32 */
 
 
 /*
@@ -61,10 +77,163 @@
 #define _PWG_EQUIVALENT(x, y)	(abs((x)-(y)) < 2)
 
 
+/*
+ * Cache file format...
+ *
+ * Cache files start with a _ppd_cfile_t header followed by tables of
+ * fixed-size records, a table of nul-terminated strings, and the IPP
+ * attributes.  Tables are referenced by byte offset and count and strings by
+ * their offset in the string table, so the file can be used in place once it
+ * is mapped into memory.  Values are stored in native byte order; a file
+ * written on another architecture is treated as out of date.
+ */
+
+#define _PPD_CFILE_MAGIC	"#CUPS-PPD-CACHE"
+					/* Magic string at start of file */
+#define _PPD_CFILE_MAX		0x7fffffff
+					/* Maximum size of a cache file */
+#define _PPD_CFILE_NONE		0xffffffff
+					/* String offset for NULL */
+#define _PPD_CFILE_ORDER	0x01020304
+					/* Byte order marker */
+
+typedef struct _ppd_ctable_s		/**** Table in cache file ****/
+{
+  unsigned	offset,			/* Byte offset from start of file */
+		count;			/* Number of records (bytes for data) */
+} _ppd_ctable_t;
+
+typedef struct _ppd_cfile_s		/**** Cache file header ****/
+{
+  char		magic[16];		/* _PPD_CFILE_MAGIC */
+  unsigned	version,		/* _PPD_CACHE_VERSION */
+		byte_order,		/* _PPD_CFILE_ORDER */
+		length;			/* Length of file in bytes */
+  _ppd_ctable_t	strings,		/* String table */
+		bins,			/* Output bins (_ppd_cmap_t) */
+		sizes,			/* Media sizes (_ppd_csize_t) */
+		sources,		/* Media sources (_ppd_cmap_t) */
+		types,			/* Media types (_ppd_cmap_t) */
+		options,		/* Preset/finishings options (_ppd_cmap_t) */
+		presets,		/* Presets (_ppd_cpreset_t) */
+		finishings,		/* Finishings (_ppd_cfinishings_t) */
+		filters,		/* cupsFilter/cupsFilter2 strings */
+		prefilters,		/* cupsPreFilter strings */
+		mandatory,		/* cupsMandatory strings */
+		support_files,		/* Support file strings */
+		ipp;			/* IPP attributes */
+  int		custom_max_width,	/* Maximum custom width in 2540ths */
+		custom_max_length,	/* Maximum custom length in 2540ths */
+		custom_min_width,	/* Minimum custom width in 2540ths */
+		custom_min_length,	/* Minimum custom length in 2540ths */
+		custom_left,		/* Custom size left margin */
+		custom_bottom,		/* Custom size bottom margin */
+		custom_right,		/* Custom size right margin */
+		custom_top,		/* Custom size top margin */
+		single_file,		/* cupsSingleFile value */
+		max_copies,		/* cupsMaxCopies value */
+		account_id,		/* cupsJobAccountId value */
+		accounting_user_id;	/* cupsJobAccountingUserId value */
+  unsigned	custom_max_keyword,	/* Maximum custom size PWG keyword */
+		custom_min_keyword,	/* Minimum custom size PWG keyword */
+		source_option,		/* PPD option for media source */
+		sides_option,		/* PPD option for sides */
+		sides_1sided,		/* Choice for one-sided */
+		sides_2sided_long,	/* Choice for two-sided-long-edge */
+		sides_2sided_short,	/* Choice for two-sided-short-edge */
+		product,		/* Product value */
+		password,		/* cupsJobPassword value */
+		charge_info_uri;	/* cupsChargeInfoURI value */
+} _ppd_cfile_t;
+
+typedef struct _ppd_cmap_s		/**** Map or option in cache file ****/
+{
+  unsigned	name,			/* PWG keyword or option name */
+		value;			/* PPD keyword or option value */
+} _ppd_cmap_t;
+
+typedef struct _ppd_csize_s		/**** Media size in cache file ****/
+{
+  unsigned	pwg,			/* PWG media name */
+		ppd;			/* PPD PageSize name */
+  int		width,			/* Width in 2540ths */
+		length,			/* Length in 2540ths */
+		left,			/* Left margin in 2540ths */
+		bottom,			/* Bottom margin in 2540ths */
+		right,			/* Right margin in 2540ths */
+		top;			/* Top margin in 2540ths */
+} _ppd_csize_t;
+
+typedef struct _ppd_cpreset_s		/**** Preset in cache file ****/
+{
+  int		print_color_mode,	/* print-color-mode index */
+		print_quality;		/* print-quality index */
+  unsigned	first_option,		/* First option in options table */
+		num_options;		/* Number of options */
+} _ppd_cpreset_t;
+
+typedef struct _ppd_cfinishings_s	/**** Finishings in cache file ****/
+{
+  int		value;			/* finishings value */
+  unsigned	first_option,		/* First option in options table */
+		num_options;		/* Number of options */
+} _ppd_cfinishings_t;
+
+typedef struct _ppd_cbuf_s		/**** Cache file write buffer ****/
+{
+  unsigned char	*data;			/* Buffer */
+  size_t	used,			/* Bytes used */
+		alloc;			/* Bytes allocated */
+  int		error;			/* Non-zero if out of memory */
+} _ppd_cbuf_t;
+
+typedef struct _ppd_cstring_s		/**** String in cache file ****/
+{
+  const char	*str;			/* String value */
+  unsigned	offset;			/* Offset in string table */
+} _ppd_cstring_t;
+
+typedef struct _ppd_cwriter_s		/**** Cache file writer ****/
+{
+  _ppd_cbuf_t	data,			/* File data */
+		strings;		/* String table */
+  cups_array_t	*pool;			/* Strings in string table */
+} _ppd_cwriter_t;
+
+typedef struct _ppd_creader_s		/**** Cache file reader ****/
+{
+  const unsigned char *data;		/* File data */
+  size_t	length;			/* Length of file data */
+  const char	*strings;		/* String table */
+  unsigned	num_strings;		/* Size of string table */
+  const unsigned char *ptr,		/* Current IPP data */
+		*end;			/* End of IPP data */
+  int		error;			/* Non-zero if the file is bad */
+} _ppd_creader_t;
+
+
 /*
  * Local functions...
  */
 
+static void	ppd_cache_add(_ppd_cbuf_t *buf, const void *data,
+		              size_t bytes);
+static void	ppd_cache_add_options(_ppd_cwriter_t *writer,
+		                      _ppd_ctable_t *table, int num_options,
+				      cups_option_t *options);
+static unsigned	ppd_cache_add_string(_ppd_cwriter_t *writer, const char *s);
+static int	ppd_cache_compare_strings(_ppd_cstring_t *a,
+		                          _ppd_cstring_t *b);
+static int	ppd_cache_options(const _ppd_cfile_t *header, unsigned first,
+		                  unsigned count);
+static ssize_t	ppd_cache_read_cb(_ppd_creader_t *reader, ipp_uchar_t *buffer,
+		                  size_t bytes);
+static char	*ppd_cache_string(_ppd_creader_t *reader, unsigned offset,
+		                  int required);
+static const void *ppd_cache_table(_ppd_creader_t *reader,
+		                   const _ppd_ctable_t *table, size_t size);
+static ssize_t	ppd_cache_write_cb(_ppd_cbuf_t *buf, ipp_uchar_t *buffer,
+		                   size_t bytes);
 static int	pwg_compare_finishings(_pwg_finishings_t *a,
 		                       _pwg_finishings_t *b);
 static void	pwg_free_finishings(_pwg_finishings_t *f);
@@ -78,7 +247,8 @@ static void	pwg_unppdize_name(const char *ppd, char *name, size_t namesize,
  *                               written file.
  *
  * Use the @link _ppdCacheWriteFile@ function to write PWG mapping data to a
- * file.
+ * file.  The file is mapped into memory and the strings in the returned cache
+ * point directly into the mapped data.
  */
 
 _ppd_cache_t *				/* O  - PPD cache and mapping data */
@@ -86,28 +256,43 @@ _ppdCacheCreateWithFile(
     const char *filename,		/* I  - File to read */
     ipp_t      **attrs)			/* IO - IPP attributes, if any */
 {
-  cups_file_t	*fp;			/* File */
-  _ppd_cache_t	*pc;			/* PWG mapping data */
+  return (_ppdCacheCreateWithFile2(filename, attrs, 1));
+}
+
+
+/*
+ * '_ppdCacheCreateWithFile2()' - Create PPD cache and mapping data from a
+ *                                written file, optionally reading it.
+ *
+ * When "mapfile" is 0, or the file cannot be mapped, the file is read into
+ * memory instead.
+ */
+
+_ppd_cache_t *				/* O  - PPD cache and mapping data */
+_ppdCacheCreateWithFile2(
+    const char *filename,		/* I  - File to read */
+    ipp_t      **attrs,			/* IO - IPP attributes, if any */
+    int        mapfile)			/* I  - 1 to map the file, 0 to read it */
+{
+  int		fd;			/* File descriptor */
+  struct stat	fileinfo;		/* File information */
+  _ppd_cache_t	*pc = NULL;		/* PWG mapping data */
+  _ppd_creader_t reader;		/* Cache file reader */
+  const _ppd_cfile_t *header;		/* Cache file header */
+  const _ppd_cmap_t *cmap;		/* Current map in file */
+  const _ppd_csize_t *csize;		/* Current size in file */
+  const _ppd_cpreset_t *cpreset;	/* Current preset in file */
+  const _ppd_cfinishings_t *cfinishings;/* Current finishings in file */
+  const unsigned *cstring;		/* Current string offset in file */
   pwg_size_t	*size;			/* Current size */
   pwg_map_t	*map;			/* Current map */
+  cups_option_t	*option;		/* Current option */
   _pwg_finishings_t *finishings;	/* Current finishings option */
-  int		linenum,		/* Current line number */
-		num_bins,		/* Number of bins in file */
-		num_sizes,		/* Number of sizes in file */
-		num_sources,		/* Number of sources in file */
-		num_types;		/* Number of types in file */
-  char		line[2048],		/* Current line */
-		*value,			/* Pointer to value in line */
-		*valueptr,		/* Pointer into value */
-		pwg_keyword[128],	/* PWG keyword */
-		ppd_keyword[PPD_MAX_NAME];
-					/* PPD keyword */
-  _pwg_print_color_mode_t print_color_mode;
-					/* Print color mode for preset */
-  _pwg_print_quality_t print_quality;	/* Print quality for preset */
-
-
-  DEBUG_printf(("_ppdCacheCreateWithFile(filename=\"%s\")", filename));
+  unsigned	i;			/* Looping var */
+
+
+  DEBUG_printf(("_ppdCacheCreateWithFile2(filename=\"%s\", attrs=%p, "
+                "mapfile=%d)", filename, attrs, mapfile));
 
  /*
   * Range check input...
@@ -126,38 +311,26 @@ _ppdCacheCreateWithFile(
   * Open the file...
   */
 
-  if ((fp = cupsFileOpen(filename, "r")) == NULL)
+  if ((fd = open(filename, O_RDONLY)) < 0)
   {
     _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
     return (NULL);
   }
 
- /*
-  * Read the first line and make sure it has "#CUPS-PPD-CACHE-version" in it...
-  */
-
-  if (!cupsFileGets(fp, line, sizeof(line)))
+  if (fstat(fd, &fileinfo))
   {
     _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
-    DEBUG_puts("_ppdCacheCreateWithFile: Unable to read first line.");
-    cupsFileClose(fp);
+    close(fd);
     return (NULL);
   }
 
-  if (strncmp(line, "#CUPS-PPD-CACHE-", 16))
+  if (fileinfo.st_size < (off_t)sizeof(_ppd_cfile_t) ||
+      fileinfo.st_size > _PPD_CFILE_MAX)
   {
     _cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-    DEBUG_printf(("_ppdCacheCreateWithFile: Wrong first line \"%s\".", line));
-    cupsFileClose(fp);
-    return (NULL);
-  }
-
-  if (atoi(line + 16) != _PPD_CACHE_VERSION)
-  {
-    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Out of date PPD cache file."), 1);
-    DEBUG_printf(("_ppdCacheCreateWithFile: Cache file has version %s, "
-                  "expected %d.", line + 16, _PPD_CACHE_VERSION));
-    cupsFileClose(fp);
+    DEBUG_printf(("_ppdCacheCreateWithFile2: Bad file size " CUPS_LLFMT ".",
+                  CUPS_LLCAST fileinfo.st_size));
+    close(fd);
     return (NULL);
   }
 
@@ -168,455 +341,370 @@ _ppdCacheCreateWithFile(
   if ((pc = calloc(1, sizeof(_ppd_cache_t))) == NULL)
   {
     _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
-    DEBUG_puts("_ppdCacheCreateWithFile: Unable to allocate _ppd_cache_t.");
-    goto create_error;
+    DEBUG_puts("_ppdCacheCreateWithFile2: Unable to allocate _ppd_cache_t.");
+    close(fd);
+    return (NULL);
   }
 
-  pc->max_copies = 9999;
-
  /*
-  * Read the file...
+  * Map the file into memory, falling back on reading it when the file cannot
+  * be mapped...
   */
 
-  linenum     = 0;
-  num_bins    = 0;
-  num_sizes   = 0;
-  num_sources = 0;
-  num_types   = 0;
+  pc->maplen = (size_t)fileinfo.st_size;
+
+#ifndef WIN32
+  if (mapfile && (pc->map = mmap(NULL, pc->maplen, PROT_READ, MAP_PRIVATE,
+                                 fd, 0)) != MAP_FAILED)
+    pc->mapped = 1;
+  else
+    pc->map = NULL;
+#endif /* !WIN32 */
 
-  while (cupsFileGetConf(fp, line, sizeof(line), &value, &linenum))
+  if (!pc->map)
   {
-    DEBUG_printf(("_ppdCacheCreateWithFile: line=\"%s\", value=\"%s\", "
-                  "linenum=%d", line, value, linenum));
+    ssize_t	bytes;			/* Bytes read */
+    size_t	total;			/* Total bytes read */
 
-    if (!value)
+    if ((pc->map = malloc(pc->maplen)) == NULL)
     {
-      DEBUG_printf(("_ppdCacheCreateWithFile: Missing value on line %d.",
-                    linenum));
-      _cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
+      _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
+      close(fd);
       goto create_error;
     }
-    else if (!_cups_strcasecmp(line, "Filter"))
-    {
-      if (!pc->filters)
-        pc->filters = cupsArrayNew3(NULL, NULL, NULL, 0,
-	                            (cups_acopy_func_t)_cupsStrAlloc,
-				    (cups_afree_func_t)_cupsStrFree);
-
-      cupsArrayAdd(pc->filters, value);
-    }
-    else if (!_cups_strcasecmp(line, "PreFilter"))
-    {
-      if (!pc->prefilters)
-        pc->prefilters = cupsArrayNew3(NULL, NULL, NULL, 0,
-	                               (cups_acopy_func_t)_cupsStrAlloc,
-				       (cups_afree_func_t)_cupsStrFree);
-
-      cupsArrayAdd(pc->prefilters, value);
-    }
-    else if (!_cups_strcasecmp(line, "Product"))
-    {
-      pc->product = _cupsStrAlloc(value);
-    }
-    else if (!_cups_strcasecmp(line, "SingleFile"))
-    {
-      pc->single_file = !_cups_strcasecmp(value, "true");
-    }
-    else if (!_cups_strcasecmp(line, "IPP"))
-    {
-      off_t	pos = cupsFileTell(fp),	/* Position in file */
-		length = strtol(value, NULL, 10);
-					/* Length of IPP attributes */
-
-      if (attrs && *attrs)
-      {
-        DEBUG_puts("_ppdCacheCreateWithFile: IPP listed multiple times.");
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
-      else if (length <= 0)
-      {
-        DEBUG_puts("_ppdCacheCreateWithFile: Bad IPP length.");
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
 
-      if (attrs)
+    for (total = 0; total < pc->maplen; total += (size_t)bytes)
+      if ((bytes = read(fd, (char *)pc->map + total,
+                        pc->maplen - total)) <= 0)
       {
-       /*
-        * Read IPP attributes into the provided variable...
-	*/
-
-        *attrs = ippNew();
-
-        if (ippReadIO(fp, (ipp_iocb_t)cupsFileRead, 1, NULL,
-		      *attrs) != IPP_STATE_DATA)
+	if (bytes < 0 && (errno == EINTR || errno == EAGAIN))
 	{
-	  DEBUG_puts("_ppdCacheCreateWithFile: Bad IPP data.");
-	  _cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	  goto create_error;
+	  bytes = 0;
+	  continue;
 	}
-      }
-      else
-      {
-       /*
-        * Skip the IPP data entirely...
-	*/
-
-        cupsFileSeek(fp, pos + length);
-      }
 
-      if (cupsFileTell(fp) != (pos + length))
-      {
-        DEBUG_puts("_ppdCacheCreateWithFile: Bad IPP data.");
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
-    }
-    else if (!_cups_strcasecmp(line, "NumBins"))
-    {
-      if (num_bins > 0)
-      {
-        DEBUG_puts("_ppdCacheCreateWithFile: NumBins listed multiple times.");
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
+        _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
+	close(fd);
 	goto create_error;
       }
+  }
 
-      if ((num_bins = atoi(value)) <= 0 || num_bins > 65536)
-      {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Bad NumBins value %d on line "
-		      "%d.", num_sizes, linenum));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
+  close(fd);
 
-      if ((pc->bins = calloc(num_bins, sizeof(pwg_map_t))) == NULL)
-      {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Unable to allocate %d bins.",
-	              num_sizes));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
-	goto create_error;
-      }
-    }
-    else if (!_cups_strcasecmp(line, "Bin"))
-    {
-      if (sscanf(value, "%127s%40s", pwg_keyword, ppd_keyword) != 2)
-      {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Bad Bin on line %d.", linenum));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
+ /*
+  * Validate the header...
+  */
 
-      if (pc->num_bins >= num_bins)
-      {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Too many Bin's on line %d.",
-	              linenum));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
+  header = (const _ppd_cfile_t *)pc->map;
 
-      map      = pc->bins + pc->num_bins;
-      map->pwg = _cupsStrAlloc(pwg_keyword);
-      map->ppd = _cupsStrAlloc(ppd_keyword);
+  if (memcmp(header->magic, _PPD_CFILE_MAGIC, sizeof(header->magic)))
+  {
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
+    DEBUG_puts("_ppdCacheCreateWithFile2: Bad magic.");
+    goto create_error;
+  }
 
-      pc->num_bins ++;
-    }
-    else if (!_cups_strcasecmp(line, "NumSizes"))
-    {
-      if (num_sizes > 0)
-      {
-        DEBUG_puts("_ppdCacheCreateWithFile: NumSizes listed multiple times.");
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
+  if (header->version != _PPD_CACHE_VERSION ||
+      header->byte_order != _PPD_CFILE_ORDER)
+  {
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Out of date PPD cache file."), 1);
+    DEBUG_printf(("_ppdCacheCreateWithFile2: Cache file has version %u and "
+                  "byte order %08x, expected %d and %08x.", header->version,
+		  header->byte_order, _PPD_CACHE_VERSION, _PPD_CFILE_ORDER));
+    goto create_error;
+  }
 
-      if ((num_sizes = atoi(value)) < 0 || num_sizes > 65536)
-      {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Bad NumSizes value %d on line "
-	              "%d.", num_sizes, linenum));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
+  reader.data   = (const unsigned char *)pc->map;
+  reader.length = pc->maplen;
+  reader.error  = header->length != pc->maplen;
 
-      if (num_sizes > 0)
-      {
-	if ((pc->sizes = calloc(num_sizes, sizeof(pwg_size_t))) == NULL)
-	{
-	  DEBUG_printf(("_ppdCacheCreateWithFile: Unable to allocate %d sizes.",
-			num_sizes));
-	  _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
-	  goto create_error;
-	}
-      }
-    }
-    else if (!_cups_strcasecmp(line, "Size"))
-    {
-      if (pc->num_sizes >= num_sizes)
-      {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Too many Size's on line %d.",
-	              linenum));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
+  if ((reader.strings = ppd_cache_table(&reader, &(header->strings), 1)) != NULL)
+  {
+    reader.num_strings = header->strings.count;
 
-      size = pc->sizes + pc->num_sizes;
+    if (reader.strings[reader.num_strings - 1])
+      reader.error = 1;
+  }
+  else
+    reader.num_strings = 0;
 
-      if (sscanf(value, "%127s%40s%d%d%d%d%d%d", pwg_keyword, ppd_keyword,
-		 &(size->width), &(size->length), &(size->left),
-		 &(size->bottom), &(size->right), &(size->top)) != 8)
-      {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Bad Size on line %d.",
-	              linenum));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
+  if (reader.error)
+  {
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
+    DEBUG_puts("_ppdCacheCreateWithFile2: Bad length or string table.");
+    goto create_error;
+  }
 
-      size->map.pwg = _cupsStrAlloc(pwg_keyword);
-      size->map.ppd = _cupsStrAlloc(ppd_keyword);
+ /*
+  * Output bins, media sizes, sources, and types...
+  */
 
-      pc->num_sizes ++;
+  if ((cmap = ppd_cache_table(&reader, &(header->bins),
+                              sizeof(_ppd_cmap_t))) != NULL)
+  {
+    if ((pc->bins = calloc(header->bins.count, sizeof(pwg_map_t))) == NULL)
+    {
+      _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
+      goto create_error;
     }
-    else if (!_cups_strcasecmp(line, "CustomSize"))
+
+    for (i = header->bins.count, map = pc->bins; i > 0; i --, map ++, cmap ++)
     {
-      if (pc->custom_max_width > 0)
-      {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Too many CustomSize's on line "
-	              "%d.", linenum));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
+      map->pwg = ppd_cache_string(&reader, cmap->name, 1);
+      map->ppd = ppd_cache_string(&reader, cmap->value, 1);
+    }
 
-      if (sscanf(value, "%d%d%d%d%d%d%d%d", &(pc->custom_max_width),
-                 &(pc->custom_max_length), &(pc->custom_min_width),
-		 &(pc->custom_min_length), &(pc->custom_size.left),
-		 &(pc->custom_size.bottom), &(pc->custom_size.right),
-		 &(pc->custom_size.top)) != 8)
-      {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Bad CustomSize on line %d.",
-	              linenum));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
+    pc->num_bins = (int)header->bins.count;
+  }
 
-      pwgFormatSizeName(pwg_keyword, sizeof(pwg_keyword), "custom", "max",
-		        pc->custom_max_width, pc->custom_max_length, NULL);
-      pc->custom_max_keyword = _cupsStrAlloc(pwg_keyword);
+  if ((csize = ppd_cache_table(&reader, &(header->sizes),
+                               sizeof(_ppd_csize_t))) != NULL)
+  {
+    if ((pc->sizes = calloc(header->sizes.count, sizeof(pwg_size_t))) == NULL)
+    {
+      _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
+      goto create_error;
+    }
 
-      pwgFormatSizeName(pwg_keyword, sizeof(pwg_keyword), "custom", "min",
-		        pc->custom_min_width, pc->custom_min_length, NULL);
-      pc->custom_min_keyword = _cupsStrAlloc(pwg_keyword);
+    for (i = header->sizes.count, size = pc->sizes;
+         i > 0;
+	 i --, size ++, csize ++)
+    {
+      size->map.pwg = ppd_cache_string(&reader, csize->pwg, 1);
+      size->map.ppd = ppd_cache_string(&reader, csize->ppd, 1);
+      size->width   = csize->width;
+      size->length  = csize->length;
+      size->left    = csize->left;
+      size->bottom  = csize->bottom;
+      size->right   = csize->right;
+      size->top     = csize->top;
     }
-    else if (!_cups_strcasecmp(line, "SourceOption"))
+
+    pc->num_sizes = (int)header->sizes.count;
+  }
+
+  pc->custom_max_width    = header->custom_max_width;
+  pc->custom_max_length   = header->custom_max_length;
+  pc->custom_min_width    = header->custom_min_width;
+  pc->custom_min_length   = header->custom_min_length;
+  pc->custom_max_keyword  = ppd_cache_string(&reader, header->custom_max_keyword,
+                                             pc->custom_max_width > 0);
+  pc->custom_min_keyword  = ppd_cache_string(&reader, header->custom_min_keyword,
+                                             pc->custom_max_width > 0);
+  pc->custom_size.left    = header->custom_left;
+  pc->custom_size.bottom  = header->custom_bottom;
+  pc->custom_size.right   = header->custom_right;
+  pc->custom_size.top     = header->custom_top;
+
+  pc->source_option = ppd_cache_string(&reader, header->source_option, 0);
+
+  if ((cmap = ppd_cache_table(&reader, &(header->sources),
+                              sizeof(_ppd_cmap_t))) != NULL)
+  {
+    if ((pc->sources = calloc(header->sources.count,
+                              sizeof(pwg_map_t))) == NULL)
     {
-      pc->source_option = _cupsStrAlloc(value);
+      _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
+      goto create_error;
     }
-    else if (!_cups_strcasecmp(line, "NumSources"))
+
+    for (i = header->sources.count, map = pc->sources;
+         i > 0;
+	 i --, map ++, cmap ++)
     {
-      if (num_sources > 0)
-      {
-        DEBUG_puts("_ppdCacheCreateWithFile: NumSources listed multiple "
-	           "times.");
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
+      map->pwg = ppd_cache_string(&reader, cmap->name, 1);
+      map->ppd = ppd_cache_string(&reader, cmap->value, 1);
+    }
 
-      if ((num_sources = atoi(value)) <= 0 || num_sources > 65536)
-      {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Bad NumSources value %d on "
-	              "line %d.", num_sources, linenum));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
+    pc->num_sources = (int)header->sources.count;
+  }
 
-      if ((pc->sources = calloc(num_sources, sizeof(pwg_map_t))) == NULL)
-      {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Unable to allocate %d sources.",
-	              num_sources));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
-	goto create_error;
-      }
+  if ((cmap = ppd_cache_table(&reader, &(header->types),
+                              sizeof(_ppd_cmap_t))) != NULL)
+  {
+    if ((pc->types = calloc(header->types.count, sizeof(pwg_map_t))) == NULL)
+    {
+      _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
+      goto create_error;
     }
-    else if (!_cups_strcasecmp(line, "Source"))
+
+    for (i = header->types.count, map = pc->types;
+         i > 0;
+	 i --, map ++, cmap ++)
     {
-      if (sscanf(value, "%127s%40s", pwg_keyword, ppd_keyword) != 2)
-      {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Bad Source on line %d.",
-	              linenum));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
+      map->pwg = ppd_cache_string(&reader, cmap->name, 1);
+      map->ppd = ppd_cache_string(&reader, cmap->value, 1);
+    }
 
-      if (pc->num_sources >= num_sources)
-      {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Too many Source's on line %d.",
-	              linenum));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
+    pc->num_types = (int)header->types.count;
+  }
 
-      map      = pc->sources + pc->num_sources;
-      map->pwg = _cupsStrAlloc(pwg_keyword);
-      map->ppd = _cupsStrAlloc(ppd_keyword);
+ /*
+  * Presets and finishings share a single table of options...
+  */
 
-      pc->num_sources ++;
+  if ((cmap = ppd_cache_table(&reader, &(header->options),
+                              sizeof(_ppd_cmap_t))) != NULL)
+  {
+    if ((pc->map_options = calloc(header->options.count,
+                                  sizeof(cups_option_t))) == NULL)
+    {
+      _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
+      goto create_error;
     }
-    else if (!_cups_strcasecmp(line, "NumTypes"))
+
+    for (i = header->options.count, option = pc->map_options;
+         i > 0;
+	 i --, option ++, cmap ++)
     {
-      if (num_types > 0)
-      {
-        DEBUG_puts("_ppdCacheCreateWithFile: NumTypes listed multiple times.");
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
+      option->name  = ppd_cache_string(&reader, cmap->name, 1);
+      option->value = ppd_cache_string(&reader, cmap->value, 1);
+    }
+  }
 
-      if ((num_types = atoi(value)) <= 0 || num_types > 65536)
+  if ((cpreset = ppd_cache_table(&reader, &(header->presets),
+                                 sizeof(_ppd_cpreset_t))) != NULL)
+  {
+    for (i = header->presets.count; i > 0; i --, cpreset ++)
+    {
+      if (cpreset->print_color_mode < _PWG_PRINT_COLOR_MODE_MONOCHROME ||
+          cpreset->print_color_mode >= _PWG_PRINT_COLOR_MODE_MAX ||
+	  cpreset->print_quality < _PWG_PRINT_QUALITY_DRAFT ||
+	  cpreset->print_quality >= _PWG_PRINT_QUALITY_MAX ||
+	  !ppd_cache_options(header, cpreset->first_option,
+	                     cpreset->num_options))
       {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Bad NumTypes value %d on "
-	              "line %d.", num_types, linenum));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
+        DEBUG_puts("_ppdCacheCreateWithFile2: Bad preset.");
+        _cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
 	goto create_error;
       }
 
-      if ((pc->types = calloc(num_types, sizeof(pwg_map_t))) == NULL)
-      {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Unable to allocate %d types.",
-	              num_types));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
-	goto create_error;
-      }
+      pc->num_presets[cpreset->print_color_mode][cpreset->print_quality] =
+          (int)cpreset->num_options;
+      pc->presets[cpreset->print_color_mode][cpreset->print_quality] =
+          pc->map_options + cpreset->first_option;
     }
-    else if (!_cups_strcasecmp(line, "Type"))
+  }
+
+  if ((cfinishings = ppd_cache_table(&reader, &(header->finishings),
+                                     sizeof(_ppd_cfinishings_t))) != NULL)
+  {
+    if ((pc->map_finishings = calloc(header->finishings.count,
+                                     sizeof(_pwg_finishings_t))) == NULL)
     {
-      if (sscanf(value, "%127s%40s", pwg_keyword, ppd_keyword) != 2)
-      {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Bad Type on line %d.",
-	              linenum));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
+      _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
+      goto create_error;
+    }
 
-      if (pc->num_types >= num_types)
+    pc->finishings = cupsArrayNew((cups_array_func_t)pwg_compare_finishings,
+                                  NULL);
+
+    for (i = header->finishings.count, finishings = pc->map_finishings;
+         i > 0;
+	 i --, finishings ++, cfinishings ++)
+    {
+      if (!ppd_cache_options(header, cfinishings->first_option,
+                             cfinishings->num_options))
       {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Too many Type's on line %d.",
-	              linenum));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
+        DEBUG_puts("_ppdCacheCreateWithFile2: Bad finishings.");
+        _cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
 	goto create_error;
       }
 
-      map      = pc->types + pc->num_types;
-      map->pwg = _cupsStrAlloc(pwg_keyword);
-      map->ppd = _cupsStrAlloc(ppd_keyword);
+      finishings->value       = (ipp_finishings_t)cfinishings->value;
+      finishings->num_options = (int)cfinishings->num_options;
+      finishings->options     = pc->map_options + cfinishings->first_option;
 
-      pc->num_types ++;
+      cupsArrayAdd(pc->finishings, finishings);
     }
-    else if (!_cups_strcasecmp(line, "Preset"))
-    {
-     /*
-      * Preset output-mode print-quality name=value ...
-      */
+  }
 
-      print_color_mode = (_pwg_print_color_mode_t)strtol(value, &valueptr, 10);
-      print_quality    = (_pwg_print_quality_t)strtol(valueptr, &valueptr, 10);
+ /*
+  * Duplex/sides, product, filters, and accounting values...
+  */
 
-      if (print_color_mode < _PWG_PRINT_COLOR_MODE_MONOCHROME ||
-          print_color_mode >= _PWG_PRINT_COLOR_MODE_MAX ||
-	  print_quality < _PWG_PRINT_QUALITY_DRAFT ||
-	  print_quality >= _PWG_PRINT_QUALITY_MAX ||
-	  valueptr == value || !*valueptr)
-      {
-        DEBUG_printf(("_ppdCacheCreateWithFile: Bad Preset on line %d.",
-	              linenum));
-	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-	goto create_error;
-      }
+  pc->sides_option       = ppd_cache_string(&reader, header->sides_option, 0);
+  pc->sides_1sided       = ppd_cache_string(&reader, header->sides_1sided, 0);
+  pc->sides_2sided_long  = ppd_cache_string(&reader,
+                                            header->sides_2sided_long, 0);
+  pc->sides_2sided_short = ppd_cache_string(&reader,
+                                            header->sides_2sided_short, 0);
+  pc->product            = ppd_cache_string(&reader, header->product, 0);
+  pc->single_file        = header->single_file;
+  pc->max_copies         = header->max_copies;
+  pc->account_id         = header->account_id;
+  pc->accounting_user_id = header->accounting_user_id;
+  pc->password           = ppd_cache_string(&reader, header->password, 0);
+  pc->charge_info_uri    = ppd_cache_string(&reader, header->charge_info_uri,
+                                            0);
+
+  if ((cstring = ppd_cache_table(&reader, &(header->filters),
+                                 sizeof(unsigned))) != NULL)
+  {
+    pc->filters = cupsArrayNew(NULL, NULL);
 
-      pc->num_presets[print_color_mode][print_quality] =
-          cupsParseOptions(valueptr, 0,
-	                   pc->presets[print_color_mode] + print_quality);
-    }
-    else if (!_cups_strcasecmp(line, "SidesOption"))
-      pc->sides_option = _cupsStrAlloc(value);
-    else if (!_cups_strcasecmp(line, "Sides1Sided"))
-      pc->sides_1sided = _cupsStrAlloc(value);
-    else if (!_cups_strcasecmp(line, "Sides2SidedLong"))
-      pc->sides_2sided_long = _cupsStrAlloc(value);
-    else if (!_cups_strcasecmp(line, "Sides2SidedShort"))
-      pc->sides_2sided_short = _cupsStrAlloc(value);
-    else if (!_cups_strcasecmp(line, "Finishings"))
-    {
-      if (!pc->finishings)
-	pc->finishings =
-	    cupsArrayNew3((cups_array_func_t)pwg_compare_finishings,
-			  NULL, NULL, 0, NULL,
-			  (cups_afree_func_t)pwg_free_finishings);
+    for (i = header->filters.count; i > 0; i --, cstring ++)
+      cupsArrayAdd(pc->filters, ppd_cache_string(&reader, *cstring, 1));
+  }
 
-      if ((finishings = calloc(1, sizeof(_pwg_finishings_t))) == NULL)
-        goto create_error;
+  if ((cstring = ppd_cache_table(&reader, &(header->prefilters),
+                                 sizeof(unsigned))) != NULL)
+  {
+    pc->prefilters = cupsArrayNew(NULL, NULL);
 
-      finishings->value       = strtol(value, &valueptr, 10);
-      finishings->num_options = cupsParseOptions(valueptr, 0,
-                                                 &(finishings->options));
+    for (i = header->prefilters.count; i > 0; i --, cstring ++)
+      cupsArrayAdd(pc->prefilters, ppd_cache_string(&reader, *cstring, 1));
+  }
 
-      cupsArrayAdd(pc->finishings, finishings);
-    }
-    else if (!_cups_strcasecmp(line, "MaxCopies"))
-      pc->max_copies = atoi(value);
-    else if (!_cups_strcasecmp(line, "ChargeInfoURI"))
-      pc->charge_info_uri = _cupsStrAlloc(value);
-    else if (!_cups_strcasecmp(line, "JobAccountId"))
-      pc->account_id = !_cups_strcasecmp(value, "true");
-    else if (!_cups_strcasecmp(line, "JobAccountingUserId"))
-      pc->accounting_user_id = !_cups_strcasecmp(value, "true");
-    else if (!_cups_strcasecmp(line, "JobPassword"))
-      pc->password = _cupsStrAlloc(value);
-    else if (!_cups_strcasecmp(line, "Mandatory"))
-    {
-      if (pc->mandatory)
-        _cupsArrayAddStrings(pc->mandatory, value, ' ');
-      else
-        pc->mandatory = _cupsArrayNewStrings(value, ' ');
-    }
-    else if (!_cups_strcasecmp(line, "SupportFile"))
-    {
-      if (!pc->support_files)
-        pc->support_files = cupsArrayNew3(NULL, NULL, NULL, 0,
-                                          (cups_acopy_func_t)_cupsStrAlloc,
-                                          (cups_afree_func_t)_cupsStrFree);
+  if ((cstring = ppd_cache_table(&reader, &(header->mandatory),
+                                 sizeof(unsigned))) != NULL)
+  {
+    pc->mandatory = cupsArrayNew((cups_array_func_t)strcmp, NULL);
 
-      cupsArrayAdd(pc->support_files, value);
-    }
-    else
-    {
-      DEBUG_printf(("_ppdCacheCreateWithFile: Unknown %s on line %d.", line,
-		    linenum));
-    }
+    for (i = header->mandatory.count; i > 0; i --, cstring ++)
+      cupsArrayAdd(pc->mandatory, ppd_cache_string(&reader, *cstring, 1));
   }
 
-  if (pc->num_sizes < num_sizes)
+  if ((cstring = ppd_cache_table(&reader, &(header->support_files),
+                                 sizeof(unsigned))) != NULL)
   {
-    DEBUG_printf(("_ppdCacheCreateWithFile: Not enough sizes (%d < %d).",
-                  pc->num_sizes, num_sizes));
-    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-    goto create_error;
+    pc->support_files = cupsArrayNew(NULL, NULL);
+
+    for (i = header->support_files.count; i > 0; i --, cstring ++)
+      cupsArrayAdd(pc->support_files, ppd_cache_string(&reader, *cstring, 1));
   }
 
-  if (pc->num_sources < num_sources)
+  if (reader.error)
   {
-    DEBUG_printf(("_ppdCacheCreateWithFile: Not enough sources (%d < %d).",
-                  pc->num_sources, num_sources));
+    DEBUG_puts("_ppdCacheCreateWithFile2: Bad table or string offset.");
     _cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
     goto create_error;
   }
 
-  if (pc->num_types < num_types)
+ /*
+  * IPP attributes, if any...
+  */
+
+  if (attrs && header->ipp.count > 0)
   {
-    DEBUG_printf(("_ppdCacheCreateWithFile: Not enough types (%d < %d).",
-                  pc->num_types, num_types));
-    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
-    goto create_error;
-  }
+    if ((reader.ptr = ppd_cache_table(&reader, &(header->ipp), 1)) == NULL)
+    {
+      DEBUG_puts("_ppdCacheCreateWithFile2: Bad IPP offset.");
+      _cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
+      goto create_error;
+    }
 
-  cupsFileClose(fp);
+    reader.end = reader.ptr + header->ipp.count;
+    *attrs     = ippNew();
+
+    if (ippReadIO(&reader, (ipp_iocb_t)ppd_cache_read_cb, 1, NULL,
+                  *attrs) != IPP_STATE_DATA || reader.ptr != reader.end)
+    {
+      DEBUG_puts("_ppdCacheCreateWithFile2: Bad IPP data.");
+      _cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
+      goto create_error;
+    }
+  }
 
   return (pc);
 
@@ -626,7 +714,6 @@ _ppdCacheCreateWithFile(
 
   create_error:
 
-  cupsFileClose(fp);
   _ppdCacheDestroy(pc);
 
   if (attrs)
@@ -1471,6 +1558,37 @@ _ppdCacheDestroy(_ppd_cache_t *pc)	/* I - PPD cache and mapping data */
   * Free memory as needed...
   */
 
+  if (pc->map)
+  {
+   /*
+    * Strings point into the cache file, so only free the tables...
+    */
+
+    free(pc->bins);
+    free(pc->sizes);
+    free(pc->sources);
+    free(pc->types);
+    free(pc->map_options);
+
+    cupsArrayDelete(pc->filters);
+    cupsArrayDelete(pc->prefilters);
+    cupsArrayDelete(pc->finishings);
+    cupsArrayDelete(pc->mandatory);
+    cupsArrayDelete(pc->support_files);
+
+    free(pc->map_finishings);
+
+#ifndef WIN32
+    if (pc->mapped)
+      munmap(pc->map, pc->maplen);
+    else
+#endif /* !WIN32 */
+    free(pc->map);
+
+    free(pc);
+    return;
+  }
+
   if (pc->bins)
   {
     for (i = pc->num_bins, map = pc->bins; i > 0; i --, map ++)
@@ -2267,12 +2385,18 @@ _ppdCacheWriteFile(
     const char   *filename,		/* I - File to write */
     ipp_t        *attrs)		/* I - Attributes to write, if any */
 {
-  int			i, j, k;	/* Looping vars */
+  int			i, j;		/* Looping vars */
   cups_file_t		*fp;		/* Output file */
+  _ppd_cwriter_t	writer;		/* Cache file writer */
+  _ppd_cfile_t		header;		/* Cache file header */
+  _ppd_cmap_t		cmap;		/* Map/option in file */
+  _ppd_csize_t		csize;		/* Size in file */
+  _ppd_cpreset_t	cpreset;	/* Preset in file */
+  _ppd_cfinishings_t	cfinishings;	/* Finishings in file */
+  unsigned		cstring;	/* String offset in file */
   pwg_size_t		*size;		/* Current size */
   pwg_map_t		*map;		/* Current map */
   _pwg_finishings_t	*f;		/* Current finishing option */
-  cups_option_t		*option;	/* Current option */
   const char		*value;		/* Filter/pre-filter value */
   char			newfile[1024];	/* New filename */
 
@@ -2288,190 +2412,273 @@ _ppdCacheWriteFile(
   }
 
  /*
-  * Open the file and write with compression...
+  * Build the tables in memory, starting with a placeholder for the header...
   */
 
-  snprintf(newfile, sizeof(newfile), "%s.N", filename);
-  if ((fp = cupsFileOpen(newfile, "w9")) == NULL)
-  {
-    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
-    return (0);
-  }
+  memset(&writer, 0, sizeof(writer));
+  memset(&header, 0, sizeof(header));
 
- /*
-  * Standard header...
-  */
+  writer.pool = cupsArrayNew3((cups_array_func_t)ppd_cache_compare_strings,
+                              NULL, NULL, 0, NULL, (cups_afree_func_t)free);
 
-  cupsFilePrintf(fp, "#CUPS-PPD-CACHE-%d\n", _PPD_CACHE_VERSION);
+  ppd_cache_add(&(writer.data), &header, sizeof(header));
 
  /*
-  * Output bins...
+  * Output bins, media sizes, sources, and types...
   */
 
-  if (pc->num_bins > 0)
+  header.bins.offset = (unsigned)writer.data.used;
+  header.bins.count  = (unsigned)pc->num_bins;
+
+  for (i = pc->num_bins, map = pc->bins; i > 0; i --, map ++)
   {
-    cupsFilePrintf(fp, "NumBins %d\n", pc->num_bins);
-    for (i = pc->num_bins, map = pc->bins; i > 0; i --, map ++)
-      cupsFilePrintf(fp, "Bin %s %s\n", map->pwg, map->ppd);
+    cmap.name  = ppd_cache_add_string(&writer, map->pwg);
+    cmap.value = ppd_cache_add_string(&writer, map->ppd);
+
+    ppd_cache_add(&(writer.data), &cmap, sizeof(cmap));
   }
 
- /*
-  * Media sizes...
-  */
+  header.sizes.offset = (unsigned)writer.data.used;
+  header.sizes.count  = (unsigned)pc->num_sizes;
 
-  cupsFilePrintf(fp, "NumSizes %d\n", pc->num_sizes);
   for (i = pc->num_sizes, size = pc->sizes; i > 0; i --, size ++)
-    cupsFilePrintf(fp, "Size %s %s %d %d %d %d %d %d\n", size->map.pwg,
-		   size->map.ppd, size->width, size->length, size->left,
-		   size->bottom, size->right, size->top);
+  {
+    csize.pwg    = ppd_cache_add_string(&writer, size->map.pwg);
+    csize.ppd    = ppd_cache_add_string(&writer, size->map.ppd);
+    csize.width  = size->width;
+    csize.length = size->length;
+    csize.left   = size->left;
+    csize.bottom = size->bottom;
+    csize.right  = size->right;
+    csize.top    = size->top;
+
+    ppd_cache_add(&(writer.data), &csize, sizeof(csize));
+  }
+
   if (pc->custom_max_width > 0)
-    cupsFilePrintf(fp, "CustomSize %d %d %d %d %d %d %d %d\n",
-                   pc->custom_max_width, pc->custom_max_length,
-		   pc->custom_min_width, pc->custom_min_length,
-		   pc->custom_size.left, pc->custom_size.bottom,
-		   pc->custom_size.right, pc->custom_size.top);
+  {
+    header.custom_max_width   = pc->custom_max_width;
+    header.custom_max_length  = pc->custom_max_length;
+    header.custom_min_width   = pc->custom_min_width;
+    header.custom_min_length  = pc->custom_min_length;
+    header.custom_left        = pc->custom_size.left;
+    header.custom_bottom      = pc->custom_size.bottom;
+    header.custom_right       = pc->custom_size.right;
+    header.custom_top         = pc->custom_size.top;
+  }
 
- /*
-  * Media sources...
-  */
+  header.custom_max_keyword = ppd_cache_add_string(&writer,
+                                                   pc->custom_max_keyword);
+  header.custom_min_keyword = ppd_cache_add_string(&writer,
+                                                   pc->custom_min_keyword);
+  header.source_option      = ppd_cache_add_string(&writer, pc->source_option);
 
-  if (pc->source_option)
-    cupsFilePrintf(fp, "SourceOption %s\n", pc->source_option);
+  header.sources.offset = (unsigned)writer.data.used;
+  header.sources.count  = (unsigned)pc->num_sources;
 
-  if (pc->num_sources > 0)
+  for (i = pc->num_sources, map = pc->sources; i > 0; i --, map ++)
   {
-    cupsFilePrintf(fp, "NumSources %d\n", pc->num_sources);
-    for (i = pc->num_sources, map = pc->sources; i > 0; i --, map ++)
-      cupsFilePrintf(fp, "Source %s %s\n", map->pwg, map->ppd);
+    cmap.name  = ppd_cache_add_string(&writer, map->pwg);
+    cmap.value = ppd_cache_add_string(&writer, map->ppd);
+
+    ppd_cache_add(&(writer.data), &cmap, sizeof(cmap));
   }
 
- /*
-  * Media types...
-  */
+  header.types.offset = (unsigned)writer.data.used;
+  header.types.count  = (unsigned)pc->num_types;
 
-  if (pc->num_types > 0)
+  for (i = pc->num_types, map = pc->types; i > 0; i --, map ++)
   {
-    cupsFilePrintf(fp, "NumTypes %d\n", pc->num_types);
-    for (i = pc->num_types, map = pc->types; i > 0; i --, map ++)
-      cupsFilePrintf(fp, "Type %s %s\n", map->pwg, map->ppd);
+    cmap.name  = ppd_cache_add_string(&writer, map->pwg);
+    cmap.value = ppd_cache_add_string(&writer, map->ppd);
+
+    ppd_cache_add(&(writer.data), &cmap, sizeof(cmap));
   }
 
  /*
-  * Presets...
+  * Preset and finishings options, followed by the presets and finishings
+  * that refer to them...
   */
 
+  header.options.offset = (unsigned)writer.data.used;
+
+  for (i = _PWG_PRINT_COLOR_MODE_MONOCHROME; i < _PWG_PRINT_COLOR_MODE_MAX; i ++)
+    for (j = _PWG_PRINT_QUALITY_DRAFT; j < _PWG_PRINT_QUALITY_MAX; j ++)
+      ppd_cache_add_options(&writer, &(header.options),
+                            pc->num_presets[i][j], pc->presets[i][j]);
+
+  for (f = (_pwg_finishings_t *)cupsArrayFirst(pc->finishings);
+       f;
+       f = (_pwg_finishings_t *)cupsArrayNext(pc->finishings))
+    ppd_cache_add_options(&writer, &(header.options), f->num_options,
+                          f->options);
+
+  header.presets.offset = (unsigned)writer.data.used;
+  cstring               = 0;
+
   for (i = _PWG_PRINT_COLOR_MODE_MONOCHROME; i < _PWG_PRINT_COLOR_MODE_MAX; i ++)
     for (j = _PWG_PRINT_QUALITY_DRAFT; j < _PWG_PRINT_QUALITY_MAX; j ++)
       if (pc->num_presets[i][j])
       {
-	cupsFilePrintf(fp, "Preset %d %d", i, j);
-	for (k = pc->num_presets[i][j], option = pc->presets[i][j];
-	     k > 0;
-	     k --, option ++)
-	  cupsFilePrintf(fp, " %s=%s", option->name, option->value);
-	cupsFilePutChar(fp, '\n');
+        cpreset.print_color_mode = i;
+	cpreset.print_quality    = j;
+	cpreset.first_option     = cstring;
+	cpreset.num_options      = (unsigned)pc->num_presets[i][j];
+
+	ppd_cache_add(&(writer.data), &cpreset, sizeof(cpreset));
+
+	header.presets.count ++;
+	cstring += cpreset.num_options;
       }
 
- /*
-  * Duplex/sides...
-  */
+  header.finishings.offset = (unsigned)writer.data.used;
+  header.finishings.count  = (unsigned)cupsArrayCount(pc->finishings);
 
-  if (pc->sides_option)
-    cupsFilePrintf(fp, "SidesOption %s\n", pc->sides_option);
+  for (f = (_pwg_finishings_t *)cupsArrayFirst(pc->finishings);
+       f;
+       f = (_pwg_finishings_t *)cupsArrayNext(pc->finishings))
+  {
+    cfinishings.value        = (int)f->value;
+    cfinishings.first_option = cstring;
+    cfinishings.num_options  = (unsigned)f->num_options;
 
-  if (pc->sides_1sided)
-    cupsFilePrintf(fp, "Sides1Sided %s\n", pc->sides_1sided);
+    ppd_cache_add(&(writer.data), &cfinishings, sizeof(cfinishings));
 
-  if (pc->sides_2sided_long)
-    cupsFilePrintf(fp, "Sides2SidedLong %s\n", pc->sides_2sided_long);
+    cstring += cfinishings.num_options;
+  }
+
+ /*
+  * Duplex/sides, product, and accounting values...
+  */
 
-  if (pc->sides_2sided_short)
-    cupsFilePrintf(fp, "Sides2SidedShort %s\n", pc->sides_2sided_short);
+  header.sides_option       = ppd_cache_add_string(&writer, pc->sides_option);
+  header.sides_1sided       = ppd_cache_add_string(&writer, pc->sides_1sided);
+  header.sides_2sided_long  = ppd_cache_add_string(&writer,
+                                                   pc->sides_2sided_long);
+  header.sides_2sided_short = ppd_cache_add_string(&writer,
+                                                   pc->sides_2sided_short);
+  header.product            = ppd_cache_add_string(&writer, pc->product);
+  header.single_file        = pc->single_file;
+  header.max_copies         = pc->max_copies;
+  header.account_id         = pc->account_id;
+  header.accounting_user_id = pc->accounting_user_id;
+  header.password           = ppd_cache_add_string(&writer, pc->password);
+  header.charge_info_uri    = ppd_cache_add_string(&writer,
+                                                   pc->charge_info_uri);
 
  /*
-  * Product, cupsFilter, cupsFilter2, and cupsPreFilter...
+  * cupsFilter, cupsFilter2, cupsPreFilter, cupsMandatory, and support
+  * files...
   */
 
-  if (pc->product)
-    cupsFilePutConf(fp, "Product", pc->product);
+  header.filters.offset = (unsigned)writer.data.used;
+  header.filters.count  = (unsigned)cupsArrayCount(pc->filters);
 
   for (value = (const char *)cupsArrayFirst(pc->filters);
        value;
        value = (const char *)cupsArrayNext(pc->filters))
-    cupsFilePutConf(fp, "Filter", value);
+  {
+    cstring = ppd_cache_add_string(&writer, value);
+    ppd_cache_add(&(writer.data), &cstring, sizeof(cstring));
+  }
+
+  header.prefilters.offset = (unsigned)writer.data.used;
+  header.prefilters.count  = (unsigned)cupsArrayCount(pc->prefilters);
 
   for (value = (const char *)cupsArrayFirst(pc->prefilters);
        value;
        value = (const char *)cupsArrayNext(pc->prefilters))
-    cupsFilePutConf(fp, "PreFilter", value);
-
-  cupsFilePrintf(fp, "SingleFile %s\n", pc->single_file ? "true" : "false");
+  {
+    cstring = ppd_cache_add_string(&writer, value);
+    ppd_cache_add(&(writer.data), &cstring, sizeof(cstring));
+  }
 
- /*
-  * Finishing options...
-  */
+  header.mandatory.offset = (unsigned)writer.data.used;
+  header.mandatory.count  = (unsigned)cupsArrayCount(pc->mandatory);
 
-  for (f = (_pwg_finishings_t *)cupsArrayFirst(pc->finishings);
-       f;
-       f = (_pwg_finishings_t *)cupsArrayNext(pc->finishings))
+  for (value = (const char *)cupsArrayFirst(pc->mandatory);
+       value;
+       value = (const char *)cupsArrayNext(pc->mandatory))
   {
-    cupsFilePrintf(fp, "Finishings %d", f->value);
-    for (i = f->num_options, option = f->options; i > 0; i --, option ++)
-      cupsFilePrintf(fp, " %s=%s", option->name, option->value);
-    cupsFilePutChar(fp, '\n');
+    cstring = ppd_cache_add_string(&writer, value);
+    ppd_cache_add(&(writer.data), &cstring, sizeof(cstring));
   }
 
- /*
-  * Max copies...
-  */
+  header.support_files.offset = (unsigned)writer.data.used;
+  header.support_files.count  = (unsigned)cupsArrayCount(pc->support_files);
 
-  cupsFilePrintf(fp, "MaxCopies %d\n", pc->max_copies);
+  for (value = (const char *)cupsArrayFirst(pc->support_files);
+       value;
+       value = (const char *)cupsArrayNext(pc->support_files))
+  {
+    cstring = ppd_cache_add_string(&writer, value);
+    ppd_cache_add(&(writer.data), &cstring, sizeof(cstring));
+  }
 
  /*
-  * Accounting/quota/PIN/managed printing values...
+  * String table, then the IPP attributes, if any...
   */
 
-  if (pc->charge_info_uri)
-    cupsFilePutConf(fp, "ChargeInfoURI", pc->charge_info_uri);
+  header.strings.offset = (unsigned)writer.data.used;
+  header.strings.count  = (unsigned)writer.strings.used;
 
-  cupsFilePrintf(fp, "AccountId %s\n", pc->account_id ? "true" : "false");
-  cupsFilePrintf(fp, "AccountingUserId %s\n",
-                 pc->accounting_user_id ? "true" : "false");
+  ppd_cache_add(&(writer.data), writer.strings.data, writer.strings.used);
 
-  if (pc->password)
-    cupsFilePutConf(fp, "Password", pc->password);
+  header.ipp.offset = (unsigned)writer.data.used;
 
-  for (value = (char *)cupsArrayFirst(pc->mandatory);
-       value;
-       value = (char *)cupsArrayNext(pc->mandatory))
-    cupsFilePutConf(fp, "Mandatory", value);
+  if (attrs)
+  {
+    attrs->state = IPP_STATE_IDLE;
+    if (ippWriteIO(&(writer.data), (ipp_iocb_t)ppd_cache_write_cb, 1, NULL,
+                   attrs) != IPP_STATE_DATA)
+      writer.data.error = 1;
+
+    header.ipp.count = (unsigned)writer.data.used - header.ipp.offset;
+  }
 
  /*
-  * Support files...
+  * Fill in the header...
   */
 
-  for (value = (char *)cupsArrayFirst(pc->support_files);
-       value;
-       value = (char *)cupsArrayNext(pc->support_files))
-    cupsFilePutConf(fp, "SupportFile", value);
+  memcpy(header.magic, _PPD_CFILE_MAGIC, sizeof(header.magic));
+  header.version    = _PPD_CACHE_VERSION;
+  header.byte_order = _PPD_CFILE_ORDER;
+  header.length     = (unsigned)writer.data.used;
+
+  cupsArrayDelete(writer.pool);
+  free(writer.strings.data);
+
+  if (writer.data.error || writer.strings.error ||
+      writer.data.used > _PPD_CFILE_MAX)
+  {
+    free(writer.data.data);
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(ENOMEM), 0);
+    return (0);
+  }
+
+  memcpy(writer.data.data, &header, sizeof(header));
 
  /*
-  * IPP attributes, if any...
+  * Write the file uncompressed so that it can be mapped into memory...
   */
 
-  if (attrs)
+  snprintf(newfile, sizeof(newfile), "%s.N", filename);
+  if ((fp = cupsFileOpen(newfile, "w")) == NULL)
   {
-    cupsFilePrintf(fp, "IPP " CUPS_LLFMT "\n", CUPS_LLCAST ippLength(attrs));
-
-    attrs->state = IPP_STATE_IDLE;
-    ippWriteIO(fp, (ipp_iocb_t)cupsFileWrite, 1, NULL, attrs);
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
+    free(writer.data.data);
+    return (0);
   }
 
+  i = cupsFileWrite(fp, (char *)writer.data.data, writer.data.used) < 0;
+
+  free(writer.data.data);
+
  /*
   * Close and return...
   */
 
-  if (cupsFileClose(fp))
+  if (cupsFileClose(fp) || i)
   {
     unlink(newfile);
     return (0);
@@ -2637,6 +2844,223 @@ _pwgPageSizeForMedia(
 }
 
 
+/*
+ * 'ppd_cache_add()' - Add data to a cache file buffer.
+ */
+
+static void
+ppd_cache_add(_ppd_cbuf_t *buf,		/* I - Buffer */
+              const void  *data,	/* I - Data to add */
+	      size_t      bytes)	/* I - Number of bytes */
+{
+  if (buf->error || bytes == 0)
+    return;
+
+  if (buf->used + bytes > buf->alloc)
+  {
+    size_t		alloc;		/* New allocation */
+    unsigned char	*temp;		/* New buffer */
+
+    for (alloc = buf->alloc ? buf->alloc : 4096;
+         alloc < buf->used + bytes;
+	 alloc *= 2);
+
+    if ((temp = realloc(buf->data, alloc)) == NULL)
+    {
+      buf->error = 1;
+      return;
+    }
+
+    buf->data  = temp;
+    buf->alloc = alloc;
+  }
+
+  memcpy(buf->data + buf->used, data, bytes);
+  buf->used += bytes;
+}
+
+
+/*
+ * 'ppd_cache_add_options()' - Add options to the options table.
+ */
+
+static void
+ppd_cache_add_options(
+    _ppd_cwriter_t *writer,		/* I - Cache file writer */
+    _ppd_ctable_t  *table,		/* I - Options table */
+    int            num_options,		/* I - Number of options */
+    cups_option_t  *options)		/* I - Options */
+{
+  _ppd_cmap_t	cmap;			/* Option in file */
+
+
+  for (; num_options > 0; num_options --, options ++)
+  {
+    cmap.name  = ppd_cache_add_string(writer, options->name);
+    cmap.value = ppd_cache_add_string(writer, options->value);
+
+    ppd_cache_add(&(writer->data), &cmap, sizeof(cmap));
+
+    table->count ++;
+  }
+}
+
+
+/*
+ * 'ppd_cache_add_string()' - Add a string to the string table.
+ *
+ * Each unique string is stored once.
+ */
+
+static unsigned				/* O - Offset in string table */
+ppd_cache_add_string(
+    _ppd_cwriter_t *writer,		/* I - Cache file writer */
+    const char     *s)			/* I - String or @code NULL@ */
+{
+  _ppd_cstring_t	key,		/* Search key */
+			*match;		/* Matching string */
+
+
+  if (!s)
+    return (_PPD_CFILE_NONE);
+
+  key.str = s;
+
+  if ((match = (_ppd_cstring_t *)cupsArrayFind(writer->pool, &key)) != NULL)
+    return (match->offset);
+
+  if ((match = malloc(sizeof(_ppd_cstring_t))) == NULL)
+  {
+    writer->strings.error = 1;
+    return (_PPD_CFILE_NONE);
+  }
+
+  match->str    = s;
+  match->offset = (unsigned)writer->strings.used;
+
+  cupsArrayAdd(writer->pool, match);
+  ppd_cache_add(&(writer->strings), s, strlen(s) + 1);
+
+  return (match->offset);
+}
+
+
+/*
+ * 'ppd_cache_compare_strings()' - Compare two strings in the string table.
+ */
+
+static int				/* O - Result of comparison */
+ppd_cache_compare_strings(
+    _ppd_cstring_t *a,			/* I - First string */
+    _ppd_cstring_t *b)			/* I - Second string */
+{
+  return (strcmp(a->str, b->str));
+}
+
+
+/*
+ * 'ppd_cache_options()' - Validate a range of the options table.
+ */
+
+static int				/* O - 1 if valid, 0 otherwise */
+ppd_cache_options(
+    const _ppd_cfile_t *header,		/* I - Cache file header */
+    unsigned           first,		/* I - First option */
+    unsigned           count)		/* I - Number of options */
+{
+  return (first <= header->options.count &&
+          count <= header->options.count - first);
+}
+
+
+/*
+ * 'ppd_cache_read_cb()' - Read IPP data from a cache file.
+ */
+
+static ssize_t				/* O - Number of bytes read */
+ppd_cache_read_cb(
+    _ppd_creader_t *reader,		/* I - Cache file reader */
+    ipp_uchar_t    *buffer,		/* I - Buffer */
+    size_t         bytes)		/* I - Number of bytes to read */
+{
+  if (bytes > (size_t)(reader->end - reader->ptr))
+    bytes = (size_t)(reader->end - reader->ptr);
+
+  memcpy(buffer, reader->ptr, bytes);
+  reader->ptr += bytes;
+
+  return ((ssize_t)bytes);
+}
+
+
+/*
+ * 'ppd_cache_string()' - Get a string from the string table.
+ */
+
+static char *				/* O - String or @code NULL@ */
+ppd_cache_string(
+    _ppd_creader_t *reader,		/* I - Cache file reader */
+    unsigned       offset,		/* I - Offset in string table */
+    int            required)		/* I - 1 if the string is required */
+{
+  if (offset == _PPD_CFILE_NONE)
+  {
+    if (required)
+      reader->error = 1;
+
+    return (NULL);
+  }
+  else if (offset >= reader->num_strings)
+  {
+    reader->error = 1;
+    return (NULL);
+  }
+  else
+    return ((char *)reader->strings + offset);
+}
+
+
+/*
+ * 'ppd_cache_table()' - Get a table from a cache file.
+ */
+
+static const void *			/* O - First record or @code NULL@ */
+ppd_cache_table(
+    _ppd_creader_t      *reader,	/* I - Cache file reader */
+    const _ppd_ctable_t *table,		/* I - Table */
+    size_t              size)		/* I - Size of each record */
+{
+  if (table->count == 0)
+    return (NULL);
+
+  if (table->offset > reader->length ||
+      table->count > (reader->length - table->offset) / size ||
+      (size > 1 && (table->offset & 3)))
+  {
+    reader->error = 1;
+    return (NULL);
+  }
+
+  return (reader->data + table->offset);
+}
+
+
+/*
+ * 'ppd_cache_write_cb()' - Write IPP data to a cache file buffer.
+ */
+
+static ssize_t				/* O - Number of bytes written */
+ppd_cache_write_cb(
+    _ppd_cbuf_t *buf,			/* I - Buffer */
+    ipp_uchar_t *buffer,		/* I - Data to write */
+    size_t      bytes)			/* I - Number of bytes */
+{
+  ppd_cache_add(buf, buffer, bytes);
+
+  return (buf->error ? -1 : (ssize_t)bytes);
+}
+
+
 /*
  * 'pwg_compare_finishings()' - Compare two finishings values.
  */
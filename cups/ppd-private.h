@@ -49,7 +49,7 @@ extern "C" {
  * Constants...
  */
 
-#  define _PPD_CACHE_VERSION	6	/* Version number in cache file */
+#  define _PPD_CACHE_VERSION	7	/* Version number in cache file */
 
 
 /*
@@ -148,6 +148,11 @@ struct _ppd_cache_s			/**** PPD cache and PWG conversion data ****/
   cups_array_t	*mandatory;		/* cupsMandatory value */
   char		*charge_info_uri;	/* cupsChargeInfoURI value */
   cups_array_t	*support_files;		/* Support files - ICC profiles, etc. */
+  void		*map;			/* Cache file data, if loaded from a file */
+  size_t	maplen;			/* Length of cache file data */
+  int		mapped;			/* Is the cache file mapped? */
+  cups_option_t	*map_options;		/* Preset/finishings options from file */
+  _pwg_finishings_t *map_finishings;	/* Finishings values from file */
 };
 
 
@@ -157,6 +162,8 @@ struct _ppd_cache_s			/**** PPD cache and PWG conversion data ****/
 
 extern _ppd_cache_t	*_ppdCacheCreateWithFile(const char *filename,
 			                         ipp_t **attrs);
+extern _ppd_cache_t	*_ppdCacheCreateWithFile2(const char *filename,
+			                          ipp_t **attrs, int mapfile);
 extern _ppd_cache_t	*_ppdCacheCreateWithPPD(ppd_file_t *ppd);
 extern void		_ppdCacheDestroy(_ppd_cache_t *pc);
 extern const char	*_ppdCacheGetBin(_ppd_cache_t *pc,
@@ -17,6 +17,9 @@
  * Contents:
  *
  *   main()             - Main entry.
+ *   arena_attributes() - Test and time arena-allocated messages.
+ *   build_message()    - Add a mix of attributes to a message.
+ *   find_attributes()  - Test and time ippFindAttribute on a large message.
  *   hex_dump()         - Produce a hex dump of a buffer.
  *   print_attributes() - Print the attributes in a request...
  *   read_cb()          - Read data from a buffer.
@@ -35,6 +38,7 @@
 #else
 #  include <unistd.h>
 #  include <fcntl.h>
+#  include <sys/time.h>
 #endif /* WIN32 */
 
 
@@ -236,6 +240,9 @@ ipp_uchar_t	mixed[] =		/* Mixed value buffer */
  * Local functions...
  */
 
+int	arena_attributes(int count);
+void	build_message(ipp_t *ipp, int count);
+int	find_attributes(const char *title, ipp_tag_t group, int count);
 void	hex_dump(const char *title, ipp_uchar_t *buffer, int bytes);
 void	print_attributes(ipp_t *ipp, int indent);
 ssize_t	read_cb(_ippdata_t *data, ipp_uchar_t *buffer, size_t bytes);
@@ -656,6 +663,23 @@ main(int  argc,			/* I - Number of command-line arguments */
       status = 1;
     }
 
+   /*
+    * Test and time lookups in printer and job sized messages...
+    */
+
+    if (!find_attributes("printer", IPP_TAG_PRINTER, 200))
+      status = 1;
+
+    if (!find_attributes("job", IPP_TAG_JOB, 200))
+      status = 1;
+
+   /*
+    * Test and time arena-allocated messages...
+    */
+
+    if (!arena_attributes(200))
+      status = 1;
+
    /*
     * Summarize...
     */
@@ -706,6 +730,340 @@ main(int  argc,			/* I - Number of command-line arguments */
 }
 
 
+/*
+ * 'arena_attributes()' - Test and time arena-allocated messages.
+ */
+
+int					/* O - 1 on success, 0 on failure */
+arena_attributes(int count)		/* I - Number of attributes */
+{
+  ipp_t		*ipp,			/* Normal message */
+		*arena;			/* Arena message */
+  _ippdata_t	data[2];		/* Encoded messages */
+  int		i,			/* Looping var */
+		messages[2];		/* Messages created */
+  struct timeval start,			/* Start time */
+		end;			/* End time */
+  double	secs[2];		/* Elapsed seconds */
+
+
+  printf("ippNewArena(%d attributes): ", count);
+
+ /*
+  * Build the same message with and without an arena and make sure they
+  * encode the same way...
+  */
+
+  ipp   = ippNew();
+  arena = ippNewArena();
+
+  build_message(ipp, count);
+  build_message(arena, count);
+
+  for (i = 0; i < 2; i ++)
+  {
+    memset(data + i, 0, sizeof(data[i]));
+    data[i].wsize   = (size_t)ippLength(i ? arena : ipp);
+    data[i].wbuffer = malloc(data[i].wsize);
+
+    ippSetState(i ? arena : ipp, IPP_STATE_IDLE);
+    while (ippWriteIO(data + i, (ipp_iocb_t)write_cb, 1, NULL,
+                      i ? arena : ipp) == IPP_STATE_ATTRIBUTE);
+  }
+
+  if (data[0].wused != data[0].wsize || data[1].wused != data[1].wsize ||
+      data[0].wused != data[1].wused ||
+      memcmp(data[0].wbuffer, data[1].wbuffer, data[0].wused))
+  {
+    printf("FAIL (encoded %d bytes, expected %d bytes)\n",
+           (int)data[1].wused, (int)data[0].wused);
+
+    if (data[1].wused == data[0].wused)
+    {
+      hex_dump("Expected", data[0].wbuffer, (int)data[0].wused);
+      hex_dump("Arena", data[1].wbuffer, (int)data[1].wused);
+    }
+
+    free(data[0].wbuffer);
+    free(data[1].wbuffer);
+    ippDelete(ipp);
+    ippDelete(arena);
+    return (0);
+  }
+
+  free(data[0].wbuffer);
+  free(data[1].wbuffer);
+  ippDelete(ipp);
+  ippDelete(arena);
+
+ /*
+  * Time building and freeing messages both ways...
+  */
+
+  for (i = 0; i < 2; i ++)
+  {
+    messages[i] = 0;
+    gettimeofday(&start, NULL);
+
+    do
+    {
+      ipp = i ? ippNewArena() : ippNew();
+      build_message(ipp, count);
+      ippDelete(ipp);
+
+      messages[i] ++;
+
+      gettimeofday(&end, NULL);
+      secs[i] = end.tv_sec - start.tv_sec +
+                0.000001 * (end.tv_usec - start.tv_usec);
+    }
+    while (secs[i] < 0.25);
+  }
+
+  printf("PASS (%.0f messages/second, %.0f without arena)\n",
+         messages[1] / secs[1], messages[0] / secs[0]);
+
+  return (1);
+}
+
+
+/*
+ * 'build_message()' - Add a mix of attributes to a message.
+ */
+
+void
+build_message(ipp_t *ipp,		/* I - IPP message */
+              int   count)		/* I - Number of attributes */
+{
+  int			i;		/* Looping var */
+  ipp_t			*col;		/* Collection value */
+  ipp_attribute_t	*attr;		/* Current attribute */
+  char			name[256],	/* Attribute name */
+			value[256];	/* String value */
+  static const char * const values[] =	/* Multiple string values */
+  {
+    "one",
+    "two",
+    "three"
+  };
+
+
+  ippAddString(ipp, IPP_TAG_OPERATION, IPP_TAG_CHARSET, "attributes-charset",
+               NULL, "utf-8");
+  ippAddString(ipp, IPP_TAG_OPERATION, IPP_TAG_LANGUAGE,
+               "attributes-natural-language", NULL, "en");
+
+  for (i = 0; i < count; i ++)
+  {
+    snprintf(name, sizeof(name), "attribute-%03d", i);
+    snprintf(value, sizeof(value), "value-%03d", i);
+
+    switch (i % 5)
+    {
+      case 0 :
+          ippAddInteger(ipp, IPP_TAG_PRINTER, IPP_TAG_INTEGER, name, i);
+	  break;
+      case 1 :
+          ippAddString(ipp, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, name, NULL,
+	               value);
+	  break;
+      case 2 :
+          ippAddString(ipp, IPP_TAG_PRINTER, IPP_TAG_TEXTLANG, name, "fr",
+	               value);
+	  break;
+      case 3 :
+          ippAddStrings(ipp, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, name, 3, NULL,
+	                values);
+	  break;
+      case 4 :
+          col = ippNew();
+	  ippAddString(col, IPP_TAG_ZERO, IPP_TAG_KEYWORD, "member", NULL,
+	               value);
+          ippAddCollection(ipp, IPP_TAG_PRINTER, name, col);
+	  ippDelete(col);
+	  break;
+    }
+  }
+
+ /*
+  * Grow, change, rename, and delete a few attributes...
+  */
+
+  attr = ippAddInteger(ipp, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "grown", 0);
+  for (i = 1; i < 3 * IPP_MAX_VALUES; i ++)
+    ippSetInteger(ipp, &attr, i, i);
+
+  attr = ippFindAttribute(ipp, "attribute-001", IPP_TAG_ZERO);
+  snprintf(value, sizeof(value), "changed-%03d", 1);
+  ippSetString(ipp, &attr, 0, value);
+  ippSetString(ipp, &attr, 1, "added");
+  ippSetName(ipp, &attr, "renamed");
+
+  ippDeleteAttribute(ipp, ippFindAttribute(ipp, "attribute-003",
+                                           IPP_TAG_ZERO));
+}
+
+
+/*
+ * 'find_attributes()' - Test and time ippFindAttribute on a large message.
+ */
+
+int					/* O - 1 on success, 0 on failure */
+find_attributes(const char *title,	/* I - Title */
+                ipp_tag_t  group,	/* I - Group for attributes */
+                int        count)	/* I - Number of attributes */
+{
+  ipp_t			*ipp;		/* Test message */
+  ipp_attribute_t	*attr,		/* Current attribute */
+			*found;		/* Found attribute */
+  int			i,		/* Looping var */
+			lookups;	/* Number of lookups */
+  char			name[256];	/* Attribute name */
+  struct timeval	start,		/* Start time */
+			end;		/* End time */
+  double		secs;		/* Elapsed seconds */
+
+
+  printf("ippFindAttribute(%d %s attributes): ", count, title);
+
+ /*
+  * Build a message with "count" attributes plus a second, differently typed
+  * copy of the first one in a later group...
+  */
+
+  ipp = ippNew();
+
+  ippAddString(ipp, IPP_TAG_OPERATION, IPP_TAG_CHARSET, "attributes-charset",
+               NULL, "utf-8");
+  ippAddString(ipp, IPP_TAG_OPERATION, IPP_TAG_LANGUAGE,
+               "attributes-natural-language", NULL, "en");
+
+  for (i = 0; i < count; i ++)
+  {
+    snprintf(name, sizeof(name), "%s-attribute-%03d", title, i);
+    ippAddInteger(ipp, group, IPP_TAG_INTEGER, name, i);
+  }
+
+  ippAddSeparator(ipp);
+  snprintf(name, sizeof(name), "%s-attribute-000", title);
+  ippAddString(ipp, group, IPP_TAG_KEYWORD, name, NULL, "duplicate");
+
+ /*
+  * Look up every attribute, in upper case for the second half to check that
+  * names are matched without regard to case...
+  */
+
+  for (i = 0; i < count; i ++)
+  {
+    snprintf(name, sizeof(name), "%s-attribute-%03d", title, i);
+    if (i >= count / 2)
+    {
+      char *ptr;			/* Pointer into name */
+
+      for (ptr = name; *ptr; ptr ++)
+        *ptr = (char)_cups_toupper(*ptr);
+    }
+
+    if ((found = ippFindAttribute(ipp, name, IPP_TAG_INTEGER)) == NULL ||
+        found->values[0].integer != i)
+    {
+      printf("FAIL (%s not found)\n", name);
+      ippDelete(ipp);
+      return (0);
+    }
+  }
+
+  snprintf(name, sizeof(name), "%s-attribute-000", title);
+
+  if ((found = ippFindAttribute(ipp, name, IPP_TAG_KEYWORD)) == NULL ||
+      found != ipp->last)
+  {
+    printf("FAIL (%s keyword not found)\n", name);
+    ippDelete(ipp);
+    return (0);
+  }
+
+  if ((found = ippFindAttribute(ipp, name, IPP_TAG_ZERO)) == NULL ||
+      found->value_tag != IPP_TAG_INTEGER ||
+      (found = ippFindNextAttribute(ipp, name, IPP_TAG_ZERO)) == NULL ||
+      found != ipp->last)
+  {
+    printf("FAIL (%s duplicates out of order)\n", name);
+    ippDelete(ipp);
+    return (0);
+  }
+
+  if (ippFindAttribute(ipp, "no-such-attribute", IPP_TAG_ZERO))
+  {
+    puts("FAIL (found missing attribute)");
+    ippDelete(ipp);
+    return (0);
+  }
+
+ /*
+  * Make sure deleting, renaming, and adding attributes are seen...
+  */
+
+  snprintf(name, sizeof(name), "%s-attribute-%03d", title, count / 2);
+  ippDeleteAttribute(ipp, ippFindAttribute(ipp, name, IPP_TAG_ZERO));
+
+  if (ippFindAttribute(ipp, name, IPP_TAG_ZERO))
+  {
+    printf("FAIL (%s found after delete)\n", name);
+    ippDelete(ipp);
+    return (0);
+  }
+
+  snprintf(name, sizeof(name), "%s-attribute-%03d", title, count - 1);
+  attr = ippFindAttribute(ipp, name, IPP_TAG_ZERO);
+  ippSetName(ipp, &attr, "renamed-attribute");
+
+  if (ippFindAttribute(ipp, name, IPP_TAG_ZERO) ||
+      ippFindAttribute(ipp, "renamed-attribute", IPP_TAG_ZERO) != attr)
+  {
+    printf("FAIL (%s found after rename)\n", name);
+    ippDelete(ipp);
+    return (0);
+  }
+
+  attr = ippAddBoolean(ipp, group, "added-attribute", 1);
+
+  if (ippFindAttribute(ipp, "added-attribute", IPP_TAG_BOOLEAN) != attr)
+  {
+    puts("FAIL (added-attribute not found)");
+    ippDelete(ipp);
+    return (0);
+  }
+
+ /*
+  * Time lookups spread across the whole message...
+  */
+
+  lookups = 0;
+  gettimeofday(&start, NULL);
+
+  do
+  {
+    for (i = 0; i < 1000; i ++, lookups ++)
+    {
+      snprintf(name, sizeof(name), "%s-attribute-%03d", title,
+               (i * 7) % (count - 1));
+      ippFindAttribute(ipp, name, IPP_TAG_ZERO);
+    }
+
+    gettimeofday(&end, NULL);
+    secs = end.tv_sec - start.tv_sec + 0.000001 * (end.tv_usec - start.tv_usec);
+  }
+  while (secs < 0.25);
+
+  printf("PASS (%.0f lookups/second)\n", lookups / secs);
+
+  ippDelete(ipp);
+
+  return (1);
+}
+
+
 /*
  * 'hex_dump()' - Produce a hex dump of a buffer.
  */
@@ -3,7 +3,7 @@
  *
  *   PPD test program for CUPS.
  *
- *   Copyright 2007-2013 by Apple Inc.
+ *   Copyright 2007-2014 by Apple Inc.
  *   Copyright 1997-2006 by Easy Software Products.
  *
  *   These coded instructions, statements, and computer programs are the
@@ -16,7 +16,14 @@
  *
  * Contents:
  *
- *   main() - Main entry.
+ *   main()              - Main entry.
+ *   compare_attrs()     - Compare two sets of IPP attributes.
+ *   compare_maps()      - Compare two arrays of PWG mappings.
+ *   compare_options()   - Compare two arrays of options.
+ *   compare_ppd_cache() - Compare two PPD caches.
+ *   compare_strings()   - Compare two arrays of strings.
+ *   put_cache_word()    - Set a word in a cache file buffer.
+ *   test_ppd_cache()    - Write and read a PPD cache file.
  */
 
 /*
@@ -128,6 +135,91 @@ static const char	*default2_code =
 			"%%EndFeature\n"
 			"} stopped cleartomark\n";
 
+static const char	*cache_ppd =
+			"*PPD-Adobe: \"4.3\"\n"
+			"*FormatVersion: \"4.3\"\n"
+			"*FileVersion: \"1.0\"\n"
+			"*LanguageVersion: English\n"
+			"*LanguageEncoding: ISOLatin1\n"
+			"*PCFileName: \"CACHE.PPD\"\n"
+			"*Manufacturer: \"Test\"\n"
+			"*Product: \"(Cache Test)\"\n"
+			"*ModelName: \"Test Cache\"\n"
+			"*ShortNickName: \"Test Cache\"\n"
+			"*NickName: \"Test Cache\"\n"
+			"*PSVersion: \"(3010.000) 0\"\n"
+			"*ColorDevice: True\n"
+			"*cupsVersion: 2.0\n"
+			"*cupsFilter2: \"application/vnd.cups-postscript "
+			"application/vnd.test 0 -\"\n"
+			"*cupsPreFilter: \"application/pdf 0 -\"\n"
+			"*cupsSingleFile: True\n"
+			"*cupsMaxCopies: 99\n"
+			"*cupsJobAccountId: True\n"
+			"*cupsJobAccountingUserId: True\n"
+			"*cupsJobPassword: \"1111\"\n"
+			"*cupsChargeInfoURI: \"http://localhost/charge\"\n"
+			"*cupsMandatory: \"job-account-id job-password\"\n"
+			"*cupsICCProfile RGB../Color: \"/test/color.icc\"\n"
+			"*cupsICCProfile Gray../Gray: \"/test/gray.icc\"\n"
+			"*cupsIPPFinishings 4/staple: \"*StapleLocation "
+			"SinglePortrait\"\n"
+			"*cupsIPPFinishings 28/staple-dual-left: \"*StapleLocation "
+			"DualLandscape *OutputBin Lower\"\n"
+			"*APPrinterPreset Color_Normal/Color: \"*ColorModel RGB "
+			"*cupsPrintQuality Normal com.apple.print.preset.quality mid "
+			"com.apple.print.preset.output-mode color\"\n"
+			"*APPrinterPreset Gray_High/Gray: \"*ColorModel Gray "
+			"*cupsPrintQuality High com.apple.print.preset.quality high "
+			"com.apple.print.preset.output-mode monochrome\"\n"
+			"*OpenUI *PageSize: PickOne\n"
+			"*DefaultPageSize: Letter\n"
+			"*PageSize Letter/US Letter: \"\"\n"
+			"*PageSize A4/A4: \"\"\n"
+			"*CloseUI: *PageSize\n"
+			"*DefaultImageableArea: Letter\n"
+			"*ImageableArea Letter: \"18 36 594 756\"\n"
+			"*ImageableArea A4: \"18 36 577 806\"\n"
+			"*DefaultPaperDimension: Letter\n"
+			"*PaperDimension Letter: \"612 792\"\n"
+			"*PaperDimension A4: \"595 842\"\n"
+			"*OpenUI *OutputBin/Output Tray: PickOne\n"
+			"*DefaultOutputBin: Upper\n"
+			"*OutputBin Upper/Upper Tray: \"\"\n"
+			"*OutputBin Lower/Lower Tray: \"\"\n"
+			"*CloseUI: *OutputBin\n"
+			"*OpenUI *StapleLocation/Staple: PickOne\n"
+			"*DefaultStapleLocation: None\n"
+			"*StapleLocation None/None: \"\"\n"
+			"*StapleLocation SinglePortrait/One Staple: \"\"\n"
+			"*StapleLocation DualLandscape/Two Staples: \"\"\n"
+			"*CloseUI: *StapleLocation\n"
+			"*OpenUI *ColorModel/Color Mode: PickOne\n"
+			"*DefaultColorModel: RGB\n"
+			"*ColorModel RGB/Color: \"\"\n"
+			"*ColorModel Gray/Grayscale: \"\"\n"
+			"*CloseUI: *ColorModel\n"
+			"*OpenUI *cupsPrintQuality/Print Quality: PickOne\n"
+			"*DefaultcupsPrintQuality: Normal\n"
+			"*cupsPrintQuality Normal/Normal: \"\"\n"
+			"*cupsPrintQuality High/High: \"\"\n"
+			"*CloseUI: *cupsPrintQuality\n";
+
+
+/*
+ * Local functions...
+ */
+
+static const char	*compare_attrs(ipp_t *a, ipp_t *b);
+static int		compare_maps(int num_maps, pwg_map_t *a, pwg_map_t *b);
+static int		compare_options(int num_options, cups_option_t *a,
+			                cups_option_t *b);
+static const char	*compare_ppd_cache(_ppd_cache_t *a, _ppd_cache_t *b);
+static int		compare_strings(cups_array_t *a, cups_array_t *b);
+static void		put_cache_word(unsigned char *data, size_t offset,
+			               unsigned value);
+static int		test_ppd_cache(const char *name, ppd_file_t *ppd);
+
 
 /*
  * 'main()' - Main entry.
@@ -152,6 +244,7 @@ main(int  argc,				/* I - Number of command-line arguments */
 		*size;			/* Current size */
   ppd_attr_t	*attr;			/* Current attribute */
   _ppd_cache_t	*pc;			/* PPD cache */
+  cups_file_t	*fp;			/* PPD file for cache tests */
 
 
   status = 0;
@@ -629,6 +722,12 @@ main(int  argc,				/* I - Number of command-line arguments */
              text ? text : "(null)");
     }
 
+   /*
+    * Test the PPD cache file...
+    */
+
+    status += test_ppd_cache("test.ppd", ppd);
+
     ppdClose(ppd);
 
    /*
@@ -854,6 +953,42 @@ main(int  argc,				/* I - Number of command-line arguments */
       puts("FAIL (returned 0)");
       status ++;
     }
+
+   /*
+    * Test the PPD cache file with the presets, finishings, and job values
+    * that test.ppd does not have...
+    */
+
+    ppdClose(ppd);
+    ppd = NULL;
+
+    fputs("ppdOpenFile(cache.ppd): ", stdout);
+
+    if ((fp = cupsFileOpen("cache.ppd", "w")) != NULL)
+    {
+      cupsFilePuts(fp, cache_ppd);
+      cupsFileClose(fp);
+    }
+
+    if ((ppd = ppdOpenFile("cache.ppd")) != NULL)
+    {
+      puts("PASS");
+
+      status += test_ppd_cache("cache.ppd", ppd);
+    }
+    else
+    {
+      ppd_status_t	err;		/* Last error in file */
+      int		line;		/* Line number in file */
+
+
+      status ++;
+      err = ppdLastError(&line);
+
+      printf("FAIL (%s on line %d)\n", ppdErrorString(err), line);
+    }
+
+    unlink("cache.ppd");
   }
   else
   {
@@ -1108,6 +1243,490 @@ main(int  argc,				/* I - Number of command-line arguments */
 }
 
 
+/*
+ * 'compare_attrs()' - Compare two sets of IPP attributes.
+ */
+
+static const char *			/* O - Difference or @code NULL@ */
+compare_attrs(ipp_t *a,			/* I - First attributes */
+              ipp_t *b)			/* I - Second attributes */
+{
+  ipp_attribute_t	*aattr,		/* First attribute */
+			*battr;		/* Second attribute */
+  char			avalue[1024],	/* First value */
+			bvalue[1024];	/* Second value */
+
+
+  if (!a || !b)
+    return (a || b ? "IPP attributes missing" : NULL);
+
+  for (aattr = ippFirstAttribute(a), battr = ippFirstAttribute(b);
+       aattr && battr;
+       aattr = ippNextAttribute(a), battr = ippNextAttribute(b))
+  {
+    if (ippGetGroupTag(aattr) != ippGetGroupTag(battr) ||
+        ippGetValueTag(aattr) != ippGetValueTag(battr) ||
+        (ippGetName(aattr) != NULL) != (ippGetName(battr) != NULL) ||
+	(ippGetName(aattr) && strcmp(ippGetName(aattr), ippGetName(battr))))
+      return ("IPP attribute names");
+
+    ippAttributeString(aattr, avalue, sizeof(avalue));
+    ippAttributeString(battr, bvalue, sizeof(bvalue));
+
+    if (strcmp(avalue, bvalue))
+      return ("IPP attribute values");
+  }
+
+  if (aattr || battr)
+    return ("IPP attribute count");
+
+  return (NULL);
+}
+
+
+/*
+ * 'compare_maps()' - Compare two arrays of PWG mappings.
+ */
+
+static int				/* O - 0 if the same, 1 otherwise */
+compare_maps(int       num_maps,	/* I - Number of mappings */
+             pwg_map_t *a,		/* I - First mappings */
+	     pwg_map_t *b)		/* I - Second mappings */
+{
+  for (; num_maps > 0; num_maps --, a ++, b ++)
+    if (strcmp(a->pwg, b->pwg) || strcmp(a->ppd, b->ppd))
+      return (1);
+
+  return (0);
+}
+
+
+/*
+ * 'compare_options()' - Compare two arrays of options.
+ */
+
+static int				/* O - 0 if the same, 1 otherwise */
+compare_options(int           num_options,
+					/* I - Number of options */
+                cups_option_t *a,	/* I - First options */
+		cups_option_t *b)	/* I - Second options */
+{
+  for (; num_options > 0; num_options --, a ++, b ++)
+    if (strcmp(a->name, b->name) || strcmp(a->value, b->value))
+      return (1);
+
+  return (0);
+}
+
+
+/*
+ * 'compare_ppd_cache()' - Compare two PPD caches.
+ */
+
+static const char *			/* O - Difference or @code NULL@ */
+compare_ppd_cache(_ppd_cache_t *a,	/* I - First cache */
+                  _ppd_cache_t *b)	/* I - Second cache */
+{
+  int			i, j;		/* Looping vars */
+  pwg_size_t		*asize,		/* First size */
+			*bsize;		/* Second size */
+  _pwg_finishings_t	*afin,		/* First finishings */
+			*bfin;		/* Second finishings */
+
+
+#define COMPARE_STRING(field) \
+  if ((a->field != NULL) != (b->field != NULL) || \
+      (a->field && strcmp(a->field, b->field))) \
+    return (#field)
+
+  if (a->num_bins != b->num_bins ||
+      compare_maps(a->num_bins, a->bins, b->bins))
+    return ("bins");
+
+  if (a->num_sizes != b->num_sizes)
+    return ("num_sizes");
+
+  for (i = a->num_sizes, asize = a->sizes, bsize = b->sizes;
+       i > 0;
+       i --, asize ++, bsize ++)
+    if (strcmp(asize->map.pwg, bsize->map.pwg) ||
+        strcmp(asize->map.ppd, bsize->map.ppd) ||
+	asize->width != bsize->width || asize->length != bsize->length ||
+	asize->left != bsize->left || asize->bottom != bsize->bottom ||
+	asize->right != bsize->right || asize->top != bsize->top)
+      return ("sizes");
+
+  if (a->custom_max_width != b->custom_max_width ||
+      a->custom_max_length != b->custom_max_length ||
+      a->custom_min_width != b->custom_min_width ||
+      a->custom_min_length != b->custom_min_length ||
+      a->custom_size.left != b->custom_size.left ||
+      a->custom_size.bottom != b->custom_size.bottom ||
+      a->custom_size.right != b->custom_size.right ||
+      a->custom_size.top != b->custom_size.top)
+    return ("custom size limits");
+
+  COMPARE_STRING(custom_max_keyword);
+  COMPARE_STRING(custom_min_keyword);
+  COMPARE_STRING(source_option);
+
+  if (a->num_sources != b->num_sources ||
+      compare_maps(a->num_sources, a->sources, b->sources))
+    return ("sources");
+
+  if (a->num_types != b->num_types ||
+      compare_maps(a->num_types, a->types, b->types))
+    return ("types");
+
+  for (i = 0; i < _PWG_PRINT_COLOR_MODE_MAX; i ++)
+    for (j = 0; j < _PWG_PRINT_QUALITY_MAX; j ++)
+      if (a->num_presets[i][j] != b->num_presets[i][j] ||
+          compare_options(a->num_presets[i][j], a->presets[i][j],
+	                  b->presets[i][j]))
+        return ("presets");
+
+  COMPARE_STRING(sides_option);
+  COMPARE_STRING(sides_1sided);
+  COMPARE_STRING(sides_2sided_long);
+  COMPARE_STRING(sides_2sided_short);
+  COMPARE_STRING(product);
+
+  if (compare_strings(a->filters, b->filters))
+    return ("filters");
+
+  if (compare_strings(a->prefilters, b->prefilters))
+    return ("prefilters");
+
+  if (a->single_file != b->single_file)
+    return ("single_file");
+
+  if (cupsArrayCount(a->finishings) != cupsArrayCount(b->finishings))
+    return ("finishings");
+
+  for (afin = (_pwg_finishings_t *)cupsArrayFirst(a->finishings),
+           bfin = (_pwg_finishings_t *)cupsArrayFirst(b->finishings);
+       afin && bfin;
+       afin = (_pwg_finishings_t *)cupsArrayNext(a->finishings),
+           bfin = (_pwg_finishings_t *)cupsArrayNext(b->finishings))
+    if (afin->value != bfin->value ||
+        afin->num_options != bfin->num_options ||
+	compare_options(afin->num_options, afin->options, bfin->options))
+      return ("finishings");
+
+  if (a->max_copies != b->max_copies)
+    return ("max_copies");
+
+  if (a->account_id != b->account_id ||
+      a->accounting_user_id != b->accounting_user_id)
+    return ("account_id");
+
+  COMPARE_STRING(password);
+
+  if (compare_strings(a->mandatory, b->mandatory))
+    return ("mandatory");
+
+  COMPARE_STRING(charge_info_uri);
+
+  if (compare_strings(a->support_files, b->support_files))
+    return ("support_files");
+
+#undef COMPARE_STRING
+
+  return (NULL);
+}
+
+
+/*
+ * 'compare_strings()' - Compare two arrays of strings.
+ */
+
+static int				/* O - 0 if the same, 1 otherwise */
+compare_strings(cups_array_t *a,	/* I - First array */
+                cups_array_t *b)	/* I - Second array */
+{
+  const char	*astr,			/* First string */
+		*bstr;			/* Second string */
+
+
+  if (cupsArrayCount(a) != cupsArrayCount(b))
+    return (1);
+
+  for (astr = (const char *)cupsArrayFirst(a),
+           bstr = (const char *)cupsArrayFirst(b);
+       astr && bstr;
+       astr = (const char *)cupsArrayNext(a),
+           bstr = (const char *)cupsArrayNext(b))
+    if (strcmp(astr, bstr))
+      return (1);
+
+  return (0);
+}
+
+
+/*
+ * 'put_cache_word()' - Set a word in a cache file buffer.
+ */
+
+static void
+put_cache_word(unsigned char *data,	/* I - Cache file data */
+               size_t        offset,	/* I - Offset of word */
+	       unsigned      value)	/* I - New value */
+{
+  memcpy(data + offset, &value, sizeof(value));
+}
+
+
+/*
+ * 'test_ppd_cache()' - Write and read a PPD cache file.
+ *
+ * The cache created from the PPD file is written along with some IPP
+ * attributes and then read back, both by mapping the file and by reading it,
+ * and compared with the original.  Truncated and corrupted copies of the file
+ * must be rejected.
+ */
+
+static int				/* O - Number of failures */
+test_ppd_cache(const char *name,	/* I - Name of PPD file */
+               ppd_file_t *ppd)		/* I - PPD file */
+{
+  int		status = 0;		/* Number of failures */
+  _ppd_cache_t	*pc,			/* PPD cache */
+		*pc2;			/* PPD cache from file */
+  ipp_t		*attrs,			/* IPP attributes */
+		*attrs2;		/* IPP attributes from file */
+  int		mapfile;		/* Map the file? */
+  const char	*diff;			/* Difference between caches */
+  cups_file_t	*fp;			/* Cache file */
+  unsigned char	*data,			/* Cache file data */
+		*bad;			/* Corrupted cache file data */
+  size_t	length,			/* Length of cache file */
+		badlength;		/* Length of corrupted data */
+  unsigned	offset,			/* Offset of table */
+		count;			/* Number of entries in table */
+  int		i;			/* Looping var */
+  struct stat	fileinfo;		/* Cache file information */
+  static const char * const sides[] =	/* sides-supported values */
+		{
+		  "one-sided",
+		  "two-sided-long-edge",
+		  "two-sided-short-edge"
+		};
+  static const char * const corruptions[] =
+		{			/* Corrupted copies of the cache file */
+		  "empty file",
+		  "truncated header",
+		  "truncated file",
+		  "bad magic",
+		  "bad version",
+		  "bad length",
+		  "unterminated strings",
+		  "bad table offset",
+		  "bad string offset"
+		};
+
+
+ /*
+  * Offsets of header fields in the cache file - see _ppd_cfile_t in
+  * ppd-cache.c...
+  */
+
+#define CACHE_VERSION		16	/* version */
+#define CACHE_LENGTH		24	/* length */
+#define CACHE_STRINGS		28	/* strings.offset, strings.count */
+#define CACHE_SIZES		44	/* sizes.offset, sizes.count */
+
+  printf("_ppdCacheCreateWithPPD(%s): ", name);
+  if ((pc = _ppdCacheCreateWithPPD(ppd)) == NULL)
+  {
+    printf("FAIL (%s)\n", cupsLastErrorString());
+    return (1);
+  }
+  else
+    puts("PASS");
+
+ /*
+  * Write the cache file...
+  */
+
+  attrs = ippNew();
+  ippAddString(attrs, IPP_TAG_PRINTER, IPP_TAG_TEXT, "printer-make-and-model",
+               NULL, ppd->nickname);
+  ippAddStrings(attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "sides-supported",
+                (int)(sizeof(sides) / sizeof(sides[0])), NULL, sides);
+  ippAddRange(attrs, IPP_TAG_PRINTER, "copies-supported", 1, pc->max_copies);
+
+  printf("_ppdCacheWriteFile(%s): ", name);
+  if (_ppdCacheWriteFile(pc, "test.cache", attrs))
+    puts("PASS");
+  else
+  {
+    printf("FAIL (%s)\n", cupsLastErrorString());
+    status ++;
+  }
+
+ /*
+  * Read it back using mmap() and read()...
+  */
+
+  for (mapfile = 1; mapfile >= 0; mapfile --)
+  {
+    printf("_ppdCacheCreateWithFile2(%s, %s): ", name,
+           mapfile ? "mmap" : "read");
+
+    if ((pc2 = _ppdCacheCreateWithFile2("test.cache", &attrs2,
+                                        mapfile)) == NULL)
+    {
+      printf("FAIL (%s)\n", cupsLastErrorString());
+      status ++;
+      continue;
+    }
+
+#ifndef WIN32
+    if (pc2->mapped != mapfile)
+      diff = mapfile ? "not mapped" : "mapped";
+    else
+#endif /* !WIN32 */
+    if ((diff = compare_ppd_cache(pc, pc2)) == NULL)
+      diff = compare_attrs(attrs, attrs2);
+
+    if (diff)
+    {
+      printf("FAIL (%s differ)\n", diff);
+      status ++;
+    }
+    else
+      puts("PASS");
+
+    _ppdCacheDestroy(pc2);
+    ippDelete(attrs2);
+  }
+
+  _ppdCacheDestroy(pc);
+  ippDelete(attrs);
+
+ /*
+  * Make sure that truncated and corrupted copies are rejected...
+  */
+
+  data = NULL;
+
+  if (stat("test.cache", &fileinfo) ||
+      (length = (size_t)fileinfo.st_size) < CACHE_SIZES + 8 ||
+      (data = malloc(length)) == NULL ||
+      (bad = malloc(length)) == NULL ||
+      (fp = cupsFileOpen("test.cache", "r")) == NULL)
+  {
+    printf("_ppdCacheCreateWithFile2(%s, corrupted): FAIL (%s)\n", name,
+           strerror(errno));
+    free(data);
+    unlink("test.cache");
+    return (status + 1);
+  }
+
+  cupsFileRead(fp, (char *)data, length);
+  cupsFileClose(fp);
+
+  for (i = 0;
+       i < (int)(sizeof(corruptions) / sizeof(corruptions[0]));
+       i ++)
+  {
+    memcpy(bad, data, length);
+    badlength = length;
+
+    switch (i)
+    {
+      case 0 : /* empty file */
+          badlength = 0;
+	  break;
+
+      case 1 : /* truncated header */
+          badlength = CACHE_SIZES;
+	  break;
+
+      case 2 : /* truncated file */
+          badlength = length - 1;
+	  break;
+
+      case 3 : /* bad magic */
+          bad[0] ^= 1;
+	  break;
+
+      case 4 : /* bad version */
+          memcpy(&count, data + CACHE_VERSION, sizeof(count));
+          put_cache_word(bad, CACHE_VERSION, count + 1);
+	  break;
+
+      case 5 : /* bad length */
+          put_cache_word(bad, CACHE_LENGTH, (unsigned)length + 4);
+	  break;
+
+      case 6 : /* unterminated strings */
+          memcpy(&offset, data + CACHE_STRINGS, sizeof(offset));
+          memcpy(&count, data + CACHE_STRINGS + 4, sizeof(count));
+	  if (offset + count <= length && count > 0)
+	    bad[offset + count - 1] = 'X';
+	  break;
+
+      case 7 : /* bad table offset */
+          put_cache_word(bad, CACHE_SIZES, (unsigned)length);
+	  break;
+
+      case 8 : /* bad string offset */
+          memcpy(&offset, data + CACHE_SIZES, sizeof(offset));
+          memcpy(&count, data + CACHE_STRINGS + 4, sizeof(count));
+	  if (offset + 4 <= length)
+	    put_cache_word(bad, offset, count);
+	  break;
+    }
+
+    if ((fp = cupsFileOpen("test-bad.cache", "w")) != NULL)
+    {
+      cupsFileWrite(fp, (char *)bad, badlength);
+      cupsFileClose(fp);
+    }
+
+    printf("_ppdCacheCreateWithFile2(%s, %s): ", name, corruptions[i]);
+
+    for (mapfile = 1; mapfile >= 0; mapfile --)
+    {
+      if ((pc2 = _ppdCacheCreateWithFile2("test-bad.cache", &attrs2,
+                                          mapfile)) != NULL)
+      {
+	_ppdCacheDestroy(pc2);
+	ippDelete(attrs2);
+	break;
+      }
+      else if (attrs2)
+      {
+	ippDelete(attrs2);
+	break;
+      }
+    }
+
+    if (mapfile >= 0)
+    {
+      printf("FAIL (loaded using %s)\n", mapfile ? "mmap" : "read");
+      status ++;
+    }
+    else
+      puts("PASS");
+  }
+
+  free(data);
+  free(bad);
+
+  unlink("test.cache");
+  unlink("test-bad.cache");
+
+#undef CACHE_VERSION
+#undef CACHE_LENGTH
+#undef CACHE_STRINGS
+#undef CACHE_SIZES
+
+  return (status);
+}
+
+
 /*
  * End of "$Id$".
  */
@@ -67,18 +67,43 @@ typedef struct sockpeercred cupsd_ucred_t;
  * Local functions...
  */
 
+static void		add_authcache(cups_array_t **cache, const char *user,
+			              const char *value, int result);
+static int		add_ipnode(cupsd_iptree_t *tree);
+static int		add_locnode(int parent, int ch);
 #ifdef HAVE_AUTHORIZATION_H
 static int		check_authref(cupsd_client_t *con, const char *right);
 #endif /* HAVE_AUTHORIZATION_H */
+static int		check_group(const char *username, struct passwd *user,
+			            const char *groupname);
+static int		compare_authcache(cupsd_authcache_t *a,
+			                  cupsd_authcache_t *b);
 static int		compare_locations(cupsd_location_t *a,
 			                  cupsd_location_t *b);
+static cupsd_authtree_t	*compile_masks(cups_array_t *masks);
 static cupsd_authmask_t	*copy_authmask(cupsd_authmask_t *am, void *data);
 #if !HAVE_LIBPAM
 static char		*cups_crypt(const char *pw, const char *salt);
 #endif /* !HAVE_LIBPAM */
+static int		find_authcache(cups_array_t *cache, const char *user,
+			               const char *value, int *hits,
+				       int *misses);
 static void		free_authmask(cupsd_authmask_t *am, void *data);
+static void		free_authtree(cupsd_authtree_t *tree);
+static void		free_location_trie(void);
 static char		*get_md5_password(const char *username,
 			                  const char *group, char passwd[33]);
+static void		hash_authcache(const char *user, const char *value,
+			               unsigned char key[16]);
+static int		ip_prefix(const unsigned netmask[4], int first);
+static int		iptree_add(cupsd_iptree_t *tree,
+			           const unsigned *address, int bits);
+static int		iptree_match(cupsd_iptree_t *tree,
+			             const unsigned *address, int bits);
+static int		location_trie(void);
+static int		match_masks(unsigned ip[4], const char *name,
+			            int namelen, cups_array_t *masks,
+				    cupsd_authtree_t **tree);
 #if HAVE_LIBPAM
 static int		pam_func(int, const struct pam_message **,
 			         struct pam_response **, void *);
@@ -99,6 +124,34 @@ typedef struct cupsd_authdata_s		/**** Authentication data ****/
 } cupsd_authdata_t;
 #endif /* HAVE_LIBPAM */
 
+typedef struct cupsd_locnode_s		/**** Location trie node ****/
+{
+  int			ch,		/* Character (lowercase) */
+			child,		/* First child node or 0 */
+			next,		/* Next sibling node or 0 */
+			num_locs;	/* Number of locations ending here */
+  cupsd_location_t	**locs;		/* Locations ending here */
+} cupsd_locnode_t;
+
+
+/*
+ * Local globals...
+ */
+
+static cups_array_t	*auth_cache = NULL;
+					/* Cached Basic authentication results */
+static unsigned char	auth_salt[16];	/* Salt for cache keys */
+static int		auth_salted = 0;
+					/* Has the salt been chosen? */
+static cups_array_t	*group_cache = NULL;
+					/* Cached group membership results */
+static cupsd_locnode_t	*loc_nodes = NULL;
+					/* Location trie, root first */
+static int		num_loc_nodes = 0,
+					/* Number of trie nodes */
+			alloc_loc_nodes = 0;
+					/* Allocated trie nodes */
+
 
 /*
  * 'cupsdAddIPMask()' - Add an IP address authorization mask.
@@ -157,6 +210,7 @@ cupsdAddLocation(cupsd_location_t *loc)	/* I - Location to add */
   if (Locations)
   {
     cupsArrayAdd(Locations, loc);
+    free_location_trie();
 
     cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdAddLocation: Added location \"%s\"",
                     loc->location ? loc->location : "(null)");
@@ -588,7 +642,8 @@ cupsdAuthorize(cupsd_client_t *con)	/* I - Client connection */
     * Get the Basic authentication data...
     */
 
-    int	userlen;			/* Username:password length */
+    int	userlen,			/* Username:password length */
+	cached;				/* Cached result or -1 */
 
 
     authorization += 5;
@@ -643,6 +698,16 @@ cupsdAuthorize(cupsd_client_t *con)	/* I - Client connection */
     {
       default :
       case CUPSD_AUTH_BASIC :
+          if ((cached = find_authcache(auth_cache, username, password,
+	                               &AuthCacheHits,
+				       &AuthCacheMisses)) == 0)
+	  {
+	    cupsdLogMessage(CUPSD_LOG_ERROR,
+	                    "[Client %d] Authentication failed for user \"%s\" "
+			    "(cached).", con->number, username);
+	    return;
+	  }
+	  else if (cached < 0)
           {
 #if HAVE_LIBPAM
 	   /*
@@ -704,6 +769,7 @@ cupsdAuthorize(cupsd_client_t *con)	/* I - Client connection */
 	                      "[Client %d] pam_authenticate() returned %d (%s)",
         	              con->number, pamerr, pam_strerror(pamh, pamerr));
 	      pam_end(pamh, 0);
+	      add_authcache(&auth_cache, username, password, 0);
 	      return;
 	    }
 
@@ -723,6 +789,7 @@ cupsdAuthorize(cupsd_client_t *con)	/* I - Client connection */
 	                      "[Client %d] pam_acct_mgmt() returned %d (%s)",
         	              con->number, pamerr, pam_strerror(pamh, pamerr));
 	      pam_end(pamh, 0);
+	      add_authcache(&auth_cache, username, password, 0);
 	      return;
 	    }
 
@@ -752,6 +819,7 @@ cupsdAuthorize(cupsd_client_t *con)	/* I - Client connection */
 	      cupsdLogMessage(CUPSD_LOG_ERROR,
 	                      "[Client %d] Unknown username \"%s\".",
         	              con->number, username);
+	      add_authcache(&auth_cache, username, password, 0);
 	      return;
 	    }
 
@@ -813,6 +881,7 @@ cupsdAuthorize(cupsd_client_t *con)	/* I - Client connection */
 	          cupsdLogMessage(CUPSD_LOG_ERROR,
 		                  "[Client %d] Authentication failed for user "
 		                  "\"%s\".", con->number, username);
+		  add_authcache(&auth_cache, username, password, 0);
 		  return;
         	}
 	      }
@@ -822,10 +891,13 @@ cupsdAuthorize(cupsd_client_t *con)	/* I - Client connection */
 		cupsdLogMessage(CUPSD_LOG_ERROR,
 		        	"[Client %d] Authentication failed for user "
 		        	"\"%s\".", con->number, username);
+		add_authcache(&auth_cache, username, password, 0);
 		return;
               }
 	    }
 #endif /* HAVE_LIBPAM */
+
+            add_authcache(&auth_cache, username, password, 1);
           }
 
 	  cupsdLogMessage(CUPSD_LOG_DEBUG,
@@ -1164,20 +1236,20 @@ cupsdCheckAccess(
       case CUPSD_AUTH_ALLOW : /* Order Deny,Allow */
           allow = 1;
 
-          if (cupsdCheckAuth(ip, name, namelen, loc->deny))
+          if (match_masks(ip, name, namelen, loc->deny, &loc->deny_tree))
 	    allow = 0;
 
-          if (cupsdCheckAuth(ip, name, namelen, loc->allow))
+          if (match_masks(ip, name, namelen, loc->allow, &loc->allow_tree))
 	    allow = 1;
 	  break;
 
       case CUPSD_AUTH_DENY : /* Order Allow,Deny */
           allow = 0;
 
-          if (cupsdCheckAuth(ip, name, namelen, loc->allow))
+          if (match_masks(ip, name, namelen, loc->allow, &loc->allow_tree))
 	    allow = 1;
 
-          if (cupsdCheckAuth(ip, name, namelen, loc->deny))
+          if (match_masks(ip, name, namelen, loc->deny, &loc->deny_tree))
 	    allow = 0;
 	  break;
     }
@@ -1378,14 +1450,7 @@ cupsdCheckGroup(
     struct passwd *user,		/* I - System user info */
     const char    *groupname)		/* I - Group name */
 {
-  int		i;			/* Looping var */
-  struct group	*group;			/* System group info */
-  char		junk[33];		/* MD5 password (not used) */
-#ifdef HAVE_MBR_UID_TO_UUID
-  uuid_t	useruuid,		/* UUID for username */
-		groupuuid;		/* UUID for groupname */
-  int		is_member;		/* True if user is a member of group */
-#endif /* HAVE_MBR_UID_TO_UUID */
+  int		result;			/* Result of check */
 
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2,
@@ -1400,86 +1465,19 @@ cupsdCheckGroup(
     return (0);
 
  /*
-  * Check to see if the user is a member of the named group...
+  * Use a cached result if we have one - the user info always comes from
+  * the password entry for username, so it isn't part of the key...
   */
 
-  group = getgrnam(groupname);
-  endgrent();
-
-  if (group != NULL)
+  if ((result = find_authcache(group_cache, username, groupname,
+                               &GroupCacheHits, &GroupCacheMisses)) < 0)
   {
-   /*
-    * Group exists, check it...
-    */
+    result = check_group(username, user, groupname);
 
-    for (i = 0; group->gr_mem[i]; i ++)
-      if (!_cups_strcasecmp(username, group->gr_mem[i]))
-	return (1);
+    add_authcache(&group_cache, username, groupname, result);
   }
 
- /*
-  * Group doesn't exist or user not in group list, check the group ID
-  * against the user's group ID...
-  */
-
-  if (user && group && group->gr_gid == user->pw_gid)
-    return (1);
-
-#ifdef HAVE_MBR_UID_TO_UUID
- /*
-  * Check group membership through MacOS X membership API...
-  */
-
-  if (user && !mbr_uid_to_uuid(user->pw_uid, useruuid))
-  {
-    if (group)
-    {
-     /*
-      * Map group name to UUID and check membership...
-      */
-
-      if (!mbr_gid_to_uuid(group->gr_gid, groupuuid))
-        if (!mbr_check_membership(useruuid, groupuuid, &is_member))
-	  if (is_member)
-	    return (1);
-    }
-    else if (groupname[0] == '#')
-    {
-     /*
-      * Use UUID directly and check for equality (user UUID) and
-      * membership (group UUID)...
-      */
-
-      if (!uuid_parse((char *)groupname + 1, groupuuid))
-      {
-        if (!uuid_compare(useruuid, groupuuid))
-	  return (1);
-	else if (!mbr_check_membership(useruuid, groupuuid, &is_member))
-	  if (is_member)
-	    return (1);
-      }
-
-      return (0);
-    }
-  }
-  else if (groupname[0] == '#')
-    return (0);
-#endif /* HAVE_MBR_UID_TO_UUID */
-
- /*
-  * Username not found, group not found, or user is not part of the
-  * system group...  Check for a user and group in the MD5 password
-  * file...
-  */
-
-  if (get_md5_password(username, groupname, junk) != NULL)
-    return (1);
-
- /*
-  * If we get this far, then the user isn't part of the named group...
-  */
-
-  return (0);
+  return (result);
 }
 
 
@@ -1580,6 +1578,8 @@ cupsdDeleteAllLocations(void)
 
   cupsArrayDelete(Locations);
   Locations = NULL;
+
+  free_location_trie();
 }
 
 
@@ -1598,6 +1598,10 @@ cupsdFindBest(const char   *path,	/* I - Resource path */
 			*best;		/* Best match for location so far */
   int			bestlen;	/* Length of best match */
   int			limit;		/* Limit field */
+  int			nocase,		/* Case-insensitive match? */
+			ch,		/* Current URI character */
+			i;		/* Looping var */
+  cupsd_locnode_t	*node;		/* Current trie node */
   static const int	limits[] =	/* Map http_status_t to CUPSD_AUTH_LIMIT_xyz */
 		{
 		  CUPSD_AUTH_LIMIT_ALL,
@@ -1647,42 +1651,79 @@ cupsdFindBest(const char   *path,	/* I - Resource path */
   limit   = limits[state];
   best    = NULL;
   bestlen = 0;
+  nocase  = !strncmp(uri, "/printers/", 10) || !strncmp(uri, "/classes/", 9);
 
-  for (loc = (cupsd_location_t *)cupsArrayFirst(Locations);
-       loc;
-       loc = (cupsd_location_t *)cupsArrayNext(Locations))
+  if (location_trie())
   {
-    cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdFindBest: Location %s Limit %x",
-                    loc->location ? loc->location : "nil", loc->limit);
+   /*
+    * Walk the location trie along the URI - each node holds the locations
+    * whose path ends there, in array order, so the deepest node with a
+    * location for this request is the best match...
+    */
 
-    if (!strncmp(uri, "/printers/", 10) || !strncmp(uri, "/classes/", 9))
+    for (uriptr = uri, node = loc_nodes; *uriptr; uriptr ++)
     {
-     /*
-      * Use case-insensitive comparison for queue names...
-      */
+      ch = _cups_tolower(*uriptr);
+
+      for (i = node->child; i && loc_nodes[i].ch != ch; i = loc_nodes[i].next);
+
+      if (!i)
+        break;
+
+      node = loc_nodes + i;
 
-      if (loc->length > bestlen && loc->location &&
-          !_cups_strncasecmp(uri, loc->location, loc->length) &&
-	  loc->location[0] == '/' &&
-	  (limit & loc->limit) != 0)
+      for (i = 0; i < node->num_locs; i ++)
       {
-	best    = loc;
-	bestlen = loc->length;
+        loc = node->locs[i];
+
+        if ((limit & loc->limit) != 0 &&
+            (nocase || !strncmp(uri, loc->location, loc->length)))
+	{
+	  best = loc;
+	  break;
+	}
       }
     }
-    else
+  }
+  else
+  {
+   /*
+    * Fall back to a linear search of the locations...
+    */
+
+    for (loc = (cupsd_location_t *)cupsArrayFirst(Locations);
+         loc;
+         loc = (cupsd_location_t *)cupsArrayNext(Locations))
     {
-     /*
-      * Use case-sensitive comparison for other URIs...
-      */
+      if (nocase)
+      {
+       /*
+	* Use case-insensitive comparison for queue names...
+	*/
 
-      if (loc->length > bestlen && loc->location &&
-          !strncmp(uri, loc->location, loc->length) &&
-	  loc->location[0] == '/' &&
-	  (limit & loc->limit) != 0)
+	if (loc->length > bestlen && loc->location &&
+	    !_cups_strncasecmp(uri, loc->location, loc->length) &&
+	    loc->location[0] == '/' &&
+	    (limit & loc->limit) != 0)
+	{
+	  best    = loc;
+	  bestlen = loc->length;
+	}
+      }
+      else
       {
-	best    = loc;
-	bestlen = loc->length;
+       /*
+	* Use case-sensitive comparison for other URIs...
+	*/
+
+	if (loc->length > bestlen && loc->location &&
+	    !strncmp(uri, loc->location, loc->length) &&
+	    loc->location[0] == '/' &&
+	    (limit & loc->limit) != 0)
+	{
+	  best    = loc;
+	  bestlen = loc->length;
+	}
       }
     }
   }
@@ -1714,6 +1755,22 @@ cupsdFindLocation(const char *location)	/* I - Connection */
 }
 
 
+/*
+ * 'cupsdFlushAuthCache()' - Forget all cached authentication and group
+ *                           membership results.
+ */
+
+void
+cupsdFlushAuthCache(void)
+{
+  cupsArrayDelete(auth_cache);
+  auth_cache = NULL;
+
+  cupsArrayDelete(group_cache);
+  group_cache = NULL;
+}
+
+
 /*
  * 'cupsdFreeLocation()' - Free all memory used by a location.
  */
@@ -1725,6 +1782,9 @@ cupsdFreeLocation(cupsd_location_t *loc)/* I - Location to free */
   cupsArrayDelete(loc->allow);
   cupsArrayDelete(loc->deny);
 
+  free_authtree(loc->allow_tree);
+  free_authtree(loc->deny_tree);
+
   _cupsStrFree(loc->location);
   free(loc);
 }
@@ -2116,6 +2176,132 @@ cupsdNewLocation(const char *location)	/* I - Location path */
 }
 
 
+/*
+ * 'add_authcache()' - Cache an authentication or group membership result.
+ */
+
+static void
+add_authcache(cups_array_t **cache,	/* IO - Cache array */
+              const char   *user,	/* I  - Username */
+	      const char   *value,	/* I  - Password or group name */
+	      int          result)	/* I  - Result to cache */
+{
+  cupsd_authcache_t	key,		/* Search key */
+			*entry,		/* Cache entry */
+			*current;	/* Current entry */
+  time_t		curtime;	/* Current time */
+
+
+  if (AuthCacheDuration <= 0)
+    return;
+
+  if (!*cache)
+    *cache = cupsArrayNew3((cups_array_func_t)compare_authcache, NULL,
+                           (cups_ahash_func_t)NULL, 0,
+			   (cups_acopy_func_t)NULL,
+			   (cups_afree_func_t)free);
+
+  if (!*cache)
+    return;
+
+  hash_authcache(user, value, key.key);
+  curtime = time(NULL);
+
+  if ((entry = (cupsd_authcache_t *)cupsArrayFind(*cache, &key)) == NULL)
+  {
+    if (cupsArrayCount(*cache) >= CUPSD_AUTH_CACHE_MAX)
+    {
+     /*
+      * Make room by removing expired entries, or else the entry that
+      * expires first...
+      */
+
+      for (current = (cupsd_authcache_t *)cupsArrayFirst(*cache);
+           current;
+	   current = (cupsd_authcache_t *)cupsArrayNext(*cache))
+	if (current->expires <= curtime)
+	  cupsArrayRemove(*cache, current);
+	else if (!entry || current->expires < entry->expires)
+	  entry = current;
+
+      if (cupsArrayCount(*cache) >= CUPSD_AUTH_CACHE_MAX && entry)
+        cupsArrayRemove(*cache, entry);
+    }
+
+    if ((entry = calloc(1, sizeof(cupsd_authcache_t))) == NULL)
+      return;
+
+    memcpy(entry->key, key.key, sizeof(entry->key));
+    cupsArrayAdd(*cache, entry);
+  }
+
+  entry->result  = result;
+  entry->expires = curtime + AuthCacheDuration;
+}
+
+
+/*
+ * 'add_ipnode()' - Add a node to an address tree.
+ */
+
+static int				/* O - Node index or -1 on error */
+add_ipnode(cupsd_iptree_t *tree)	/* I - Address tree */
+{
+  cupsd_ipnode_t	*temp;		/* New node array */
+
+
+  if (tree->num_nodes >= tree->alloc_nodes)
+  {
+    if ((temp = realloc(tree->nodes, (size_t)(tree->alloc_nodes + 64) *
+                                     sizeof(cupsd_ipnode_t))) == NULL)
+      return (-1);
+
+    tree->nodes       = temp;
+    tree->alloc_nodes += 64;
+  }
+
+  temp = tree->nodes + tree->num_nodes;
+  memset(temp, 0, sizeof(cupsd_ipnode_t));
+
+  return (tree->num_nodes ++);
+}
+
+
+/*
+ * 'add_locnode()' - Add a node to the location trie.
+ */
+
+static int				/* O - Node index or -1 on error */
+add_locnode(int parent,			/* I - Parent node or -1 for root */
+            int ch)			/* I - Character (lowercase) */
+{
+  cupsd_locnode_t	*temp;		/* New node array */
+
+
+  if (num_loc_nodes >= alloc_loc_nodes)
+  {
+    if ((temp = realloc(loc_nodes, (size_t)(alloc_loc_nodes + 256) *
+                                   sizeof(cupsd_locnode_t))) == NULL)
+      return (-1);
+
+    loc_nodes       = temp;
+    alloc_loc_nodes += 256;
+  }
+
+  temp = loc_nodes + num_loc_nodes;
+  memset(temp, 0, sizeof(cupsd_locnode_t));
+  temp->ch = ch;
+
+  if (parent >= 0)
+  {
+    temp->next              = loc_nodes[parent].child;
+    loc_nodes[parent].child = num_loc_nodes;
+  }
+
+  return (num_loc_nodes ++);
+}
+
+
 #ifdef HAVE_AUTHORIZATION_H
 /*
  * 'check_authref()' - Check if an authorization services reference has the
@@ -2169,6 +2355,123 @@ check_authref(cupsd_client_t *con,	/* I - Connection */
 #endif /* HAVE_AUTHORIZATION_H */
 
 
+/*
+ * 'check_group()' - Check for a user's group membership in the system and
+ *                   MD5 password files.
+ */
+
+static int				/* O - 1 if user is a member, 0 otherwise */
+check_group(
+    const char    *username,		/* I - User name */
+    struct passwd *user,		/* I - System user info */
+    const char    *groupname)		/* I - Group name */
+{
+  int		i;			/* Looping var */
+  struct group	*group;			/* System group info */
+  char		junk[33];		/* MD5 password (not used) */
+#ifdef HAVE_MBR_UID_TO_UUID
+  uuid_t	useruuid,		/* UUID for username */
+		groupuuid;		/* UUID for groupname */
+  int		is_member;		/* True if user is a member of group */
+#endif /* HAVE_MBR_UID_TO_UUID */
+
+
+ /*
+  * Check to see if the user is a member of the named group...
+  */
+
+  group = getgrnam(groupname);
+  endgrent();
+
+  if (group != NULL)
+  {
+   /*
+    * Group exists, check it...
+    */
+
+    for (i = 0; group->gr_mem[i]; i ++)
+      if (!_cups_strcasecmp(username, group->gr_mem[i]))
+	return (1);
+  }
+
+ /*
+  * Group doesn't exist or user not in group list, check the group ID
+  * against the user's group ID...
+  */
+
+  if (user && group && group->gr_gid == user->pw_gid)
+    return (1);
+
+#ifdef HAVE_MBR_UID_TO_UUID
+ /*
+  * Check group membership through MacOS X membership API...
+  */
+
+  if (user && !mbr_uid_to_uuid(user->pw_uid, useruuid))
+  {
+    if (group)
+    {
+     /*
+      * Map group name to UUID and check membership...
+      */
+
+      if (!mbr_gid_to_uuid(group->gr_gid, groupuuid))
+        if (!mbr_check_membership(useruuid, groupuuid, &is_member))
+	  if (is_member)
+	    return (1);
+    }
+    else if (groupname[0] == '#')
+    {
+     /*
+      * Use UUID directly and check for equality (user UUID) and
+      * membership (group UUID)...
+      */
+
+      if (!uuid_parse((char *)groupname + 1, groupuuid))
+      {
+        if (!uuid_compare(useruuid, groupuuid))
+	  return (1);
+	else if (!mbr_check_membership(useruuid, groupuuid, &is_member))
+	  if (is_member)
+	    return (1);
+      }
+
+      return (0);
+    }
+  }
+  else if (groupname[0] == '#')
+    return (0);
+#endif /* HAVE_MBR_UID_TO_UUID */
+
+ /*
+  * Username not found, group not found, or user is not part of the
+  * system group...  Check for a user and group in the MD5 password
+  * file...
+  */
+
+  if (get_md5_password(username, groupname, junk) != NULL)
+    return (1);
+
+ /*
+  * If we get this far, then the user isn't part of the named group...
+  */
+
+  return (0);
+}
+
+
+/*
+ * 'compare_authcache()' - Compare two cached results.
+ */
+
+static int				/* O - Result of comparison */
+compare_authcache(cupsd_authcache_t *a,	/* I - First result */
+                  cupsd_authcache_t *b)	/* I - Second result */
+{
+  return (memcmp(a->key, b->key, sizeof(a->key)));
+}
+
+
 /*
  * 'compare_locations()' - Compare two locations.
  */
@@ -2181,6 +2484,69 @@ compare_locations(cupsd_location_t *a,	/* I - First location */
 }
 
 
+/*
+ * 'compile_masks()' - Compile auth masks into address trees.
+ *
+ * IP masks with a contiguous netmask go into a 128-bit tree; IPv4 masks
+ * from a dotted netmask only look at the last 32 bits of the address and
+ * go into a 32-bit tree.  Everything else is checked with cupsdCheckAuth().
+ */
+
+static cupsd_authtree_t	*		/* O - Compiled masks or NULL on error */
+compile_masks(cups_array_t *masks)	/* I - Auth masks */
+{
+  cupsd_authtree_t	*tree;		/* Compiled masks */
+  cupsd_authmask_t	*mask;		/* Current mask */
+  const unsigned	*address,	/* Mask address */
+			*netmask;	/* Mask netmask */
+  int			bits;		/* Prefix length */
+
+
+  if ((tree = calloc(1, sizeof(cupsd_authtree_t))) == NULL)
+    return (NULL);
+
+  tree->count = cupsArrayCount(masks);
+
+  for (mask = (cupsd_authmask_t *)cupsArrayFirst(masks);
+       mask;
+       mask = (cupsd_authmask_t *)cupsArrayNext(masks))
+  {
+    if (mask->type == CUPSD_AUTH_IP)
+    {
+      address = mask->mask.ip.address;
+      netmask = mask->mask.ip.netmask;
+
+      if (!(address[0] & ~netmask[0]) && !(address[1] & ~netmask[1]) &&
+          !(address[2] & ~netmask[2]) && !(address[3] & ~netmask[3]))
+      {
+        if ((bits = ip_prefix(netmask, 0)) >= 0)
+	{
+	  if (iptree_add(&(tree->addr128), address, bits))
+	    continue;
+	}
+	else if (!netmask[0] && !netmask[1] && !netmask[2] &&
+	         (bits = ip_prefix(netmask, 3)) >= 0)
+	{
+	  if (iptree_add(&(tree->addr32), address + 3, bits))
+	    continue;
+	}
+      }
+    }
+
+    if (!tree->others)
+      tree->others = cupsArrayNew(NULL, NULL);
+
+    if (!tree->others || !cupsArrayAdd(tree->others, mask))
+    {
+      free_authtree(tree);
+      return (NULL);
+    }
+  }
+
+  return (tree);
+}
+
+
 /*
  * 'copy_authmask()' - Copy function for auth masks.
  */
@@ -2343,6 +2709,46 @@ cups_crypt(const char *pw,		/* I - Password string */
 #endif /* !HAVE_LIBPAM */
 
 
+/*
+ * 'find_authcache()' - Find a cached authentication or group membership
+ *                      result.
+ */
+
+static int				/* O - Cached result or -1 if none */
+find_authcache(cups_array_t *cache,	/* I  - Cache array */
+               const char   *user,	/* I  - Username */
+	       const char   *value,	/* I  - Password or group name */
+	       int          *hits,	/* IO - Cache hit counter */
+	       int          *misses)	/* IO - Cache miss counter */
+{
+  cupsd_authcache_t	key,		/* Search key */
+			*entry;		/* Cache entry */
+
+
+  if (AuthCacheDuration <= 0)
+    return (-1);
+
+  hash_authcache(user, value, key.key);
+
+  if ((entry = (cupsd_authcache_t *)cupsArrayFind(cache, &key)) != NULL &&
+      entry->expires <= time(NULL))
+  {
+    cupsArrayRemove(cache, entry);
+    entry = NULL;
+  }
+
+  if (!entry)
+  {
+    (*misses) ++;
+    return (-1);
+  }
+
+  (*hits) ++;
+
+  return (entry->result);
+}
+
+
 /*
  * 'free_authmask()' - Free function for auth masks.
  */
@@ -2360,6 +2766,44 @@ free_authmask(cupsd_authmask_t *mask,	/* I - Auth mask to free */
 }
 
 
+/*
+ * 'free_authtree()' - Free compiled auth masks.
+ */
+
+static void
+free_authtree(cupsd_authtree_t *tree)	/* I - Compiled masks */
+{
+  if (!tree)
+    return;
+
+  free(tree->addr32.nodes);
+  free(tree->addr128.nodes);
+  cupsArrayDelete(tree->others);
+  free(tree);
+}
+
+
+/*
+ * 'free_location_trie()' - Free the location trie.
+ */
+
+static void
+free_location_trie(void)
+{
+  int	i;				/* Looping var */
+
+
+  for (i = 0; i < num_loc_nodes; i ++)
+    free(loc_nodes[i].locs);
+
+  free(loc_nodes);
+
+  loc_nodes       = NULL;
+  num_loc_nodes   = 0;
+  alloc_loc_nodes = 0;
+}
+
+
 /*
  * 'get_md5_password()' - Get an MD5 password.
  */
@@ -2422,6 +2866,243 @@ get_md5_password(const char *username,	/* I - Username */
 }
 
 
+/*
+ * 'hash_authcache()' - Compute the key for a cached result.
+ *
+ * The key is a salted MD5 sum so that passwords are not kept in memory.
+ */
+
+static void
+hash_authcache(const char    *user,	/* I - Username */
+               const char    *value,	/* I - Password or group name */
+	       unsigned char key[16])	/* O - Key */
+{
+  int			i;		/* Looping var */
+  _cups_md5_state_t	md5;		/* MD5 state */
+
+
+  if (!auth_salted)
+  {
+    for (i = 0; i < (int)sizeof(auth_salt); i ++)
+      auth_salt[i] = (unsigned char)CUPS_RAND();
+
+    auth_salted = 1;
+  }
+
+  _cupsMD5Init(&md5);
+  _cupsMD5Append(&md5, auth_salt, (int)sizeof(auth_salt));
+  _cupsMD5Append(&md5, (const unsigned char *)user, (int)strlen(user) + 1);
+  _cupsMD5Append(&md5, (const unsigned char *)value, (int)strlen(value));
+  _cupsMD5Finish(&md5, key);
+}
+
+
+/*
+ * 'ip_prefix()' - Get the prefix length of a netmask.
+ */
+
+static int				/* O - Prefix length or -1 if not contiguous */
+ip_prefix(const unsigned netmask[4],	/* I - Netmask */
+          int            first)		/* I - First word to look at */
+{
+  int		i,			/* Looping var */
+		bits;			/* Prefix length */
+  unsigned	m;			/* Current word */
+
+
+  for (i = first, bits = 0; i < 4; i ++)
+  {
+    if (netmask[i] == 0xffffffff)
+    {
+      bits += 32;
+      continue;
+    }
+
+    for (m = netmask[i]; m & 0x80000000; m = (m << 1) & 0xffffffff)
+      bits ++;
+
+    if (m)
+      return (-1);
+
+    for (i ++; i < 4; i ++)
+      if (netmask[i])
+        return (-1);
+  }
+
+  return (bits);
+}
+
+
+/*
+ * 'iptree_add()' - Add a network to an address tree.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+iptree_add(cupsd_iptree_t *tree,	/* I - Address tree */
+           const unsigned *address,	/* I - Network address */
+	   int            bits)		/* I - Prefix length */
+{
+  int	node,				/* Current node */
+	child,				/* Child node */
+	bit,				/* Current bit */
+	b;				/* Value of current bit */
+
+
+  if (!tree->num_nodes && add_ipnode(tree) < 0)
+    return (0);
+
+  for (node = 0, bit = 0; bit < bits; bit ++)
+  {
+    b = (address[bit / 32] >> (31 - bit % 32)) & 1;
+
+    if (!tree->nodes[node].child[b])
+    {
+      if ((child = add_ipnode(tree)) < 0)
+        return (0);
+
+      tree->nodes[node].child[b] = child;
+    }
+
+    node = tree->nodes[node].child[b];
+  }
+
+  tree->nodes[node].match = 1;
+
+  return (1);
+}
+
+
+/*
+ * 'iptree_match()' - See if an address is in one of the networks of a tree.
+ */
+
+static int				/* O - 1 if matched, 0 otherwise */
+iptree_match(cupsd_iptree_t *tree,	/* I - Address tree */
+             const unsigned *address,	/* I - Client address */
+	     int            bits)	/* I - Number of address bits */
+{
+  int	node,				/* Current node */
+	bit;				/* Current bit */
+
+
+  if (!tree->num_nodes)
+    return (0);
+
+  for (node = 0, bit = 0; !tree->nodes[node].match; bit ++)
+  {
+    if (bit >= bits)
+      return (0);
+
+    if ((node = tree->nodes[node].child[(address[bit / 32] >>
+                                         (31 - bit % 32)) & 1]) == 0)
+      return (0);
+  }
+
+  return (1);
+}
+
+
+/*
+ * 'location_trie()' - Build the location trie as needed.
+ */
+
+static int				/* O - 1 if the trie is usable, 0 otherwise */
+location_trie(void)
+{
+  cupsd_location_t	*loc,		/* Current location */
+			**locs;		/* New location array */
+  cupsd_locnode_t	*node;		/* Current node */
+  int			current,	/* Current node index */
+			ch,		/* Current character */
+			i,		/* Looping var */
+			j;		/* Child node */
+
+
+  if (num_loc_nodes)
+    return (1);
+
+  if (add_locnode(-1, 0) < 0)
+    goto error;
+
+  for (loc = (cupsd_location_t *)cupsArrayFirst(Locations);
+       loc;
+       loc = (cupsd_location_t *)cupsArrayNext(Locations))
+  {
+    if (!loc->location || loc->location[0] != '/' || loc->length <= 0)
+      continue;
+
+    for (i = 0, current = 0; i < loc->length; i ++)
+    {
+      ch = _cups_tolower(loc->location[i]);
+
+      for (j = loc_nodes[current].child; j && loc_nodes[j].ch != ch;
+           j = loc_nodes[j].next);
+
+      if (!j && (j = add_locnode(current, ch)) < 0)
+        goto error;
+
+      current = j;
+    }
+
+    node = loc_nodes + current;
+
+    if ((locs = realloc(node->locs, (size_t)(node->num_locs + 1) *
+                                    sizeof(cupsd_location_t *))) == NULL)
+      goto error;
+
+    node->locs                   = locs;
+    node->locs[node->num_locs ++] = loc;
+  }
+
+  return (1);
+
+ /*
+  * If we get here we ran out of memory, so fall back to a linear search...
+  */
+
+  error:
+
+  cupsdLogMessage(CUPSD_LOG_ERROR,
+                  "Unable to allocate memory for location trie: %s",
+		  strerror(errno));
+
+  free_location_trie();
+
+  return (0);
+}
+
+
+/*
+ * 'match_masks()' - Check a client against auth masks, compiling them as
+ *                   needed.
+ */
+
+static int				/* O - 1 if mask matches, 0 otherwise */
+match_masks(unsigned         ip[4],	/* I - Client address */
+            const char       *name,	/* I - Client hostname */
+            int              namelen,	/* I - Length of hostname */
+            cups_array_t     *masks,	/* I - Masks */
+	    cupsd_authtree_t **tree)	/* IO - Compiled masks */
+{
+  if (!masks)
+    return (0);
+
+  if (!*tree || (*tree)->count != cupsArrayCount(masks))
+  {
+    free_authtree(*tree);
+
+    if ((*tree = compile_masks(masks)) == NULL)
+      return (cupsdCheckAuth(ip, name, namelen, masks));
+  }
+
+  if (iptree_match(&((*tree)->addr128), ip, 128) ||
+      iptree_match(&((*tree)->addr32), ip + 3, 32))
+    return (1);
+
+  return (cupsdCheckAuth(ip, name, namelen, (*tree)->others));
+}
+
+
 #if HAVE_LIBPAM
 /*
  * 'pam_func()' - PAM conversation function.
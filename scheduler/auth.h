@@ -56,6 +56,8 @@
 #define CUPSD_AUTH_LIMIT_ALL	127	/* Limit all requests */
 #define CUPSD_AUTH_LIMIT_IPP	128	/* Limit IPP requests */
 
+#define CUPSD_AUTH_CACHE_MAX	1024	/* Maximum cached results of each kind */
+
 #define IPP_ANY_OPERATION	(ipp_op_t)0
 					/* Any IPP operation */
 #define IPP_BAD_OPERATION	(ipp_op_t)-1
@@ -88,6 +90,27 @@ typedef struct
   }		mask;			/* Mask data */
 } cupsd_authmask_t;
 
+typedef struct
+{
+  int		child[2],		/* Child nodes for 0 and 1 bits */
+		match;			/* 1 if a network ends here */
+} cupsd_ipnode_t;
+
+typedef struct
+{
+  int		num_nodes,		/* Number of nodes */
+		alloc_nodes;		/* Allocated nodes */
+  cupsd_ipnode_t *nodes;		/* Nodes, root first */
+} cupsd_iptree_t;
+
+typedef struct
+{
+  int		count;			/* Number of masks compiled */
+  cupsd_iptree_t addr32,		/* IPv4 networks with dotted netmask */
+		addr128;		/* IPv6 and IPv4 CIDR networks */
+  cups_array_t	*others;		/* Names, interfaces, and other masks */
+} cupsd_authtree_t;
+
 typedef struct
 {
   char			*location;	/* Location of resource */
@@ -101,9 +124,18 @@ typedef struct
   cups_array_t		*names,		/* User or group names */
 			*allow,		/* Allow lines */
 			*deny;		/* Deny lines */
+  cupsd_authtree_t	*allow_tree,	/* Compiled allow lines */
+			*deny_tree;	/* Compiled deny lines */
   http_encryption_t	encryption;	/* To encrypt or not to encrypt... */
 } cupsd_location_t;
 
+typedef struct
+{
+  unsigned char	key[16];		/* Salted MD5 of user and password/group */
+  int		result;			/* 1 if authorized or member, 0 if not */
+  time_t	expires;		/* Time when result expires */
+} cupsd_authcache_t;
+
 typedef struct cupsd_client_s cupsd_client_t;
 
 
@@ -117,6 +149,16 @@ VAR cups_array_t	*Locations	VALUE(NULL);
 VAR http_encryption_t	DefaultEncryption VALUE(HTTP_ENCRYPT_REQUIRED);
 					/* Default encryption for authentication */
 #endif /* HAVE_SSL */
+VAR int			AuthCacheDuration VALUE(0),
+					/* Time to cache Basic and group results */
+			AuthCacheHits	VALUE(0),
+					/* Cached Basic results used */
+			AuthCacheMisses	VALUE(0),
+					/* Basic results not in cache */
+			GroupCacheHits	VALUE(0),
+					/* Cached group results used */
+			GroupCacheMisses VALUE(0);
+					/* Group results not in cache */
 
 
 /*
@@ -141,6 +183,7 @@ extern cupsd_location_t	*cupsdCopyLocation(cupsd_location_t *loc);
 extern void		cupsdDeleteAllLocations(void);
 extern cupsd_location_t	*cupsdFindBest(const char *path, http_state_t state);
 extern cupsd_location_t	*cupsdFindLocation(const char *location);
+extern void		cupsdFlushAuthCache(void);
 extern void		cupsdFreeLocation(cupsd_location_t *loc);
 extern http_status_t	cupsdIsAuthorized(cupsd_client_t *con, const char *owner);
 extern cupsd_location_t	*cupsdNewLocation(const char *location);
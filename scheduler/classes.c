@@ -22,6 +22,7 @@
  *   cupsdFindClass()                - Find the named class.
  *   cupsdLoadAllClasses()           - Load classes from the classes.conf file.
  *   cupsdSaveAllClasses()           - Save classes to the classes.conf file.
+ *   write_class()                   - Write a class to the classes.conf file.
  */
 
 /*
@@ -31,6 +32,20 @@
 #include "cupsd.h"
 
 
+/*
+ * Local globals...
+ */
+
+static int	class_records = -1;	/* Stale records in classes.conf or -1 */
+
+
+/*
+ * Local functions...
+ */
+
+static void	write_class(cups_file_t *fp, cupsd_printer_t *pclass);
+
+
 /*
  * 'cupsdAddClass()' - Add a class to the system.
  */
@@ -284,25 +299,49 @@ cupsdLoadAllClasses(void)
 			*valueptr;	/* Pointer into value */
   cupsd_printer_t	*p,		/* Current printer class */
 			*temp;		/* Temporary pointer to printer */
+  cups_array_t		*records;	/* Current class records */
+  int			skip;		/* Skipping an old record? */
 
 
  /*
   * Open the classes.conf file...
   */
 
+  class_records = -1;
+
   snprintf(line, sizeof(line), "%s/classes.conf", ServerRoot);
   if ((fp = cupsdOpenConfFile(line)) == NULL)
     return;
 
+ /*
+  * Find the current copy of each class, since changed classes are appended
+  * to the file...
+  */
+
+  records = cupsdFindConfRecords(fp, &class_records);
+
  /*
   * Read class configurations until we hit EOF...
   */
 
   linenum = 0;
   p       = NULL;
+  skip    = 0;
 
   while (cupsFileGetConf(fp, line, sizeof(line), &value, &linenum))
   {
+    if (skip)
+    {
+     /*
+      * Skip older (or incomplete) copies of a class...
+      */
+
+      if (!_cups_strcasecmp(line, "</Class>"))
+        skip = 0;
+
+      continue;
+    }
+
    /*
     * Decode the directive...
     */
@@ -314,7 +353,10 @@ cupsdLoadAllClasses(void)
       * <Class name> or <DefaultClass name>
       */
 
-      if (p == NULL && value)
+      if (p == NULL && value &&
+          !cupsdIsCurrentConfRecord(records, value, linenum))
+        skip = 1;
+      else if (p == NULL && value)
       {
         cupsdLogMessage(CUPSD_LOG_DEBUG, "Loading class %s...", value);
 
@@ -609,6 +651,14 @@ cupsdLoadAllClasses(void)
 	cupsdLogMessage(CUPSD_LOG_ERROR,
 	                "Syntax error on line %d of classes.conf.", linenum);
     }
+    else if (!_cups_strcasecmp(line, "SpoolCompression"))
+    {
+      if (value && isdigit(*value & 255))
+        p->spool_compression = atoi(value);
+      else
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of classes.conf.", linenum);
+    }
     else if (!_cups_strcasecmp(line, "OpPolicy"))
     {
       if (value)
@@ -655,7 +705,20 @@ cupsdLoadAllClasses(void)
     }
   }
 
+  cupsArrayDelete(records);
   cupsFileClose(fp);
+
+ /*
+  * Rewrite the file right away if it holds older or incomplete copies of a
+  * class, since other programs that read classes.conf (including older
+  * versions of cupsd) would otherwise see duplicate classes...
+  */
+
+  if (class_records)
+  {
+    class_records = -1;
+    cupsdSaveAllClasses();
+  }
 }
 
 
@@ -668,21 +731,62 @@ cupsdSaveAllClasses(void)
 {
   cups_file_t		*fp;		/* classes.conf file */
   char			filename[1024],	/* classes.conf filename */
-			temp[1024],	/* Temporary string */
-			value[2048],	/* Value string */
-			*name;		/* Current user name */
+			temp[1024];	/* Temporary string */
   cupsd_printer_t	*pclass;	/* Current printer class */
-  int			i;		/* Looping var */
   time_t		curtime;	/* Current time */
   struct tm		*curdate;	/* Current date */
-  cups_option_t		*option;	/* Current option */
+  int			records;	/* Number of records written */
+
 
+  snprintf(filename, sizeof(filename), "%s/classes.conf", ServerRoot);
 
  /*
-  * Create the classes.conf file...
+  * Append the changed classes to the classes.conf file if we can...
   */
 
-  snprintf(filename, sizeof(filename), "%s/classes.conf", ServerRoot);
+  if (!(DirtyFiles & (CUPSD_DIRTY_CLASSES | CUPSD_DIRTY_COMPACT)) &&
+      class_records >= 0 &&
+      class_records <= (cupsArrayCount(Printers) + MAX_CONF_RECORDS))
+  {
+    if ((fp = cupsdAppendConfFile(filename)) != NULL)
+    {
+      for (pclass = (cupsd_printer_t *)cupsArrayFirst(Printers), records = 0;
+	   pclass;
+	   pclass = (cupsd_printer_t *)cupsArrayNext(Printers))
+      {
+	if ((pclass->type & CUPS_PRINTER_REMOTE) ||
+	    !(pclass->type & CUPS_PRINTER_CLASS) || !pclass->dirty)
+	  continue;
+
+	write_class(fp, pclass);
+
+	pclass->dirty = 0;
+	records ++;
+      }
+
+      if (!cupsdCloseAppendedConfFile(fp, filename))
+      {
+	cupsdLogMessage(CUPSD_LOG_DEBUG,
+	                "Appended %d records to classes.conf.", records);
+
+	class_records += records;
+	return;
+      }
+    }
+  }
+  else if (!((DirtyFiles | DirtyRecords) & CUPSD_DIRTY_CLASSES) &&
+           class_records == 0)
+  {
+   /*
+    * Nothing to compact...
+    */
+
+    return;
+  }
+
+ /*
+  * Otherwise create a new classes.conf file...
+  */
 
   if ((fp = cupsdCreateConfFile(filename, ConfigFilePerm)) == NULL)
     return;
@@ -721,95 +825,120 @@ cupsdSaveAllClasses(void)
     * Write printers as needed...
     */
 
-    if (pclass == DefaultPrinter)
-      cupsFilePrintf(fp, "<DefaultClass %s>\n", pclass->name);
-    else
-      cupsFilePrintf(fp, "<Class %s>\n", pclass->name);
-
-    cupsFilePrintf(fp, "UUID %s\n", pclass->uuid);
-
-    if (pclass->num_auth_info_required > 0)
-    {
-      switch (pclass->num_auth_info_required)
-      {
-        case 1 :
-            strlcpy(value, pclass->auth_info_required[0], sizeof(value));
-	    break;
+    write_class(fp, pclass);
 
-        case 2 :
-            snprintf(value, sizeof(value), "%s,%s",
-	             pclass->auth_info_required[0],
-		     pclass->auth_info_required[1]);
-	    break;
+    pclass->dirty = 0;
+  }
 
-        case 3 :
-	default :
-            snprintf(value, sizeof(value), "%s,%s,%s",
-	             pclass->auth_info_required[0],
-		     pclass->auth_info_required[1],
-		     pclass->auth_info_required[2]);
-	    break;
-      }
+  if (cupsdCloseCreatedConfFile(fp, filename))
+    class_records = -1;
+  else
+    class_records = 0;
+}
 
-      cupsFilePutConf(fp, "AuthInfoRequired", value);
-    }
 
-    if (pclass->info)
-      cupsFilePutConf(fp, "Info", pclass->info);
+/*
+ * 'write_class()' - Write a class to the classes.conf file.
+ */
 
-    if (pclass->location)
-      cupsFilePutConf(fp, "Location", pclass->location);
+static void
+write_class(cups_file_t     *fp,	/* I - classes.conf file */
+            cupsd_printer_t *pclass)	/* I - Class */
+{
+  int			i;		/* Looping var */
+  char			value[2048],	/* Value string */
+			*name;		/* Current user name */
+  cups_option_t		*option;	/* Current option */
 
-    if (pclass->state == IPP_PRINTER_STOPPED)
-      cupsFilePuts(fp, "State Stopped\n");
-    else
-      cupsFilePuts(fp, "State Idle\n");
 
-    cupsFilePrintf(fp, "StateTime %d\n", (int)pclass->state_time);
+  if (pclass == DefaultPrinter)
+    cupsFilePrintf(fp, "<DefaultClass %s>\n", pclass->name);
+  else
+    cupsFilePrintf(fp, "<Class %s>\n", pclass->name);
 
-    if (pclass->accepting)
-      cupsFilePuts(fp, "Accepting Yes\n");
-    else
-      cupsFilePuts(fp, "Accepting No\n");
+  cupsFilePrintf(fp, "UUID %s\n", pclass->uuid);
 
-    if (pclass->shared)
-      cupsFilePuts(fp, "Shared Yes\n");
-    else
-      cupsFilePuts(fp, "Shared No\n");
+  if (pclass->num_auth_info_required > 0)
+  {
+    switch (pclass->num_auth_info_required)
+    {
+      case 1 :
+	  strlcpy(value, pclass->auth_info_required[0], sizeof(value));
+	  break;
+
+      case 2 :
+	  snprintf(value, sizeof(value), "%s,%s",
+		   pclass->auth_info_required[0],
+		   pclass->auth_info_required[1]);
+	  break;
+
+      case 3 :
+      default :
+	  snprintf(value, sizeof(value), "%s,%s,%s",
+		   pclass->auth_info_required[0],
+		   pclass->auth_info_required[1],
+		   pclass->auth_info_required[2]);
+	  break;
+    }
 
-    snprintf(value, sizeof(value), "%s %s", pclass->job_sheets[0],
-             pclass->job_sheets[1]);
-    cupsFilePutConf(fp, "JobSheets", value);
+    cupsFilePutConf(fp, "AuthInfoRequired", value);
+  }
 
-    for (i = 0; i < pclass->num_printers; i ++)
-      cupsFilePrintf(fp, "Printer %s\n", pclass->printers[i]->name);
+  if (pclass->info)
+    cupsFilePutConf(fp, "Info", pclass->info);
 
-    cupsFilePrintf(fp, "QuotaPeriod %d\n", pclass->quota_period);
-    cupsFilePrintf(fp, "PageLimit %d\n", pclass->page_limit);
-    cupsFilePrintf(fp, "KLimit %d\n", pclass->k_limit);
+  if (pclass->location)
+    cupsFilePutConf(fp, "Location", pclass->location);
 
-    for (name = (char *)cupsArrayFirst(pclass->users);
-         name;
-	 name = (char *)cupsArrayNext(pclass->users))
-      cupsFilePutConf(fp, pclass->deny_users ? "DenyUser" : "AllowUser", name);
+  if (pclass->state == IPP_PRINTER_STOPPED)
+    cupsFilePuts(fp, "State Stopped\n");
+  else
+    cupsFilePuts(fp, "State Idle\n");
 
-     if (pclass->op_policy)
-      cupsFilePutConf(fp, "OpPolicy", pclass->op_policy);
-    if (pclass->error_policy)
-      cupsFilePutConf(fp, "ErrorPolicy", pclass->error_policy);
+  cupsFilePrintf(fp, "StateTime %d\n", (int)pclass->state_time);
 
-    for (i = pclass->num_options, option = pclass->options;
-         i > 0;
-	 i --, option ++)
-    {
-      snprintf(value, sizeof(value), "%s %s", option->name, option->value);
-      cupsFilePutConf(fp, "Option", value);
-    }
+  if (pclass->accepting)
+    cupsFilePuts(fp, "Accepting Yes\n");
+  else
+    cupsFilePuts(fp, "Accepting No\n");
 
-    cupsFilePuts(fp, "</Class>\n");
+  if (pclass->shared)
+    cupsFilePuts(fp, "Shared Yes\n");
+  else
+    cupsFilePuts(fp, "Shared No\n");
+
+  snprintf(value, sizeof(value), "%s %s", pclass->job_sheets[0],
+	   pclass->job_sheets[1]);
+  cupsFilePutConf(fp, "JobSheets", value);
+
+  for (i = 0; i < pclass->num_printers; i ++)
+    cupsFilePrintf(fp, "Printer %s\n", pclass->printers[i]->name);
+
+  cupsFilePrintf(fp, "QuotaPeriod %d\n", pclass->quota_period);
+  cupsFilePrintf(fp, "PageLimit %d\n", pclass->page_limit);
+  cupsFilePrintf(fp, "KLimit %d\n", pclass->k_limit);
+  if (pclass->spool_compression >= 0)
+    cupsFilePrintf(fp, "SpoolCompression %d\n", pclass->spool_compression);
+
+  for (name = (char *)cupsArrayFirst(pclass->users);
+       name;
+       name = (char *)cupsArrayNext(pclass->users))
+    cupsFilePutConf(fp, pclass->deny_users ? "DenyUser" : "AllowUser", name);
+
+  if (pclass->op_policy)
+    cupsFilePutConf(fp, "OpPolicy", pclass->op_policy);
+  if (pclass->error_policy)
+    cupsFilePutConf(fp, "ErrorPolicy", pclass->error_policy);
+
+  for (i = pclass->num_options, option = pclass->options;
+       i > 0;
+       i --, option ++)
+  {
+    snprintf(value, sizeof(value), "%s %s", option->name, option->value);
+    cupsFilePutConf(fp, "Option", value);
   }
 
-  cupsdCloseCreatedConfFile(fp, filename);
+  cupsFilePuts(fp, "</Class>\n");
 }
 
 
@@ -422,6 +422,12 @@ cupsdCloseClient(cupsd_client_t *con)	/* I - Client to close */
 
   cupsdLogClient(con, CUPSD_LOG_DEBUG, "Closing connection.");
 
+ /*
+  * Give up any response that is being encoded by a worker thread...
+  */
+
+  cupsdReleaseResponse(con);
+
  /*
   * Flush pending writes before closing...
   */
@@ -430,13 +436,22 @@ cupsdCloseClient(cupsd_client_t *con)	/* I - Client to close */
 
   partial = 0;
 
+ /*
+  * Abort a job whose document is still being received...
+  */
+
+  if (con->streaming)
+    cupsdFinishIPPStream(con, -1);
+
   if (con->pipe_pid != 0)
   {
    /*
     * Stop any CGI process...
     */
 
-    cupsdEndProcess(con->pipe_pid, 1);
+    if (!con->pipe_shared)
+      cupsdEndProcess(con->pipe_pid, 1);
+
     con->pipe_pid = 0;
   }
 
@@ -570,6 +585,7 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
   struct stat		filestats;	/* File information */
   mime_type_t		*type;		/* MIME type of file */
   cupsd_printer_t	*p;		/* Printer */
+  cupsd_job_t		*job;		/* Job receiving a streamed document */
   static unsigned	request_id = 0;	/* Request ID for temp files */
 
 
@@ -1179,6 +1195,43 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 		break;
 	      }
 	    }
+	    else if (!strcmp(con->uri, "/metrics"))
+	    {
+	     /*
+	      * Send the scheduler statistics as plain text...
+	      */
+
+	      char	*metrics;		/* Statistics text */
+	      size_t	length;			/* Length of text */
+
+	      if ((metrics = cupsdGetMetrics(&length)) == NULL)
+	      {
+		if (!cupsdSendError(con, HTTP_STATUS_SERVER_ERROR, CUPSD_AUTH_NONE))
+		{
+		  cupsdCloseClient(con);
+		  return;
+		}
+
+		break;
+	      }
+
+	      httpSetLength(con->http, length);
+
+	      if (!cupsdSendHeader(con, HTTP_STATUS_OK,
+	                           "text/plain; version=0.0.4", CUPSD_AUTH_NONE) ||
+		  httpWrite2(con->http, metrics, length) < 0 ||
+		  httpFlushWrite(con->http) < 0)
+	      {
+		free(metrics);
+		cupsdCloseClient(con);
+		return;
+	      }
+
+	      free(metrics);
+
+	      cupsdLogRequest(con, HTTP_STATUS_OK);
+	      break;
+	    }
 	    else if (!WebInterface)
 	    {
 	     /*
@@ -1936,6 +1989,17 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 	    fchmod(con->file, 0640);
 	    fchown(con->file, RunUser, Group);
             fcntl(con->file, F_SETFD, fcntl(con->file, F_GETFD) | FD_CLOEXEC);
+
+           /*
+	    * Documents in one of the StreamJobs formats are printed while they
+	    * are received...
+	    */
+
+	    if (con->file >= 0 && cupsdStreamIPPRequest(con) < 0)
+	    {
+	      cupsdCloseClient(con);
+	      return;
+	    }
 	  }
 
 	  if (httpGetState(con->http) != HTTP_STATE_POST_SEND)
@@ -1970,6 +2034,20 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 		unlink(con->filename);
 		cupsdClearString(&con->filename);
 
+                if (con->streaming)
+		{
+		 /*
+		  * The job has already been created, so don't process the
+		  * request again...
+		  */
+
+		  cupsdFinishIPPStream(con, -1);
+		  cupsdSendError(con, HTTP_STATUS_REQUEST_TOO_LARGE,
+		                 CUPSD_AUTH_NONE);
+		  cupsdCloseClient(con);
+		  return;
+		}
+
         	if (!cupsdSendError(con, HTTP_STATUS_REQUEST_TOO_LARGE,
 		                    CUPSD_AUTH_NONE))
 		{
@@ -1977,6 +2055,9 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 		  return;
 		}
 	      }
+	      else if (con->stream_job &&
+	               (job = cupsdFindJob(con->stream_job)) != NULL)
+		cupsdStreamJobData(job);
 	    }
 	    else if (httpGetState(con->http) == HTTP_STATE_POST_RECV)
               return;
@@ -1994,6 +2075,30 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 
 	if (httpGetState(con->http) == HTTP_STATE_POST_SEND)
 	{
+	  if (con->streaming)
+	  {
+	   /*
+	    * The job was created before the document arrived; let it know the
+	    * document is complete and send the response...
+	    */
+
+	    if (fstat(con->file, &filestats))
+	      filestats.st_size = -1;
+
+	    close(con->file);
+	    con->file = -1;
+
+	    cupsdFinishIPPStream(con, filestats.st_size);
+
+	    if (con->filename)
+	    {
+	      unlink(con->filename);
+	      cupsdClearString(&con->filename);
+	    }
+
+	    return;
+	  }
+
 	  if (con->file >= 0)
 	  {
 	    fstat(con->file, &filestats);
@@ -2434,22 +2539,20 @@ cupsdSendHeader(
 void
 cupsdUpdateCGI(void)
 {
-  char		*ptr,			/* Pointer to end of line in buffer */
-		message[1024];		/* Pointer to message text */
+  char		*message;		/* Pointer to message text */
   int		loglevel;		/* Log level for message */
 
 
-  while ((ptr = cupsdStatBufUpdate(CGIStatusBuffer, &loglevel,
-                                   message, sizeof(message))) != NULL)
+  while ((message = cupsdStatBufUpdate(CGIStatusBuffer, &loglevel)) != NULL)
   {
     if (loglevel == CUPSD_LOG_INFO)
       cupsdLogMessage(CUPSD_LOG_INFO, "%s", message);
 
-    if (!strchr(CGIStatusBuffer->buffer, '\n'))
+    if (!cupsdStatBufHasLine(CGIStatusBuffer))
       break;
   }
 
-  if (ptr == NULL && !CGIStatusBuffer->bufused)
+  if (message == NULL && !CGIStatusBuffer->bufused)
   {
    /*
     * Fatal error on pipe - should never happen!
@@ -2532,7 +2635,35 @@ cupsdWriteClient(cupsd_client_t *con)	/* I - Client connection */
     con->file_ready = 0;
   }
 
-  if (con->response && con->response->state != IPP_STATE_DATA)
+  if (con->work)
+  {
+    cupsd_work_t *work = con->work;	/* Response encoded by a worker */
+    size_t	remaining = work->datalen - work->datapos;
+					/* Bytes left to send */
+
+   /*
+    * Send the next part of the response that was encoded by a worker
+    * thread...
+    */
+
+    if (remaining > 65536)
+      remaining = 65536;
+
+    if ((bytes = httpWrite2(con->http, (char *)work->data + work->datapos,
+                            remaining)) > 0)
+      work->datapos += (size_t)bytes;
+
+    if (httpGetPending(con->http) > 0)
+      httpFlushWrite(con->http);
+
+    cupsdLogClient(con, CUPSD_LOG_DEBUG,
+                   "Writing encoded IPP response, " CUPS_LLFMT " of "
+		   CUPS_LLFMT " bytes sent", CUPS_LLCAST work->datapos,
+		   CUPS_LLCAST work->datalen);
+
+    bytes = bytes > 0 && work->datapos < work->datalen;
+  }
+  else if (con->response && con->response->state != IPP_STATE_DATA)
   {
     size_t wused = httpGetPending(con->http);	/* Previous write buffer use */
 
@@ -2570,6 +2701,28 @@ cupsdWriteClient(cupsd_client_t *con)	/* I - Client connection */
                    (int)bytes, httpGetState(con->http),
                    CUPS_LLCAST httpGetLength2(con->http));
   }
+  else if (con->file >= 0 && (!con->pipe_pid || con->got_fields))
+  {
+   /*
+    * Send file or CGI data, without copying it when possible...
+    */
+
+    if ((bytes = (int)_httpSendFile(con->http, con->file, 65536)) < 0)
+    {
+      cupsdLogClient(con, CUPSD_LOG_DEBUG, "Closing for error %d (%s)",
+		     httpError(con->http), strerror(httpError(con->http)));
+      cupsdCloseClient(con);
+      return;
+    }
+
+    if (httpIsChunked(con->http))
+      httpFlushWrite(con->http);
+
+    con->bytes += bytes;
+
+    if (httpGetState(con->http) == HTTP_STATE_WAITING)
+      bytes = 0;
+  }
   else if ((bytes = read(con->file, con->header + con->header_used,
 			 sizeof(con->header) - con->header_used)) > 0)
   {
@@ -2747,7 +2900,7 @@ cupsdWriteClient(cupsd_client_t *con)	/* I - Client connection */
     {
       cupsdRemoveSelect(con->file);
 
-      if (con->pipe_pid)
+      if (con->pipe_pid && !con->pipe_shared)
 	cupsdEndProcess(con->pipe_pid, 0);
 
       close(con->file);
@@ -2767,6 +2920,8 @@ cupsdWriteClient(cupsd_client_t *con)	/* I - Client connection */
       con->request = NULL;
     }
 
+    cupsdReleaseResponse(con);
+
     if (con->response)
     {
       ippDelete(con->response);
@@ -3375,6 +3530,7 @@ pipe_command(cupsd_client_t *con,	/* I - Client connection */
   char		*commptr,		/* Command string pointer */
 		commch;			/* Command string character */
   char		*uriptr;		/* URI string pointer */
+  char		driverd[1024];		/* Path to cups-driverd */
   int		fds[2];			/* Pipe FDs */
   int		argc;			/* Number of arguments */
   int		envc;			/* Number of environment variables */
@@ -3728,8 +3884,26 @@ pipe_command(cupsd_client_t *con,	/* I - Client connection */
   * Then execute the command...
   */
 
-  if (cupsdStartProcess(command, argv, envp, infile, fds[1], CGIPipes[1],
-			-1, -1, root, DefaultProfile, NULL, &pid) < 0)
+  snprintf(driverd, sizeof(driverd), "%s/daemon/cups-driverd", ServerBin);
+
+  con->pipe_shared = 0;
+
+  if (!strcmp(command, driverd) && (pid = cupsdRunDriverd(argv, fds[1])) > 0)
+  {
+   /*
+    * The cups-driverd service writes the response to our pipe...
+    */
+
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "[CGI] Sent request to %s (PID %d)",
+                    command, pid);
+
+    con->pipe_shared = 1;
+
+    *outfile = fds[0];
+    close(fds[1]);
+  }
+  else if (cupsdStartProcess(command, argv, envp, infile, fds[1], CGIPipes[1],
+			     -1, -1, root, DefaultProfile, NULL, &pid) < 0)
   {
    /*
     * Error - can't fork!
@@ -18,6 +18,31 @@
 #endif /* HAVE_AUTHORIZATION_H */
 
 
+/*
+ * Response worker constants...
+ */
+
+#define CUPSD_WORKER_MAX	8	/* Maximum number of response workers */
+#define CUPSD_WORKER_MIN	65536	/* Minimum response size for workers */
+
+
+/*
+ * Response worker structure...
+ */
+
+typedef struct cupsd_work_s		/**** Response worker data ****/
+{
+  cupsd_client_t	*con;		/* Client connection or NULL if closed */
+  ipp_t			*response;	/* Response to encode */
+  ipp_uchar_t		*data;		/* Encoded response */
+  size_t		datalen,	/* Length of encoded response */
+			datasize,	/* Size of encoded response buffer */
+			datapos;	/* Bytes sent to the client */
+  int			busy,		/* Being encoded by a worker? */
+			error;		/* Non-zero if encoding failed */
+} cupsd_work_t;
+
+
 /*
  * HTTP client structure...
  */
@@ -28,6 +53,7 @@ struct cupsd_client_s
   http_t		*http;		/* HTTP client connection */
   ipp_t			*request,	/* IPP request information */
 			*response;	/* IPP response information */
+  cupsd_work_t		*work;		/* Response worker data */
   cupsd_location_t	*best;		/* Best match for AAA */
   struct timeval	start;		/* Request start time */
   http_state_t		operation;	/* Request operation */
@@ -45,7 +71,10 @@ struct cupsd_client_s
 			*query_string;	/* QUERY_STRING environment variable */
   int			file;		/* Input/output file */
   int			file_ready;	/* Input ready on file/pipe? */
+  int			streaming,	/* Document streamed to a job? */
+			stream_job;	/* Job receiving the document */
   int			pipe_pid;	/* Pipe process ID (or 0 if not a pipe) */
+  int			pipe_shared;	/* Non-zero if pipe process is shared */
   http_status_t		pipe_status;	/* HTTP status from pipe process */
   int			sent_header,	/* Non-zero if sent HTTP header */
 			got_fields,	/* Non-zero if all fields seen */
@@ -122,9 +151,12 @@ extern void	cupsdAcceptClient(cupsd_listener_t *lis);
 extern void	cupsdCloseAllClients(void);
 extern int	cupsdCloseClient(cupsd_client_t *con);
 extern void	cupsdDeleteAllListeners(void);
+extern int	cupsdFinishIPPStream(cupsd_client_t *con, off_t bytes);
 extern void	cupsdPauseListening(void);
 extern int	cupsdProcessIPPRequest(cupsd_client_t *con);
+extern int	cupsdQueueResponse(cupsd_client_t *con);
 extern void	cupsdReadClient(cupsd_client_t *con);
+extern void	cupsdReleaseResponse(cupsd_client_t *con);
 extern void	cupsdResumeListening(void);
 extern int	cupsdSendCommand(cupsd_client_t *con, char *command,
 		                 char *options, int root);
@@ -134,7 +166,10 @@ extern int	cupsdSendHeader(cupsd_client_t *con, http_status_t code,
 		                char *type, int auth_type);
 extern void	cupsdShutdownClient(cupsd_client_t *con);
 extern void	cupsdStartListening(void);
+extern void	cupsdStartWorkers(void);
 extern void	cupsdStopListening(void);
+extern void	cupsdStopWorkers(void);
+extern int	cupsdStreamIPPRequest(cupsd_client_t *con);
 extern void	cupsdUpdateCGI(void);
 extern void	cupsdWriteClient(cupsd_client_t *con);
 
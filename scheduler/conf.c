@@ -64,6 +64,7 @@ typedef struct
 
 static const cupsd_var_t	cupsd_vars[] =
 {
+  { "AuthCacheDuration",	&AuthCacheDuration,	CUPSD_VARTYPE_TIME },
   { "AutoPurgeJobs", 		&JobAutoPurge,		CUPSD_VARTYPE_BOOLEAN },
 #if defined(HAVE_DNSSD) || defined(HAVE_AVAHI)
   { "BrowseDNSSDSubTypes",	&DNSSDSubTypes,		CUPSD_VARTYPE_STRING },
@@ -78,9 +79,11 @@ static const cupsd_var_t	cupsd_vars[] =
   { "DefaultPolicy",		&DefaultPolicy,		CUPSD_VARTYPE_STRING },
   { "DefaultShared",		&DefaultShared,		CUPSD_VARTYPE_BOOLEAN },
   { "DirtyCleanInterval",	&DirtyCleanInterval,	CUPSD_VARTYPE_TIME },
+  { "DriverdTimeout",		&DriverdTimeout,	CUPSD_VARTYPE_TIME },
   { "ErrorPolicy",		&ErrorPolicy,		CUPSD_VARTYPE_STRING },
   { "FilterLimit",		&FilterLimit,		CUPSD_VARTYPE_INTEGER },
   { "FilterNice",		&FilterNice,		CUPSD_VARTYPE_INTEGER },
+  { "FilterWorkers",		&FilterWorkers,		CUPSD_VARTYPE_INTEGER },
 #ifdef HAVE_GSSAPI
   { "GSSServiceName",		&GSSServiceName,	CUPSD_VARTYPE_STRING },
 #endif /* HAVE_GSSAPI */
@@ -121,6 +124,8 @@ static const cupsd_var_t	cupsd_vars[] =
   { "RootCertDuration",		&RootCertDuration,	CUPSD_VARTYPE_TIME },
   { "ServerAdmin",		&ServerAdmin,		CUPSD_VARTYPE_STRING },
   { "ServerName",		&ServerName,		CUPSD_VARTYPE_STRING },
+  { "SpoolCompression",		&SpoolCompression,	CUPSD_VARTYPE_INTEGER },
+  { "StreamJobs",		&StreamJobs,		CUPSD_VARTYPE_STRING },
   { "StrictConformance",	&StrictConformance,	CUPSD_VARTYPE_BOOLEAN },
   { "Timeout",			&Timeout,		CUPSD_VARTYPE_TIME },
   { "WebInterface",		&WebInterface,		CUPSD_VARTYPE_BOOLEAN }
@@ -540,6 +545,7 @@ cupsdReadConfiguration(void)
   */
 
   cupsdDeleteAllLocations();
+  cupsdFlushAuthCache();
 
   cupsdDeleteAllListeners();
 
@@ -611,6 +617,8 @@ cupsdReadConfiguration(void)
 
   cupsdSetString(&RIPCache, "128m");
 
+  cupsdClearString(&StreamJobs);
+
   cupsdSetString(&TempDir, NULL);
 
 #ifdef HAVE_GSSAPI
@@ -685,10 +693,12 @@ cupsdReadConfiguration(void)
   ConfigFilePerm           = CUPS_DEFAULT_CONFIG_FILE_PERM;
   FatalErrors              = parse_fatal_errors(CUPS_DEFAULT_FATAL_ERRORS);
   default_auth_type        = CUPSD_AUTH_BASIC;
+  AuthCacheDuration        = 0;
 #ifdef HAVE_SSL
   DefaultEncryption        = HTTP_ENCRYPT_REQUIRED;
 #endif /* HAVE_SSL */
   DirtyCleanInterval       = DEFAULT_KEEPALIVE;
+  DriverdTimeout           = 600;
   JobKillDelay             = DEFAULT_TIMEOUT;
   JobRetryLimit            = 5;
   JobRetryInterval         = 300;
@@ -696,6 +706,7 @@ cupsdReadConfiguration(void)
   FilterLevel              = 0;
   FilterLimit              = 0;
   FilterNice               = 0;
+  FilterWorkers            = 0;
   HostNameLookups          = FALSE;
   KeepAlive                = TRUE;
   KeepAliveTimeout         = DEFAULT_KEEPALIVE;
@@ -733,6 +744,7 @@ cupsdReadConfiguration(void)
 
   JobHistory          = DEFAULT_HISTORY;
   JobFiles            = DEFAULT_FILES;
+  SpoolCompression    = 0;
   JobAutoPurge        = 0;
   MaxHoldTime         = 0;
   MaxJobs             = 500;
@@ -1915,6 +1927,8 @@ get_addr_and_mask(const char *value,	/* I - String from config file */
 
 	if (i <= 96)
 	  mask[0] = 0xffffffff;
+	else if (i >= 128)
+	  mask[0] = 0;
 	else
 	  mask[0] = (0xffffffff << (i - 96)) & 0xffffffff;
 
@@ -1949,7 +1963,9 @@ get_addr_and_mask(const char *value,	/* I - String from config file */
         mask[1] = 0xffffffff;
         mask[2] = 0xffffffff;
 
-	if (i < 32)
+	if (i <= 0)
+	  mask[3] = 0;
+	else if (i < 32)
           mask[3] = (0xffffffff << (32 - i)) & 0xffffffff;
 	else
 	  mask[3] = 0xffffffff;
@@ -138,6 +138,8 @@ VAR char		*AccessLog		VALUE(NULL),
 					/* Default printer-error-policy */
 			*RIPCache		VALUE(NULL),
 					/* Amount of memory for RIPs */
+			*StreamJobs		VALUE(NULL),
+					/* Formats printed while received */
 			*TempDir		VALUE(NULL),
 					/* Temporary directory */
 			*Printcap		VALUE(NULL),
@@ -190,6 +192,8 @@ VAR int			MaxClients		VALUE(100),
 					/* Support the Keep-Alive option? */
 			KeepAliveTimeout	VALUE(DEFAULT_KEEPALIVE),
 					/* Timeout between requests */
+			DriverdTimeout		VALUE(600),
+					/* Idle time before cups-driverd exits */
 			FileDevice		VALUE(FALSE),
 					/* Allow file: devices? */
 			FilterLimit		VALUE(0),
@@ -198,6 +202,8 @@ VAR int			MaxClients		VALUE(100),
 					/* Current filter level */
 			FilterNice		VALUE(0),
 					/* Nice value for filters */
+			FilterWorkers		VALUE(0),
+					/* Number of idle worker processes */
 			ReloadTimeout		VALUE(DEFAULT_KEEPALIVE),
 					/* Timeout before reload from SIGHUP */
 			RootCertDuration	VALUE(300),
@@ -288,6 +294,8 @@ extern int	cupsdLogMessage(int level, const char *message, ...)
 extern int	cupsdLogPage(cupsd_job_t *job, const char *page);
 extern int	cupsdLogRequest(cupsd_client_t *con, http_status_t code);
 extern int	cupsdReadConfiguration(void);
+extern void	cupsdStartLogWriter(void);
+extern void	cupsdStopLogWriter(void);
 extern int	cupsdWriteErrorLog(int level, const char *message);
 
 
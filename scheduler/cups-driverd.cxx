@@ -19,6 +19,7 @@
  * Contents:
  *
 ﻿ *   main()	       - Scan for drivers and return an IPP response.
+ *   add_list()        - Add a string to a PPD string list.
  *   add_ppd()	       - Add a PPD file.
  *   cat_drv()	       - Generate a PPD from a driver info file.
  *   cat_ppd()	       - Copy a PPD file to stdout.
@@ -28,9 +29,13 @@
  *   compare_matches() - Compare PPD match scores for sorting.
  *   compare_names()   - Compare PPD filenames for sorting.
  *   compare_ppds()    - Compare PPD file make and model names for sorting.
+ *   compare_strings() - Compare ppds.dat strings for sorting.
  *   dump_ppds_dat()   - Dump the contents of the ppds.dat file.
  *   free_array()      - Free an array of strings.
+ *   free_ppd()        - Free a PPD record.
  *   get_file()        - Get the filename associated with a request.
+ *   get_request()     - Get a request from the scheduler.
+ *   list_length()     - Return the length of a PPD string list.
  *   list_ppds()       - List PPD files.
  *   load_drv()        - Load the PPDs from a driver information file.
  *   load_drivers()    - Load driver-generated PPD files.
@@ -38,11 +43,18 @@
  *   load_ppds()       - Load PPD files recursively.
  *   load_ppds_dat()   - Load the ppds.dat file.
  *   load_tar()        - Load archived PPD files.
+ *   new_list()        - Create a PPD string list.
  *   read_tar()        - Read a file header from an archive.
  *   regex_device_id() - Compile a regular expression based on the 1284 device
  *			 ID.
  *   regex_string()    - Construct a regular expression to compare a simple
  *			 string.
+ *   run_request()     - Run a single request.
+ *   serve_ppds()      - Handle requests from the scheduler.
+ *   update_ppds()     - Update the PPD database from the PPD directories.
+ *   watch_parent()    - Watch for a missing PPD directory to be created.
+ *   write_ppds_dat()  - Write the ppds.dat file.
+ *   write_string()    - Add a string to the ppds.dat string table.
  */
 
 /*
@@ -55,17 +67,30 @@
 #include <cups/ppd-private.h>
 #include <ppdc/ppdc.h>
 #include <regex.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#ifdef HAVE_SYS_INOTIFY_H
+#  include <sys/inotify.h>
+#endif /* HAVE_SYS_INOTIFY_H */
 
 
 /*
  * Constants...
  */
 
-#define PPD_SYNC	0x50504437	/* Sync word for ppds.dat (PPD7) */
+#define PPD_SYNC	0x50504438	/* Sync word for ppds.dat (PPD8) */
 #define PPD_MAX_LANG	32		/* Maximum languages */
 #define PPD_MAX_PROD	32		/* Maximum products */
 #define PPD_MAX_VERS	32		/* Maximum versions */
 
+#ifdef HAVE_SYS_INOTIFY_H
+#  define PPD_WATCH_EVENTS (IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | \
+			    IN_DELETE | IN_DELETE_SELF | IN_MODIFY | \
+			    IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO)
+					/* Events that change a PPD directory */
+#endif /* HAVE_SYS_INOTIFY_H */
+
 #define PPD_TYPE_POSTSCRIPT	0	/* PostScript PPD */
 #define PPD_TYPE_PDF		1	/* PDF PPD */
 #define PPD_TYPE_RASTER		2	/* CUPS raster PPD */
@@ -101,27 +126,82 @@ typedef struct				/**** PPD record ****/
   off_t		size;			/* Size in bytes */
   int		model_number;		/* cupsModelNumber */
   int		type;			/* ppd-type */
-  char		filename[512],		/* Filename */
-		name[512],		/* PPD name */
-		languages[PPD_MAX_LANG][6],
-					/* LanguageVersion/cupsLanguages */
-		products[PPD_MAX_PROD][128],
-					/* Product strings */
-		psversions[PPD_MAX_VERS][32],
-					/* PSVersion strings */
-		make[128],		/* Manufacturer */
-		make_and_model[128],	/* NickName/ModelName */
-		device_id[256],		/* IEEE 1284 Device ID */
-		scheme[128];		/* PPD scheme */
+  const char	*filename,		/* Filename */
+		*name,			/* PPD name */
+		*languages,		/* LanguageVersion/cupsLanguages list */
+		*products,		/* Product strings list */
+		*psversions,		/* PSVersion strings list */
+		*make,			/* Manufacturer */
+		*make_and_model,	/* NickName/ModelName */
+		*device_id,		/* IEEE 1284 Device ID */
+		*scheme;		/* PPD scheme */
 } ppd_rec_t;
 
+/*
+ * The languages, products, and psversions lists hold their first value
+ * (which may be empty) followed by zero or more non-empty values, each
+ * nul-terminated, and end with an empty string, e.g. "en\0fr\0\0".
+ */
+
 typedef struct				/**** In-memory record ****/
 {
   int		found;			/* 1 if PPD is found */
   int		matches;		/* Match count */
-  ppd_rec_t	record;			/* PPDs.dat record */
+  int		mapped;			/* 1 if record is from ppds.dat */
+  ppd_rec_t	record;			/* PPD record */
 } ppd_info_t;
 
+/*
+ * The ppds.dat file contains a header, the records sorted by filename and
+ * name, the record numbers sorted by make and model, and the string table.
+ * All strings are stored as offsets into the string table, which ends with
+ * two nul bytes.  The file is mapped into memory and used in place.
+ */
+
+typedef struct				/**** ppds.dat header ****/
+{
+  unsigned	sync,			/* Sync word (PPD_SYNC) */
+		length,			/* Length of file */
+		num_ppds,		/* Number of records */
+		records,		/* Offset of records */
+		make_models,		/* Offset of make and model index */
+		strings;		/* Offset of string table */
+} ppd_dat_t;
+
+typedef struct				/**** ppds.dat record ****/
+{
+  time_t	mtime;			/* Modification time */
+  off_t		size;			/* Size in bytes */
+  int		model_number;		/* cupsModelNumber */
+  int		type;			/* ppd-type */
+  unsigned	filename,		/* Filename */
+		name,			/* PPD name */
+		languages,		/* LanguageVersion/cupsLanguages list */
+		products,		/* Product strings list */
+		psversions,		/* PSVersion strings list */
+		make,			/* Manufacturer */
+		make_and_model,		/* NickName/ModelName */
+		device_id,		/* IEEE 1284 Device ID */
+		scheme;			/* PPD scheme */
+} ppd_drec_t;
+
+typedef struct				/**** ppds.dat string ****/
+{
+  const char	*value;			/* String or list value */
+  size_t	length;			/* Length including nul bytes */
+  unsigned	offset;			/* Offset in string table */
+} ppd_string_t;
+
+typedef struct				/**** ppds.dat string table ****/
+{
+  char		*data;			/* String data */
+  size_t	used,			/* Bytes used */
+		alloc;			/* Bytes allocated */
+  cups_array_t	*pool;			/* Strings sorted by value */
+  ppd_string_t	*strings;		/* Strings in pool */
+  int		num_strings;		/* Number of strings in pool */
+} ppd_strings_t;
+
 typedef union				/**** TAR record format ****/
 {
   unsigned char	all[TAR_BLOCK];		/* Raw data block */
@@ -156,7 +236,9 @@ static cups_array_t	*Inodes = NULL,	/* Inodes of directories we've visited */
 					/* PPD files sorted by filename and name */
 			*PPDsByMakeModel = NULL;
 					/* PPD files sorted by make and model */
-static int		ChangedPPD;	/* Did we change the PPD database? */
+static int		ChangedPPD,	/* Did we change the PPD database? */
+			UpdatePPDs = 1,	/* Do we need to update the database? */
+			WatchFD = -1;	/* inotify descriptor for PPD directories */
 static const char * const PPDTypes[] =	/* ppd-type values */
 			{
 			  "postscript",
@@ -173,6 +255,7 @@ static const char * const PPDTypes[] =	/* ppd-type values */
  * Local functions...
  */
 
+static void		add_list(const char **list, const char *value);
 static ppd_info_t	*add_ppd(const char *filename, const char *name,
 			         const char *language, const char *make,
 				 const char *make_and_model,
@@ -191,11 +274,16 @@ static int		compare_names(const ppd_info_t *p0,
 			              const ppd_info_t *p1);
 static int		compare_ppds(const ppd_info_t *p0,
 			             const ppd_info_t *p1);
+static int		compare_strings(const ppd_string_t *s0,
+			                const ppd_string_t *s1);
 static int		dump_ppds_dat(const char *filename);
 static void		free_array(cups_array_t *a);
+static void		free_ppd(ppd_info_t *ppd);
 static cups_file_t	*get_file(const char *name, int request_id,
 			          const char *subdir, char *buffer,
 			          size_t bufsize, char **subfile);
+static char		**get_request(int *argc, int *fd);
+static size_t		list_length(const char *list);
 static int		list_ppds(int request_id, int limit, const char *opt);
 static int		load_drivers(cups_array_t *include,
 			             cups_array_t *exclude);
@@ -209,10 +297,18 @@ static void		load_ppds_dat(char *filename, size_t filesize,
 			              int verbose);
 static int		load_tar(const char *filename, const char *name,
 			         cups_file_t *fp, time_t mtime, off_t size);
+static char		*new_list(const char *value);
 static int		read_tar(cups_file_t *fp, char *name, size_t namesize,
 			         struct stat *info);
 static regex_t		*regex_device_id(const char *device_id);
 static regex_t		*regex_string(const char *s);
+static int		run_request(int argc, char *argv[]);
+static int		serve_ppds(void);
+static void		update_ppds(void);
+static void		watch_parent(const char *d);
+static void		write_ppds_dat(const char *filename);
+static unsigned		write_string(ppd_strings_t *sp, const char *value,
+			             size_t length);
 
 
 /*
@@ -228,25 +324,42 @@ main(int  argc,				/* I - Number of command-line args */
      char *argv[])			/* I - Command-line arguments */
 {
  /*
-  * Install or list PPDs...
+  * Serve requests from the scheduler, or install or list PPDs...
   */
 
-  if (argc == 3 && !strcmp(argv[1], "cat"))
-    return (cat_ppd(argv[2], 0));
-  else if ((argc == 2 || argc == 3) && !strcmp(argv[1], "dump"))
-    return (dump_ppds_dat(argv[2]));
-  else if (argc == 4 && !strcmp(argv[1], "get"))
-    return (cat_ppd(argv[3], atoi(argv[2])));
-  else if (argc == 5 && !strcmp(argv[1], "list"))
-    return (list_ppds(atoi(argv[2]), atoi(argv[3]), argv[4]));
+  if (argc == 2 && !strcmp(argv[1], "daemon"))
+    return (serve_ppds());
   else
-  {
-    fputs("Usage: cups-driverd cat ppd-name\n", stderr);
-    fputs("Usage: cups-driverd dump\n", stderr);
-    fputs("Usage: cups-driverd get request_id ppd-name\n", stderr);
-    fputs("Usage: cups-driverd list request_id limit options\n", stderr);
-    return (1);
-  }
+    return (run_request(argc, argv));
+}
+
+
+/*
+ * 'add_list()' - Add a string to a PPD string list.
+ */
+
+static void
+add_list(const char **list,		/* IO - List */
+         const char *value)		/* I  - Value to add */
+{
+  size_t	length,			/* Length of list */
+		vlength;		/* Length of value */
+  char		*temp;			/* New list */
+
+
+  if (!*value)
+    return;
+
+  length  = list_length(*list);
+  vlength = strlen(value) + 1;
+
+  if ((temp = (char *)realloc((void *)*list, length + vlength)) == NULL)
+    return;
+
+  memcpy(temp + length - 1, value, vlength);
+  temp[length + vlength - 1] = '\0';
+
+  *list = temp;
 }
 
 
@@ -295,25 +408,34 @@ add_ppd(const char *filename,		/* I - PPD filename */
   ppd->record.model_number = model_number;
   ppd->record.type         = type;
 
-  strlcpy(ppd->record.filename, filename, sizeof(ppd->record.filename));
-  strlcpy(ppd->record.name, name, sizeof(ppd->record.name));
-  strlcpy(ppd->record.languages[0], language,
-          sizeof(ppd->record.languages[0]));
-  strlcpy(ppd->record.products[0], product, sizeof(ppd->record.products[0]));
-  strlcpy(ppd->record.psversions[0], psversion,
-          sizeof(ppd->record.psversions[0]));
-  strlcpy(ppd->record.make, make, sizeof(ppd->record.make));
-  strlcpy(ppd->record.make_and_model, make_and_model,
-          sizeof(ppd->record.make_and_model));
-  strlcpy(ppd->record.device_id, device_id, sizeof(ppd->record.device_id));
-  strlcpy(ppd->record.scheme, scheme, sizeof(ppd->record.scheme));
+  ppd->record.filename       = strdup(filename);
+  ppd->record.name           = strdup(name);
+  ppd->record.languages      = new_list(language);
+  ppd->record.products       = new_list(product);
+  ppd->record.psversions     = new_list(psversion);
+  ppd->record.make           = strdup(make);
+  ppd->record.make_and_model = strdup(make_and_model);
+  ppd->record.device_id      = strdup(device_id);
+  ppd->record.scheme         = strdup(scheme);
+
+  if (!ppd->record.filename || !ppd->record.name || !ppd->record.languages ||
+      !ppd->record.products || !ppd->record.psversions || !ppd->record.make ||
+      !ppd->record.make_and_model || !ppd->record.device_id ||
+      !ppd->record.scheme)
+  {
+    fprintf(stderr,
+	    "ERROR: [cups-driverd] Ran out of memory for %d PPD files!\n",
+	    cupsArrayCount(PPDsByName));
+    free_ppd(ppd);
+    return (NULL);
+  }
 
  /*
   * Strip confusing (and often wrong) "recommended" suffix added by
   * Foomatic drivers...
   */
 
-  if ((recommended = strstr(ppd->record.make_and_model,
+  if ((recommended = strstr((char *)ppd->record.make_and_model,
                             " (recommended)")) != NULL)
     *recommended = '\0';
 
@@ -788,14 +910,29 @@ compare_ppds(const ppd_info_t *p0,	/* I - First PPD file */
   else if ((diff = cupsdCompareNames(p0->record.make_and_model,
                                      p1->record.make_and_model)) != 0)
     return (diff);
-  else if ((diff = strcmp(p0->record.languages[0],
-                          p1->record.languages[0])) != 0)
+  else if ((diff = strcmp(p0->record.languages,
+                          p1->record.languages)) != 0)
     return (diff);
   else
     return (compare_names(p0, p1));
 }
 
 
+/*
+ * 'compare_strings()' - Compare ppds.dat strings for sorting.
+ */
+
+static int				/* O - Result of comparison */
+compare_strings(const ppd_string_t *s0,	/* I - First string */
+                const ppd_string_t *s1)	/* I - Second string */
+{
+  if (s0->length != s1->length)
+    return (s0->length < s1->length ? -1 : 1);
+  else
+    return (memcmp(s0->value, s1->value, s0->length));
+}
+
+
 /*
  * 'dump_ppds_dat()' - Dump the contents of the ppds.dat file.
  */
@@ -827,8 +964,8 @@ dump_ppds_dat(const char *filename)	/* I - Filename */
            "\"%s\",\"%s\"\n",
            (int)ppd->record.mtime, (long)ppd->record.size,
 	   ppd->record.model_number, ppd->record.type, ppd->record.filename,
-	   ppd->record.name, ppd->record.languages[0], ppd->record.products[0],
-	   ppd->record.psversions[0], ppd->record.make,
+	   ppd->record.name, ppd->record.languages, ppd->record.products,
+	   ppd->record.psversions, ppd->record.make,
 	   ppd->record.make_and_model, ppd->record.device_id,
 	   ppd->record.scheme);
 
@@ -855,6 +992,34 @@ free_array(cups_array_t *a)		/* I - Array to free */
 }
 
 
+/*
+ * 'free_ppd()' - Free a PPD record.
+ */
+
+static void
+free_ppd(ppd_info_t *ppd)		/* I - PPD record */
+{
+ /*
+  * Records from ppds.dat point into the mapped file and are allocated as a
+  * single array, so only free records that were added since...
+  */
+
+  if (ppd->mapped)
+    return;
+
+  free((void *)ppd->record.filename);
+  free((void *)ppd->record.name);
+  free((void *)ppd->record.languages);
+  free((void *)ppd->record.products);
+  free((void *)ppd->record.psversions);
+  free((void *)ppd->record.make);
+  free((void *)ppd->record.make_and_model);
+  free((void *)ppd->record.device_id);
+  free((void *)ppd->record.scheme);
+  free(ppd);
+}
+
+
 /*
  * 'get_file()' - Get the filename associated with a request.
  */
@@ -1022,6 +1187,142 @@ get_file(const char *name,		/* I - Name */
 }
 
 
+/*
+ * 'get_request()' - Get a request from the scheduler.
+ *
+ * Requests use the same format as the ones sent to idle "cups-exec" workers
+ * and carry the file descriptor for the response.  The returned array and
+ * its first string are allocated separately and must be freed by the caller.
+ */
+
+static char **				/* O - Arguments or NULL on end-of-file */
+get_request(int *argc,			/* O - Number of arguments */
+            int *fd)			/* O - Response file descriptor */
+{
+  int			i,		/* Looping var */
+			header[4],	/* Request header */
+			recvfds[5],	/* Received file descriptors */
+			numfds;		/* Number of received file descriptors */
+  ssize_t		bytes;		/* Bytes read */
+  size_t		total;		/* Total bytes read */
+  char			*data,		/* Request data */
+			*dataptr,	/* Pointer into request data */
+			*dataend,	/* End of request data */
+			**args;		/* Arguments */
+  struct iovec		iov;		/* Request header */
+  struct msghdr		msg;		/* Request message */
+  struct cmsghdr	*cmsg;		/* Control message */
+  union
+  {
+    struct cmsghdr	hdr;		/* Alignment */
+    char		buf[CMSG_SPACE(sizeof(recvfds))];
+					/* Control message buffer */
+  }			control;	/* Control message */
+
+
+  for (;;)
+  {
+   /*
+    * Read the header and file descriptors; cupsd closes the socket when it
+    * no longer needs us...
+    */
+
+    iov.iov_base = (void *)header;
+    iov.iov_len  = sizeof(header);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    if ((bytes = recvmsg(0, &msg, MSG_WAITALL)) < 0 && errno == EINTR)
+      continue;
+    else if (bytes != (ssize_t)sizeof(header))
+      return (NULL);
+
+    if (header[0] <= 0 || header[0] > 65536 || header[2] < 2 ||
+        header[3] < 0 || header[2] + header[3] > header[0])
+      return (NULL);
+
+    numfds = 0;
+
+    if ((cmsg = CMSG_FIRSTHDR(&msg)) != NULL &&
+        cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+    {
+      numfds = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+      if (numfds > 5)
+	numfds = 5;
+
+      memcpy(recvfds, CMSG_DATA(cmsg), sizeof(int) * (size_t)numfds);
+    }
+
+   /*
+    * The response goes to the standard output file descriptor that was
+    * passed with the request...
+    */
+
+    for (i = 0, *fd = -1; i < numfds; i ++)
+      if (i == 0 && header[1] == 2)
+        *fd = recvfds[i];
+      else
+        close(recvfds[i]);
+
+   /*
+    * Read the argument and environment strings; the environment is ignored
+    * since it is the same for every request...
+    */
+
+    if ((data = (char *)malloc((size_t)header[0])) == NULL)
+      return (NULL);
+
+    for (total = 0; total < (size_t)header[0]; total += (size_t)bytes)
+      if ((bytes = read(0, data + total, (size_t)header[0] - total)) <= 0)
+	return (NULL);
+
+    if (data[header[0] - 1] ||
+        (args = (char **)calloc((size_t)header[2] + 1,
+                                sizeof(char *))) == NULL)
+      return (NULL);
+
+    for (i = 0, dataptr = data, dataend = data + header[0];
+	 i < header[2] && dataptr < dataend;
+	 i ++, dataptr += strlen(dataptr) + 1)
+      args[i] = dataptr;
+
+    if (i == header[2] && *fd >= 0)
+    {
+      *argc = header[2];
+      return (args);
+    }
+
+    fputs("ERROR: [cups-driverd] Bad request from scheduler!\n", stderr);
+
+    if (*fd >= 0)
+      close(*fd);
+
+    free(args);
+    free(data);
+  }
+}
+
+
+/*
+ * 'list_length()' - Return the length of a PPD string list.
+ */
+
+static size_t				/* O - Length including nul bytes */
+list_length(const char *list)		/* I - List */
+{
+  const char	*ptr;			/* Pointer into list */
+
+
+  for (ptr = list + strlen(list) + 1; *ptr; ptr += strlen(ptr) + 1);
+
+  return ((size_t)(ptr - list + 1));
+}
+
+
 /*
  * 'list_ppds()' - List PPD files.
  */
@@ -1034,10 +1335,7 @@ list_ppds(int        request_id,	/* I - Request ID */
   int		i;			/* Looping vars */
   int		count;			/* Number of PPDs to send */
   ppd_info_t	*ppd;			/* Current PPD file */
-  cups_file_t	*fp;			/* ppds.dat file */
-  char		filename[1024],		/* ppds.dat filename */
-		model[1024];		/* Model directory */
-  const char	*cups_datadir;		/* CUPS_DATADIR environment variable */
+  const char	*ptr;			/* Pointer into string list */
   int		num_options;		/* Number of options */
   cups_option_t	*options;		/* Options */
   cups_array_t	*requested,		/* requested-attributes values */
@@ -1076,116 +1374,11 @@ list_ppds(int        request_id,	/* I - Request ID */
           "opt=\"%s\"\n", request_id, limit, opt);
 
  /*
-  * See if we a PPD database file...
-  */
-
-  filename[0] = '\0';
-  load_ppds_dat(filename, sizeof(filename), 1);
-
- /*
-  * Load all PPDs in the specified directory and below...
-  */
-
-  if ((cups_datadir = getenv("CUPS_DATADIR")) == NULL)
-    cups_datadir = CUPS_DATADIR;
-
-  Inodes = cupsArrayNew((cups_array_func_t)compare_inodes, NULL);
-
-  snprintf(model, sizeof(model), "%s/model", cups_datadir);
-  load_ppds(model, "", 1);
-
-  snprintf(model, sizeof(model), "%s/drv", cups_datadir);
-  load_ppds(model, "", 1);
-
-#ifdef __APPLE__
- /*
-  * Load PPDs from standard OS X locations...
-  */
-
-  load_ppds("/Library/Printers",
-            "Library/Printers", 0);
-  load_ppds("/Library/Printers/PPDs/Contents/Resources",
-            "Library/Printers/PPDs/Contents/Resources", 0);
-  load_ppds("/Library/Printers/PPDs/Contents/Resources/en.lproj",
-            "Library/Printers/PPDs/Contents/Resources/en.lproj", 0);
-  load_ppds("/System/Library/Printers",
-            "System/Library/Printers", 0);
-  load_ppds("/System/Library/Printers/PPDs/Contents/Resources",
-            "System/Library/Printers/PPDs/Contents/Resources", 0);
-  load_ppds("/System/Library/Printers/PPDs/Contents/Resources/en.lproj",
-            "System/Library/Printers/PPDs/Contents/Resources/en.lproj", 0);
-
-#elif defined(__linux)
- /*
-  * Load PPDs from LSB-defined locations...
-  */
-
-  if (!access("/usr/local/share/ppd", 0))
-    load_ppds("/usr/local/share/ppd", "lsb/local", 1);
-  if (!access("/usr/share/ppd", 0))
-    load_ppds("/usr/share/ppd", "lsb/usr", 1);
-  if (!access("/opt/share/ppd", 0))
-    load_ppds("/opt/share/ppd", "lsb/opt", 1);
-#endif /* __APPLE__ */
-
- /*
-  * Cull PPD files that are no longer present...
-  */
-
-  for (ppd = (ppd_info_t *)cupsArrayFirst(PPDsByName);
-       ppd;
-       ppd = (ppd_info_t *)cupsArrayNext(PPDsByName))
-    if (!ppd->found)
-    {
-     /*
-      * Remove this PPD file from the list...
-      */
-
-      cupsArrayRemove(PPDsByName, ppd);
-      cupsArrayRemove(PPDsByMakeModel, ppd);
-      free(ppd);
-
-      ChangedPPD = 1;
-    }
-
- /*
-  * Write the new ppds.dat file...
+  * Update the PPD database as needed...
   */
 
-  fprintf(stderr, "DEBUG: [cups-driverd] ChangedPPD=%d\n", ChangedPPD);
-
-  if (ChangedPPD)
-  {
-    char	newname[1024];		/* New filename */
-
-    snprintf(newname, sizeof(newname), "%s.%d", filename, (int)getpid());
-
-    if ((fp = cupsFileOpen(newname, "w")) != NULL)
-    {
-      unsigned ppdsync = PPD_SYNC;	/* Sync word */
-
-      cupsFileWrite(fp, (char *)&ppdsync, sizeof(ppdsync));
-
-      for (ppd = (ppd_info_t *)cupsArrayFirst(PPDsByName);
-	   ppd;
-	   ppd = (ppd_info_t *)cupsArrayNext(PPDsByName))
-	cupsFileWrite(fp, (char *)&(ppd->record), sizeof(ppd_rec_t));
-
-      cupsFileClose(fp);
-
-      if (rename(newname, filename))
-	fprintf(stderr, "ERROR: [cups-driverd] Unable to rename \"%s\" - %s\n",
-		newname, strerror(errno));
-      else
-	fprintf(stderr, "INFO: [cups-driverd] Wrote \"%s\", %d PPDs...\n",
-		filename, cupsArrayCount(PPDsByName));
-    }
-    else
-      fprintf(stderr, "ERROR: [cups-driverd] Unable to write \"%s\" - %s\n",
-              filename, strerror(errno));
-  }
-  else
-    fputs("INFO: [cups-driverd] No new or changed PPDs...\n", stderr);
+  if (UpdatePPDs)
+    update_ppds();
 
  /*
   * Scan for dynamic PPD files...
@@ -1341,8 +1534,8 @@ list_ppds(int        request_id,	/* I - Request ID */
 	  ppd->record.type >= PPD_TYPE_DRV)
 	continue;
 
-      if (cupsArrayFind(exclude, ppd->record.scheme) ||
-          (include && !cupsArrayFind(include, ppd->record.scheme)))
+      if (cupsArrayFind(exclude, (void *)ppd->record.scheme) ||
+          (include && !cupsArrayFind(include, (void *)ppd->record.scheme)))
         continue;
 
       ppd->matches = 0;
@@ -1364,10 +1557,8 @@ list_ppds(int        request_id,	/* I - Request ID */
 
       if (language)
       {
-	for (i = 0; i < PPD_MAX_LANG; i ++)
-	  if (!ppd->record.languages[i][0])
-	    break;
-	  else if (!strcmp(ppd->record.languages[i], language))
+	for (ptr = ppd->record.languages; *ptr; ptr += strlen(ptr) + 1)
+	  if (!strcmp(ptr, language))
 	  {
 	    ppd->matches ++;
 	    break;
@@ -1399,16 +1590,13 @@ list_ppds(int        request_id,	/* I - Request ID */
 
       if (product)
       {
-	for (i = 0; i < PPD_MAX_PROD; i ++)
-	  if (!ppd->record.products[i][0])
-	    break;
-	  else if (!_cups_strcasecmp(ppd->record.products[i], product))
+	for (ptr = ppd->record.products; *ptr; ptr += strlen(ptr) + 1)
+	  if (!_cups_strcasecmp(ptr, product))
 	  {
 	    ppd->matches += 3;
 	    break;
 	  }
-	  else if (!_cups_strncasecmp(ppd->record.products[i], product,
-	                              product_len))
+	  else if (!_cups_strncasecmp(ptr, product, product_len))
 	  {
 	    ppd->matches += 2;
 	    break;
@@ -1417,10 +1605,8 @@ list_ppds(int        request_id,	/* I - Request ID */
 
       if (psversion)
       {
-	for (i = 0; i < PPD_MAX_VERS; i ++)
-	  if (!ppd->record.psversions[i][0])
-	    break;
-	  else if (!_cups_strcasecmp(ppd->record.psversions[i], psversion))
+	for (ptr = ppd->record.psversions; *ptr; ptr += strlen(ptr) + 1)
+	  if (!_cups_strcasecmp(ptr, psversion))
 	  {
 	    ppd->matches ++;
 	    break;
@@ -1454,8 +1640,8 @@ list_ppds(int        request_id,	/* I - Request ID */
 	  ppd->record.type >= PPD_TYPE_DRV)
 	continue;
 
-      if (cupsArrayFind(exclude, ppd->record.scheme) ||
-          (include && !cupsArrayFind(include, ppd->record.scheme)))
+      if (cupsArrayFind(exclude, (void *)ppd->record.scheme) ||
+          (include && !cupsArrayFind(include, (void *)ppd->record.scheme)))
         continue;
 
       cupsArrayAdd(matches, ppd);
@@ -1509,10 +1695,12 @@ list_ppds(int        request_id,	/* I - Request ID */
       if (send_natural_language)
       {
 	cupsdSendIPPString(IPP_TAG_LANGUAGE, "ppd-natural-language",
-			   ppd->record.languages[0]);
+			   ppd->record.languages);
 
-	for (i = 1; i < PPD_MAX_LANG && ppd->record.languages[i][0]; i ++)
-	  cupsdSendIPPString(IPP_TAG_LANGUAGE, "", ppd->record.languages[i]);
+	for (ptr = ppd->record.languages + strlen(ppd->record.languages) + 1;
+	     *ptr;
+	     ptr += strlen(ptr) + 1)
+	  cupsdSendIPPString(IPP_TAG_LANGUAGE, "", ptr);
       }
 
       if (send_make)
@@ -1529,19 +1717,23 @@ list_ppds(int        request_id,	/* I - Request ID */
       if (send_product)
       {
 	cupsdSendIPPString(IPP_TAG_TEXT, "ppd-product",
-			   ppd->record.products[0]);
+			   ppd->record.products);
 
-	for (i = 1; i < PPD_MAX_PROD && ppd->record.products[i][0]; i ++)
-	  cupsdSendIPPString(IPP_TAG_TEXT, "", ppd->record.products[i]);
+	for (ptr = ppd->record.products + strlen(ppd->record.products) + 1;
+	     *ptr;
+	     ptr += strlen(ptr) + 1)
+	  cupsdSendIPPString(IPP_TAG_TEXT, "", ptr);
       }
 
       if (send_psversion)
       {
 	cupsdSendIPPString(IPP_TAG_TEXT, "ppd-psversion",
-			   ppd->record.psversions[0]);
+			   ppd->record.psversions);
 
-	for (i = 1; i < PPD_MAX_VERS && ppd->record.psversions[i][0]; i ++)
-	  cupsdSendIPPString(IPP_TAG_TEXT, "", ppd->record.psversions[i]);
+	for (ptr = ppd->record.psversions + strlen(ppd->record.psversions) + 1;
+	     *ptr;
+	     ptr += strlen(ptr) + 1)
+	  cupsdSendIPPString(IPP_TAG_TEXT, "", ptr);
       }
 
       if (send_type)
@@ -1702,8 +1894,10 @@ load_drv(const char  *filename,		/* I - Actual filename */
 		        ps_version ? ps_version->value->value : "(3010) 0",
 		        mtime, size, d->model_number, type, "drv");
 	else if (products_found < PPD_MAX_PROD)
-	  strlcpy(ppd->record.products[products_found], product->value->value,
-	          sizeof(ppd->record.products[0]));
+	{
+	  if (ppd)
+	    add_list(&ppd->record.products, product->value->value);
+	}
 	else
 	  break;
 
@@ -1939,8 +2133,7 @@ load_drivers(cups_array_t *include,	/* I - Drivers to include */
 	      else
 	        ptr = start + strlen(start);
 
-              strlcpy(ppd->record.languages[i], start,
-	              sizeof(ppd->record.languages[0]));
+              add_list(&ppd->record.languages, start);
 
 	      start = ptr;
 	    }
@@ -1997,7 +2190,6 @@ load_ppd(const char  *filename,		/* I - Real filename */
   cups_array_t	*products,		/* Product array */
 		*psversions,		/* PSVersion array */
 		*cups_languages;	/* cupsLanguages array */
-  int		new_ppd;		/* Is this a new PPD? */
   struct				/* LanguageVersion translation table */
   {
     const char	*version,		/* LanguageVersion string */
@@ -2297,54 +2489,34 @@ load_ppd(const char  *filename,		/* I - Real filename */
   * Record the PPD file...
   */
 
-  new_ppd = !ppd;
-
-  if (new_ppd)
+  if (ppd)
   {
    /*
-    * Add new PPD file...
+    * Replace existing record; the make and model may have changed, so
+    * remove it from the arrays and add it again...
     */
 
-    fprintf(stderr, "DEBUG2: [cups-driverd] Adding ppd \"%s\"...\n", name);
-
-    ppd = add_ppd(name, name, lang_version, manufacturer, make_model,
-		  device_id, (char *)cupsArrayFirst(products),
-		  (char *)cupsArrayFirst(psversions),
-		  fileinfo->st_mtime, fileinfo->st_size,
-		  model_number, type, scheme);
+    fprintf(stderr, "DEBUG2: [cups-driverd] Updating ppd \"%s\"...\n", name);
 
-    if (!ppd)
-      return;
+    cupsArrayRemove(PPDsByName, ppd);
+    cupsArrayRemove(PPDsByMakeModel, ppd);
+    free_ppd(ppd);
   }
   else
-  {
-   /*
-    * Update existing record...
-    */
+    fprintf(stderr, "DEBUG2: [cups-driverd] Adding ppd \"%s\"...\n", name);
 
-    fprintf(stderr, "DEBUG2: [cups-driverd] Updating ppd \"%s\"...\n", name);
+  ppd = add_ppd(name, name, lang_version, manufacturer, make_model,
+		device_id, (char *)cupsArrayFirst(products),
+		(char *)cupsArrayFirst(psversions),
+		fileinfo->st_mtime, fileinfo->st_size,
+		model_number, type, scheme);
 
-    memset(ppd, 0, sizeof(ppd_info_t));
-
-    ppd->found               = 1;
-    ppd->record.mtime        = fileinfo->st_mtime;
-    ppd->record.size         = fileinfo->st_size;
-    ppd->record.model_number = model_number;
-    ppd->record.type         = type;
-
-    strlcpy(ppd->record.filename, name, sizeof(ppd->record.filename));
-    strlcpy(ppd->record.name, name, sizeof(ppd->record.name));
-    strlcpy(ppd->record.languages[0], lang_version,
-	    sizeof(ppd->record.languages[0]));
-    strlcpy(ppd->record.products[0], (char *)cupsArrayFirst(products),
-	    sizeof(ppd->record.products[0]));
-    strlcpy(ppd->record.psversions[0], (char *)cupsArrayFirst(psversions),
-	    sizeof(ppd->record.psversions[0]));
-    strlcpy(ppd->record.make, manufacturer, sizeof(ppd->record.make));
-    strlcpy(ppd->record.make_and_model, make_model,
-	    sizeof(ppd->record.make_and_model));
-    strlcpy(ppd->record.device_id, device_id, sizeof(ppd->record.device_id));
-    strlcpy(ppd->record.scheme, scheme, sizeof(ppd->record.scheme));
+  if (!ppd)
+  {
+    free_array(cups_languages);
+    free_array(products);
+    free_array(psversions);
+    return;
   }
 
  /*
@@ -2354,20 +2526,17 @@ load_ppd(const char  *filename,		/* I - Real filename */
   for (i = 1;
        i < PPD_MAX_PROD && (ptr = (char *)cupsArrayNext(products)) != NULL;
        i ++)
-    strlcpy(ppd->record.products[i], ptr,
-	    sizeof(ppd->record.products[0]));
+    add_list(&ppd->record.products, ptr);
 
   for (i = 1;
        i < PPD_MAX_VERS && (ptr = (char *)cupsArrayNext(psversions)) != NULL;
        i ++)
-    strlcpy(ppd->record.psversions[i], ptr,
-	    sizeof(ppd->record.psversions[0]));
+    add_list(&ppd->record.psversions, ptr);
 
   for (i = 1, ptr = (char *)cupsArrayFirst(cups_languages);
        i < PPD_MAX_LANG && ptr;
        i ++, ptr = (char *)cupsArrayNext(cups_languages))
-    strlcpy(ppd->record.languages[i], ptr,
-	    sizeof(ppd->record.languages[0]));
+    add_list(&ppd->record.languages, ptr);
 
  /*
   * Free products, versions, and languages...
@@ -2412,6 +2581,8 @@ load_ppds(const char *d,		/* I - Actual directory */
     if (errno != ENOENT)
       fprintf(stderr, "ERROR: [cups-driverd] Unable to stat \"%s\": %s\n", d,
 	      strerror(errno));
+    else
+      watch_parent(d);
 
     return (0);
   }
@@ -2448,6 +2619,17 @@ load_ppds(const char *d,		/* I - Actual directory */
     return (0);
   }
 
+#ifdef HAVE_SYS_INOTIFY_H
+  if (WatchFD >= 0 && inotify_add_watch(WatchFD, d, PPD_WATCH_EVENTS) < 0)
+  {
+    fprintf(stderr,
+            "WARNING: [cups-driverd] Unable to watch \"%s\": %s\n", d,
+	    strerror(errno));
+    close(WatchFD);
+    WatchFD = -1;
+  }
+#endif /* HAVE_SYS_INOTIFY_H */
+
   fprintf(stderr, "DEBUG: [cups-driverd] Loading \"%s\"...\n", d);
 
   while ((dent = cupsDirRead(dir)) != NULL)
@@ -2519,8 +2701,8 @@ load_ppds(const char *d,		/* I - Actual directory */
     * See if this file has been scanned before...
     */
 
-    strlcpy(key.record.filename, name, sizeof(key.record.filename));
-    strlcpy(key.record.name, name, sizeof(key.record.name));
+    key.record.filename = name;
+    key.record.name     = name;
 
     ppd = (ppd_info_t *)cupsArrayFind(PPDsByName, &key);
 
@@ -2607,10 +2789,20 @@ load_ppds_dat(char   *filename,		/* I - Filename buffer */
               size_t filesize,		/* I - Size of filename buffer */
               int    verbose)		/* I - Be verbose? */
 {
-  ppd_info_t	*ppd;			/* Current PPD file */
-  cups_file_t	*fp;			/* ppds.dat file */
+  unsigned	i,			/* Looping var */
+		num_ppds;		/* Number of PPDs */
+  int		fd;			/* ppds.dat file */
   struct stat	fileinfo;		/* ppds.dat information */
   const char	*cups_cachedir;		/* CUPS_CACHEDIR environment variable */
+  char		*map;			/* Mapped ppds.dat file */
+  size_t	length,			/* Length of file */
+		slength;		/* Length of string table */
+  const ppd_dat_t *header;		/* ppds.dat header */
+  const ppd_drec_t *drec;		/* Current ppds.dat record */
+  const unsigned *make_models;		/* Make and model index */
+  const char	*strings;		/* String table */
+  ppd_info_t	*ppds,			/* PPD records */
+		*ppd;			/* Current PPD */
 
 
   PPDsByName      = cupsArrayNew((cups_array_func_t)compare_names, NULL);
@@ -2625,56 +2817,129 @@ load_ppds_dat(char   *filename,		/* I - Filename buffer */
     snprintf(filename, filesize, "%s/ppds.dat", cups_cachedir);
   }
 
-  if ((fp = cupsFileOpen(filename, "r")) != NULL)
-  {
-   /*
-    * See if we have the right sync word...
-    */
+ /*
+  * Map the file into memory...
+  */
 
-    unsigned ppdsync;			/* Sync word */
-    int      num_ppds;			/* Number of PPDs */
+  if ((fd = open(filename, O_RDONLY)) < 0)
+    return;
 
-    if (cupsFileRead(fp, (char *)&ppdsync, sizeof(ppdsync))
-            == sizeof(ppdsync) &&
-        ppdsync == PPD_SYNC &&
-        !stat(filename, &fileinfo) &&
-	((fileinfo.st_size - sizeof(ppdsync)) % sizeof(ppd_rec_t)) == 0 &&
-	(num_ppds = (fileinfo.st_size - sizeof(ppdsync)) /
-	            sizeof(ppd_rec_t)) > 0)
-    {
-     /*
-      * We have a ppds.dat file, so read it!
-      */
+  if (fstat(fd, &fileinfo) || fileinfo.st_size < (off_t)sizeof(ppd_dat_t) ||
+      fileinfo.st_size > 0x7fffffff)
+  {
+    close(fd);
+    return;
+  }
 
-      for (; num_ppds > 0; num_ppds --)
-      {
-	if ((ppd = (ppd_info_t *)calloc(1, sizeof(ppd_info_t))) == NULL)
-	{
-	  if (verbose)
-	    fputs("ERROR: [cups-driverd] Unable to allocate memory for PPD!\n",
-		  stderr);
-	  exit(1);
-	}
+  length = (size_t)fileinfo.st_size;
+  map    = (char *)mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
 
-	if (cupsFileRead(fp, (char *)&(ppd->record), sizeof(ppd_rec_t)) > 0)
-	{
-	  cupsArrayAdd(PPDsByName, ppd);
-	  cupsArrayAdd(PPDsByMakeModel, ppd);
-	}
-	else
-	{
-	  free(ppd);
-	  break;
-	}
-      }
+  close(fd);
+
+  if (map == MAP_FAILED)
+  {
+    if (verbose)
+      fprintf(stderr, "ERROR: [cups-driverd] Unable to map \"%s\" - %s\n",
+              filename, strerror(errno));
+    return;
+  }
+
+ /*
+  * See if we have the right sync word and layout...
+  */
+
+  header   = (const ppd_dat_t *)map;
+  num_ppds = header->num_ppds;
+
+  if (header->sync != PPD_SYNC || header->length != length ||
+      num_ppds > length / sizeof(ppd_drec_t) ||
+      header->records != sizeof(ppd_dat_t) ||
+      header->make_models != header->records + num_ppds * sizeof(ppd_drec_t) ||
+      header->strings != header->make_models + num_ppds * sizeof(unsigned) ||
+      header->strings > length - 2 || map[length - 2] || map[length - 1])
+  {
+    munmap(map, length);
+    return;
+  }
+
+  drec        = (const ppd_drec_t *)(map + header->records);
+  make_models = (const unsigned *)(map + header->make_models);
+  strings     = map + header->strings;
+  slength     = length - header->strings;
 
+ /*
+  * Point the PPD records at the mapped strings - the string table ends with
+  * two nul bytes, so every string and list offset within it is safe to
+  * use...
+  */
+
+  if (num_ppds == 0 ||
+      (ppds = (ppd_info_t *)calloc(num_ppds, sizeof(ppd_info_t))) == NULL)
+  {
+    munmap(map, length);
+    return;
+  }
+
+  for (i = 0, ppd = ppds; i < num_ppds; i ++, ppd ++, drec ++)
+  {
+    if (drec->filename >= slength || drec->name >= slength ||
+        drec->languages >= slength || drec->products >= slength ||
+	drec->psversions >= slength || drec->make >= slength ||
+	drec->make_and_model >= slength || drec->device_id >= slength ||
+	drec->scheme >= slength)
+    {
       if (verbose)
-	fprintf(stderr, "INFO: [cups-driverd] Read \"%s\", %d PPDs...\n",
-		filename, cupsArrayCount(PPDsByName));
+	fprintf(stderr, "ERROR: [cups-driverd] Bad record %u in \"%s\"!\n", i,
+	        filename);
+
+      free(ppds);
+      munmap(map, length);
+      return;
     }
 
-    cupsFileClose(fp);
+    ppd->mapped                = 1;
+    ppd->record.mtime          = drec->mtime;
+    ppd->record.size           = drec->size;
+    ppd->record.model_number   = drec->model_number;
+    ppd->record.type           = drec->type;
+    ppd->record.filename       = strings + drec->filename;
+    ppd->record.name           = strings + drec->name;
+    ppd->record.languages      = strings + drec->languages;
+    ppd->record.products       = strings + drec->products;
+    ppd->record.psversions     = strings + drec->psversions;
+    ppd->record.make           = strings + drec->make;
+    ppd->record.make_and_model = strings + drec->make_and_model;
+    ppd->record.device_id      = strings + drec->device_id;
+    ppd->record.scheme         = strings + drec->scheme;
   }
+
+ /*
+  * The records are stored in name order and the index lists them in make and
+  * model order, so both arrays are built by appending.  The "matches" value
+  * is used to catch index entries that are duplicated or missing...
+  */
+
+  for (i = 0, ppd = ppds; i < num_ppds; i ++, ppd ++)
+    cupsArrayAdd(PPDsByName, ppd);
+
+  for (i = 0; i < num_ppds; i ++)
+    if (make_models[i] < num_ppds && !ppds[make_models[i]].matches)
+    {
+      ppds[make_models[i]].matches = 1;
+      cupsArrayAdd(PPDsByMakeModel, ppds + make_models[i]);
+    }
+
+  for (i = 0, ppd = ppds; i < num_ppds; i ++, ppd ++)
+  {
+    if (!ppd->matches)
+      cupsArrayAdd(PPDsByMakeModel, ppd);
+
+    ppd->matches = 0;
+  }
+
+  if (verbose)
+    fprintf(stderr, "INFO: [cups-driverd] Read \"%s\", %d PPDs...\n",
+	    filename, cupsArrayCount(PPDsByName));
 }
 
 
@@ -2731,6 +2996,29 @@ load_tar(const char  *filename,		/* I - Actual filename */
 }
 
 
+/*
+ * 'new_list()' - Create a PPD string list.
+ */
+
+static char *				/* O - New list or NULL */
+new_list(const char *value)		/* I - First value */
+{
+  size_t	length;			/* Length of value */
+  char		*list;			/* New list */
+
+
+  length = strlen(value) + 1;
+
+  if ((list = (char *)malloc(length + 1)) != NULL)
+  {
+    memcpy(list, value, length);
+    list[length] = '\0';
+  }
+
+  return (list);
+}
+
+
 /*
  * 'read_tar()' - Read a file header from an archive.
  *
@@ -2946,6 +3234,525 @@ regex_string(const char *s)		/* I - String to compare */
 }
 
 
+/*
+ * 'run_request()' - Run a single request.
+ */
+
+static int				/* O - Exit code */
+run_request(int  argc,			/* I - Number of arguments */
+            char *argv[])		/* I - Arguments */
+{
+ /*
+  * Install or list PPDs...
+  */
+
+  if (argc == 3 && !strcmp(argv[1], "cat"))
+    return (cat_ppd(argv[2], 0));
+  else if ((argc == 2 || argc == 3) && !strcmp(argv[1], "dump"))
+    return (dump_ppds_dat(argv[2]));
+  else if (argc == 4 && !strcmp(argv[1], "get"))
+    return (cat_ppd(argv[3], atoi(argv[2])));
+  else if (argc == 5 && !strcmp(argv[1], "list"))
+    return (list_ppds(atoi(argv[2]), atoi(argv[3]), argv[4]));
+  else
+  {
+    fputs("Usage: cups-driverd cat ppd-name\n", stderr);
+    fputs("Usage: cups-driverd daemon\n", stderr);
+    fputs("Usage: cups-driverd dump\n", stderr);
+    fputs("Usage: cups-driverd get request_id ppd-name\n", stderr);
+    fputs("Usage: cups-driverd list request_id limit options\n", stderr);
+    return (1);
+  }
+}
+
+
+/*
+ * 'serve_ppds()' - Handle requests from the scheduler.
+ *
+ * The scheduler keeps us running and sends its requests over the socket on
+ * the standard input.  The PPD database stays in memory and is only updated
+ * when the PPD directories change.  Each request is run by a child process
+ * so that a slow client or a driver program cannot hold up the others.
+ */
+
+static int				/* O - Exit code */
+serve_ppds(void)
+{
+  int		argc,			/* Number of arguments */
+		fd;			/* Response file descriptor */
+  char		**argv;			/* Request arguments */
+  pid_t		pid;			/* Child process ID */
+#ifdef HAVE_SYS_INOTIFY_H
+  char		events[4096];		/* inotify events */
+#endif /* HAVE_SYS_INOTIFY_H */
+
+
+ /*
+  * Let the system reap our child processes...
+  */
+
+  signal(SIGCHLD, SIG_IGN);
+  signal(SIGPIPE, SIG_IGN);
+
+#ifdef HAVE_SYS_INOTIFY_H
+ /*
+  * Watch the PPD directories for changes; without inotify we check them
+  * on every request...
+  */
+
+  if ((WatchFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+    fprintf(stderr,
+            "WARNING: [cups-driverd] Unable to watch PPD directories: %s\n",
+	    strerror(errno));
+#endif /* HAVE_SYS_INOTIFY_H */
+
+  while ((argv = get_request(&argc, &fd)) != NULL)
+  {
+#ifdef HAVE_SYS_INOTIFY_H
+    while (WatchFD >= 0 && read(WatchFD, events, sizeof(events)) > 0)
+      UpdatePPDs = 1;
+#endif /* HAVE_SYS_INOTIFY_H */
+
+    if (WatchFD < 0)
+      UpdatePPDs = 1;
+
+    if (argc == 5 && !strcmp(argv[1], "list") && UpdatePPDs)
+      update_ppds();
+
+    if ((pid = fork()) == 0)
+    {
+     /*
+      * Child comes here; send the response to the scheduler's pipe...
+      */
+
+      signal(SIGCHLD, SIG_DFL);
+      signal(SIGPIPE, SIG_DFL);
+
+      dup2(fd, 1);
+      close(fd);
+
+      close(0);
+      open("/dev/null", O_RDONLY);
+
+      exit(run_request(argc, argv));
+    }
+    else if (pid < 0)
+      fprintf(stderr, "ERROR: [cups-driverd] Unable to fork: %s\n",
+              strerror(errno));
+
+    close(fd);
+    free(argv[0]);
+    free(argv);
+  }
+
+  return (0);
+}
+
+
+/*
+ * 'update_ppds()' - Update the PPD database from the PPD directories.
+ */
+
+static void
+update_ppds(void)
+{
+  ppd_info_t	*ppd;			/* Current PPD file */
+  char		model[1024];		/* Model directory */
+  const char	*cups_datadir;		/* CUPS_DATADIR environment variable */
+  static char	filename[1024] = "";	/* ppds.dat filename */
+
+
+ /*
+  * See if we a PPD database file, or check the PPDs we already have...
+  */
+
+  if (!PPDsByName)
+    load_ppds_dat(filename, sizeof(filename), 1);
+  else
+  {
+    for (ppd = (ppd_info_t *)cupsArrayFirst(PPDsByName);
+         ppd;
+	 ppd = (ppd_info_t *)cupsArrayNext(PPDsByName))
+      ppd->found = 0;
+  }
+
+ /*
+  * Load all PPDs in the specified directory and below...
+  */
+
+  if ((cups_datadir = getenv("CUPS_DATADIR")) == NULL)
+    cups_datadir = CUPS_DATADIR;
+
+  free_array(Inodes);
+
+  Inodes = cupsArrayNew((cups_array_func_t)compare_inodes, NULL);
+
+  snprintf(model, sizeof(model), "%s/model", cups_datadir);
+  load_ppds(model, "", 1);
+
+  snprintf(model, sizeof(model), "%s/drv", cups_datadir);
+  load_ppds(model, "", 1);
+
+#ifdef __APPLE__
+ /*
+  * Load PPDs from standard OS X locations...
+  */
+
+  load_ppds("/Library/Printers",
+            "Library/Printers", 0);
+  load_ppds("/Library/Printers/PPDs/Contents/Resources",
+            "Library/Printers/PPDs/Contents/Resources", 0);
+  load_ppds("/Library/Printers/PPDs/Contents/Resources/en.lproj",
+            "Library/Printers/PPDs/Contents/Resources/en.lproj", 0);
+  load_ppds("/System/Library/Printers",
+            "System/Library/Printers", 0);
+  load_ppds("/System/Library/Printers/PPDs/Contents/Resources",
+            "System/Library/Printers/PPDs/Contents/Resources", 0);
+  load_ppds("/System/Library/Printers/PPDs/Contents/Resources/en.lproj",
+            "System/Library/Printers/PPDs/Contents/Resources/en.lproj", 0);
+
+#elif defined(__linux)
+ /*
+  * Load PPDs from LSB-defined locations...
+  */
+
+  load_ppds("/usr/local/share/ppd", "lsb/local", 1);
+  load_ppds("/usr/share/ppd", "lsb/usr", 1);
+  load_ppds("/opt/share/ppd", "lsb/opt", 1);
+#endif /* __APPLE__ */
+
+ /*
+  * Cull PPD files that are no longer present...
+  */
+
+  for (ppd = (ppd_info_t *)cupsArrayFirst(PPDsByName);
+       ppd;
+       ppd = (ppd_info_t *)cupsArrayNext(PPDsByName))
+    if (!ppd->found)
+      break;
+
+  if (ppd)
+  {
+   /*
+    * Rebuild both arrays without the missing PPD files - a changed driver
+    * information file produces new records that compare equal to the old
+    * ones, so cupsArrayRemove() could remove the wrong record...
+    */
+
+    cups_array_t	*names,		/* New PPDsByName array */
+			*make_models;	/* New PPDsByMakeModel array */
+
+    names       = cupsArrayNew((cups_array_func_t)compare_names, NULL);
+    make_models = cupsArrayNew((cups_array_func_t)compare_ppds, NULL);
+
+    for (ppd = (ppd_info_t *)cupsArrayFirst(PPDsByMakeModel);
+	 ppd;
+	 ppd = (ppd_info_t *)cupsArrayNext(PPDsByMakeModel))
+      if (ppd->found)
+	cupsArrayAdd(make_models, ppd);
+
+    for (ppd = (ppd_info_t *)cupsArrayFirst(PPDsByName);
+	 ppd;
+	 ppd = (ppd_info_t *)cupsArrayNext(PPDsByName))
+      if (ppd->found)
+	cupsArrayAdd(names, ppd);
+      else
+	free_ppd(ppd);
+
+    cupsArrayDelete(PPDsByName);
+    cupsArrayDelete(PPDsByMakeModel);
+
+    PPDsByName      = names;
+    PPDsByMakeModel = make_models;
+    ChangedPPD      = 1;
+  }
+
+ /*
+  * Write the new ppds.dat file...
+  */
+
+  fprintf(stderr, "DEBUG: [cups-driverd] ChangedPPD=%d\n", ChangedPPD);
+
+  if (ChangedPPD)
+    write_ppds_dat(filename);
+  else
+    fputs("INFO: [cups-driverd] No new or changed PPDs...\n", stderr);
+
+  ChangedPPD = 0;
+  UpdatePPDs = 0;
+}
+
+
+/*
+ * 'watch_parent()' - Watch for a missing PPD directory to be created.
+ *
+ * The closest existing parent directory is watched so that a driver package
+ * that creates the directory later triggers a rescan.
+ */
+
+static void
+watch_parent(const char *d)		/* I - Missing directory */
+{
+#ifdef HAVE_SYS_INOTIFY_H
+  char	parent[1024],			/* Parent directory */
+	*ptr;				/* Pointer into parent */
+
+
+  if (WatchFD < 0)
+    return;
+
+  strlcpy(parent, d, sizeof(parent));
+
+  while ((ptr = strrchr(parent, '/')) != NULL)
+  {
+    if (ptr == parent)
+      ptr[1] = '\0';
+    else
+      *ptr = '\0';
+
+    if (inotify_add_watch(WatchFD, parent, IN_CREATE | IN_MOVED_TO |
+                                           IN_ONLYDIR | IN_MASK_ADD) >= 0)
+      return;
+
+    if (errno != ENOENT || ptr == parent)
+      break;
+  }
+
+  fprintf(stderr,
+          "WARNING: [cups-driverd] Unable to watch for \"%s\": %s\n", d,
+	  strerror(errno));
+  close(WatchFD);
+  WatchFD = -1;
+#else
+  (void)d;
+#endif /* HAVE_SYS_INOTIFY_H */
+}
+
+
+/*
+ * 'write_ppds_dat()' - Write the ppds.dat file.
+ */
+
+static void
+write_ppds_dat(const char *filename)	/* I - Filename */
+{
+  int		i;			/* Looping var */
+  int		num_ppds;		/* Number of PPDs */
+  ppd_info_t	*ppd;			/* Current PPD */
+  ppd_dat_t	header;			/* ppds.dat header */
+  ppd_drec_t	*drecs,			/* Records */
+		*drec;			/* Current record */
+  unsigned	*make_models;		/* Make and model index */
+  ppd_strings_t	strings;		/* String table */
+  cups_file_t	*fp;			/* ppds.dat file */
+  char		newname[1024];		/* New filename */
+  size_t	length;			/* Length of file */
+
+
+ /*
+  * Build the records, index, and string table in memory...
+  */
+
+  num_ppds = cupsArrayCount(PPDsByName);
+
+  memset(&strings, 0, sizeof(strings));
+
+  drecs               = (ppd_drec_t *)calloc((size_t)num_ppds + 1,
+                                             sizeof(ppd_drec_t));
+  make_models         = (unsigned *)calloc((size_t)num_ppds + 1,
+                                           sizeof(unsigned));
+  strings.strings     = (ppd_string_t *)calloc((size_t)num_ppds * 9 + 1,
+                                               sizeof(ppd_string_t));
+  strings.pool        = cupsArrayNew((cups_array_func_t)compare_strings, NULL);
+
+  if (!drecs || !make_models || !strings.strings || !strings.pool)
+  {
+    fputs("ERROR: [cups-driverd] Unable to allocate memory for ppds.dat!\n",
+          stderr);
+    goto cleanup;
+  }
+
+  write_string(&strings, "", 1);
+
+  for (ppd = (ppd_info_t *)cupsArrayFirst(PPDsByName), drec = drecs;
+       ppd;
+       ppd = (ppd_info_t *)cupsArrayNext(PPDsByName), drec ++)
+  {
+    drec->mtime          = ppd->record.mtime;
+    drec->size           = ppd->record.size;
+    drec->model_number   = ppd->record.model_number;
+    drec->type           = ppd->record.type;
+    drec->filename       = write_string(&strings, ppd->record.filename,
+                                        strlen(ppd->record.filename) + 1);
+    drec->name           = write_string(&strings, ppd->record.name,
+                                        strlen(ppd->record.name) + 1);
+    drec->languages      = write_string(&strings, ppd->record.languages,
+                                        list_length(ppd->record.languages));
+    drec->products       = write_string(&strings, ppd->record.products,
+                                        list_length(ppd->record.products));
+    drec->psversions     = write_string(&strings, ppd->record.psversions,
+                                        list_length(ppd->record.psversions));
+    drec->make           = write_string(&strings, ppd->record.make,
+                                        strlen(ppd->record.make) + 1);
+    drec->make_and_model = write_string(&strings, ppd->record.make_and_model,
+                                        strlen(ppd->record.make_and_model) + 1);
+    drec->device_id      = write_string(&strings, ppd->record.device_id,
+                                        strlen(ppd->record.device_id) + 1);
+    drec->scheme         = write_string(&strings, ppd->record.scheme,
+                                        strlen(ppd->record.scheme) + 1);
+  }
+
+ /*
+  * End the string table with a second nul byte so that the reader can use
+  * any offset into it...
+  */
+
+  write_string(&strings, NULL, 1);
+
+  if (!strings.data)
+  {
+    fputs("ERROR: [cups-driverd] Unable to allocate memory for ppds.dat!\n",
+          stderr);
+    goto cleanup;
+  }
+
+  for (ppd = (ppd_info_t *)cupsArrayFirst(PPDsByMakeModel), i = 0;
+       ppd && i < num_ppds;
+       ppd = (ppd_info_t *)cupsArrayNext(PPDsByMakeModel), i ++)
+  {
+    cupsArrayFind(PPDsByName, ppd);
+    make_models[i] = (unsigned)cupsArrayGetIndex(PPDsByName);
+  }
+
+  length = sizeof(header) + (size_t)num_ppds * sizeof(ppd_drec_t) +
+           (size_t)num_ppds * sizeof(unsigned) + strings.used;
+
+  if (length > 0x7fffffff)
+  {
+    fprintf(stderr, "ERROR: [cups-driverd] Too many PPDs (%d) for \"%s\"!\n",
+            num_ppds, filename);
+    goto cleanup;
+  }
+
+  header.sync        = PPD_SYNC;
+  header.length      = (unsigned)length;
+  header.num_ppds    = (unsigned)num_ppds;
+  header.records     = sizeof(header);
+  header.make_models = header.records + num_ppds * sizeof(ppd_drec_t);
+  header.strings     = header.make_models + num_ppds * sizeof(unsigned);
+
+ /*
+  * Write the new file and then rename it...
+  */
+
+  snprintf(newname, sizeof(newname), "%s.%d", filename, (int)getpid());
+
+  if ((fp = cupsFileOpen(newname, "w")) != NULL)
+  {
+    if (cupsFileWrite(fp, (char *)&header, sizeof(header)) < 0 ||
+        cupsFileWrite(fp, (char *)drecs,
+	              (size_t)num_ppds * sizeof(ppd_drec_t)) < 0 ||
+        cupsFileWrite(fp, (char *)make_models,
+	              (size_t)num_ppds * sizeof(unsigned)) < 0 ||
+        cupsFileWrite(fp, strings.data, strings.used) < 0 ||
+	cupsFileClose(fp))
+    {
+      fprintf(stderr, "ERROR: [cups-driverd] Unable to write \"%s\" - %s\n",
+	      newname, strerror(errno));
+      unlink(newname);
+    }
+    else if (rename(newname, filename))
+      fprintf(stderr, "ERROR: [cups-driverd] Unable to rename \"%s\" - %s\n",
+	      newname, strerror(errno));
+    else
+      fprintf(stderr, "INFO: [cups-driverd] Wrote \"%s\", %d PPDs...\n",
+	      filename, num_ppds);
+  }
+  else
+    fprintf(stderr, "ERROR: [cups-driverd] Unable to write \"%s\" - %s\n",
+	    filename, strerror(errno));
+
+  cleanup:
+
+  cupsArrayDelete(strings.pool);
+  free(strings.strings);
+  free(strings.data);
+  free(make_models);
+  free(drecs);
+}
+
+
+/*
+ * 'write_string()' - Add a string to the ppds.dat string table.
+ *
+ * Identical strings and lists are only stored once.  A NULL value adds
+ * "length" nul bytes without pooling them.
+ */
+
+static unsigned				/* O - Offset in string table */
+write_string(ppd_strings_t *sp,		/* I - String table */
+             const char    *value,	/* I - String or list */
+	     size_t        length)	/* I - Length including nul bytes */
+{
+  ppd_string_t	key,			/* Search key */
+		*match;			/* Matching string */
+  unsigned	offset;			/* Offset of string */
+
+
+  if (value)
+  {
+    key.value  = value;
+    key.length = length;
+
+    if ((match = (ppd_string_t *)cupsArrayFind(sp->pool, &key)) != NULL)
+      return (match->offset);
+  }
+
+  if (sp->used + length > sp->alloc)
+  {
+    size_t	alloc;			/* New allocation */
+    char	*data;			/* New string data */
+
+    for (alloc = sp->alloc ? sp->alloc : 65536;
+         alloc < sp->used + length;
+	 alloc *= 2);
+
+    if ((data = (char *)realloc(sp->data, alloc)) == NULL)
+    {
+      free(sp->data);
+      sp->data  = NULL;
+      sp->used  = 0;
+      sp->alloc = 0;
+
+      return (0);
+    }
+
+    sp->data  = data;
+    sp->alloc = alloc;
+  }
+
+  offset = (unsigned)sp->used;
+
+  if (value)
+  {
+    memcpy(sp->data + sp->used, value, length);
+
+    match         = sp->strings + sp->num_strings ++;
+    match->value  = value;
+    match->length = length;
+    match->offset = offset;
+
+    cupsArrayAdd(sp->pool, match);
+  }
+  else
+    memset(sp->data + sp->used, 0, length);
+
+  sp->used += length;
+
+  return (offset);
+}
+
+
 /*
  * End of "$Id$".
  */
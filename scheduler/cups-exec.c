@@ -13,11 +13,14 @@
  *
  * Usage:
  *
- *     cups-exec /path/to/profile /path/to/program argv0 argv1 ... argvN
+ *     cups-exec /path/to/profile UID GID NICE /path/to/program argv0 argv1
+ *               ... argvN
+ *     cups-exec -w
  *
  * Contents:
  *
- *   main() - Apply sandbox profile and execute program.
+ *   main()        - Apply sandbox profile and execute program.
+ *   get_request() - Get a request from the scheduler.
  */
 
 /*
@@ -26,6 +29,10 @@
 
 #include <cups/string-private.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
 #ifdef HAVE_SANDBOX_H
 #  include <sandbox.h>
 #  ifndef SANDBOX_NAMED_EXTERNAL
@@ -35,6 +42,20 @@
 #endif /* HAVE_SANDBOX_H */
 
 
+/*
+ * Globals...
+ */
+
+extern char	**environ;		/* Environment */
+
+
+/*
+ * Local functions...
+ */
+
+static char	**get_request(int *argc, char ***envp);
+
+
 /*
  * 'main()' - Apply sandbox profile and execute program.
  */
@@ -43,22 +64,70 @@ int					/* O - Exit status */
 main(int  argc,				/* I - Number of command-line args */
      char *argv[])			/* I - Command-line arguments */
 {
+  uid_t	uid;				/* UID */
+  gid_t	gid;				/* GID */
+  int	nice_value;			/* Nice value */
+  char	**envp;				/* Environment */
 #ifdef HAVE_SANDBOX_H
   char	*sandbox_error = NULL;		/* Sandbox error, if any */
 #endif /* HAVE_SANDBOX_H */
 
 
+ /*
+  * Worker processes started by cupsd get the arguments, environment, and
+  * file descriptors of the program to run from their standard input...
+  */
+
+  if (argc == 2 && !strcmp(argv[1], "-w"))
+  {
+    if ((argv = get_request(&argc, &envp)) == NULL)
+      return (1);
+  }
+  else
+    envp = environ;
+
  /*
   * Check that we have enough arguments...
   */
 
-  if (argc < 4)
+  if (argc < 7)
   {
-    puts("Usage: cups-exec /path/to/profile /path/to/program argv0 argv1 ... "
-         "argvN");
+    puts("Usage: cups-exec /path/to/profile UID GID NICE /path/to/program "
+         "argv0 argv1 ... argvN");
+    puts("       cups-exec -w");
     return (1);
   }
 
+ /*
+  * Change the priority, group, and user of the process as cupsd asked;
+  * the user and group are only changed when we are started as root...
+  */
+
+  uid        = (uid_t)atoi(argv[2]);
+  gid        = (gid_t)atoi(argv[3]);
+  nice_value = atoi(argv[4]);
+
+  if (nice_value)
+    nice(nice_value);
+
+  if (!getuid())
+  {
+    if (setgid(gid))
+      exit(errno + 100);
+
+    if (setgroups(1, &gid))
+      exit(errno + 100);
+
+    if (uid && setuid(uid))
+      exit(errno + 100);
+  }
+
+ /*
+  * Change umask to restrict permissions on created files...
+  */
+
+  umask(077);
+
 #ifdef HAVE_SANDBOX_H
  /*
   * Run in a separate security profile...
@@ -78,7 +147,7 @@ main(int  argc,				/* I - Number of command-line args */
   * Execute the program...
   */
 
-  execv(argv[2], argv + 3);
+  execve(argv[5], argv + 6, envp);
 
  /*
   * If we get here, execv() failed...
@@ -89,6 +158,152 @@ main(int  argc,				/* I - Number of command-line args */
 }
 
 
+/*
+ * 'get_request()' - Get a request from the scheduler.
+ *
+ * The request is a header with the length of the data that follows, a mask
+ * of the file descriptors that are passed, and the number of arguments and
+ * environment strings, followed by the nul-terminated strings themselves.
+ * The passed file descriptors replace the standard input (our request socket),
+ * output, and error, and the back and side channels.
+ */
+
+static char **				/* O - Arguments or NULL on error */
+get_request(int   *argc,		/* O - Number of arguments */
+            char  ***envp)		/* O - Environment */
+{
+  int			i, j,		/* Looping vars */
+			fd,		/* File descriptor */
+			header[4],	/* Request header */
+			fds[5],		/* File descriptors */
+			recvfds[5],	/* Received file descriptors */
+			numfds;		/* Number of received file descriptors */
+  ssize_t		bytes;		/* Bytes read */
+  size_t		total;		/* Total bytes read */
+  char			*data,		/* Request data */
+			*dataptr,	/* Pointer into request data */
+			*dataend,	/* End of request data */
+			**args;		/* Arguments and environment */
+  struct iovec		iov;		/* Request header */
+  struct msghdr		msg;		/* Request message */
+  struct cmsghdr	*cmsg;		/* Control message */
+  union
+  {
+    struct cmsghdr	hdr;		/* Alignment */
+    char		buf[CMSG_SPACE(sizeof(recvfds))];
+					/* Control message buffer */
+  }			control;	/* Control message */
+
+
+ /*
+  * Read the header and file descriptors; cupsd closes the socket without
+  * sending anything when it no longer needs us...
+  */
+
+  iov.iov_base = (void *)header;
+  iov.iov_len  = sizeof(header);
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  if (recvmsg(0, &msg, MSG_WAITALL) != (ssize_t)sizeof(header))
+    return (NULL);
+
+  if (header[0] <= 0 || header[0] > 65536 || header[2] < 6 || header[3] < 0 ||
+      header[2] + header[3] > header[0])
+    return (NULL);
+
+  numfds = 0;
+
+  if ((cmsg = CMSG_FIRSTHDR(&msg)) != NULL && cmsg->cmsg_level == SOL_SOCKET &&
+      cmsg->cmsg_type == SCM_RIGHTS)
+  {
+    numfds = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+    if (numfds > 5)
+      numfds = 5;
+
+    memcpy(recvfds, CMSG_DATA(cmsg), sizeof(int) * (size_t)numfds);
+  }
+
+ /*
+  * Move the file descriptors out of the way of the ones we replace...
+  */
+
+  for (i = 0, j = 0; i < 5; i ++)
+    if ((header[1] & (1 << i)) && j < numfds)
+    {
+      fds[i] = fcntl(recvfds[j], F_DUPFD, 10);
+      close(recvfds[j ++]);
+    }
+    else
+      fds[i] = -1;
+
+ /*
+  * Read the arguments and environment strings...
+  */
+
+  if ((data = malloc((size_t)header[0])) == NULL)
+    return (NULL);
+
+  for (total = 0; total < (size_t)header[0]; total += (size_t)bytes)
+    if ((bytes = read(0, data + total, (size_t)header[0] - total)) <= 0)
+      return (NULL);
+
+  if (data[header[0] - 1])
+    return (NULL);
+
+  if ((args = calloc((size_t)(header[2] + header[3] + 3),
+                     sizeof(char *))) == NULL)
+    return (NULL);
+
+  args[0] = "cups-exec";
+
+  for (i = 0, dataptr = data, dataend = data + header[0];
+       i < header[2] + header[3] && dataptr < dataend;
+       i ++, dataptr += strlen(dataptr) + 1)
+    args[i < header[2] ? i + 1 : i + 2] = dataptr;
+					/* Leave a NULL after the arguments */
+
+  if (i < header[2] + header[3] || dataptr < dataend)
+    return (NULL);
+
+  *argc = header[2] + 1;
+  *envp = header[3] ? args + header[2] + 2 : environ;
+
+ /*
+  * Replace our standard input, output, and error, and the back and side
+  * channels...
+  */
+
+  for (i = 0; i < 5; i ++)
+  {
+    if (fds[i] >= 0)
+    {
+      dup2(fds[i], i);
+      close(fds[i]);
+
+      if (i > 2)
+        fcntl(i, F_SETFL, O_NDELAY);
+    }
+    else if (i < 3)
+    {
+      if ((fd = open("/dev/null", i ? O_WRONLY : O_RDONLY)) != i && fd >= 0)
+      {
+        dup2(fd, i);
+        close(fd);
+      }
+    }
+    else
+      close(i);
+  }
+
+  return (args);
+}
+
+
 /*
  * End of "$Id$".
  */
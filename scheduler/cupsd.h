@@ -76,6 +76,8 @@ extern const char *cups_hstrerror(int);
 #define MAX_USERPASS		33	/* Maximum size of username/password */
 #define MAX_FILTERS		20	/* Maximum number of filters */
 #define MAX_SYSTEM_GROUPS	32	/* Maximum number of system groups */
+#define MAX_CONF_RECORDS	64	/* Maximum stale .conf records beyond *
+					 * one per object before rewriting    */
 
 
 /*
@@ -122,6 +124,7 @@ extern const char *cups_hstrerror(int);
 #include "dirsvc.h"
 #include "network.h"
 #include "subscriptions.h"
+#include "stats.h"
 
 
 /*
@@ -179,11 +182,17 @@ extern void		cupsdSetEnvf(const char *name, const char *value, ...)
 extern void		cupsdUpdateEnv(void);
 
 /* file.c */
+extern cups_file_t	*cupsdAppendConfFile(const char *filename);
 extern void		cupsdCleanFiles(const char *path, const char *pattern);
+extern int		cupsdCloseAppendedConfFile(cups_file_t *fp,
+			                           const char *filename);
 extern int		cupsdCloseCreatedConfFile(cups_file_t *fp,
 			                          const char *filename);
 extern void		cupsdClosePipe(int *fds);
 extern cups_file_t	*cupsdCreateConfFile(const char *filename, mode_t mode);
+extern cups_array_t	*cupsdFindConfRecords(cups_file_t *fp, int *stale);
+extern int		cupsdIsCurrentConfRecord(cups_array_t *records,
+			                         const char *name, int linenum);
 extern cups_file_t	*cupsdOpenConfFile(const char *filename);
 extern int		cupsdOpenPipe(int *fds);
 extern int		cupsdRemoveFile(const char *filename);
@@ -203,16 +212,21 @@ extern void		cupsdSetStringf(char **s, const char *f, ...)
 			__attribute__ ((__format__ (__printf__, 2, 3)));
 
 /* process.c */
+extern void		cupsdCheckWorkers(void);
 extern void		*cupsdCreateProfile(int job_id);
 extern void		cupsdDestroyProfile(void *profile);
 extern int		cupsdEndProcess(int pid, int force);
 extern const char	*cupsdFinishProcess(int pid, char *name, int namelen,
 					    int *job_id);
+extern time_t		cupsdGetDriverdTimeout(void);
+extern int		cupsdNeedWorkers(void);
+extern int		cupsdRunDriverd(char *argv[], int outfd);
 extern int		cupsdStartProcess(const char *command, char *argv[],
 					  char *envp[], int infd, int outfd,
 					  int errfd, int backfd, int sidefd,
 					  int root, void *profile,
 					  cupsd_job_t *job, int *pid);
+extern void		cupsdStopDriverd(void);
 
 /* select.c */
 extern int		cupsdAddSelect(int fd, cupsd_selfunc_t read_cb,
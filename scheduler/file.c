@@ -14,16 +14,24 @@
  *
  * Contents:
  *
+ *   cupsdAppendConfFile()	 - Open a configuration file for appending
+ *				   records.
  *   cupsdCleanFiles()		 - Clean out old files.
+ *   cupsdCloseAppendedConfFile() - Close a configuration file after appending
+ *				   records.
  *   cupsdCloseCreatedConfFile() - Close a created configuration file and move
  *				   into place.
  *   cupsdClosePipe()		 - Close a pipe as necessary.
  *   cupsdCreateConfFile()	 - Create a configuration file safely.
+ *   cupsdFindConfRecords()	 - Find the current records in a configuration
+ *				   file.
+ *   cupsdIsCurrentConfRecord()	 - Check whether a record is the current copy.
  *   cupsdOpenConfFile()	 - Open a configuration file.
  *   cupsdOpenPipe()		 - Create a pipe which is closed on exec.
  *   cupsdRemoveFile()		 - Remove a file securely.
  *   cupsdUnlinkOrRemoveFile()	 - Unlink or securely remove a file depending
  *				   on the configuration.
+ *   compare_records()		 - Compare two configuration file records.
  *   overwrite_data()		 - Overwrite the data in a file.
  */
 
@@ -36,10 +44,81 @@
 #include <fnmatch.h>
 #ifdef HAVE_REMOVEFILE
 #  include <removefile.h>
-#else
+#endif /* HAVE_REMOVEFILE */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct cupsd_confrec_s		/**** Configuration file record ****/
+{
+  int		linenum;		/* Line number of record start */
+  char		name[256];		/* Name of record */
+} cupsd_confrec_t;
+
+
+/*
+ * Local functions...
+ */
+
+static int	compare_records(cupsd_confrec_t *a, cupsd_confrec_t *b);
+#ifndef HAVE_REMOVEFILE
 static int	overwrite_data(int fd, const char *buffer, int bufsize,
 		               int filesize);
-#endif /* HAVE_REMOVEFILE */
+#endif /* !HAVE_REMOVEFILE */
+
+
+/*
+ * 'cupsdAppendConfFile()' - Open a configuration file for appending records.
+ *
+ * The printers.conf, classes.conf, and subscriptions.conf files are only
+ * rewritten in full occasionally.  In between, the records ("<Printer name>"
+ * through "</Printer>" and so forth) that have changed are appended to the
+ * end of the file and cupsdFindConfRecords() is used to ignore the older
+ * copies when the file is loaded.
+ */
+
+cups_file_t *				/* O - File pointer */
+cupsdAppendConfFile(
+    const char *filename)		/* I - Filename */
+{
+  cups_file_t	*fp;			/* File pointer */
+  int		fd;			/* File descriptor */
+  struct stat	fileinfo;		/* File information */
+  char		ch;			/* Last character in file */
+
+
+ /*
+  * Make sure the file exists and ends with a complete line - we never create
+  * the file here since the older records would be lost...
+  */
+
+  if ((fd = open(filename, O_RDONLY)) < 0)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to append to \"%s\": %s",
+		    filename, strerror(errno));
+    return (NULL);
+  }
+
+  if (fstat(fd, &fileinfo) || fileinfo.st_size == 0 ||
+      pread(fd, &ch, 1, fileinfo.st_size - 1) != 1 || ch != '\n')
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to append to \"%s\": Incomplete last line.",
+		    filename);
+    close(fd);
+    return (NULL);
+  }
+
+  close(fd);
+
+  if ((fp = cupsFileOpen(filename, "a")) == NULL)
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to append to \"%s\": %s",
+		    filename, strerror(errno));
+
+  return (fp);
+}
 
 
 /*
@@ -94,6 +173,28 @@ cupsdCleanFiles(const char *path,	/* I - Directory to clean */
 }
 
 
+/*
+ * 'cupsdCloseAppendedConfFile()' - Close a configuration file after appending
+ *                                  records.
+ */
+
+int					/* O - 0 on success, -1 on error */
+cupsdCloseAppendedConfFile(
+    cups_file_t *fp,			/* I - File to close */
+    const char  *filename)		/* I - Filename */
+{
+  if (cupsFileFlush(fp) || (SyncOnClose && fsync(cupsFileNumber(fp))))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to write changes to \"%s\": %s",
+		    filename, strerror(errno));
+    cupsFileClose(fp);
+    return (-1);
+  }
+
+  return (cupsFileClose(fp));
+}
+
+
 /*
  * 'cupsdCloseCreatedConfFile()' - Close a created configuration file and move
  *                                 into place.
@@ -219,6 +320,119 @@ cupsdCreateConfFile(
 }
 
 
+/*
+ * 'cupsdFindConfRecords()' - Find the current records in a configuration
+ *                            file.
+ *
+ * Returns the line number of the last complete copy of each record, keyed
+ * by the record name.  Incomplete records at the end of the file are
+ * ignored.  The file is rewound afterwards so it can be loaded normally.
+ *
+ * "stale" is set to the number of older copies in the file, or -1 if the
+ * file ends inside a record and must not be appended to.
+ */
+
+cups_array_t *				/* O - Array of records */
+cupsdFindConfRecords(cups_file_t *fp,	/* I - File to scan */
+                     int         *stale)/* O - Number of stale records */
+{
+  cups_array_t		*records;	/* Array of records */
+  cupsd_confrec_t	*rec,		/* Current record */
+			key;		/* Open record */
+  char			line[4096],	/* Line from file */
+			*value;		/* Pointer to value */
+  int			linenum;	/* Current line number */
+
+
+  *stale = -1;
+
+  if ((records = cupsArrayNew3((cups_array_func_t)compare_records, NULL,
+                               (cups_ahash_func_t)NULL, 0,
+			       (cups_acopy_func_t)NULL,
+			       (cups_afree_func_t)free)) == NULL)
+    return (NULL);
+
+  linenum     = 0;
+  key.linenum = 0;
+  *stale      = 0;
+
+  while (cupsFileGetConf(fp, line, sizeof(line), &value, &linenum))
+  {
+    if (line[0] != '<')
+      continue;
+
+    if (line[1] != '/')
+    {
+     /*
+      * <Record name>
+      */
+
+      if (value)
+      {
+        strlcpy(key.name, value, sizeof(key.name));
+	key.linenum = linenum;
+      }
+      else
+        key.linenum = 0;
+    }
+    else if (key.linenum && line[strlen(line) - 1] == '>')
+    {
+     /*
+      * </Record> - remember the line number of this (newer) copy...
+      */
+
+      if ((rec = (cupsd_confrec_t *)cupsArrayFind(records, &key)) != NULL)
+      {
+        rec->linenum = key.linenum;
+	(*stale) ++;
+      }
+      else if ((rec = malloc(sizeof(cupsd_confrec_t))) != NULL)
+      {
+        memcpy(rec, &key, sizeof(cupsd_confrec_t));
+	cupsArrayAdd(records, rec);
+      }
+
+      key.linenum = 0;
+    }
+  }
+
+  if (key.linenum)
+    *stale = -1;
+
+  cupsFileRewind(fp);
+
+  return (records);
+}
+
+
+/*
+ * 'cupsdIsCurrentConfRecord()' - Check whether a record is the current copy.
+ *
+ * A record with no complete copy in the file is treated as current so that
+ * whatever could be read is still loaded.
+ */
+
+int					/* O - 1 if current, 0 if not */
+cupsdIsCurrentConfRecord(
+    cups_array_t *records,		/* I - Records from cupsdFindConfRecords */
+    const char   *name,			/* I - Record name */
+    int          linenum)		/* I - Line number of record start */
+{
+  cupsd_confrec_t	key,		/* Search key */
+			*rec;		/* Matching record */
+
+
+  if (!records)
+    return (1);
+
+  strlcpy(key.name, name, sizeof(key.name));
+
+  rec = (cupsd_confrec_t *)cupsArrayFind(records, &key);
+
+  return (!rec || rec->linenum == linenum);
+}
+
+
 /*
  * 'cupsdOpenConfFile()' - Open a configuration file.
  *
@@ -413,6 +627,18 @@ cupsdUnlinkOrRemoveFile(
 }
 
 
+/*
+ * 'compare_records()' - Compare two configuration file records.
+ */
+
+static int				/* O - Result of comparison */
+compare_records(cupsd_confrec_t *a,	/* I - First record */
+                cupsd_confrec_t *b)	/* I - Second record */
+{
+  return (_cups_strcasecmp(a->name, b->name));
+}
+
+
 #ifndef HAVE_REMOVEFILE
 /*
  * 'overwrite_data()' - Overwrite the data in a file.
@@ -70,6 +70,8 @@ static void	copy_attrs(ipp_t *to, ipp_t *from, cups_array_t *ra,
 			   cups_array_t *exclude);
 static int	copy_banner(cupsd_client_t *con, cupsd_job_t *job,
 		            const char *name);
+static void	copy_encoded(ipp_t *to, cupsd_encoded_t *from,
+		             cups_array_t *ra);
 static int	copy_file(const char *from, const char *to);
 static int	copy_model(cupsd_client_t *con, const char *from,
 		           const char *to);
@@ -98,6 +100,7 @@ static void	get_ppds(cupsd_client_t *con);
 static void	get_printers(cupsd_client_t *con, int type);
 static void	get_printer_attrs(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	get_printer_supported(cupsd_client_t *con, ipp_attribute_t *uri);
+static void	get_statistics(cupsd_client_t *con);
 static void	get_subscription_attrs(cupsd_client_t *con, int sub_id);
 static void	get_subscriptions(cupsd_client_t *con, ipp_attribute_t *uri);
 static const char *get_username(cupsd_client_t *con);
@@ -122,6 +125,7 @@ static void	send_http_error(cupsd_client_t *con, http_status_t status,
 static void	send_ipp_status(cupsd_client_t *con, ipp_status_t status,
 		                const char *message, ...)
 		__attribute__((__format__(__printf__, 3, 4)));
+static int	send_response(cupsd_client_t *con, const char *uri);
 static void	set_default(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	set_job_attrs(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	set_printer_attrs(cupsd_client_t *con, ipp_attribute_t *uri);
@@ -129,6 +133,7 @@ static void	set_printer_defaults(cupsd_client_t *con,
 		                     cupsd_printer_t *printer);
 static void	start_printer(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	stop_printer(cupsd_client_t *con, ipp_attribute_t *uri);
+static int	stream_format(const char *format);
 static void	url_encode_attr(ipp_attribute_t *attr, char *buffer,
 		                int bufsize);
 static char	*url_encode_string(const char *s, char *buffer, int bufsize);
@@ -140,6 +145,99 @@ static int	validate_user(cupsd_job_t *job, cupsd_client_t *con,
 		              int userlen);
 
 
+/*
+ * 'cupsdFinishIPPStream()' - Finish a Print-Job request whose document was
+ *                            streamed to the job.
+ *
+ * Pass a size of -1 when the document could not be received; the job is then
+ * aborted and no response is sent.
+ */
+
+int					/* O - 1 on success, 0 on failure */
+cupsdFinishIPPStream(
+    cupsd_client_t *con,		/* I - Client connection */
+    off_t          bytes)		/* I - Size of document or -1 */
+{
+  cupsd_job_t		*job;		/* Job receiving the document */
+  cupsd_printer_t	*printer;	/* Destination printer or class */
+  ipp_attribute_t	*attr;		/* Current attribute */
+  int			kbytes;		/* Size of document */
+  char			uri[HTTP_MAX_URI] = "";
+					/* Printer URI for log */
+
+
+  con->streaming = 0;
+
+  if (con->stream_job && (job = cupsdFindJob(con->stream_job)) != NULL &&
+      job->incoming)
+  {
+    job->incoming = 0;
+
+    if ((attr = ippFindAttribute(job->attrs, "printer-uri",
+                                 IPP_TAG_URI)) != NULL)
+      strlcpy(uri, attr->values[0].string.text, sizeof(uri));
+
+    if (bytes < 0)
+    {
+      cupsdSetJobState(job, IPP_JOB_ABORTED, CUPSD_JOB_DEFAULT,
+                       "Job aborted because the document could not be "
+		       "received.");
+    }
+    else if (bytes == 0 || (MaxRequestSize > 0 && bytes > MaxRequestSize))
+    {
+      cupsdSetJobState(job, IPP_JOB_ABORTED, CUPSD_JOB_DEFAULT,
+                       "Job aborted because the document was %s.",
+		       bytes ? "too large" : "empty");
+
+      if (bytes)
+        send_ipp_status(con, IPP_REQUEST_ENTITY,
+	                _("Document is too large."));
+      else
+        send_ipp_status(con, IPP_BAD_REQUEST, _("No file in print request."));
+    }
+    else
+    {
+     /*
+      * Update quota data now that the size of the document is known...
+      */
+
+      kbytes = (int)((bytes + 1023) / 1024);
+
+      if ((printer = cupsdFindDest(job->dest)) != NULL)
+        cupsdUpdateQuota(printer, job->username, 0, kbytes);
+
+      if ((attr = ippFindAttribute(job->attrs, "job-k-octets",
+				   IPP_TAG_INTEGER)) != NULL)
+	attr->values[0].integer += kbytes;
+
+      job->dirty = 1;
+      cupsdMarkDirty(CUPSD_DIRTY_JOBS);
+
+      cupsdLogJob(job, CUPSD_LOG_INFO,
+                  "Received " CUPS_LLFMT " bytes of streamed document.",
+		  CUPS_LLCAST bytes);
+
+      cupsdClearString(&con->filename);	/* Now owned by the job */
+    }
+
+   /*
+    * Let the filters see the end of the document, and start the job if it
+    * was waiting for the whole document...
+    */
+
+    cupsdStreamJobData(job);
+    cupsdCheckJobs();
+  }
+
+  con->stream_job = 0;
+
+  if (bytes < 0 || !con->response)
+    return (0);
+
+  return (send_response(con, uri[0] ? uri : NULL));
+}
+
+
 /*
  * 'cupsdProcessIPPRequest()' - Process an incoming IPP request.
  */
@@ -155,17 +253,23 @@ cupsdProcessIPPRequest(
   ipp_attribute_t	*uri = NULL;	/* Printer or job URI attribute */
   ipp_attribute_t	*username;	/* requesting-user-name attr */
   int			sub_id;		/* Subscription ID */
+  ipp_op_t		op;		/* Operation for statistics */
+  double		start;		/* Start time for statistics */
 
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2,
                   "cupsdProcessIPPRequest(%p[%d]): operation_id = %04x",
                   con, con->number, con->request->request.op.operation_id);
 
+  op    = con->request->request.op.operation_id;
+  start = cupsdGetStatTime();
+
  /*
-  * First build an empty response message for this request...
+  * First build an empty response message for this request; responses are
+  * thrown away as soon as they are sent, so use an arena...
   */
 
-  con->response = ippNew();
+  con->response = ippNewArena();
 
   con->response->request.status.version[0] =
       con->request->request.op.version[0];
@@ -338,7 +442,8 @@ cupsdProcessIPPRequest(
 	        con->request->request.op.operation_id != CUPS_GET_PRINTERS &&
 	        con->request->request.op.operation_id != CUPS_GET_CLASSES &&
 	        con->request->request.op.operation_id != CUPS_GET_DEVICES &&
-	        con->request->request.op.operation_id != CUPS_GET_PPDS))
+	        con->request->request.op.operation_id != CUPS_GET_PPDS &&
+	        con->request->request.op.operation_id != CUPS_GET_STATISTICS))
       {
        /*
 	* Return an error, since attributes-charset,
@@ -569,6 +674,10 @@ cupsdProcessIPPRequest(
 	      get_document(con, uri);
 	      break;
 
+          case CUPS_GET_STATISTICS :
+	      get_statistics(con);
+	      break;
+
 	  case CUPS_GET_PPD :
               get_ppd(con, uri);
               break;
@@ -627,93 +736,108 @@ cupsdProcessIPPRequest(
     }
   }
 
-  if (con->response)
+  cupsdAddIPPStat(op, start);
+
+  if (con->response && con->streaming)
   {
    /*
-    * Sending data from the scheduler...
+    * The document is still being received; cupsdFinishIPPStream() sends the
+    * response once it is done...
     */
 
-    cupsdLogMessage(con->response->request.status.status_code
-                        >= IPP_BAD_REQUEST &&
-                    con->response->request.status.status_code
-		        != IPP_NOT_FOUND ? CUPSD_LOG_ERROR : CUPSD_LOG_DEBUG,
-                    "[Client %d] Returning IPP %s for %s (%s) from %s",
-	            con->number,
-	            ippErrorString(con->response->request.status.status_code),
-		    ippOpString(con->request->request.op.operation_id),
-		    uri ? uri->values[0].string.text : "no URI",
-		    con->http->hostname);
-
-    httpClearFields(con->http);
+    return (1);
+  }
+  else if (con->response)
+  {
+   /*
+    * Sending data from the scheduler...
+    */
 
-#ifdef CUPSD_USE_CHUNKING
+    return (send_response(con, uri ? uri->values[0].string.text : NULL));
+  }
+  else
+  {
    /*
-    * Because older versions of CUPS (1.1.17 and older) and some IPP
-    * clients do not implement chunking properly, we cannot use
-    * chunking by default.  This may become the default in future
-    * CUPS releases, or we might add a configuration directive for
-    * it.
+    * Sending data from a subprocess like cups-deviced; tell the caller
+    * everything is A-OK so far...
     */
 
-    if (con->http->version == HTTP_1_1)
-    {
-      cupsdLogMessage(CUPSD_LOG_DEBUG,
-		      "[Client %d] Transfer-Encoding: chunked",
-		      con->number);
+    return (1);
+  }
+}
 
-      cupsdSetLength(con->http, 0);
-    }
-    else
-#endif /* CUPSD_USE_CHUNKING */
-    {
-      size_t	length;			/* Length of response */
 
+/*
+ * 'cupsdStreamIPPRequest()' - Process a Print-Job request before its document
+ *                             has been received.
+ *
+ * Only requests for the document formats listed by the StreamJobs directive
+ * are processed early, so that the job's filters can read the document as it
+ * arrives.  The response is sent by cupsdFinishIPPStream().
+ */
 
-      length = ippLength(con->response);
+int					/* O - 1 if streaming, 0 if not, -1 on error */
+cupsdStreamIPPRequest(
+    cupsd_client_t *con)		/* I - Client connection */
+{
+  ipp_attribute_t	*uri,		/* printer-uri attribute */
+			*format,	/* document-format attribute */
+			*attr;		/* Current attribute */
+  cupsd_printer_t	*printer;	/* Destination printer or class */
 
-      if (con->file >= 0 && !con->pipe_pid)
-      {
-	struct stat	fileinfo;	/* File information */
 
-	if (!fstat(con->file, &fileinfo))
-	  length += fileinfo.st_size;
-      }
+  if (!StreamJobs || !con->request || !con->filename ||
+      con->request->request.op.operation_id != IPP_OP_PRINT_JOB)
+    return (0);
 
-      cupsdLogMessage(CUPSD_LOG_DEBUG,
-		      "[Client %d] Content-Length: " CUPS_LLFMT,
-		      con->number, CUPS_LLCAST length);
-      httpSetLength(con->http, length);
-    }
+ /*
+  * Only stream to destinations the client may print to without further
+  * authentication, since any error has to be reported right away...
+  */
 
-    if (cupsdSendHeader(con, HTTP_OK, "application/ipp", CUPSD_AUTH_NONE))
-    {
-     /*
-      * Tell the caller the response header was sent successfully...
-      */
+  if ((uri = ippFindAttribute(con->request, "printer-uri",
+                              IPP_TAG_URI)) == NULL ||
+      !cupsdValidateDest(uri->values[0].string.text, NULL, &printer) ||
+      (printer->type & CUPS_PRINTER_REMOTE) ||
+      (printer->num_auth_info_required > 0 &&
+       !strcmp(printer->auth_info_required[0], "negotiate")) ||
+      ippFindAttribute(con->request, "auth-info", IPP_TAG_TEXT) ||
+      cupsdCheckPolicy(printer->op_policy_ptr, con, NULL) != HTTP_OK)
+    return (0);
 
-      cupsdAddSelect(httpGetFd(con->http), (cupsd_selfunc_t)cupsdReadClient,
-		     (cupsd_selfunc_t)cupsdWriteClient, con);
-    
-      return (1);
-    }
-    else
-    {
-     /*
-      * Tell the caller the response header could not be sent...
-      */
+ /*
+  * Auto-typed and compressed documents are always spooled first...
+  */
 
-      return (0);
-    }
-  }
-  else
+  if ((format = ippFindAttribute(con->request, "document-format",
+                                 IPP_TAG_MIMETYPE)) == NULL ||
+      !stream_format(format->values[0].string.text))
+    return (0);
+
+  if ((attr = ippFindAttribute(con->request, "compression",
+                               IPP_TAG_KEYWORD)) != NULL &&
+      strcmp(attr->values[0].string.text, "none"))
+    return (0);
+
+  cupsdLogClient(con, CUPSD_LOG_DEBUG,
+                 "Printing %s document while it is received.",
+		 format->values[0].string.text);
+
+  con->streaming = 1;
+
+  cupsdProcessIPPRequest(con);
+
+  if (!con->response)
   {
    /*
-    * Sending data from a subprocess like cups-deviced; tell the caller
-    * everything is A-OK so far...
+    * An HTTP error was sent...
     */
 
-    return (1);
+    con->streaming = 0;
+    return (-1);
   }
+
+  return (1);
 }
 
 
@@ -812,16 +936,18 @@ accept_jobs(cupsd_client_t  *con,	/* I - Client connection */
   cupsdAddEvent(CUPSD_EVENT_PRINTER_STATE, printer, NULL,
                 "Now accepting jobs.");
 
+  printer->dirty = 1;
+
   if (dtype & CUPS_PRINTER_CLASS)
   {
-    cupsdMarkDirty(CUPSD_DIRTY_CLASSES);
+    cupsdMarkDirtyRecords(CUPSD_DIRTY_CLASSES);
 
     cupsdLogMessage(CUPSD_LOG_INFO, "Class \"%s\" now accepting jobs (\"%s\").",
                     printer->name, get_username(con));
   }
   else
   {
-    cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+    cupsdMarkDirtyRecords(CUPSD_DIRTY_PRINTERS);
 
     cupsdLogMessage(CUPSD_LOG_INFO,
                     "Printer \"%s\" now accepting jobs (\"%s\").",
@@ -1077,7 +1203,9 @@ add_class(cupsd_client_t  *con,		/* I - Client connection */
   */
 
   cupsdSetPrinterAttrs(pclass);
-  cupsdMarkDirty(CUPSD_DIRTY_CLASSES);
+
+  pclass->dirty = 1;
+  cupsdMarkDirtyRecords(CUPSD_DIRTY_CLASSES);
 
   if (need_restart_job && pclass->job)
   {
@@ -1174,7 +1302,8 @@ add_file(cupsd_client_t *con,		/* I - Connection to client */
 
   job->num_files ++;
 
-  job->dirty = 1;
+  job->dirty         = 1;
+  job->summary_dirty = 1;
   cupsdMarkDirty(CUPSD_DIRTY_JOBS);
 
   return (0);
@@ -1579,8 +1708,7 @@ add_job(cupsd_client_t  *con,		/* I - Client connection */
   else
   {
     attr->group_tag = IPP_TAG_JOB;
-    _cupsStrFree(attr->name);
-    attr->name = _cupsStrAlloc("job-originating-user-name");
+    ippSetName(job->attrs, &attr, "job-originating-user-name");
   }
 
   if (con->username[0] || auth_info)
@@ -1725,6 +1853,8 @@ add_job(cupsd_client_t  *con,		/* I - Client connection */
     job->hold_until               = time(NULL) + MultipleOperationTimeout;
     job->state->values[0].integer = IPP_JOB_HELD;
     job->state_value              = IPP_JOB_HELD;
+
+    cupsdUpdateJobTimers(job);
   }
   else
   {
@@ -1942,8 +2072,7 @@ add_job_subscriptions(
     cupsd_job_t    *job)		/* I - Newly created job */
 {
   int			i;		/* Looping var */
-  ipp_attribute_t	*prev,		/* Previous attribute */
-			*next,		/* Next attribute */
+  ipp_attribute_t	*next,		/* Next attribute */
 			*attr;		/* Current attribute */
   cupsd_subscription_t	*sub;		/* Subscription object */
   const char		*recipient,	/* notify-recipient-uri */
@@ -2130,7 +2259,7 @@ add_job_subscriptions(
       attr = attr->next;
   }
 
-  cupsdMarkDirty(CUPSD_DIRTY_SUBSCRIPTIONS);
+  cupsdMarkDirtyRecords(CUPSD_DIRTY_SUBSCRIPTIONS);
 
  /*
   * Remove all of the subscription attributes from the job request...
@@ -2139,7 +2268,7 @@ add_job_subscriptions(
   * end of the request...
   */
 
-  for (attr = job->attrs->attrs, prev = NULL; attr; attr = next)
+  for (attr = job->attrs->attrs; attr; attr = next)
   {
     next = attr->next;
 
@@ -2150,19 +2279,11 @@ add_job_subscriptions(
       * Free and remove this attribute...
       */
 
-      ippDeleteAttribute(NULL, attr);
-
-      if (prev)
-        prev->next = next;
-      else
-        job->attrs->attrs = next;
+      ippDeleteAttribute(job->attrs, attr);
     }
-    else
-      prev = attr;
   }
 
-  job->attrs->last    = prev;
-  job->attrs->current = prev;
+  job->attrs->current = job->attrs->last;
 }
 
 
@@ -2298,7 +2419,14 @@ add_printer(cupsd_client_t  *con,	/* I - Client connection */
     return;
   }
   else
+  {
+   /*
+    * Don't let a PPD file that is still loading overwrite the changes...
+    */
+
+    cupsdFinishLoadingPrinter(printer);
     modify = 1;
+  }
 
  /*
   * Look for attributes and copy them over as needed...
@@ -2790,7 +2918,8 @@ add_printer(cupsd_client_t  *con,	/* I - Client connection */
   */
 
   cupsdSetPrinterAttrs(printer);
-  cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+  printer->dirty = 1;
+  cupsdMarkDirtyRecords(CUPSD_DIRTY_PRINTERS);
 
   if (need_restart_job && printer->job)
   {
@@ -3956,7 +4085,8 @@ close_job(cupsd_client_t  *con,		/* I - Client connection */
     }
   }
 
-  job->dirty = 1;
+  job->dirty         = 1;
+  job->summary_dirty = 1;
   cupsdMarkDirty(CUPSD_DIRTY_JOBS);
 
  /*
@@ -4341,6 +4471,64 @@ copy_banner(cupsd_client_t *con,	/* I - Client connection */
 }
 
 
+/*
+ * 'copy_encoded()' - Copy pre-encoded attributes to a response.
+ *
+ * This applies the same filtering as copy_attrs() and appends each run of
+ * adjacent requested attributes as a single block of encoded data.
+ */
+
+static void
+copy_encoded(ipp_t           *to,	/* I - Destination response */
+             cupsd_encoded_t *from,	/* I - Encoded attributes */
+	     cups_array_t    *ra)	/* I - Requested attributes */
+{
+  int			i;		/* Looping var */
+  cupsd_encattr_t	*attr;		/* Current attribute */
+  ipp_tag_t		group;		/* Group of current run */
+  size_t		start,		/* Start of current run */
+			length;		/* Length of current run */
+
+
+  for (i = from->num_attrs, attr = from->attrs, group = IPP_TAG_ZERO,
+           start = 0, length = 0;
+       i > 0;
+       i --, attr ++)
+  {
+    if (ra && !cupsArrayFind(ra, attr->name))
+      continue;
+
+   /*
+    * Don't send collection attributes by default to IPP/1.x clients
+    * since many do not support collections.  Also don't send
+    * media-col-database unless specifically requested by the client.
+    */
+
+    if (attr->collection && !ra &&
+        (to->request.status.version[0] == 1 ||
+	 !strcmp(attr->name, "media-col-database")))
+      continue;
+
+    if (length > 0 && attr->group == group &&
+        attr->offset == start + length)
+    {
+      length += attr->length;
+      continue;
+    }
+
+    if (length > 0)
+      _ippAddEncoded(to, group, from->data + start, (int)length);
+
+    group  = attr->group;
+    start  = attr->offset;
+    length = attr->length;
+  }
+
+  if (length > 0)
+    _ippAddEncoded(to, group, from->data + start, (int)length);
+}
+
+
 /*
  * 'copy_file()' - Copy a PPD file or interface script...
  */
@@ -4451,7 +4639,8 @@ copy_model(cupsd_client_t *con,		/* I - Client connection */
   cupsdLogMessage(CUPSD_LOG_DEBUG,
                   "copy_model: Running \"cups-driverd cat %s\"...", from);
 
-  if (!cupsdStartProcess(buffer, argv, envp, -1, temppipe[1], CGIPipes[1],
+  if ((temppid = cupsdRunDriverd(argv, temppipe[1])) == 0 &&
+      !cupsdStartProcess(buffer, argv, envp, -1, temppipe[1], CGIPipes[1],
                          -1, -1, 0, DefaultProfile, NULL, &temppid))
   {
     close(tempfd);
@@ -4774,6 +4963,7 @@ copy_printer_attrs(
 					/* Printer icons */
   time_t		curtime;	/* Current time */
   int			i;		/* Looping var */
+  cupsd_encoded_t	*encoded;	/* Pre-encoded attributes */
 
 
  /*
@@ -4959,10 +5149,20 @@ copy_printer_attrs(
   if (!ra || cupsArrayFind(ra, "queued-job-count"))
     add_queued_job_count(con, printer);
 
-  copy_attrs(con->response, printer->attrs, ra, IPP_TAG_ZERO, 0, NULL);
-  if (printer->ppd_attrs)
-    copy_attrs(con->response, printer->ppd_attrs, ra, IPP_TAG_ZERO, 0, NULL);
-  copy_attrs(con->response, CommonData, ra, IPP_TAG_ZERO, IPP_TAG_COPY, NULL);
+  if ((encoded = cupsdEncodePrinterAttrs(printer)) != NULL)
+    copy_encoded(con->response, encoded, ra);
+  else
+  {
+    copy_attrs(con->response, printer->attrs, ra, IPP_TAG_ZERO, 0, NULL);
+    if (printer->ppd_attrs)
+      copy_attrs(con->response, printer->ppd_attrs, ra, IPP_TAG_ZERO, 0, NULL);
+  }
+
+  if ((encoded = cupsdEncodeCommonData()) != NULL)
+    copy_encoded(con->response, encoded, ra);
+  else
+    copy_attrs(con->response, CommonData, ra, IPP_TAG_ZERO, IPP_TAG_COPY,
+               NULL);
 }
 
 
@@ -5571,7 +5771,7 @@ create_subscription(
       attr = attr->next;
   }
 
-  cupsdMarkDirty(CUPSD_DIRTY_SUBSCRIPTIONS);
+  cupsdMarkDirtyRecords(CUPSD_DIRTY_SUBSCRIPTIONS);
 }
 
 
@@ -5845,6 +6045,14 @@ get_document(cupsd_client_t  *con,	/* I - Client connection */
   int		port;			/* Port portion of URI */
   char		filename[1024],		/* Filename for document */
 		format[1024];		/* Format for document */
+  int		docpipe[2];		/* Uncompressed document pipe */
+  char		command[1024],		/* gziptoany filter */
+		jobidstr[255],		/* Job ID string */
+		final_content_type[1024],
+					/* FINAL_CONTENT_TYPE env var */
+		*argv[8],		/* Command-line arguments */
+		*envp[MAX_ENV];		/* Environment */
+  int		envc;			/* Number of environment variables */
 
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "get_document(%p[%d], %s)", con,
@@ -5960,6 +6168,69 @@ get_document(cupsd_client_t  *con,	/* I - Client connection */
   snprintf(format, sizeof(format), "%s/%s", job->filetypes[docnum - 1]->super,
            job->filetypes[docnum - 1]->type);
 
+  if (job->compressions[docnum - 1])
+  {
+   /*
+    * Stream the uncompressed data from the gziptoany filter, which is read
+    * by cupsdWriteClient like CGI output...
+    */
+
+    close(con->file);
+    con->file = -1;
+
+    snprintf(command, sizeof(command), "%s/filter/gziptoany", ServerBin);
+    snprintf(jobidstr, sizeof(jobidstr), "%d", jobid);
+    snprintf(final_content_type, sizeof(final_content_type),
+             "FINAL_CONTENT_TYPE=%s/%s", job->filetypes[docnum - 1]->super,
+	     job->filetypes[docnum - 1]->type);
+
+    argv[0] = "gziptoany";
+    argv[1] = jobidstr;
+    argv[2] = job->username;
+    argv[3] = "Get-Document";
+    argv[4] = "1";
+    argv[5] = "";
+    argv[6] = filename;
+    argv[7] = NULL;
+
+    envc         = cupsdLoadEnv(envp, (int)(sizeof(envp) / sizeof(envp[0])) - 1);
+    envp[envc++] = final_content_type;
+    envp[envc]   = NULL;
+
+    if (cupsdOpenPipe(docpipe))
+    {
+      cupsdLogMessage(CUPSD_LOG_ERROR,
+		      "Unable to create pipe for document %d in job %d - %s",
+		      docnum, jobid, strerror(errno));
+      send_ipp_status(con, IPP_INTERNAL_ERROR,
+		      _("Unable to open document #%d in job #%d."), docnum,
+		      jobid);
+      return;
+    }
+
+    if (!cupsdStartProcess(command, argv, envp, -1, docpipe[1], CGIPipes[1],
+                           -1, -1, 0, DefaultProfile, NULL, &con->pipe_pid))
+    {
+      cupsdLogMessage(CUPSD_LOG_ERROR,
+		      "Unable to uncompress document %d in job %d - %s",
+		      docnum, jobid, strerror(errno));
+      send_ipp_status(con, IPP_INTERNAL_ERROR,
+		      _("Unable to open document #%d in job #%d."), docnum,
+		      jobid);
+      cupsdClosePipe(docpipe);
+      con->pipe_pid = 0;
+      return;
+    }
+
+    close(docpipe[1]);
+
+    con->file        = docpipe[0];
+    con->pipe_shared = 0;
+    con->sent_header = 1;
+    con->got_fields  = 1;
+    con->file_ready  = 0;
+  }
+
   ippAddString(con->response, IPP_TAG_JOB, IPP_TAG_MIMETYPE, "document-format",
                NULL, format);
   ippAddInteger(con->response, IPP_TAG_JOB, IPP_TAG_INTEGER, "document-number",
@@ -6568,6 +6839,7 @@ get_notifications(cupsd_client_t *con)	/* I - Client connection */
     {
       ippAddSeparator(con->response);
 
+      cupsdAddEventHeader(con->response, sub, sub->first_event_id + j);
       copy_attrs(con->response,
                  ((cupsd_event_t *)cupsArrayIndex(sub->events, j))->attrs, NULL,
         	 IPP_TAG_EVENT_NOTIFICATION, 0, NULL);
@@ -7155,6 +7427,39 @@ get_printers(cupsd_client_t *con,	/* I - Client connection */
 }
 
 
+/*
+ * 'get_statistics()' - Get scheduler performance statistics.
+ */
+
+static void
+get_statistics(cupsd_client_t *con)	/* I - Client connection */
+{
+  http_status_t	status;			/* Policy status */
+
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "get_statistics(%p[%d])", con,
+                  con->number);
+
+ /*
+  * Check policy...
+  */
+
+  if ((status = cupsdCheckPolicy(DefaultPolicyPtr, con, NULL)) != HTTP_OK)
+  {
+    send_http_error(con, status, NULL);
+    return;
+  }
+
+ /*
+  * Add the statistics...
+  */
+
+  cupsdAddStatAttrs(con->response);
+
+  con->response->request.status.status_code = IPP_OK;
+}
+
+
 /*
  * 'get_subscription_attrs()' - Get subscription attributes.
  */
@@ -8116,12 +8421,13 @@ print_job(cupsd_client_t  *con,		/* I - Client connection */
   }
 
  /*
-  * Read any embedded job ticket info from PS files...
+  * Read any embedded job ticket info from PS files (streamed documents
+  * haven't been received yet)...
   */
 
   if (!_cups_strcasecmp(filetype->super, "application") &&
       (!_cups_strcasecmp(filetype->type, "postscript") ||
-       !_cups_strcasecmp(filetype->type, "pdf")))
+       !_cups_strcasecmp(filetype->type, "pdf")) && !con->streaming)
     read_job_ticket(con);
 
  /*
@@ -8135,7 +8441,7 @@ print_job(cupsd_client_t  *con,		/* I - Client connection */
   * Update quota data...
   */
 
-  if (stat(con->filename, &fileinfo))
+  if (con->streaming || stat(con->filename, &fileinfo))
     kbytes = 0;
   else
     kbytes = (fileinfo.st_size + 1023) / 1024;
@@ -8156,7 +8462,20 @@ print_job(cupsd_client_t  *con,		/* I - Client connection */
   snprintf(filename, sizeof(filename), "%s/d%05d-%03d", RequestRoot, job->id,
            job->num_files);
   rename(con->filename, filename);
-  cupsdClearString(&con->filename);
+
+  if (con->streaming)
+  {
+   /*
+    * The rest of the document is written to the job file as it arrives...
+    */
+
+    cupsdSetString(&con->filename, filename);
+
+    job->incoming   = job->num_files;
+    con->stream_job = job->id;
+  }
+  else
+    cupsdClearString(&con->filename);
 
  /*
   * See if we need to add the ending sheet...
@@ -8226,8 +8545,7 @@ read_job_ticket(cupsd_client_t *con)	/* I - Client connection */
   cups_option_t		*options;	/* Options */
   ipp_t			*ticket;	/* New attributes */
   ipp_attribute_t	*attr,		/* Current attribute */
-			*attr2,		/* Job attribute */
-			*prev2;		/* Previous job attribute */
+			*attr2;		/* Job attribute */
 
 
  /*
@@ -8330,25 +8648,7 @@ read_job_ticket(cupsd_client_t *con)	/* I - Client connection */
       * Some other value; first free the old value...
       */
 
-      if (con->request->attrs == attr2)
-      {
-	con->request->attrs = attr2->next;
-	prev2               = NULL;
-      }
-      else
-      {
-	for (prev2 = con->request->attrs; prev2; prev2 = prev2->next)
-	  if (prev2->next == attr2)
-	  {
-	    prev2->next = attr2->next;
-	    break;
-	  }
-      }
-
-      if (con->request->last == attr2)
-        con->request->last = prev2;
-
-      ippDeleteAttribute(NULL, attr2);
+      ippDeleteAttribute(con->request, attr2);
     }
 
    /*
@@ -8426,16 +8726,18 @@ reject_jobs(cupsd_client_t  *con,	/* I - Client connection */
   cupsdAddEvent(CUPSD_EVENT_PRINTER_STATE, printer, NULL,
                 "No longer accepting jobs.");
 
+  printer->dirty = 1;
+
   if (dtype & CUPS_PRINTER_CLASS)
   {
-    cupsdMarkDirty(CUPSD_DIRTY_CLASSES);
+    cupsdMarkDirtyRecords(CUPSD_DIRTY_CLASSES);
 
     cupsdLogMessage(CUPSD_LOG_INFO, "Class \"%s\" rejecting jobs (\"%s\").",
                     printer->name, get_username(con));
   }
   else
   {
-    cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+    cupsdMarkDirtyRecords(CUPSD_DIRTY_PRINTERS);
 
     cupsdLogMessage(CUPSD_LOG_INFO, "Printer \"%s\" rejecting jobs (\"%s\").",
                     printer->name, get_username(con));
@@ -8732,8 +9034,9 @@ renew_subscription(
   }
 
   sub->expire = sub->lease ? time(NULL) + sub->lease : 0;
+  sub->dirty  = 1;
 
-  cupsdMarkDirty(CUPSD_DIRTY_SUBSCRIPTIONS);
+  cupsdMarkDirtyRecords(CUPSD_DIRTY_SUBSCRIPTIONS);
 
   con->response->request.status.status_code = IPP_OK;
 
@@ -9433,7 +9736,8 @@ send_document(cupsd_client_t  *con,	/* I - Client connection */
 	ippSetString(job->attrs, &job->reasons, 0, "job-hold-until-specified");
     }
 
-    job->dirty = 1;
+    job->dirty         = 1;
+    job->summary_dirty = 1;
     cupsdMarkDirty(CUPSD_DIRTY_JOBS);
 
     start_job = 1;
@@ -9450,9 +9754,12 @@ send_document(cupsd_client_t  *con,	/* I - Client connection */
       job->state_value              = IPP_JOB_HELD;
       job->hold_until               = time(NULL) + MultipleOperationTimeout;
 
+      cupsdUpdateJobTimers(job);
+
       ippSetString(job->attrs, &job->reasons, 0, "job-incoming");
 
-      job->dirty = 1;
+      job->dirty         = 1;
+      job->summary_dirty = 1;
       cupsdMarkDirty(CUPSD_DIRTY_JOBS);
     }
 
@@ -9616,6 +9923,110 @@ send_ipp_status(cupsd_client_t *con,	/* I - Client connection */
 }
 
 
+/*
+ * 'send_response()' - Send the response to an IPP request.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+send_response(cupsd_client_t *con,	/* I - Client connection */
+              const char     *uri)	/* I - Printer or job URI, if any */
+{
+  cupsdLogMessage(con->response->request.status.status_code
+                      >= IPP_BAD_REQUEST &&
+                  con->response->request.status.status_code
+		      != IPP_NOT_FOUND ? CUPSD_LOG_ERROR : CUPSD_LOG_DEBUG,
+                  "[Client %d] Returning IPP %s for %s (%s) from %s",
+	          con->number,
+	          ippErrorString(con->response->request.status.status_code),
+		  ippOpString(con->request->request.op.operation_id),
+		  uri ? uri : "no URI", con->http->hostname);
+
+  httpClearFields(con->http);
+
+#ifdef CUPSD_USE_CHUNKING
+ /*
+  * Because older versions of CUPS (1.1.17 and older) and some IPP
+  * clients do not implement chunking properly, we cannot use
+  * chunking by default.  This may become the default in future
+  * CUPS releases, or we might add a configuration directive for
+  * it.
+  */
+
+  if (con->http->version == HTTP_1_1)
+  {
+    cupsdLogMessage(CUPSD_LOG_DEBUG,
+		    "[Client %d] Transfer-Encoding: chunked",
+		    con->number);
+
+    cupsdSetLength(con->http, 0);
+  }
+  else
+#endif /* CUPSD_USE_CHUNKING */
+  if (con->file >= 0 && con->pipe_pid)
+  {
+   /*
+    * The length of piped document data is not known ahead of time, so use
+    * chunking or close the connection after the response...
+    */
+
+    if (httpGetVersion(con->http) == HTTP_VERSION_1_1)
+    {
+      cupsdLogMessage(CUPSD_LOG_DEBUG,
+		      "[Client %d] Transfer-Encoding: chunked",
+		      con->number);
+
+      httpSetLength(con->http, 0);
+    }
+    else
+      httpSetKeepAlive(con->http, HTTP_KEEPALIVE_OFF);
+  }
+  else
+  {
+    size_t	length;			/* Length of response */
+
+
+    length = ippLength(con->response);
+
+    if (con->file >= 0 && !con->pipe_pid)
+    {
+      struct stat	fileinfo;	/* File information */
+
+      if (!fstat(con->file, &fileinfo))
+	length += fileinfo.st_size;
+    }
+
+    cupsdLogMessage(CUPSD_LOG_DEBUG,
+		    "[Client %d] Content-Length: " CUPS_LLFMT,
+		    con->number, CUPS_LLCAST length);
+    httpSetLength(con->http, length);
+  }
+
+  if (cupsdSendHeader(con, HTTP_OK, "application/ipp", CUPSD_AUTH_NONE))
+  {
+   /*
+    * Tell the caller the response header was sent successfully; large
+    * responses to read-only operations are encoded by a worker thread...
+    */
+
+    if (cupsdQueueResponse(con))
+      return (1);
+
+    cupsdAddSelect(httpGetFd(con->http), (cupsd_selfunc_t)cupsdReadClient,
+		   (cupsd_selfunc_t)cupsdWriteClient, con);
+
+    return (1);
+  }
+  else
+  {
+   /*
+    * Tell the caller the response header could not be sent...
+    */
+
+    return (0);
+  }
+}
+
+
 /*
  * 'set_default()' - Set the default destination...
  */
@@ -9963,15 +10374,7 @@ set_job_attrs(cupsd_client_t  *con,	/* I - Client connection */
       * Some other value; first free the old value...
       */
 
-      if (job->attrs->prev)
-        job->attrs->prev->next = attr2->next;
-      else
-        job->attrs->attrs = attr2->next;
-
-      if (job->attrs->last == attr2)
-        job->attrs->last = job->attrs->prev;
-
-      ippDeleteAttribute(NULL, attr2);
+      ippDeleteAttribute(job->attrs, attr2);
 
      /*
       * Then copy the attribute...
@@ -10010,15 +10413,7 @@ set_job_attrs(cupsd_client_t  *con,	/* I - Client connection */
       if ((attr2 = ippFindAttribute(job->attrs, attr->name,
                                     IPP_TAG_ZERO)) != NULL)
       {
-        if (job->attrs->prev)
-	  job->attrs->prev->next = attr2->next;
-	else
-	  job->attrs->attrs = attr2->next;
-
-        if (attr2 == job->attrs->last)
-	  job->attrs->last = job->attrs->prev;
-
-        ippDeleteAttribute(NULL, attr2);
+        ippDeleteAttribute(job->attrs, attr2);
 
         event |= CUPSD_EVENT_JOB_CONFIG_CHANGED;
       }
@@ -10137,7 +10532,8 @@ set_printer_attrs(cupsd_client_t  *con,	/* I - Client connection */
   if (changed)
   {
     cupsdSetPrinterAttrs(printer);
-    cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+    printer->dirty = 1;
+    cupsdMarkDirtyRecords(CUPSD_DIRTY_PRINTERS);
 
     cupsdAddEvent(CUPSD_EVENT_PRINTER_CONFIG, printer, NULL,
                   "Printer \"%s\" description or location changed by \"%s\".",
@@ -10264,6 +10660,17 @@ set_printer_defaults(
 
       printer->page_limit = attr->values[0].integer;
     }
+    else if (!strcmp(attr->name, "spool-compression"))
+    {
+      if (attr->value_tag != IPP_TAG_INTEGER ||
+          attr->values[0].integer < -1 || attr->values[0].integer > 9)
+        continue;
+
+      cupsdLogMessage(CUPSD_LOG_DEBUG, "Setting spool-compression to %d...",
+        	      attr->values[0].integer);
+
+      printer->spool_compression = attr->values[0].integer;
+    }
     else if (!strcmp(attr->name, "printer-op-policy"))
     {
       cupsd_policy_t *p;		/* Policy */
@@ -10555,6 +10962,52 @@ stop_printer(cupsd_client_t  *con,	/* I - Client connection */
 }
 
 
+/*
+ * 'stream_format()' - Determine whether a document format can be streamed.
+ */
+
+static int				/* O - 1 if streamed, 0 otherwise */
+stream_format(const char *format)	/* I - document-format value */
+{
+  const char	*ptr,			/* Pointer into StreamJobs */
+		*end;			/* End of current format */
+  size_t	superlen,		/* Length of super-type */
+		typelen,		/* Length of format without parameters */
+		len;			/* Length of current format */
+
+
+  if ((ptr = strchr(format, '/')) == NULL)
+    return (0);
+
+  superlen = (size_t)(ptr - format);
+  typelen  = strcspn(format, "; \t");
+
+  if (typelen == 24 && !_cups_strncasecmp(format, "application/octet-stream",
+                                          typelen))
+    return (0);				/* Never stream auto-typed documents */
+
+  for (ptr = StreamJobs; *ptr; ptr = end)
+  {
+    while (*ptr == ',' || isspace(*ptr & 255))
+      ptr ++;
+
+    for (end = ptr; *end && *end != ',' && !isspace(*end & 255); end ++);
+
+    if ((len = (size_t)(end - ptr)) == 0)
+      continue;
+
+    if (len == typelen && !_cups_strncasecmp(ptr, format, len))
+      return (1);
+
+    if (len == superlen + 2 && !strncmp(ptr + superlen, "/*", 2) &&
+        !_cups_strncasecmp(ptr, format, superlen))
+      return (1);
+  }
+
+  return (0);
+}
+
+
 /*
  * 'url_encode_attr()' - URL-encode a string attribute.
  */
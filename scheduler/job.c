@@ -21,6 +21,7 @@
 #include <grp.h>
 #include <cups/backend.h>
 #include <cups/dir.h>
+#include <sys/resource.h>
 #ifdef __APPLE__
 #  include <IOKit/pwr_mgt/IOPMLib.h>
 #  ifdef HAVE_IOKIT_PWR_MGT_IOPMLIBPRIVATE_H
@@ -76,6 +77,16 @@
  *     If we can print, we build a string for the print options and run each of
  *     the filters, piping the output from one into the next.
  *
+ * STREAMED DOCUMENTS (cupsdStreamJobData)
+ *
+ *     A Print-Job request for one of the StreamJobs formats creates its job as
+ *     soon as the request attributes have been read, and job->incoming is set
+ *     while the client is still sending the document.  When that file gets
+ *     printed, the first filter reads from a pipe instead of the spool file
+ *     and write_stream copies whatever has been received so far into the pipe.
+ *     cupsdStreamJobData is called as more data arrives and once the upload is
+ *     done, and the pipe is closed after the last byte has been copied.
+ *
  * JOB STATUS UPDATES (update_job)
  *
  *     The update_job function gets called whenever there are pending messages
@@ -92,19 +103,108 @@
  *
  *     Then we close the pipes and free the status buffers and profiles.
  *
+ * JOB JOURNAL (cupsdSaveAllJobs)
+ *
+ *     A summary of every job (state, priority, hold time, user, destination,
+ *     and document types) is kept in the binary CacheDir/job.journal file.
+ *     Each time the job state is saved, cupsdSaveAllJobs appends a record for
+ *     each job whose summary changed since the last save, and cupsdDeleteJob
+ *     appends a record when a job is removed.  Every record has a checksum so
+ *     a partial record from a crash is ignored on startup.  When the journal
+ *     holds too many stale records it is compacted by writing a new copy with
+ *     one record per job.  The job attributes are still stored in the
+ *     individual c##### control files.
+ *
  * JOB FILE COMPLETION (process_children in main.c)
  *
  *     For multiple-file jobs, process_children (in main.c) sees that all
  *     filters have exited and calls in to print the next file if there are
  *     more files in the job, otherwise it waits for the backend to exit and
  *     update_job to do the cleanup.
+ *
+ * COMPRESSION OF PRESERVED FILES (cupsdCompressJobFiles)
+ *
+ *     When SpoolCompression (or the queue's SpoolCompression value) is
+ *     non-zero, completed jobs whose files are preserved are added to the
+ *     compress_jobs list.  The main loop calls cupsdCompressJobFiles when it
+ *     is idle, which gzips at most CUPSD_COMPRESS_SLICE bytes of the current
+ *     document into a temporary file next to it in RequestRoot and then
+ *     renames the result over the original file once it is complete and
+ *     smaller.  Restarting a job stops the compression of its files;
+ *     compressed documents are printed through the gziptoany filter and
+ *     uncompressed by get_document in ipp.c.
+ */
+
+
+/*
+ * Local constants...
+ */
+
+#define CUPSD_JOURNAL_MAGIC	"CUPSJNL1"
+					/* job.journal header, version 1 */
+#define CUPSD_JOURNAL_SEED	2166136261U
+					/* Initial journal hash value */
+#define CUPSD_COMPRESS_SLICE	262144
+					/* Bytes to compress per main loop */
+
+
+/*
+ * Local types...
  */
 
+typedef struct cupsd_jobtimer_s		/**** Job timer ****/
+{
+  time_t	time;			/* When the timer expires */
+  int		id;			/* Job ID */
+} cupsd_jobtimer_t;
+
+typedef enum cupsd_jrec_e		/**** Job journal record types ****/
+{
+  CUPSD_JREC_NEXTID = 1,		/* NextJobId value */
+  CUPSD_JREC_JOB,			/* Job summary */
+  CUPSD_JREC_DELETE			/* Job removed */
+} cupsd_jrec_t;
+
+typedef struct cupsd_jobrec_s		/**** Job journal summary ****/
+{
+  int		id;			/* Job ID */
+  size_t	length;			/* Length of summary */
+  unsigned char	data[1];		/* Summary data */
+} cupsd_jobrec_t;
+
 
 /*
  * Local globals...
  */
 
+static cups_array_t	*job_timers = NULL;
+					/* Pending job timers, sorted by time */
+static cups_file_t	*journal_fp = NULL;
+					/* Job journal, open for appending */
+static int		journal_records = 0,
+					/* Number of records in journal */
+			journal_next_id = 0;
+					/* Last NextJobId in journal */
+static unsigned char	*journal_buffer = NULL;
+					/* Record buffer */
+static size_t		journal_bufsize = 0;
+					/* Size of record buffer */
+static cups_array_t	*compress_jobs = NULL;
+					/* Jobs waiting to be compressed */
+static cupsd_job_t	*compress_job = NULL;
+					/* Job being compressed */
+static int		compress_file = 0,
+					/* Index of file being compressed */
+			compress_level = 0,
+					/* Compression level for job */
+			compress_in = -1;
+					/* File being compressed */
+static cups_file_t	*compress_out = NULL;
+					/* Compressed copy of file */
+static char		compress_temp[1024] = "";
+					/* Compressed copy filename */
+static double		compress_cpu = 0.0;
+					/* CPU time used for current file */
 static mime_filter_t	gziptoany_filter =
 			{
 			  NULL,		/* Source type */
@@ -118,26 +218,54 @@ static mime_filter_t	gziptoany_filter =
  * Local functions...
  */
 
+static void	check_job_timers(cupsd_job_t *job, time_t curtime);
+static void	close_stream(cupsd_job_t *job);
 static int	compare_active_jobs(void *first, void *second, void *data);
 static int	compare_jobs(void *first, void *second, void *data);
+static int	compare_jobrecs(cupsd_jobrec_t *a, cupsd_jobrec_t *b);
+static int	compare_timers(cupsd_jobtimer_t *a, cupsd_jobtimer_t *b);
+static int	compression_level(cupsd_job_t *job);
 static void	dump_job_history(cupsd_job_t *job);
+static unsigned char *encode_job(cupsd_job_t *job, size_t *length);
+static int	get_journal_int(const unsigned char **dataptr,
+		                const unsigned char *dataend, int *value);
+static int	get_journal_string(const unsigned char **dataptr,
+		                   const unsigned char *dataend, char *buffer,
+				   size_t bufsize);
 static void	finalize_job(cupsd_job_t *job, int set_job_state);
 static void	free_job_history(cupsd_job_t *job);
 static char	*get_options(cupsd_job_t *job, int banner_page, char *copies,
 		             size_t copies_size, char *title,
 			     size_t title_size);
 static size_t	ipp_length(ipp_t *ipp);
+static unsigned	journal_hash(const unsigned char *data, size_t length,
+		             unsigned hash);
 static void	load_job_cache(const char *filename);
+static int	load_job_journal(const char *filename, int next_id_only);
+static void	load_job_summary(cupsd_jobrec_t *rec);
 static void	load_next_job_id(const char *filename);
 static void	load_request_root(void);
 static void	remove_job_files(cupsd_job_t *job);
+static unsigned char *put_journal_int(unsigned char *bufptr, int value);
+static unsigned char *put_journal_string(unsigned char *bufptr,
+		                         const char *s);
+static void	queue_compression(cupsd_job_t *job);
+static int	read_journal(cups_file_t *fp, int *type, int *id,
+		             size_t *length);
 static void	remove_job_history(cupsd_job_t *job);
+static void	save_job_journal(void);
 static void	set_time(cupsd_job_t *job, const char *name);
 static void	start_job(cupsd_job_t *job, cupsd_printer_t *printer);
+static int	start_stream(cupsd_job_t *job, const char *filename,
+		             int fds[2]);
+static void	stop_compression(cupsd_job_t *job);
 static void	stop_job(cupsd_job_t *job, cupsd_jobaction_t action);
 static void	unload_job(cupsd_job_t *job);
 static void	update_job(cupsd_job_t *job);
 static void	update_job_attrs(cupsd_job_t *job, int do_message);
+static int	write_journal(cups_file_t *fp, int type, int id,
+		              const unsigned char *data, size_t length);
+static void	write_stream(cupsd_job_t *job);
 
 
 /*
@@ -164,6 +292,7 @@ cupsdAddJob(int        priority,	/* I - Job priority */
   job->side_pipes[1]   = -1;
   job->status_pipes[0] = -1;
   job->status_pipes[1] = -1;
+  job->summary_dirty   = 1;
 
   cupsdSetString(&job->dest, dest);
 
@@ -230,175 +359,227 @@ cupsdCheckJobs(void)
 			*pclass;	/* Printer class destination */
   ipp_attribute_t	*attr;		/* Job attribute */
   time_t		curtime;	/* Current time */
+  cupsd_jobtimer_t	*timer;		/* Current timer */
+  cups_array_t		*expired,	/* Expired timers */
+			*busy;		/* Destinations that can't print now */
+  int			pending,	/* Number of jobs still waiting */
+			started;	/* Did we start the current job? */
+  double		start;		/* Start time for statistics */
 
 
   curtime = time(NULL);
+  start   = cupsdGetStatTime();
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2,
-                  "cupsdCheckJobs: %d active jobs, sleeping=%d, reload=%d, "
-                  "curtime=%ld", cupsArrayCount(ActiveJobs), Sleeping,
-                  NeedReload, (long)curtime);
+                  "cupsdCheckJobs: %d active jobs, %d timers, sleeping=%d, "
+                  "reload=%d, curtime=%ld", cupsArrayCount(ActiveJobs),
+                  cupsArrayCount(job_timers), Sleeping, NeedReload,
+                  (long)curtime);
 
-  for (job = (cupsd_job_t *)cupsArrayFirst(ActiveJobs);
-       job;
-       job = (cupsd_job_t *)cupsArrayNext(ActiveJobs))
+ /*
+  * Collect the jobs whose timers have expired.  Timers are only queued when
+  * the kill, cancel, or hold time of a job changes, so this only touches the
+  * jobs that actually need attention...
+  */
+
+  expired = NULL;
+
+  while ((timer = (cupsd_jobtimer_t *)cupsArrayFirst(job_timers)) != NULL &&
+         timer->time < curtime)
   {
-    cupsdLogMessage(CUPSD_LOG_DEBUG2,
-                    "cupsdCheckJobs: Job %d - dest=\"%s\", printer=%p, "
-                    "state=%d, cancel_time=%ld, hold_until=%ld, kill_time=%ld, "
-                    "pending_cost=%d, pending_timeout=%ld", job->id, job->dest,
-                    job->printer, job->state_value, (long)job->cancel_time,
-                    (long)job->hold_until, (long)job->kill_time,
-                    job->pending_cost, (long)job->pending_timeout);
+    cupsArrayRemove(job_timers, timer);
 
-   /*
-    * Kill jobs if they are unresponsive...
-    */
+    if (!expired)
+      expired = cupsArrayNew(NULL, NULL);
 
-    if (job->kill_time && job->kill_time <= curtime)
-    {
-      if (!job->completed)
-        cupsdLogJob(job, CUPSD_LOG_ERROR, "Stopping unresponsive job.");
+    cupsArrayAdd(expired, timer);
+  }
 
-      stop_job(job, CUPSD_JOB_FORCE);
-      continue;
-    }
+  JobTimerUpdate = timer ? timer->time : 0;
 
+  for (timer = (cupsd_jobtimer_t *)cupsArrayFirst(expired);
+       timer;
+       timer = (cupsd_jobtimer_t *)cupsArrayNext(expired))
+  {
    /*
-    * Cancel stuck jobs...
+    * Look the job up by ID since an earlier state change may have deleted
+    * it, and then re-queue any timers that are still set...
     */
 
-    if (job->cancel_time && job->cancel_time <= curtime)
+    if ((job = cupsdFindJob(timer->id)) == NULL)
+      continue;
+
+    if (!cupsArrayFind(ActiveJobs, job))
     {
-      int cancel_after;			/* job-cancel-after value */
+     /*
+      * Canceled and aborted jobs leave the active list right away, but their
+      * processes may still need to be killed...
+      */
 
-      attr         = ippFindAttribute(job->attrs, "job-cancel-after", IPP_TAG_INTEGER);
-      cancel_after = attr ? ippGetInteger(attr, 0) : MaxJobTime;
+      if (job->kill_time && job->kill_time <= curtime &&
+          cupsArrayFind(PrintingJobs, job))
+      {
+	cupsdLogJob(job, CUPSD_LOG_ERROR, "Stopping unresponsive job.");
+	stop_job(job, CUPSD_JOB_FORCE);
+      }
 
-      if (job->completed)
-	cupsdSetJobState(job, IPP_JOB_CANCELED, CUPSD_JOB_FORCE, "Marking stuck job as completed after %d seconds.", cancel_after);
-      else
-	cupsdSetJobState(job, IPP_JOB_CANCELED, CUPSD_JOB_DEFAULT, "Canceling stuck job after %d seconds.", cancel_after);
       continue;
     }
 
-   /*
-    * Start held jobs if they are ready...
-    */
-
-    if (job->state_value == IPP_JOB_HELD &&
-        job->hold_until &&
-	job->hold_until < curtime)
-    {
-      if (job->pending_timeout)
-      {
-       /*
-        * This job is pending; check that we don't have an active Send-Document
-	* operation in progress on any of the client connections, then timeout
-	* the job so we can start printing...
-	*/
+    check_job_timers(job, curtime);
 
-        cupsd_client_t	*con;		/* Current client connection */
+    if ((job = cupsdFindJob(timer->id)) != NULL &&
+        cupsArrayFind(ActiveJobs, job))
+      cupsdUpdateJobTimers(job);
+  }
 
-	for (con = (cupsd_client_t *)cupsArrayFirst(Clients);
-	     con;
-	     con = (cupsd_client_t *)cupsArrayNext(Clients))
-	  if (con->request &&
-	      con->request->request.op.operation_id == IPP_SEND_DOCUMENT)
-	    break;
+  for (timer = (cupsd_jobtimer_t *)cupsArrayFirst(expired);
+       timer;
+       timer = (cupsd_jobtimer_t *)cupsArrayNext(expired))
+    free(timer);
 
-        if (con)
-	  continue;
+  cupsArrayDelete(expired);
 
-        if (cupsdTimeoutJob(job))
-	  continue;
-      }
+ /*
+  * Then dispatch pending jobs.  Destinations are resolved at most once per
+  * pass - once a printer or class is known to be busy, the remaining jobs
+  * for it are skipped without another lookup...
+  */
 
-      cupsdSetJobState(job, IPP_JOB_PENDING, CUPSD_JOB_DEFAULT,
-                       "Job submission timed out.");
-    }
+  busy    = NULL;
+  pending = 0;
 
+  for (job = (cupsd_job_t *)cupsArrayFirst(ActiveJobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(ActiveJobs))
+  {
    /*
     * Continue jobs that are waiting on the FilterLimit...
     */
 
-    if (job->pending_cost > 0 &&
-	((FilterLevel + job->pending_cost) < FilterLimit || FilterLevel == 0))
-      cupsdContinueJob(job);
+    if (job->pending_cost > 0)
+    {
+      if ((FilterLevel + job->pending_cost) < FilterLimit || FilterLevel == 0)
+        cupsdContinueJob(job);
+
+      if (job->pending_cost > 0)
+        pending ++;
+    }
 
    /*
     * Start pending jobs if the destination is available...
     */
 
-    if (job->state_value == IPP_JOB_PENDING && !NeedReload &&
-        !Sleeping && !DoingShutdown && !job->printer)
+    if (job->state_value != IPP_JOB_PENDING || NeedReload || Sleeping ||
+        DoingShutdown || job->printer)
+      continue;
+
+    if (busy && cupsArrayFind(busy, job->dest))
+    {
+      pending ++;
+      continue;
+    }
+
+    cupsdLogMessage(CUPSD_LOG_DEBUG2,
+                    "cupsdCheckJobs: Job %d - dest=\"%s\", printer=%p, "
+                    "state=%d, cancel_time=%ld, hold_until=%ld, kill_time=%ld, "
+                    "pending_cost=%d, pending_timeout=%ld", job->id, job->dest,
+                    job->printer, job->state_value, (long)job->cancel_time,
+                    (long)job->hold_until, (long)job->kill_time,
+                    job->pending_cost, (long)job->pending_timeout);
+
+    printer = cupsdFindDest(job->dest);
+    pclass  = NULL;
+    started = 0;
+
+    while (printer && (printer->type & CUPS_PRINTER_CLASS))
+    {
+     /*
+      * If the class is remote, just pass it to the remote server...
+      */
+
+      pclass = printer;
+
+      if (pclass->state == IPP_PRINTER_STOPPED)
+	printer = NULL;
+      else if (pclass->type & CUPS_PRINTER_REMOTE)
+	break;
+      else
+	printer = cupsdFindAvailablePrinter(printer->name);
+    }
+
+    if (!printer && !pclass)
+    {
+     /*
+      * Whoa, the printer and/or class for this destination went away;
+      * cancel the job...
+      */
+
+      cupsdSetJobState(job, IPP_JOB_ABORTED, CUPSD_JOB_PURGE,
+		       "Job aborted because the destination printer/class "
+		       "has gone away.");
+      continue;
+    }
+    else if (printer && !printer->holding_new_jobs)
     {
-      printer = cupsdFindDest(job->dest);
-      pclass  = NULL;
+     /*
+      * See if the printer is available or remote and not printing a job;
+      * if so, start the job...
+      */
 
-      while (printer && (printer->type & CUPS_PRINTER_CLASS))
+      if (pclass)
       {
        /*
-        * If the class is remote, just pass it to the remote server...
+	* Add/update a job-actual-printer-uri attribute for this job
+	* so that we know which printer actually printed the job...
 	*/
 
-        pclass = printer;
-
-        if (pclass->state == IPP_PRINTER_STOPPED)
-	  printer = NULL;
-        else if (pclass->type & CUPS_PRINTER_REMOTE)
-	  break;
+	if ((attr = ippFindAttribute(job->attrs, "job-actual-printer-uri",
+				     IPP_TAG_URI)) != NULL)
+	  cupsdSetString(&attr->values[0].string.text, printer->uri);
 	else
-	  printer = cupsdFindAvailablePrinter(printer->name);
+	  ippAddString(job->attrs, IPP_TAG_JOB, IPP_TAG_URI,
+		       "job-actual-printer-uri", NULL, printer->uri);
+
+	job->dirty = 1;
+	cupsdMarkDirty(CUPSD_DIRTY_JOBS);
       }
 
-      if (!printer && !pclass)
+      if (!printer->job && printer->state == IPP_PRINTER_IDLE &&
+          !printer->ppd_load && !(job->incoming && printer->remote))
       {
        /*
-        * Whoa, the printer and/or class for this destination went away;
-	* cancel the job...
+	* Start the job (remote printers get the document once it has been
+	* received)...
 	*/
 
-        cupsdSetJobState(job, IPP_JOB_ABORTED, CUPSD_JOB_PURGE,
-	                 "Job aborted because the destination printer/class "
-			 "has gone away.");
+	start_job(job, printer);
+	started = 1;
       }
-      else if (printer && !printer->holding_new_jobs)
-      {
-       /*
-        * See if the printer is available or remote and not printing a job;
-	* if so, start the job...
-	*/
+    }
 
-        if (pclass)
-	{
-	 /*
-	  * Add/update a job-actual-printer-uri attribute for this job
-	  * so that we know which printer actually printed the job...
-	  */
+    if (!started)
+      pending ++;
 
-          if ((attr = ippFindAttribute(job->attrs, "job-actual-printer-uri",
-	                               IPP_TAG_URI)) != NULL)
-            cupsdSetString(&attr->values[0].string.text, printer->uri);
-	  else
-	    ippAddString(job->attrs, IPP_TAG_JOB, IPP_TAG_URI,
-	                 "job-actual-printer-uri", NULL, printer->uri);
+   /*
+    * A local class may still have other idle members, otherwise nothing more
+    * can be started on this destination during this pass...
+    */
 
-          job->dirty = 1;
-          cupsdMarkDirty(CUPSD_DIRTY_JOBS);
-	}
+    if (pclass && printer && !(pclass->type & CUPS_PRINTER_REMOTE))
+      continue;
 
-        if (!printer->job && printer->state == IPP_PRINTER_IDLE)
-        {
-	 /*
-	  * Start the job...
-	  */
+    if (!busy)
+      busy = cupsArrayNew((cups_array_func_t)_cups_strcasecmp, NULL);
 
-	  start_job(job, printer);
-	}
-      }
-    }
+    cupsArrayAdd(busy, pclass ? pclass->name : printer->name);
   }
+
+  cupsArrayDelete(busy);
+
+  PendingJobCount = pending;
+
+  cupsdAddStat(&CheckJobsStats, start);
 }
 
 
@@ -463,6 +644,210 @@ cupsdCleanJobs(void)
 }
 
 
+/*
+ * 'cupsdCompressJobFiles()' - Compress the next part of a preserved job file.
+ */
+
+void
+cupsdCompressJobFiles(void)
+{
+  cupsd_job_t	*job;			/* Current job */
+  ssize_t	bytes;			/* Bytes read */
+  size_t	total;			/* Bytes compressed by this call */
+  char		filename[1024],		/* Job filename */
+		mode[3],		/* Compression mode */
+		buffer[32768];		/* Copy buffer */
+  struct stat	srcinfo,		/* Original file information */
+		dstinfo;		/* Compressed file information */
+  struct rusage	start,			/* CPU usage before compressing */
+		end;			/* CPU usage after compressing */
+
+
+ /*
+  * Find the next job that has finished printing...
+  */
+
+  while (!compress_job)
+  {
+    for (job = (cupsd_job_t *)cupsArrayFirst(compress_jobs);
+         job && job->printer;
+	 job = (cupsd_job_t *)cupsArrayNext(compress_jobs));
+
+    if (!job)
+      return;
+
+    cupsArrayRemove(compress_jobs, job);
+
+    if (job->state_value >= IPP_JOB_CANCELED && job->num_files > 0 &&
+        (compress_level = compression_level(job)) > 0)
+    {
+      compress_job  = job;
+      compress_file = 0;
+    }
+  }
+
+  job = compress_job;
+
+  if (job->state_value < IPP_JOB_CANCELED || job->printer)
+  {
+   /*
+    * The job has been restarted, leave its files alone...
+    */
+
+    stop_compression(job);
+    return;
+  }
+
+  getrusage(RUSAGE_SELF, &start);
+
+  snprintf(filename, sizeof(filename), "%s/d%05d-%03d", RequestRoot, job->id,
+           compress_file + 1);
+
+  if (!compress_out)
+  {
+   /*
+    * Open the next uncompressed file...
+    */
+
+    while (compress_file < job->num_files && job->compressions[compress_file])
+      compress_file ++;
+
+    if (compress_file >= job->num_files)
+    {
+      compress_job = NULL;
+      return;
+    }
+
+    snprintf(filename, sizeof(filename), "%s/d%05d-%03d", RequestRoot,
+             job->id, compress_file + 1);
+    snprintf(compress_temp, sizeof(compress_temp), "%s/d%05d-%03d.gz.N",
+             RequestRoot, job->id, compress_file + 1);
+    snprintf(mode, sizeof(mode), "w%d", compress_level);
+
+    if ((compress_in = open(filename, O_RDONLY)) < 0)
+    {
+      cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to open \"%s\" - %s",
+                  filename, strerror(errno));
+      compress_file ++;
+      return;
+    }
+
+    fcntl(compress_in, F_SETFD, fcntl(compress_in, F_GETFD) | FD_CLOEXEC);
+
+    if ((compress_out = cupsFileOpen(compress_temp, mode)) == NULL)
+    {
+      cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to create \"%s\" - %s",
+                  compress_temp, strerror(errno));
+      stop_compression(job);
+      return;
+    }
+
+    fchmod(cupsFileNumber(compress_out), 0640);
+    fchown(cupsFileNumber(compress_out), RunUser, Group);
+    fcntl(cupsFileNumber(compress_out), F_SETFD,
+          fcntl(cupsFileNumber(compress_out), F_GETFD) | FD_CLOEXEC);
+
+    compress_cpu = 0.0;
+  }
+
+ /*
+  * Compress the next slice of the file...
+  */
+
+  for (total = 0; total < CUPSD_COMPRESS_SLICE; total += (size_t)bytes)
+  {
+    if ((bytes = read(compress_in, buffer, sizeof(buffer))) <= 0)
+      break;
+
+    if (cupsFileWrite(compress_out, buffer, (size_t)bytes) < 0)
+    {
+      bytes = -1;
+      break;
+    }
+  }
+
+  getrusage(RUSAGE_SELF, &end);
+
+  compress_cpu += end.ru_utime.tv_sec - start.ru_utime.tv_sec +
+                  end.ru_stime.tv_sec - start.ru_stime.tv_sec +
+		  0.000001 * (end.ru_utime.tv_usec - start.ru_utime.tv_usec +
+		              end.ru_stime.tv_usec - start.ru_stime.tv_usec);
+
+  if (bytes > 0)
+    return;
+
+  SpoolCompressTime += compress_cpu;
+
+  if (bytes < 0)
+  {
+    cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to compress \"%s\" - %s",
+                filename, strerror(errno));
+    stop_compression(job);
+    return;
+  }
+
+ /*
+  * Finished the file, replace the original if the compressed copy is
+  * smaller...
+  */
+
+  close(compress_in);
+  compress_in = -1;
+
+  if (cupsFileClose(compress_out))
+  {
+    compress_out = NULL;
+
+    cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to write \"%s\" - %s",
+                compress_temp, strerror(errno));
+    stop_compression(job);
+    return;
+  }
+
+  compress_out = NULL;
+
+  if (stat(filename, &srcinfo) || stat(compress_temp, &dstinfo))
+  {
+    cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to compress \"%s\" - %s",
+                filename, strerror(errno));
+    unlink(compress_temp);
+  }
+  else if (dstinfo.st_size >= srcinfo.st_size)
+  {
+    cupsdLogJob(job, CUPSD_LOG_DEBUG,
+                "Document %d did not compress (" CUPS_LLFMT " bytes).",
+		compress_file + 1, CUPS_LLCAST srcinfo.st_size);
+    unlink(compress_temp);
+  }
+  else if (rename(compress_temp, filename))
+  {
+    cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to rename \"%s\" - %s",
+                compress_temp, strerror(errno));
+    unlink(compress_temp);
+  }
+  else
+  {
+    job->compressions[compress_file] = CUPS_FILE_GZIP;
+    job->summary_dirty               = 1;
+
+    SpoolCompressedFiles ++;
+    SpoolBytesIn  += srcinfo.st_size;
+    SpoolBytesOut += dstinfo.st_size;
+
+    cupsdLogJob(job, CUPSD_LOG_INFO,
+                "Compressed document %d from " CUPS_LLFMT " to " CUPS_LLFMT
+		" bytes (%d%% saved, %.3f seconds CPU).", compress_file + 1,
+		CUPS_LLCAST srcinfo.st_size, CUPS_LLCAST dstinfo.st_size,
+		(int)(100 - 100 * dstinfo.st_size / srcinfo.st_size),
+		compress_cpu);
+
+    cupsdMarkDirty(CUPSD_DIRTY_JOBS);
+  }
+
+  compress_file ++;
+}
+
+
 /*
  * 'cupsdContinueJob()' - Continue printing with the next file in a job.
  */
@@ -878,7 +1263,21 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
   {
     snprintf(filename, sizeof(filename), "%s/d%05d-%03d", RequestRoot,
              job->id, job->current_file + 1);
-    argv[6] = strdup(filename);
+
+   /*
+    * A document that is still being received is fed to the first filter
+    * through a pipe...
+    */
+
+    if (job->incoming != job->current_file + 1 || job->printer->remote)
+      argv[6] = strdup(filename);
+    else if (!start_stream(job, filename, filterfds[1]))
+    {
+      abort_message = "Stopping job because the scheduler could not create "
+		      "the filter pipes.";
+
+      goto abort_job;
+    }
   }
 
   for (i = 0; argv[i]; i ++)
@@ -1268,6 +1667,9 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
 
   cupsdClosePipe(filterfds[slot]);
 
+  if (!i)
+    cupsdClosePipe(filterfds[1]);	/* Streamed document with no filters */
+
   for (i = 6; i < argc; i ++)
     if (argv[i])
       free(argv[i]);
@@ -1299,6 +1701,8 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
   for (slot = 0; slot < 2; slot ++)
     cupsdClosePipe(filterfds[slot]);
 
+  close_stream(job);
+
   cupsArrayDelete(filters);
 
   if (argv)
@@ -1356,6 +1760,8 @@ cupsdDeleteJob(cupsd_job_t       *job,	/* I - Job */
   if (job->printer)
     finalize_job(job, 1);
 
+  stop_compression(job);
+
   if (action == CUPSD_JOB_PURGE)
     remove_job_history(job);
 
@@ -1382,6 +1788,16 @@ cupsdDeleteJob(cupsd_job_t       *job,	/* I - Job */
 
   unload_job(job);
 
+  if (journal_fp && job->journal_hash)
+  {
+   /*
+    * Record the deletion in the job journal...
+    */
+
+    write_journal(journal_fp, CUPSD_JREC_DELETE, job->id, NULL, 0);
+    cupsdMarkDirty(CUPSD_DIRTY_JOBS);
+  }
+
   cupsArrayRemove(Jobs, job);
   cupsArrayRemove(ActiveJobs, job);
   cupsArrayRemove(PrintingJobs, job);
@@ -1408,6 +1824,17 @@ cupsdFreeAllJobs(void)
   cupsdStopAllJobs(CUPSD_JOB_FORCE, 0);
   cupsdSaveAllJobs();
 
+ /*
+  * Close the journal so that freeing the jobs doesn't record them as
+  * deleted...
+  */
+
+  if (journal_fp)
+  {
+    cupsFileClose(journal_fp);
+    journal_fp = NULL;
+  }
+
   for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
        job;
        job = (cupsd_job_t *)cupsArrayNext(Jobs))
@@ -1486,9 +1913,12 @@ cupsdGetUserJobCount(
 void
 cupsdLoadAllJobs(void)
 {
-  char		filename[1024];		/* Full filename of job.cache file */
-  struct stat	fileinfo,		/* Information on job.cache file */
+  char		filename[1024],		/* Full filename of job.journal file */
+		cachename[1024];	/* Full filename of job.cache file */
+  struct stat	fileinfo,		/* Information on job.journal file */
 		dirinfo;		/* Information on RequestRoot dir */
+  int		journal;		/* Have a job.journal file? */
+  cupsd_job_t	*job;			/* Current job */
 
 
 
@@ -1506,19 +1936,33 @@ cupsdLoadAllJobs(void)
     PrintingJobs = cupsArrayNew(compare_jobs, NULL);
 
  /*
-  * See whether the job.cache file is older than the RequestRoot directory...
+  * See whether the job.journal file (or the job.cache file from an older
+  * version of CUPS) is older than the RequestRoot directory...
   */
 
-  snprintf(filename, sizeof(filename), "%s/job.cache", CacheDir);
+  snprintf(filename, sizeof(filename), "%s/job.journal", CacheDir);
+  snprintf(cachename, sizeof(cachename), "%s/job.cache", CacheDir);
 
-  if (stat(filename, &fileinfo))
+  if (!stat(filename, &fileinfo))
+    journal = 1;
+  else
   {
-    fileinfo.st_mtime = 0;
+    journal = 0;
 
     if (errno != ENOENT)
       cupsdLogMessage(CUPSD_LOG_ERROR,
                       "Unable to get file information for \"%s\" - %s",
 		      filename, strerror(errno));
+
+    if (stat(cachename, &fileinfo))
+    {
+      fileinfo.st_mtime = 0;
+
+      if (errno != ENOENT)
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+			"Unable to get file information for \"%s\" - %s",
+			cachename, strerror(errno));
+    }
   }
 
   if (stat(RequestRoot, &dirinfo))
@@ -1539,10 +1983,20 @@ cupsdLoadAllJobs(void)
   {
     load_request_root();
 
-    load_next_job_id(filename);
+    if (journal)
+      load_job_journal(filename, 1);
+    else
+      load_next_job_id(cachename);
+
+    save_job_journal();
   }
+  else if (journal)
+    load_job_journal(filename, 0);
   else
-    load_job_cache(filename);
+  {
+    load_job_cache(cachename);
+    save_job_journal();
+  }
 
  /*
   * Clean out old jobs as needed...
@@ -1550,6 +2004,16 @@ cupsdLoadAllJobs(void)
 
   if (MaxJobs > 0 && cupsArrayCount(Jobs) >= MaxJobs)
     cupsdCleanJobs();
+
+ /*
+  * Compress any preserved files that were left uncompressed...
+  */
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(Jobs))
+    if (job->state_value >= IPP_JOB_CANCELED)
+      queue_compression(job);
 }
 
 
@@ -1624,6 +2088,9 @@ cupsdLoadJob(cupsd_job_t *job)		/* I - Job */
     goto error;
   }
 
+  if (job->state_value != (ipp_jstate_t)job->state->values[0].integer)
+    job->summary_dirty = 1;
+
   job->state_value  = (ipp_jstate_t)job->state->values[0].integer;
   job->file_time    = 0;
   job->history_time = 0;
@@ -1675,6 +2142,8 @@ cupsdLoadJob(cupsd_job_t *job)		/* I - Job */
     }
 
     cupsdSetString(&job->dest, dest);
+
+    job->summary_dirty = 1;
   }
   else if ((destptr = cupsdFindDest(job->dest)) == NULL)
   {
@@ -1760,7 +2229,8 @@ cupsdLoadJob(cupsd_job_t *job)		/* I - Job */
       goto error;
     }
 
-    job->priority = attr->values[0].integer;
+    job->priority      = attr->values[0].integer;
+    job->summary_dirty = 1;
   }
 
   if (!job->username)
@@ -1775,6 +2245,8 @@ cupsdLoadJob(cupsd_job_t *job)		/* I - Job */
     }
 
     cupsdSetString(&job->username, attr->values[0].string.text);
+
+    job->summary_dirty = 1;
   }
 
  /*
@@ -1793,12 +2265,14 @@ cupsdLoadJob(cupsd_job_t *job)		/* I - Job */
     {
       job->state->values[0].integer = IPP_JOB_PENDING;
       job->state_value              = IPP_JOB_PENDING;
+      job->summary_dirty            = 1;
     }
   }
   else if (job->state_value == IPP_JOB_PROCESSING)
   {
     job->state->values[0].integer = IPP_JOB_PENDING;
     job->state_value              = IPP_JOB_PENDING;
+    job->summary_dirty            = 1;
   }
 
   if (!job->num_files)
@@ -1864,7 +2338,8 @@ cupsdLoadJob(cupsd_job_t *job)		/* I - Job */
 	  return (0);
 	}
 
-	job->num_files = fileid;
+	job->num_files     = fileid;
+	job->summary_dirty = 1;
       }
 
       job->filetypes[fileid - 1] = mimeFileType(MimeDatabase, jobfile, NULL,
@@ -2009,7 +2484,8 @@ cupsdMoveJob(cupsd_job_t     *job,	/* I - Job */
 		p->name);
 
   cupsdSetString(&job->dest, p->name);
-  job->dtype = p->type & (CUPS_PRINTER_CLASS | CUPS_PRINTER_REMOTE);
+  job->dtype         = p->type & (CUPS_PRINTER_CLASS | CUPS_PRINTER_REMOTE);
+  job->summary_dirty = 1;
 
   if ((attr = ippFindAttribute(job->attrs, "job-printer-uri",
                                IPP_TAG_URI)) != NULL)
@@ -2024,6 +2500,30 @@ cupsdMoveJob(cupsd_job_t     *job,	/* I - Job */
 }
 
 
+/*
+ * 'cupsdNeedJobCompression()' - Report whether preserved files are waiting to
+ *                               be compressed.
+ */
+
+int					/* O - 1 if files are waiting, 0 otherwise */
+cupsdNeedJobCompression(void)
+{
+  cupsd_job_t	*job;			/* Current job */
+
+
+  if (compress_job)
+    return (1);
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(compress_jobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(compress_jobs))
+    if (!job->printer)
+      return (1);
+
+  return (0);
+}
+
+
 /*
  * 'cupsdReleaseJob()' - Release the specified job.
  */
@@ -2072,56 +2572,91 @@ cupsdRestartJob(cupsd_job_t *job)	/* I - Job */
 void
 cupsdSaveAllJobs(void)
 {
-  int		i;			/* Looping var */
-  cups_file_t	*fp;			/* job.cache file */
-  char		filename[1024],		/* job.cache filename */
-		temp[1024];		/* Temporary string */
   cupsd_job_t	*job;			/* Current job */
-  time_t	curtime;		/* Current time */
-  struct tm	*curdate;		/* Current date */
+  unsigned char	*data;			/* Job summary */
+  size_t	length;			/* Length of job summary */
+  unsigned	hash;			/* Hash of job summary */
+  int		records;		/* Number of records written */
 
 
-  snprintf(filename, sizeof(filename), "%s/job.cache", CacheDir);
-  if ((fp = cupsdCreateConfFile(filename, ConfigFilePerm)) == NULL)
-    return;
+ /*
+  * Write a new copy of the journal if we don't have one open or it has
+  * collected too many stale records...
+  */
 
-  cupsdLogMessage(CUPSD_LOG_INFO, "Saving job.cache...");
+  if (!journal_fp ||
+      journal_records > (2 * cupsArrayCount(Jobs) + 1024))
+  {
+    save_job_journal();
+    return;
+  }
 
  /*
-  * Write a small header to the file...
+  * Otherwise append a record for every job whose summary has changed.  The
+  * summary_dirty flag is set whenever one of the fields in the summary is
+  * changed, so only those jobs need to be encoded...
   */
 
-  curtime = time(NULL);
-  curdate = localtime(&curtime);
-  strftime(temp, sizeof(temp) - 1, "%Y-%m-%d %H:%M", curdate);
+  records = 0;
 
-  cupsFilePuts(fp, "# Job cache file for " CUPS_SVERSION "\n");
-  cupsFilePrintf(fp, "# Written by cupsd on %s\n", temp);
-  cupsFilePrintf(fp, "NextJobId %d\n", NextJobId);
+  if (NextJobId != journal_next_id)
+  {
+    if (write_journal(journal_fp, CUPSD_JREC_NEXTID, NextJobId, NULL, 0))
+      goto error;
 
- /*
-  * Write each job known to the system...
-  */
+    journal_next_id = NextJobId;
+    records ++;
+  }
 
   for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
        job;
        job = (cupsd_job_t *)cupsArrayNext(Jobs))
   {
-    cupsFilePrintf(fp, "<Job %d>\n", job->id);
-    cupsFilePrintf(fp, "State %d\n", job->state_value);
-    cupsFilePrintf(fp, "Priority %d\n", job->priority);
-    cupsFilePrintf(fp, "HoldUntil %d\n", (int)job->hold_until);
-    cupsFilePrintf(fp, "Username %s\n", job->username);
-    cupsFilePrintf(fp, "Destination %s\n", job->dest);
-    cupsFilePrintf(fp, "DestType %d\n", job->dtype);
-    cupsFilePrintf(fp, "NumFiles %d\n", job->num_files);
-    for (i = 0; i < job->num_files; i ++)
-      cupsFilePrintf(fp, "File %d %s/%s %d\n", i + 1, job->filetypes[i]->super,
-                     job->filetypes[i]->type, job->compressions[i]);
-    cupsFilePuts(fp, "</Job>\n");
+    if (!job->summary_dirty)
+      continue;
+
+    if ((data = encode_job(job, &length)) == NULL)
+    {
+      job->summary_dirty = 0;
+      continue;
+    }
+
+    if ((hash = journal_hash(data, length, CUPSD_JOURNAL_SEED)) !=
+            job->journal_hash)
+    {
+      if (write_journal(journal_fp, CUPSD_JREC_JOB, job->id, data, length))
+	goto error;
+
+      job->journal_hash = hash;
+      records ++;
+    }
+
+    job->summary_dirty = 0;
   }
 
-  cupsdCloseCreatedConfFile(fp, filename);
+  if (cupsFileFlush(journal_fp))
+    goto error;
+
+  if (SyncOnClose && fsync(cupsFileNumber(journal_fp)))
+    goto error;
+
+  journal_records += records;
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG, "Saved %d records to job.journal.",
+                  records);
+  return;
+
+ /*
+  * If we get here, we were unable to append to the journal - try writing a
+  * new copy...
+  */
+
+  error:
+
+  cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to write to job.journal: %s",
+                  strerror(errno));
+
+  save_job_journal();
 }
 
 
@@ -2343,6 +2878,10 @@ cupsdSetJobHoldUntil(cupsd_job_t *job,	/* I - Job */
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdSetJobHoldUntil: hold_until=%d",
                   (int)job->hold_until);
+
+  job->summary_dirty = 1;
+
+  cupsdUpdateJobTimers(job);
 }
 
 
@@ -2372,7 +2911,8 @@ cupsdSetJobPriority(
 
   cupsArrayRemove(ActiveJobs, job);
 
-  job->priority = priority;
+  job->priority      = priority;
+  job->summary_dirty = 1;
 
   if ((attr = ippFindAttribute(job->attrs, "job-priority",
                                IPP_TAG_INTEGER)) != NULL)
@@ -2439,7 +2979,8 @@ cupsdSetJobState(
   * Set the new job state...
   */
 
-  job->state_value = newstate;
+  job->state_value   = newstate;
+  job->summary_dirty = 1;
 
   if (job->state)
     job->state->values[0].integer = newstate;
@@ -2526,6 +3067,8 @@ cupsdSetJobState(
         if (!cupsArrayFind(ActiveJobs, job))
 	  cupsArrayAdd(ActiveJobs, job);
 
+        cupsdUpdateJobTimers(job);
+
        /*
 	* Save the job state to disk...
 	*/
@@ -2602,11 +3145,14 @@ cupsdSetJobState(
 	if (JobHistory && action != CUPSD_JOB_PURGE)
 	{
 	 /*
-	  * Save job state info...
+	  * Save job state info and compress any preserved files...
 	  */
 
 	  job->dirty = 1;
 	  cupsdMarkDirty(CUPSD_DIRTY_JOBS);
+
+	  if (JobFiles)
+	    queue_compression(job);
 	}
 	else if (!job->printer)
 	{
@@ -2668,6 +3214,27 @@ cupsdStopAllJobs(
 }
 
 
+/*
+ * 'cupsdStreamJobData()' - Copy newly received document data to the filters.
+ *
+ * This is called whenever more of a streamed document has been written to
+ * the spool file and once the document has been received completely.
+ */
+
+void
+cupsdStreamJobData(cupsd_job_t *job)	/* I - Job */
+{
+  cupsd_jobstream_t	*stream;	/* Streamed document */
+
+
+  if ((stream = job->stream) == NULL || stream->selected)
+    return;
+
+  if (cupsdAddSelect(stream->pipe, NULL, (cupsd_selfunc_t)write_stream, job))
+    stream->selected = 1;
+}
+
+
 /*
  * 'cupsdUnloadCompletedJobs()' - Flush completed job history from memory.
  */
@@ -2695,6 +3262,57 @@ cupsdUnloadCompletedJobs(void)
 }
 
 
+/*
+ * 'cupsdUpdateJobTimers()' - Queue the kill, cancel, and hold timers for a job.
+ *
+ * This must be called whenever job->kill_time, job->cancel_time, or
+ * job->hold_until changes so that cupsdCheckJobs() sees the new time.  Stale
+ * timers are harmless - they just cause the job to be checked again.
+ */
+
+void
+cupsdUpdateJobTimers(cupsd_job_t *job)	/* I - Job */
+{
+  int			i;		/* Looping var */
+  time_t		times[3];	/* Timer values */
+  cupsd_jobtimer_t	key,		/* Search key */
+			*timer;		/* New timer */
+
+
+  if (!job_timers)
+    job_timers = cupsArrayNew((cups_array_func_t)compare_timers, NULL);
+
+  times[0] = job->kill_time;
+  times[1] = job->cancel_time;
+  times[2] = job->hold_until;
+
+  for (i = 0; i < 3; i ++)
+  {
+    if (!times[i])
+      continue;
+
+    key.time = times[i];
+    key.id   = job->id;
+
+    if (cupsArrayFind(job_timers, &key))
+      continue;
+
+    if ((timer = calloc(1, sizeof(cupsd_jobtimer_t))) == NULL)
+    {
+      cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to allocate memory for timer.");
+      continue;
+    }
+
+    *timer = key;
+
+    cupsArrayAdd(job_timers, timer);
+  }
+
+  timer          = (cupsd_jobtimer_t *)cupsArrayFirst(job_timers);
+  JobTimerUpdate = timer ? timer->time : 0;
+}
+
+
 /*
  * 'cupsdUpdateJobs()' - Update the history/file files for all jobs.
  */
@@ -2751,6 +3369,121 @@ cupsdUpdateJobs(void)
 }
 
 
+/*
+ * 'check_job_timers()' - Kill, cancel, or release a job whose timers expired.
+ */
+
+static void
+check_job_timers(cupsd_job_t *job,	/* I - Job */
+                 time_t      curtime)	/* I - Current time */
+{
+  ipp_attribute_t	*attr;		/* Job attribute */
+
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG2,
+		  "check_job_timers: Job %d - dest=\"%s\", printer=%p, "
+		  "state=%d, cancel_time=%ld, hold_until=%ld, kill_time=%ld, "
+		  "pending_cost=%d, pending_timeout=%ld", job->id, job->dest,
+		  job->printer, job->state_value, (long)job->cancel_time,
+		  (long)job->hold_until, (long)job->kill_time,
+		  job->pending_cost, (long)job->pending_timeout);
+
+ /*
+  * Kill jobs if they are unresponsive...
+  */
+
+  if (job->kill_time && job->kill_time <= curtime)
+  {
+    if (!job->completed)
+      cupsdLogJob(job, CUPSD_LOG_ERROR, "Stopping unresponsive job.");
+
+    stop_job(job, CUPSD_JOB_FORCE);
+    return;
+  }
+
+ /*
+  * Cancel stuck jobs...
+  */
+
+  if (job->cancel_time && job->cancel_time <= curtime)
+  {
+    int cancel_after;			/* job-cancel-after value */
+
+    attr         = ippFindAttribute(job->attrs, "job-cancel-after", IPP_TAG_INTEGER);
+    cancel_after = attr ? ippGetInteger(attr, 0) : MaxJobTime;
+
+    if (job->completed)
+      cupsdSetJobState(job, IPP_JOB_CANCELED, CUPSD_JOB_FORCE, "Marking stuck job as completed after %d seconds.", cancel_after);
+    else
+      cupsdSetJobState(job, IPP_JOB_CANCELED, CUPSD_JOB_DEFAULT, "Canceling stuck job after %d seconds.", cancel_after);
+    return;
+  }
+
+ /*
+  * Start held jobs if they are ready...
+  */
+
+  if (job->state_value == IPP_JOB_HELD &&
+      job->hold_until &&
+      job->hold_until < curtime)
+  {
+    if (job->pending_timeout)
+    {
+     /*
+      * This job is pending; check that we don't have an active Send-Document
+      * operation in progress on any of the client connections, then timeout
+      * the job so we can start printing...
+      */
+
+      cupsd_client_t	*con;		/* Current client connection */
+
+      for (con = (cupsd_client_t *)cupsArrayFirst(Clients);
+	   con;
+	   con = (cupsd_client_t *)cupsArrayNext(Clients))
+	if (con->request &&
+	    con->request->request.op.operation_id == IPP_SEND_DOCUMENT)
+	  break;
+
+      if (con)
+	return;
+
+      if (cupsdTimeoutJob(job))
+	return;
+    }
+
+    cupsdSetJobState(job, IPP_JOB_PENDING, CUPSD_JOB_DEFAULT,
+		     "Job submission timed out.");
+  }
+
+}
+
+
+/*
+ * 'close_stream()' - Stop copying a streamed document to the filters.
+ */
+
+static void
+close_stream(cupsd_job_t *job)		/* I - Job */
+{
+  cupsd_jobstream_t	*stream;	/* Streamed document */
+
+
+  if ((stream = job->stream) == NULL)
+    return;
+
+  cupsdLogJob(job, CUPSD_LOG_DEBUG,
+              "Streamed " CUPS_LLFMT " bytes of document to filters.",
+	      CUPS_LLCAST stream->offset);
+
+  cupsdRemoveSelect(stream->pipe);
+  close(stream->pipe);
+  close(stream->fd);
+  free(stream);
+
+  job->stream = NULL;
+}
+
+
 /*
  * 'compare_active_jobs()' - Compare the job IDs and priorities of two jobs.
  */
@@ -2773,6 +3506,18 @@ compare_active_jobs(void *first,	/* I - First job */
 }
 
 
+/*
+ * 'compare_jobrecs()' - Compare the job IDs of two journal summaries.
+ */
+
+static int				/* O - Difference */
+compare_jobrecs(cupsd_jobrec_t *a,	/* I - First summary */
+                cupsd_jobrec_t *b)	/* I - Second summary */
+{
+  return (a->id - b->id);
+}
+
+
 /*
  * 'compare_jobs()' - Compare the job IDs of two jobs.
  */
@@ -2788,6 +3533,57 @@ compare_jobs(void *first,		/* I - First job */
 }
 
 
+/*
+ * 'compare_timers()' - Compare the expiration times and job IDs of two timers.
+ */
+
+static int				/* O - Difference */
+compare_timers(cupsd_jobtimer_t *a,	/* I - First timer */
+               cupsd_jobtimer_t *b)	/* I - Second timer */
+{
+  if (a->time < b->time)
+    return (-1);
+  else if (a->time > b->time)
+    return (1);
+  else
+    return (a->id - b->id);
+}
+
+
+/*
+ * 'compression_level()' - Get the spool compression level for a job.
+ */
+
+static int				/* O - Compression level, 0 for none */
+compression_level(cupsd_job_t *job)	/* I - Job */
+{
+  cupsd_printer_t	*p;		/* Job destination */
+  int			level;		/* Compression level */
+
+
+  if ((p = cupsdFindDest(job->dest)) != NULL && p->spool_compression >= 0)
+    level = p->spool_compression;
+  else
+    level = SpoolCompression;
+
+ /*
+  * Compressed files are only uncompressed for remote queues when the job has
+  * a single document (see cupsdContinueJob)...
+  */
+
+  if (job->num_files > 1 &&
+      (!p || (p->type & (CUPS_PRINTER_CLASS | CUPS_PRINTER_REMOTE))))
+    return (0);
+
+  if (level < 0)
+    return (0);
+  else if (level > 9)
+    return (9);
+  else
+    return (level);
+}
+
+
 /*
  * 'dump_job_history()' - Dump any debug messages for a job.
  */
@@ -2923,45 +3719,122 @@ free_job_history(cupsd_job_t *job)	/* I - Job */
 
 
 /*
- * 'finalize_job()' - Cleanup after job filter processes and support data.
+ * 'encode_job()' - Encode the journal summary for a job.
+ *
+ * The summary is returned in a buffer that is reused by the next call.
  */
 
-static void
-finalize_job(cupsd_job_t *job,		/* I - Job */
-             int         set_job_state)	/* I - 1 = set the job state */
+static unsigned char *			/* O - Summary or NULL on error */
+encode_job(cupsd_job_t *job,		/* I - Job */
+           size_t      *length)		/* O - Length of summary */
 {
-  ipp_pstate_t		printer_state;	/* New printer state value */
-  ipp_jstate_t		job_state;	/* New job state value */
-  const char		*message;	/* Message for job state */
-  char			buffer[1024];	/* Buffer for formatted messages */
-
+  int			i;		/* Looping var */
+  size_t		bytes;		/* Bytes needed */
+  unsigned char		*bufptr;	/* Pointer into buffer */
+  const char		*strings[2];	/* Username and destination */
 
-  cupsdLogMessage(CUPSD_LOG_DEBUG2, "finalize_job(job=%p(%d))", job, job->id);
 
  /*
-  * Clear the "connecting-to-device" and "cups-waiting-for-job-completed"
-  * reasons, which are only valid when a printer is processing, along with any
-  * remote printing job state...
+  * Figure out how much space we need...
   */
 
-  cupsdSetPrinterReasons(job->printer, "-connecting-to-device,"
-                                       "cups-waiting-for-job-completed,"
-				       "cups-remote-pending,"
-				       "cups-remote-pending-held,"
-				       "cups-remote-processing,"
-				       "cups-remote-stopped,"
-				       "cups-remote-canceled,"
-				       "cups-remote-aborted,"
-				       "cups-remote-completed");
+  strings[0] = job->username ? job->username : "";
+  strings[1] = job->dest ? job->dest : "";
 
- /*
-  * Similarly, clear the "offline-report" reason for non-USB devices since we
-  * rarely have current information for network devices...
-  */
+  bytes = 20 + 2 + strlen(strings[0]) + 2 + strlen(strings[1]);
 
-  if (strncmp(job->printer->device_uri, "usb:", 4) &&
-      strncmp(job->printer->device_uri, "ippusb:", 7))
-    cupsdSetPrinterReasons(job->printer, "-offline-report");
+  for (i = 0; i < job->num_files; i ++)
+  {
+    if (!job->filetypes[i])
+      return (NULL);
+
+    bytes += 2 + strlen(job->filetypes[i]->super) + 2 +
+             strlen(job->filetypes[i]->type) + 4;
+  }
+
+  if (bytes > journal_bufsize)
+  {
+    unsigned char *temp;		/* New buffer */
+
+    if ((temp = realloc(journal_buffer, bytes + 1024)) == NULL)
+    {
+      cupsdLogJob(job, CUPSD_LOG_ERROR,
+                  "Unable to allocate memory for journal record.");
+      return (NULL);
+    }
+
+    journal_buffer  = temp;
+    journal_bufsize = bytes + 1024;
+  }
+
+ /*
+  * Then encode the summary with big-endian integers and length-prefixed
+  * strings...
+  */
+
+  bufptr = journal_buffer;
+
+  bufptr = put_journal_int(bufptr, job->state_value);
+  bufptr = put_journal_int(bufptr, job->priority);
+  bufptr = put_journal_int(bufptr, (int)job->hold_until);
+  bufptr = put_journal_int(bufptr, (int)job->dtype);
+  bufptr = put_journal_int(bufptr, job->num_files);
+  bufptr = put_journal_string(bufptr, strings[0]);
+  bufptr = put_journal_string(bufptr, strings[1]);
+
+  for (i = 0; i < job->num_files; i ++)
+  {
+    bufptr = put_journal_string(bufptr, job->filetypes[i]->super);
+    bufptr = put_journal_string(bufptr, job->filetypes[i]->type);
+    bufptr = put_journal_int(bufptr, job->compressions[i]);
+  }
+
+  *length = (size_t)(bufptr - journal_buffer);
+
+  return (journal_buffer);
+}
+
+
+/*
+ * 'finalize_job()' - Cleanup after job filter processes and support data.
+ */
+
+static void
+finalize_job(cupsd_job_t *job,		/* I - Job */
+             int         set_job_state)	/* I - 1 = set the job state */
+{
+  ipp_pstate_t		printer_state;	/* New printer state value */
+  ipp_jstate_t		job_state;	/* New job state value */
+  const char		*message;	/* Message for job state */
+  char			buffer[1024];	/* Buffer for formatted messages */
+
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "finalize_job(job=%p(%d))", job, job->id);
+
+ /*
+  * Clear the "connecting-to-device" and "cups-waiting-for-job-completed"
+  * reasons, which are only valid when a printer is processing, along with any
+  * remote printing job state...
+  */
+
+  cupsdSetPrinterReasons(job->printer, "-connecting-to-device,"
+                                       "cups-waiting-for-job-completed,"
+				       "cups-remote-pending,"
+				       "cups-remote-pending-held,"
+				       "cups-remote-processing,"
+				       "cups-remote-stopped,"
+				       "cups-remote-canceled,"
+				       "cups-remote-aborted,"
+				       "cups-remote-completed");
+
+ /*
+  * Similarly, clear the "offline-report" reason for non-USB devices since we
+  * rarely have current information for network devices...
+  */
+
+  if (strncmp(job->printer->device_uri, "usb:", 4) &&
+      strncmp(job->printer->device_uri, "ippusb:", 7))
+    cupsdSetPrinterReasons(job->printer, "-offline-report");
 
  /*
   * Free the security profile...
@@ -2981,6 +3854,8 @@ finalize_job(cupsd_job_t *job,		/* I - Job */
   * Close pipes and status buffer...
   */
 
+  close_stream(job);
+
   cupsdClosePipe(job->print_pipes);
   cupsdClosePipe(job->back_pipes);
   cupsdClosePipe(job->side_pipes);
@@ -3153,9 +4028,10 @@ finalize_job(cupsd_job_t *job,		/* I - Job */
 			 "Job held for %d seconds since it could not be sent.",
 			 JobRetryInterval);
 
-		job->hold_until = time(NULL) + JobRetryInterval;
-		job_state       = IPP_JOB_HELD;
-		message         = buffer;
+		job->hold_until    = time(NULL) + JobRetryInterval;
+		job->summary_dirty = 1;
+		job_state          = IPP_JOB_HELD;
+		message            = buffer;
 
 		ippSetString(job->attrs, &job->reasons, 0,
 		             "resources-are-not-ready");
@@ -3318,9 +4194,10 @@ finalize_job(cupsd_job_t *job,		/* I - Job */
 		       "Job held for %d seconds since it could not be sent.",
 		       JobRetryInterval);
 
-	      job->hold_until = time(NULL) + JobRetryInterval;
-	      job_state       = IPP_JOB_HELD;
-	      message         = buffer;
+	      job->hold_until    = time(NULL) + JobRetryInterval;
+	      job->summary_dirty = 1;
+	      job_state          = IPP_JOB_HELD;
+	      message            = buffer;
 
 	      ippSetString(job->attrs, &job->reasons, 0,
 	                   "resources-are-not-ready");
@@ -3928,6 +4805,86 @@ ipp_length(ipp_t *ipp)			/* I - IPP request */
 }
 
 
+/*
+ * 'get_journal_int()' - Get a big-endian integer from a journal record.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+get_journal_int(
+    const unsigned char **dataptr,	/* IO - Pointer into record */
+    const unsigned char *dataend,	/* I  - End of record */
+    int                 *value)		/* O  - Value */
+{
+  const unsigned char	*ptr = *dataptr;/* Pointer into record */
+
+
+  if ((dataend - ptr) < 4)
+    return (0);
+
+  *value   = (int)(((unsigned)ptr[0] << 24) | ((unsigned)ptr[1] << 16) |
+                   ((unsigned)ptr[2] << 8) | (unsigned)ptr[3]);
+  *dataptr = ptr + 4;
+
+  return (1);
+}
+
+
+/*
+ * 'get_journal_string()' - Get a length-prefixed string from a journal record.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+get_journal_string(
+    const unsigned char **dataptr,	/* IO - Pointer into record */
+    const unsigned char *dataend,	/* I  - End of record */
+    char                *buffer,	/* I  - String buffer */
+    size_t              bufsize)	/* I  - Size of string buffer */
+{
+  const unsigned char	*ptr = *dataptr;/* Pointer into record */
+  size_t		length;		/* Length of string */
+
+
+  if ((dataend - ptr) < 2)
+    return (0);
+
+  length = (size_t)((ptr[0] << 8) | ptr[1]);
+  ptr    += 2;
+
+  if ((size_t)(dataend - ptr) < length || length >= bufsize)
+    return (0);
+
+  memcpy(buffer, ptr, length);
+  buffer[length] = '\0';
+
+  *dataptr = ptr + length;
+
+  return (1);
+}
+
+
+/*
+ * 'journal_hash()' - Compute the hash of journal data.
+ *
+ * This is the 32-bit FNV-1a hash, so a hash can be continued over more data
+ * by passing the previous value.
+ */
+
+static unsigned				/* O - Hash value */
+journal_hash(const unsigned char *data,	/* I - Data */
+             size_t              length,/* I - Length of data */
+	     unsigned            hash)	/* I - Initial hash value */
+{
+  while (length > 0)
+  {
+    hash ^= *data++;
+    hash *= 16777619U;
+    length --;
+  }
+
+  return (hash);
+}
+
+
 /*
  * 'load_job_cache()' - Load jobs from the job.cache file.
  */
@@ -4038,7 +4995,10 @@ load_job_cache(const char *filename)	/* I - job.cache filename */
       cupsArrayAdd(Jobs, job);
 
       if (job->state_value <= IPP_JOB_STOPPED && cupsdLoadJob(job))
+      {
 	cupsArrayAdd(ActiveJobs, job);
+	cupsdUpdateJobTimers(job);
+      }
 
       job = NULL;
     }
@@ -4178,6 +5138,307 @@ load_job_cache(const char *filename)	/* I - job.cache filename */
 }
 
 
+/*
+ * 'load_job_journal()' - Load jobs from the job.journal file.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+load_job_journal(const char *filename,	/* I - job.journal filename */
+                 int        next_id_only)
+					/* I - Only load NextJobId? */
+{
+  cups_file_t		*fp;		/* job.journal file */
+  char			header[8];	/* File header */
+  int			type,		/* Record type */
+			id,		/* Record job ID */
+			records,	/* Number of records */
+			next_job_id,	/* NextJobId value */
+			status;		/* Status of last read */
+  size_t		length;		/* Record length */
+  cups_array_t		*summaries;	/* Latest summary for each job */
+  cupsd_jobrec_t	key,		/* Search key */
+			*rec;		/* Current summary */
+
+
+ /*
+  * Open the job.journal file and check the header...
+  */
+
+  if ((fp = cupsdOpenConfFile(filename)) == NULL)
+    return (0);
+
+  if (cupsFileRead(fp, header, sizeof(header)) != sizeof(header) ||
+      memcmp(header, CUPSD_JOURNAL_MAGIC, sizeof(header)))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Bad job journal file \"%s\".",
+                    filename);
+    cupsFileClose(fp);
+    return (0);
+  }
+
+  cupsdLogMessage(CUPSD_LOG_INFO, "Loading job journal file \"%s\"...",
+                  filename);
+
+ /*
+  * Replay the records, keeping only the latest summary for each job...
+  */
+
+  summaries   = cupsArrayNew((cups_array_func_t)compare_jobrecs, NULL);
+  records     = 0;
+  next_job_id = 0;
+
+  while ((status = read_journal(fp, &type, &id, &length)) > 0)
+  {
+    records ++;
+
+    if (type == CUPSD_JREC_NEXTID)
+    {
+      next_job_id = id;
+      continue;
+    }
+    else if (next_id_only)
+      continue;
+
+    key.id = id;
+
+    if ((rec = (cupsd_jobrec_t *)cupsArrayFind(summaries, &key)) != NULL)
+    {
+      cupsArrayRemove(summaries, rec);
+      free(rec);
+    }
+
+    if (type != CUPSD_JREC_JOB)
+      continue;
+
+    if ((rec = malloc(sizeof(cupsd_jobrec_t) + length)) == NULL)
+    {
+      cupsdLogMessage(CUPSD_LOG_EMERG,
+		      "[Job %d] Unable to allocate memory for job.", id);
+      break;
+    }
+
+    rec->id     = id;
+    rec->length = length;
+    memcpy(rec->data, journal_buffer, length);
+
+    cupsArrayAdd(summaries, rec);
+  }
+
+  if (status < 0)
+  {
+    cupsdLogMessage(CUPSD_LOG_WARN,
+                    "Ignoring incomplete records at the end of \"%s\".",
+                    filename);
+
+   /*
+    * Force compaction so we don't append after the bad record...
+    */
+
+    records = INT_MAX / 2;
+  }
+
+  cupsFileClose(fp);
+
+  if (next_job_id > NextJobId)
+    NextJobId = next_job_id;
+
+ /*
+  * Create the jobs in job ID order...
+  */
+
+  for (rec = (cupsd_jobrec_t *)cupsArrayFirst(summaries);
+       rec;
+       rec = (cupsd_jobrec_t *)cupsArrayNext(summaries))
+  {
+    load_job_summary(rec);
+    free(rec);
+  }
+
+  cupsArrayDelete(summaries);
+
+ /*
+  * Continue appending to the journal unless it needs to be compacted...
+  */
+
+  journal_records = records;
+  journal_next_id = next_job_id;
+
+  if (next_id_only)
+    return (1);
+
+  if (records > (2 * cupsArrayCount(Jobs) + 1024))
+    save_job_journal();
+  else if ((journal_fp = cupsFileOpen(filename, "a")) == NULL)
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to open \"%s\" - %s", filename,
+                    strerror(errno));
+
+  return (1);
+}
+
+
+/*
+ * 'load_job_summary()' - Create a job from its journal summary.
+ */
+
+static void
+load_job_summary(cupsd_jobrec_t *rec)	/* I - Job summary */
+{
+  cupsd_job_t		*job;		/* New job */
+  const unsigned char	*dataptr,	/* Pointer into summary */
+			*dataend;	/* End of summary */
+  int			i,		/* Looping var */
+			state,		/* Job state */
+			hold_until,	/* Hold expiration time */
+			dtype,		/* Destination type */
+			compression;	/* Compression of file */
+  char			username[256],	/* Username */
+			dest[256],	/* Destination */
+			super[MIME_MAX_SUPER],
+					/* MIME super type */
+			type[MIME_MAX_TYPE],
+					/* MIME type */
+			jobfile[1024];	/* Job filename */
+
+
+  snprintf(jobfile, sizeof(jobfile), "%s/c%05d", RequestRoot, rec->id);
+  if (access(jobfile, 0))
+  {
+    snprintf(jobfile, sizeof(jobfile), "%s/c%05d.N", RequestRoot, rec->id);
+    if (access(jobfile, 0))
+    {
+      cupsdLogMessage(CUPSD_LOG_ERROR, "[Job %d] Files have gone away.",
+		      rec->id);
+      return;
+    }
+  }
+
+  if ((job = calloc(1, sizeof(cupsd_job_t))) == NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_EMERG,
+		    "[Job %d] Unable to allocate memory for job.", rec->id);
+    return;
+  }
+
+  job->id              = rec->id;
+  job->back_pipes[0]   = -1;
+  job->back_pipes[1]   = -1;
+  job->print_pipes[0]  = -1;
+  job->print_pipes[1]  = -1;
+  job->side_pipes[0]   = -1;
+  job->side_pipes[1]   = -1;
+  job->status_pipes[0] = -1;
+  job->status_pipes[1] = -1;
+  job->journal_hash    = journal_hash(rec->data, rec->length,
+                                      CUPSD_JOURNAL_SEED);
+
+  dataptr = rec->data;
+  dataend = rec->data + rec->length;
+
+  if (!get_journal_int(&dataptr, dataend, &state) ||
+      !get_journal_int(&dataptr, dataend, &job->priority) ||
+      !get_journal_int(&dataptr, dataend, &hold_until) ||
+      !get_journal_int(&dataptr, dataend, &dtype) ||
+      !get_journal_int(&dataptr, dataend, &job->num_files) ||
+      !get_journal_string(&dataptr, dataend, username, sizeof(username)) ||
+      !get_journal_string(&dataptr, dataend, dest, sizeof(dest)) ||
+      job->num_files < 0 || job->num_files > ((dataend - dataptr) / 8))
+  {
+    cupsdLogJob(job, CUPSD_LOG_ERROR, "Bad job summary in journal.");
+    free(job);
+    return;
+  }
+
+  cupsdLogJob(job, CUPSD_LOG_DEBUG, "Loading from journal...");
+
+  if (state < IPP_JOB_PENDING)
+    job->state_value = IPP_JOB_PENDING;
+  else if (state > IPP_JOB_COMPLETED)
+    job->state_value = IPP_JOB_COMPLETED;
+  else
+    job->state_value = (ipp_jstate_t)state;
+
+  job->hold_until = hold_until;
+  job->dtype      = (cups_ptype_t)dtype;
+
+  if (username[0])
+    cupsdSetString(&job->username, username);
+  if (dest[0])
+    cupsdSetString(&job->dest, dest);
+
+  if (job->num_files > 0)
+  {
+    snprintf(jobfile, sizeof(jobfile), "%s/d%05d-001", RequestRoot, job->id);
+    if (access(jobfile, 0))
+    {
+      cupsdLogJob(job, CUPSD_LOG_INFO, "Data files have gone away.");
+      job->num_files = 0;
+    }
+  }
+
+  if (job->num_files > 0)
+  {
+    job->filetypes    = calloc(job->num_files, sizeof(mime_type_t *));
+    job->compressions = calloc(job->num_files, sizeof(int));
+
+    if (!job->filetypes || !job->compressions)
+    {
+      cupsdLogJob(job, CUPSD_LOG_EMERG,
+		  "Unable to allocate memory for %d files.", job->num_files);
+      cupsdDeleteJob(job, CUPSD_JOB_DEFAULT);
+      return;
+    }
+  }
+
+  for (i = 0; i < job->num_files; i ++)
+  {
+    if (!get_journal_string(&dataptr, dataend, super, sizeof(super)) ||
+        !get_journal_string(&dataptr, dataend, type, sizeof(type)) ||
+        !get_journal_int(&dataptr, dataend, &compression))
+    {
+      cupsdLogJob(job, CUPSD_LOG_ERROR, "Bad job summary in journal.");
+      cupsdDeleteJob(job, CUPSD_JOB_DEFAULT);
+      return;
+    }
+
+    job->compressions[i] = compression;
+
+    if ((job->filetypes[i] = mimeType(MimeDatabase, super, type)) == NULL)
+    {
+     /*
+      * If the original MIME type is unknown, auto-type it!
+      */
+
+      cupsdLogJob(job, CUPSD_LOG_ERROR, "Unknown MIME type %s/%s for file %d.",
+		  super, type, i + 1);
+
+      snprintf(jobfile, sizeof(jobfile), "%s/d%05d-%03d", RequestRoot,
+	       job->id, i + 1);
+      job->filetypes[i] = mimeFileType(MimeDatabase, jobfile, NULL,
+				       job->compressions + i);
+
+     /*
+      * If that didn't work, assume it is raw...
+      */
+
+      if (!job->filetypes[i])
+	job->filetypes[i] = mimeType(MimeDatabase, "application",
+				     "vnd.cups-raw");
+    }
+  }
+
+  if (job->id >= NextJobId)
+    NextJobId = job->id + 1;
+
+  cupsArrayAdd(Jobs, job);
+
+  if (job->state_value <= IPP_JOB_STOPPED && cupsdLoadJob(job))
+  {
+    cupsArrayAdd(ActiveJobs, job);
+    cupsdUpdateJobTimers(job);
+  }
+}
+
+
 /*
  * 'load_next_job_id()' - Load the NextJobId value from the job.cache file.
  */
@@ -4305,7 +5566,10 @@ load_request_root(void)
 	cupsArrayAdd(Jobs, job);
 
 	if (job->state_value <= IPP_JOB_STOPPED)
+	{
 	  cupsArrayAdd(ActiveJobs, job);
+	  cupsdUpdateJobTimers(job);
+	}
 	else
 	  unload_job(job);
       }
@@ -4317,6 +5581,142 @@ load_request_root(void)
 }
 
 
+/*
+ * 'put_journal_int()' - Put a big-endian integer in a journal record.
+ */
+
+static unsigned char *			/* O - Pointer after value */
+put_journal_int(unsigned char *bufptr,	/* I - Pointer into record */
+                int           value)	/* I - Value */
+{
+  *bufptr++ = (unsigned char)((unsigned)value >> 24);
+  *bufptr++ = (unsigned char)((unsigned)value >> 16);
+  *bufptr++ = (unsigned char)((unsigned)value >> 8);
+  *bufptr++ = (unsigned char)value;
+
+  return (bufptr);
+}
+
+
+/*
+ * 'put_journal_string()' - Put a length-prefixed string in a journal record.
+ */
+
+static unsigned char *			/* O - Pointer after string */
+put_journal_string(
+    unsigned char *bufptr,		/* I - Pointer into record */
+    const char    *s)			/* I - String */
+{
+  size_t	length = strlen(s);	/* Length of string */
+
+
+  *bufptr++ = (unsigned char)(length >> 8);
+  *bufptr++ = (unsigned char)length;
+
+  memcpy(bufptr, s, length);
+
+  return (bufptr + length);
+}
+
+
+/*
+ * 'queue_compression()' - Queue the preserved files of a job for compression.
+ */
+
+static void
+queue_compression(cupsd_job_t *job)	/* I - Job */
+{
+  int	i;				/* Looping var */
+
+
+  if (!job->num_files || job == compress_job || compression_level(job) <= 0)
+    return;
+
+  for (i = 0; i < job->num_files; i ++)
+    if (!job->compressions[i])
+      break;
+
+  if (i >= job->num_files)
+    return;
+
+  if (!compress_jobs)
+    compress_jobs = cupsArrayNew(NULL, NULL);
+
+  if (!cupsArrayFind(compress_jobs, job))
+    cupsArrayAdd(compress_jobs, job);
+}
+
+
+/*
+ * 'read_journal()' - Read a record from the job journal.
+ *
+ * The record data is stored in the journal buffer.
+ */
+
+static int				/* O - 1 on success, 0 on end, -1 on error */
+read_journal(cups_file_t *fp,		/* I - job.journal file */
+             int         *type,		/* O - Record type */
+	     int         *id,		/* O - Job ID */
+	     size_t      *length)	/* O - Length of record data */
+{
+  unsigned char		header[9],	/* Record header */
+			trailer[4];	/* Record hash */
+  const unsigned char	*ptr;		/* Pointer into header */
+  ssize_t		rbytes;		/* Bytes read */
+  int			bytes,		/* Length of record data */
+			hash;		/* Hash of record */
+
+
+  if ((rbytes = cupsFileRead(fp, (char *)header, sizeof(header))) <= 0 &&
+      cupsFileEOF(fp))
+    return (0);
+  else if (rbytes != sizeof(header))
+    return (-1);
+
+  ptr = header + 5;
+  if (!get_journal_int(&ptr, header + sizeof(header), &bytes) ||
+      bytes < 0 || bytes > 65536)
+    return (-1);
+
+  if ((size_t)bytes > journal_bufsize)
+  {
+    unsigned char *temp;		/* New buffer */
+
+    if ((temp = realloc(journal_buffer, (size_t)bytes + 1024)) == NULL)
+      return (-1);
+
+    journal_buffer  = temp;
+    journal_bufsize = (size_t)bytes + 1024;
+  }
+
+  if ((bytes > 0 &&
+       cupsFileRead(fp, (char *)journal_buffer, (size_t)bytes) != bytes) ||
+      cupsFileRead(fp, (char *)trailer, sizeof(trailer)) != sizeof(trailer))
+    return (-1);
+
+ /*
+  * The hash covers the header and data...
+  */
+
+  ptr = trailer;
+  get_journal_int(&ptr, trailer + sizeof(trailer), &hash);
+
+  if ((unsigned)hash !=
+          journal_hash(journal_buffer, (size_t)bytes,
+	               journal_hash(header, sizeof(header),
+		                    CUPSD_JOURNAL_SEED)))
+    return (-1);
+
+  ptr = header + 1;
+  get_journal_int(&ptr, header + sizeof(header), id);
+
+  *type   = header[0];
+  *length = (size_t)bytes;
+
+  return (1);
+}
+
+
 /*
  * 'remove_job_files()' - Remove the document files for a job.
  */
@@ -4331,20 +5731,31 @@ remove_job_files(cupsd_job_t *job)	/* I - Job */
   if (job->num_files <= 0)
     return;
 
+  stop_compression(job);
+
   for (i = 1; i <= job->num_files; i ++)
   {
     snprintf(filename, sizeof(filename), "%s/d%05d-%03d", RequestRoot,
 	     job->id, i);
     cupsdUnlinkOrRemoveFile(filename);
+
+   /*
+    * Also remove any partial compressed copy left behind by a crash...
+    */
+
+    strlcat(filename, ".gz.N", sizeof(filename));
+    if (!access(filename, F_OK))
+      cupsdUnlinkOrRemoveFile(filename);
   }
 
   free(job->filetypes);
   free(job->compressions);
 
-  job->file_time    = 0;
-  job->num_files    = 0;
-  job->filetypes    = NULL;
-  job->compressions = NULL;
+  job->file_time     = 0;
+  job->num_files     = 0;
+  job->filetypes     = NULL;
+  job->compressions  = NULL;
+  job->summary_dirty = 1;
 
   LastEvent |= CUPSD_EVENT_PRINTER_STATE_CHANGED;
 }
@@ -4372,6 +5783,77 @@ remove_job_history(cupsd_job_t *job)	/* I - Job */
 }
 
 
+/*
+ * 'save_job_journal()' - Write a compacted copy of the job journal.
+ */
+
+static void
+save_job_journal(void)
+{
+  cups_file_t	*fp;			/* job.journal file */
+  char		filename[1024];		/* job.journal filename */
+  cupsd_job_t	*job;			/* Current job */
+  unsigned char	*data;			/* Job summary */
+  size_t	length;			/* Length of job summary */
+
+
+  if (journal_fp)
+  {
+    cupsFileClose(journal_fp);
+    journal_fp = NULL;
+  }
+
+  snprintf(filename, sizeof(filename), "%s/job.journal", CacheDir);
+  if ((fp = cupsdCreateConfFile(filename, ConfigFilePerm)) == NULL)
+    return;
+
+  cupsdLogMessage(CUPSD_LOG_INFO, "Saving job.journal...");
+
+  cupsFileWrite(fp, CUPSD_JOURNAL_MAGIC, 8);
+
+  write_journal(fp, CUPSD_JREC_NEXTID, NextJobId, NULL, 0);
+
+  journal_next_id = NextJobId;
+  journal_records = 1;
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(Jobs))
+  {
+    job->summary_dirty = 0;
+
+    if ((data = encode_job(job, &length)) == NULL)
+    {
+      job->journal_hash = 0;
+      continue;
+    }
+
+    write_journal(fp, CUPSD_JREC_JOB, job->id, data, length);
+
+    job->journal_hash = journal_hash(data, length, CUPSD_JOURNAL_SEED);
+    journal_records ++;
+  }
+
+  if (cupsdCloseCreatedConfFile(fp, filename))
+    return;
+
+ /*
+  * Remove the job.cache file from older versions of CUPS, if any, and open
+  * the new journal for appending...
+  */
+
+  snprintf(filename, sizeof(filename), "%s/job.cache", CacheDir);
+  cupsdUnlinkOrRemoveFile(filename);
+  strlcat(filename, ".O", sizeof(filename));
+  cupsdUnlinkOrRemoveFile(filename);
+
+  snprintf(filename, sizeof(filename), "%s/job.journal", CacheDir);
+  if ((journal_fp = cupsFileOpen(filename, "a")) == NULL)
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to open \"%s\" - %s", filename,
+                    strerror(errno));
+}
+
+
 /*
  * 'set_time()' - Set one of the "time-at-xyz" attributes.
  */
@@ -4488,6 +5970,8 @@ start_job(cupsd_job_t     *job,		/* I - Job ID */
   else
     job->cancel_time = 0;
 
+  cupsdUpdateJobTimers(job);
+
  /*
   * Check for support files...
   */
@@ -4604,6 +6088,95 @@ start_job(cupsd_job_t     *job,		/* I - Job ID */
 }
 
 
+/*
+ * 'start_stream()' - Start copying a document that is still being received.
+ *
+ * On success fds[0] is the read end of a pipe for the first filter and the
+ * document data is copied to the other end by write_stream().
+ */
+
+static int				/* O - 1 on success, 0 on error */
+start_stream(cupsd_job_t *job,		/* I - Job */
+             const char  *filename,	/* I - Spool file */
+	     int         fds[2])	/* O - Pipe for first filter */
+{
+  cupsd_jobstream_t	*stream;	/* Streamed document */
+
+
+  close_stream(job);
+
+  if ((stream = calloc(1, sizeof(cupsd_jobstream_t))) == NULL)
+    return (0);
+
+  if ((stream->fd = open(filename, O_RDONLY)) < 0)
+  {
+    cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to open \"%s\" - %s", filename,
+                strerror(errno));
+    free(stream);
+    return (0);
+  }
+
+  fcntl(stream->fd, F_SETFD, fcntl(stream->fd, F_GETFD) | FD_CLOEXEC);
+
+  if (cupsdOpenPipe(fds))
+  {
+    close(stream->fd);
+    free(stream);
+    return (0);
+  }
+
+ /*
+  * Keep the write end to ourselves so that the filter only sees EOF once the
+  * whole document has been copied...
+  */
+
+  stream->pipe = fds[1];
+  fds[1]       = -1;
+
+  fcntl(stream->pipe, F_SETFL, fcntl(stream->pipe, F_GETFL) | O_NONBLOCK);
+
+  job->stream = stream;
+
+  cupsdLogJob(job, CUPSD_LOG_DEBUG,
+              "Streaming document %d to filters while it is received.",
+	      job->incoming);
+
+  cupsdStreamJobData(job);
+
+  return (1);
+}
+
+
+/*
+ * 'stop_compression()' - Stop compressing the files for a job.
+ */
+
+static void
+stop_compression(cupsd_job_t *job)	/* I - Job */
+{
+  cupsArrayRemove(compress_jobs, job);
+
+  if (job != compress_job)
+    return;
+
+  if (compress_in >= 0)
+  {
+    close(compress_in);
+    compress_in = -1;
+  }
+
+  if (compress_out)
+  {
+    cupsFileClose(compress_out);
+    compress_out = NULL;
+
+    unlink(compress_temp);
+  }
+
+  compress_job = NULL;
+}
+
+
 /*
  * 'stop_job()' - Stop a print job.
  */
@@ -4626,6 +6199,8 @@ stop_job(cupsd_job_t       *job,	/* I - Job */
   else if (action >= CUPSD_JOB_FORCE)
     job->kill_time = 0;
 
+  cupsdUpdateJobTimers(job);
+
   for (i = 0; job->filters[i]; i ++)
     if (job->filters[i] > 0)
     {
@@ -4687,8 +6262,7 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
 {
   int		i;			/* Looping var */
   int		copies;			/* Number of copies printed */
-  char		message[CUPSD_SB_BUFFER_SIZE],
-					/* Message text */
+  char		*message,		/* Message text */
 		*ptr;			/* Pointer update... */
   int		loglevel,		/* Log level for message */
 		event = 0;		/* Events? */
@@ -4713,8 +6287,8 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
   * a valid pointer...
   */
 
-  while ((ptr = cupsdStatBufUpdate(job->status_buffer, &loglevel,
-                                   message, sizeof(message))) != NULL)
+  while ((message = cupsdStatBufUpdate(job->status_buffer,
+                                       &loglevel)) != NULL)
   {
    /*
     * Process page and printer state messages as needed...
@@ -4800,6 +6374,8 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
 	      job->cancel_time = time(NULL) + ippGetInteger(cancel_after, 0);
 	    else
 	      job->cancel_time = time(NULL) + MaxJobTime;
+
+            cupsdUpdateJobTimers(job);
 	  }
         }
       }
@@ -4828,7 +6404,8 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
 						  &(job->printer->options));
 	cupsdSetPrinterAttrs(job->printer);
 
-	cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+	job->printer->dirty = 1;
+	cupsdMarkDirtyRecords(CUPSD_DIRTY_PRINTERS);
       }
 
       if ((attr = cupsGetOption("auth-info-required", num_attrs,
@@ -4837,7 +6414,8 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
         cupsdSetAuthInfoRequired(job->printer, attr, NULL);
 	cupsdSetPrinterAttrs(job->printer);
 
-	cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+	job->printer->dirty = 1;
+	cupsdMarkDirtyRecords(CUPSD_DIRTY_PRINTERS);
       }
 
       if ((attr = cupsGetOption("job-media-progress", num_attrs,
@@ -4875,7 +6453,8 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
         cupsdSetPrinterAttr(job->printer, "marker-colors", (char *)attr);
 	job->printer->marker_time = time(NULL);
 	event |= CUPSD_EVENT_PRINTER_STATE;
-        cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+        job->printer->dirty = 1;
+        cupsdMarkDirtyRecords(CUPSD_DIRTY_PRINTERS);
       }
 
       if ((attr = cupsGetOption("marker-levels", num_attrs, attrs)) != NULL)
@@ -4883,7 +6462,8 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
         cupsdSetPrinterAttr(job->printer, "marker-levels", (char *)attr);
 	job->printer->marker_time = time(NULL);
 	event |= CUPSD_EVENT_PRINTER_STATE;
-        cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+        job->printer->dirty = 1;
+        cupsdMarkDirtyRecords(CUPSD_DIRTY_PRINTERS);
       }
 
       if ((attr = cupsGetOption("marker-low-levels", num_attrs, attrs)) != NULL)
@@ -4891,7 +6471,8 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
         cupsdSetPrinterAttr(job->printer, "marker-low-levels", (char *)attr);
 	job->printer->marker_time = time(NULL);
 	event |= CUPSD_EVENT_PRINTER_STATE;
-        cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+        job->printer->dirty = 1;
+        cupsdMarkDirtyRecords(CUPSD_DIRTY_PRINTERS);
       }
 
       if ((attr = cupsGetOption("marker-high-levels", num_attrs, attrs)) != NULL)
@@ -4899,7 +6480,8 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
         cupsdSetPrinterAttr(job->printer, "marker-high-levels", (char *)attr);
 	job->printer->marker_time = time(NULL);
 	event |= CUPSD_EVENT_PRINTER_STATE;
-        cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+        job->printer->dirty = 1;
+        cupsdMarkDirtyRecords(CUPSD_DIRTY_PRINTERS);
       }
 
       if ((attr = cupsGetOption("marker-message", num_attrs, attrs)) != NULL)
@@ -4907,7 +6489,8 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
         cupsdSetPrinterAttr(job->printer, "marker-message", (char *)attr);
 	job->printer->marker_time = time(NULL);
 	event |= CUPSD_EVENT_PRINTER_STATE;
-        cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+        job->printer->dirty = 1;
+        cupsdMarkDirtyRecords(CUPSD_DIRTY_PRINTERS);
       }
 
       if ((attr = cupsGetOption("marker-names", num_attrs, attrs)) != NULL)
@@ -4915,7 +6498,8 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
         cupsdSetPrinterAttr(job->printer, "marker-names", (char *)attr);
 	job->printer->marker_time = time(NULL);
 	event |= CUPSD_EVENT_PRINTER_STATE;
-        cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+        job->printer->dirty = 1;
+        cupsdMarkDirtyRecords(CUPSD_DIRTY_PRINTERS);
       }
 
       if ((attr = cupsGetOption("marker-types", num_attrs, attrs)) != NULL)
@@ -4923,7 +6507,8 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
         cupsdSetPrinterAttr(job->printer, "marker-types", (char *)attr);
 	job->printer->marker_time = time(NULL);
 	event |= CUPSD_EVENT_PRINTER_STATE;
-        cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+        job->printer->dirty = 1;
+        cupsdMarkDirtyRecords(CUPSD_DIRTY_PRINTERS);
       }
 
       cupsFreeOptions(num_attrs, attrs);
@@ -4991,7 +6576,7 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
       }
     }
 
-    if (!strchr(job->status_buffer->buffer, '\n'))
+    if (!cupsdStatBufHasLine(job->status_buffer))
       break;
   }
 
@@ -5006,7 +6591,7 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
 		  job->printer->name);
 
 
-  if (ptr == NULL && !job->status_buffer->bufused)
+  if (message == NULL && !job->status_buffer->bufused)
   {
    /*
     * See if all of the filters and the backend have returned their
@@ -5165,6 +6750,103 @@ update_job_attrs(cupsd_job_t *job,	/* I - Job to update */
 }
 
 
+/*
+ * 'write_journal()' - Write a record to the job journal.
+ *
+ * Each record consists of a 1-byte type, 4-byte job ID, 4-byte length, the
+ * record data, and a 4-byte hash of everything before it.  All integers are
+ * big-endian.
+ */
+
+static int				/* O - 0 on success, -1 on error */
+write_journal(
+    cups_file_t         *fp,		/* I - job.journal file */
+    int                 type,		/* I - Record type */
+    int                 id,		/* I - Job ID */
+    const unsigned char *data,		/* I - Record data */
+    size_t              length)		/* I - Length of record data */
+{
+  unsigned char	header[9],		/* Record header */
+		trailer[4];		/* Record hash */
+  unsigned	hash;			/* Hash of record */
+
+
+  header[0] = (unsigned char)type;
+  put_journal_int(put_journal_int(header + 1, id), (int)length);
+
+  hash = journal_hash(data, length,
+                      journal_hash(header, sizeof(header), CUPSD_JOURNAL_SEED));
+
+  put_journal_int(trailer, (int)hash);
+
+  if (cupsFileWrite(fp, (char *)header, sizeof(header)) < 0 ||
+      (length > 0 && cupsFileWrite(fp, (char *)data, length) < 0) ||
+      cupsFileWrite(fp, (char *)trailer, sizeof(trailer)) < 0)
+    return (-1);
+
+  return (0);
+}
+
+
+/*
+ * 'write_stream()' - Copy received document data to the first filter.
+ */
+
+static void
+write_stream(cupsd_job_t *job)		/* I - Job */
+{
+  cupsd_jobstream_t	*stream;	/* Streamed document */
+  ssize_t		bytes;		/* Bytes copied */
+  char			buffer[32768];	/* Copy buffer */
+
+
+  if ((stream = job->stream) == NULL)
+    return;
+
+  do
+  {
+#ifdef HAVE_SPLICE
+   /*
+    * Move the data without copying it, unless the spool filesystem doesn't
+    * support that...
+    */
+
+    if ((bytes = splice(stream->fd, &stream->offset, stream->pipe, NULL,
+                        sizeof(buffer), SPLICE_F_NONBLOCK)) < 0 &&
+        errno == EINVAL)
+#endif /* HAVE_SPLICE */
+    if ((bytes = pread(stream->fd, buffer, sizeof(buffer),
+                       stream->offset)) > 0 &&
+        (bytes = write(stream->pipe, buffer, (size_t)bytes)) > 0)
+      stream->offset += bytes;
+  }
+  while (bytes > 0);
+
+  if (bytes < 0 && (errno == EAGAIN || errno == EINTR))
+    return;				/* Pipe is full */
+
+  if (bytes < 0)
+  {
+    if (errno != EPIPE)
+      cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to stream document - %s",
+		  strerror(errno));
+
+    close_stream(job);
+  }
+  else if (job->incoming)
+  {
+   /*
+    * Caught up with the client; wait for more data...
+    */
+
+    cupsdRemoveSelect(stream->pipe);
+    stream->selected = 0;
+  }
+  else
+    close_stream(job);			/* All done */
+}
+
+
 /*
  * End of "$Id$".
  */
@@ -25,6 +25,19 @@ typedef enum cupsd_jobaction_e		/**** Actions for state changes ****/
 } cupsd_jobaction_t;
 
 
+/*
+ * Streamed document structure...
+ */
+
+typedef struct cupsd_jobstream_s	/**** Document being received ****/
+{
+  int			fd,		/* Spool file */
+			pipe,		/* Pipe to first filter */
+			selected;	/* Waiting for the pipe? */
+  off_t			offset;		/* Bytes copied so far */
+} cupsd_jobstream_t;
+
+
 /*
  * Job request structure...
  */
@@ -33,7 +46,9 @@ struct cupsd_job_s			/**** Job request ****/
 {
   int			id,		/* Job ID */
 			priority,	/* Job priority */
-			dirty;		/* Do we need to write the "c" file? */
+			dirty,		/* Do we need to write the "c" file? */
+			summary_dirty;	/* Do we need to write the journal
+					 * summary? */
   ipp_jstate_t		state_value;	/* Cached job-state */
   int			pending_timeout;/* Non-zero if the job was created and
 					 * waiting on files */
@@ -83,6 +98,9 @@ struct cupsd_job_s			/**** Job request ****/
   int			progress;	/* Printing progress */
   int			num_keywords;	/* Number of PPD keywords */
   cups_option_t		*keywords;	/* PPD keywords */
+  unsigned		journal_hash;	/* Hash of summary in job.journal */
+  int			incoming;	/* File still being received, 1-based */
+  cupsd_jobstream_t	*stream;	/* Copy of file for first filter */
 };
 
 typedef struct cupsd_joblog_s		/**** Job log message ****/
@@ -100,8 +118,22 @@ VAR int			JobHistory	VALUE(INT_MAX);
 					/* Preserve job history? */
 VAR int			JobFiles	VALUE(86400);
 					/* Preserve job files? */
+VAR int			SpoolCompression VALUE(0);
+					/* Compression level for preserved files */
+VAR int			SpoolCompressedFiles VALUE(0);
+					/* Number of files compressed */
+VAR off_t		SpoolBytesIn	VALUE(0),
+					/* Bytes read by the compressor */
+			SpoolBytesOut	VALUE(0);
+					/* Bytes written by the compressor */
+VAR double		SpoolCompressTime VALUE(0.0);
+					/* CPU seconds used by the compressor */
 VAR time_t		JobHistoryUpdate VALUE(0);
 					/* Time for next job history update */
+VAR time_t		JobTimerUpdate	VALUE(0);
+					/* Time for next job timer check */
+VAR int			PendingJobCount	VALUE(0);
+					/* Jobs left waiting by the last check */
 VAR int			MaxJobs		VALUE(0),
 					/* Max number of jobs */
 			MaxActiveJobs	VALUE(0),
@@ -141,6 +173,7 @@ extern void		cupsdCancelJobs(const char *dest, const char *username,
 			                int purge);
 extern void		cupsdCheckJobs(void);
 extern void		cupsdCleanJobs(void);
+extern void		cupsdCompressJobFiles(void);
 extern void		cupsdContinueJob(cupsd_job_t *job);
 extern void		cupsdDeleteJob(cupsd_job_t *job,
 			               cupsd_jobaction_t action);
@@ -151,6 +184,7 @@ extern int		cupsdGetUserJobCount(const char *username);
 extern void		cupsdLoadAllJobs(void);
 extern int		cupsdLoadJob(cupsd_job_t *job);
 extern void		cupsdMoveJob(cupsd_job_t *job, cupsd_printer_t *p);
+extern int		cupsdNeedJobCompression(void);
 extern void		cupsdReleaseJob(cupsd_job_t *job);
 extern void		cupsdRestartJob(cupsd_job_t *job);
 extern void		cupsdSaveAllJobs(void);
@@ -166,8 +200,10 @@ extern void		cupsdSetJobState(cupsd_job_t *job,
 					                          4, 5)));
 extern void		cupsdStopAllJobs(cupsd_jobaction_t action,
 			                 int kill_delay);
+extern void		cupsdStreamJobData(cupsd_job_t *job);
 extern int		cupsdTimeoutJob(cupsd_job_t *job);
 extern void		cupsdUnloadCompletedJobs(void);
+extern void		cupsdUpdateJobTimers(cupsd_job_t *job);
 extern void		cupsdUpdateJobs(void);
 
 
@@ -20,6 +20,62 @@
 #include "cupsd.h"
 #include <stdarg.h>
 #include <syslog.h>
+#include <poll.h>
+
+
+/*
+ * Design Notes for the Log Writer
+ * -------------------------------
+ *
+ * Once the server is started, lines for the access, error, and page logs are
+ * formatted by the caller and copied into a fixed-size ring buffer, and a
+ * writer thread copies them to the log files in large writes, flushing every
+ * CUPSD_LOG_FLUSH milliseconds and syncing every CUPSD_LOG_SYNC seconds.
+ * Loggers never wait for the disk: when the buffer is full the line is
+ * dropped and counted, and the count is reported in the error log once there
+ * is room again.
+ *
+ * Loggers are serialized by log_mutex, which the writer never takes, so the
+ * buffer has a single producer and a single consumer that only share the
+ * head and tail offsets.  The writer owns the log files (including rotation)
+ * while it runs; before the server is started and after it is stopped lines
+ * are written directly as before.
+ */
+
+
+/*
+ * Local constants...
+ */
+
+#define CUPSD_LOG_BUFSIZE	1048576	/* Size of log buffer */
+#define CUPSD_LOG_BATCH		65536	/* Maximum size of log file writes */
+#define CUPSD_LOG_FLUSH		100	/* Milliseconds between log writes */
+#define CUPSD_LOG_SYNC		5	/* Seconds between log syncs */
+
+#define CUPSD_LOGREC_ACCESS	0	/* Access log record */
+#define CUPSD_LOGREC_ERROR	1	/* Error log record */
+#define CUPSD_LOGREC_PAGE	2	/* Page log record */
+#define CUPSD_LOGREC_SKIP	-1	/* Unused space at end of buffer */
+
+#define CUPSD_LOGREC_SIZE(len)	((sizeof(cupsd_logrec_t) + (size_t)(len) + 7) & \
+				 ~(size_t)7)
+					/* Buffer space used by record */
+
+#ifdef HAVE_PTHREAD_H
+#  define log_load(v)		__atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#  define log_store(v,n)	__atomic_store_n(&(v), (n), __ATOMIC_RELEASE)
+#endif /* HAVE_PTHREAD_H */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct cupsd_logrec_s		/**** Log buffer record ****/
+{
+  int		log,			/* Log file (CUPSD_LOGREC_xxx) */
+		length;			/* Length of line */
+} cupsd_logrec_t;
 
 
 /*
@@ -31,6 +87,18 @@ static _cups_mutex_t log_mutex = _CUPS_MUTEX_INITIALIZER;
 static int	log_linesize = 0;	/* Size of line for output file */
 static char	*log_line = NULL;	/* Line for output file */
 
+static unsigned char *log_buffer = NULL;/* Buffer for queued log lines */
+static size_t	log_head = 0,		/* Offset of next queued line */
+		log_tail = 0;		/* Offset of next line to write */
+static int	log_running = 0,	/* Is the log writer running? */
+		log_stop = 0,		/* Should the log writer stop? */
+		log_wake[2] = { -1, -1 },
+					/* Pipes to wake up the log writer */
+		log_done[2] = { -1, -1 };
+					/* Pipes for log writer exit */
+static unsigned	log_dropped = 0,	/* Number of dropped log lines */
+		log_reported = 0;	/* Number of dropped lines reported */
+
 #ifdef HAVE_VSYSLOG
 static const int syslevels[] =		/* SYSLOG levels... */
 		{
@@ -53,6 +121,11 @@ static const int syslevels[] =		/* SYSLOG levels... */
  */
 
 static int	format_log_line(const char *message, va_list ap);
+#ifdef HAVE_PTHREAD_H
+static int	log_drain(void);
+static int	log_queue(int log, const char *prefix, const char *line);
+static void	*log_writer(void *arg);
+#endif /* HAVE_PTHREAD_H */
 
 
 /*
@@ -818,6 +891,24 @@ cupsdLogPage(cupsd_job_t *job,		/* I - Job being printed */
   }
 #endif /* HAVE_VSYSLOG */
 
+#ifdef HAVE_PTHREAD_H
+ /*
+  * See if the log writer is running...
+  */
+
+  if (log_running)
+  {
+    _cupsMutexLock(&log_mutex);
+
+    if (!log_queue(CUPSD_LOGREC_PAGE, "", buffer))
+      log_dropped ++;
+
+    _cupsMutexUnlock(&log_mutex);
+
+    return (1);
+  }
+#endif /* HAVE_PTHREAD_H */
+
  /*
   * Not using syslog; check the log file...
   */
@@ -847,7 +938,8 @@ int					/* O - 1 on success, 0 on error */
 cupsdLogRequest(cupsd_client_t *con,	/* I - Request to log */
                 http_status_t  code)	/* I - Response code */
 {
-  char	temp[2048];			/* Temporary string for URI */
+  char	temp[2048],			/* Temporary string for URI */
+	line[4096];			/* Line for log file */
   static const char * const states[] =	/* HTTP client states... */
 		{
 		  "WAITING",
@@ -997,6 +1089,42 @@ cupsdLogRequest(cupsd_client_t *con,	/* I - Request to log */
   }
 #endif /* HAVE_VSYSLOG */
 
+ /*
+  * Format a log of the request in "common log format"...
+  */
+
+  snprintf(line, sizeof(line),
+           "%s - %s %s \"%s %s HTTP/%d.%d\" %d " CUPS_LLFMT " %s %s",
+	   con->http->hostname,
+	   con->username[0] != '\0' ? con->username : "-",
+	   cupsdGetDateTime(&(con->start), LogTimeFormat),
+	   states[con->operation],
+	   _httpEncodeURI(temp, con->uri, sizeof(temp)),
+	   con->http->version / 100, con->http->version % 100,
+	   code, CUPS_LLCAST con->bytes,
+	   con->request ?
+	       ippOpString(con->request->request.op.operation_id) : "-",
+	   con->response ?
+	       ippErrorString(con->response->request.status.status_code) : "-");
+
+#ifdef HAVE_PTHREAD_H
+ /*
+  * See if the log writer is running...
+  */
+
+  if (log_running)
+  {
+    _cupsMutexLock(&log_mutex);
+
+    if (!log_queue(CUPSD_LOGREC_ACCESS, "", line))
+      log_dropped ++;
+
+    _cupsMutexUnlock(&log_mutex);
+
+    return (1);
+  }
+#endif /* HAVE_PTHREAD_H */
+
  /*
   * Not using syslog; check the log file...
   */
@@ -1005,30 +1133,115 @@ cupsdLogRequest(cupsd_client_t *con,	/* I - Request to log */
     return (0);
 
  /*
-  * Write a log of the request in "common log format"...
+  * Write the log line...
   */
 
-  cupsFilePrintf(AccessFile,
-                 "%s - %s %s \"%s %s HTTP/%d.%d\" %d " CUPS_LLFMT " %s %s\n",
-        	 con->http->hostname,
-		 con->username[0] != '\0' ? con->username : "-",
-		 cupsdGetDateTime(&(con->start), LogTimeFormat),
-		 states[con->operation],
-		 _httpEncodeURI(temp, con->uri, sizeof(temp)),
-		 con->http->version / 100, con->http->version % 100,
-		 code, CUPS_LLCAST con->bytes,
-		 con->request ?
-		     ippOpString(con->request->request.op.operation_id) : "-",
-		 con->response ?
-		     ippErrorString(con->response->request.status.status_code) :
-		     "-");
-
+  cupsFilePrintf(AccessFile, "%s\n", line);
   cupsFileFlush(AccessFile);
 
   return (1);
 }
 
 
+/*
+ * 'cupsdStartLogWriter()' - Start the log writer thread.
+ */
+
+void
+cupsdStartLogWriter(void)
+{
+#ifdef HAVE_PTHREAD_H
+  if (log_running)
+    return;
+
+  if (!log_buffer && (log_buffer = malloc(CUPSD_LOG_BUFSIZE)) == NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to allocate log buffer - %s",
+                    strerror(errno));
+    return;
+  }
+
+  if (cupsdOpenPipe(log_wake))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to create pipes for log writer - %s",
+		    strerror(errno));
+    return;
+  }
+
+  if (cupsdOpenPipe(log_done))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to create pipes for log writer - %s",
+		    strerror(errno));
+    cupsdClosePipe(log_wake);
+    return;
+  }
+
+ /*
+  * Never block when waking up the writer; a full pipe already wakes it...
+  */
+
+  fcntl(log_wake[1], F_SETFL, fcntl(log_wake[1], F_GETFL) | O_NONBLOCK);
+
+  log_head = log_tail = 0;
+  log_stop = 0;
+
+  if (!_cupsThreadCreate((_cups_thread_func_t)log_writer, NULL))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to start log writer.");
+    cupsdClosePipe(log_wake);
+    cupsdClosePipe(log_done);
+    return;
+  }
+
+  _cupsMutexLock(&log_mutex);
+  log_running = 1;
+  _cupsMutexUnlock(&log_mutex);
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG, "Started log writer.");
+#endif /* HAVE_PTHREAD_H */
+}
+
+
+/*
+ * 'cupsdStopLogWriter()' - Stop the log writer thread.
+ *
+ * Queued log lines are written before returning, and lines are written
+ * directly to the log files afterwards.
+ */
+
+void
+cupsdStopLogWriter(void)
+{
+#ifdef HAVE_PTHREAD_H
+  char	done;				/* Exit status from writer */
+
+
+  if (!log_running)
+    return;
+
+  log_store(log_stop, 1);
+
+  while (write(log_wake[1], "", 1) < 0 && errno == EINTR);
+  while (read(log_done[0], &done, 1) < 0 && errno == EINTR);
+
+ /*
+  * Write any lines that were queued after the writer finished...
+  */
+
+  _cupsMutexLock(&log_mutex);
+  log_running = 0;
+  _cupsMutexUnlock(&log_mutex);
+
+  log_drain();
+
+  cupsdClosePipe(log_wake);
+  cupsdClosePipe(log_done);
+#endif /* HAVE_PTHREAD_H */
+}
+
+
 /*
  * 'cupsdWriteErrorLog()' - Write a line to the ErrorLog.
  */
@@ -1071,6 +1284,36 @@ cupsdWriteErrorLog(int        level,	/* I - Log level */
 
   _cupsMutexLock(&log_mutex);
 
+#ifdef HAVE_PTHREAD_H
+  if (log_running)
+  {
+   /*
+    * Queue the log message, reporting any lines that were dropped...
+    */
+
+    char	prefix[256],		/* Level and date/time */
+		notice[256];		/* Dropped lines notice */
+
+    if (log_dropped != log_reported)
+    {
+      snprintf(prefix, sizeof(prefix), "W %s ",
+               cupsdGetDateTime(NULL, LogTimeFormat));
+      snprintf(notice, sizeof(notice),
+               "Dropped %u log lines because the log buffer was full.",
+	       log_dropped - log_reported);
+
+      if (log_queue(CUPSD_LOGREC_ERROR, prefix, notice))
+        log_reported = log_dropped;
+    }
+
+    snprintf(prefix, sizeof(prefix), "%c %s ", levels[level],
+             cupsdGetDateTime(NULL, LogTimeFormat));
+
+    if (!log_queue(CUPSD_LOGREC_ERROR, prefix, message))
+      log_dropped ++;
+  }
+  else
+#endif /* HAVE_PTHREAD_H */
   if (!cupsdCheckLogFile(&ErrorFile, ErrorLog))
   {
     ret = 0;
@@ -1157,6 +1400,270 @@ format_log_line(const char *message,	/* I - Printf-style format string */
 }
 
 
+#ifdef HAVE_PTHREAD_H
+/*
+ * 'log_drain()' - Write queued lines to the log files.
+ *
+ * Consecutive lines for the same log file are written together.  Must only be
+ * called by the log writer or once the writer has stopped.
+ */
+
+static int				/* O - Bitmask of log files written */
+log_drain(void)
+{
+  int			i,		/* Looping var */
+			batchlog,	/* Log file for batch */
+			written;	/* Log files written */
+  size_t		head,		/* Offset of next queued line */
+			tail,		/* Offset of next line to write */
+			batchlen;	/* Length of batch */
+  cupsd_logrec_t	*rec;		/* Current line */
+  cups_file_t		**lf;		/* Log file */
+  const char		*logname;	/* Log filename */
+  static char		batch[CUPSD_LOG_BATCH];
+					/* Lines to write */
+
+
+  head     = log_load(log_head);
+  tail     = log_tail;
+  rec      = NULL;
+  batchlog = CUPSD_LOGREC_SKIP;
+  batchlen = 0;
+  written  = 0;
+
+  for (;;)
+  {
+    if (tail != head)
+    {
+      rec = (cupsd_logrec_t *)(log_buffer + tail % CUPSD_LOG_BUFSIZE);
+
+      if (rec->log == CUPSD_LOGREC_SKIP || batchlen == 0 ||
+          (rec->log == batchlog &&
+	   (batchlen + (size_t)rec->length) <= sizeof(batch)))
+      {
+       /*
+        * Add the line to the current batch and free its space in the
+	* buffer...
+	*/
+
+        if (rec->log != CUPSD_LOGREC_SKIP)
+	{
+	  memcpy(batch + batchlen, rec + 1, (size_t)rec->length);
+	  batchlen += (size_t)rec->length;
+	  batchlog = rec->log;
+	}
+
+	tail += CUPSD_LOGREC_SIZE(rec->length);
+	log_store(log_tail, tail);
+	continue;
+      }
+    }
+
+   /*
+    * Write the current batch...
+    */
+
+    if (batchlen > 0)
+    {
+      if (batchlog == CUPSD_LOGREC_ACCESS)
+      {
+        lf      = &AccessFile;
+	logname = AccessLog;
+      }
+      else if (batchlog == CUPSD_LOGREC_ERROR)
+      {
+        lf      = &ErrorFile;
+	logname = ErrorLog;
+      }
+      else
+      {
+        lf      = &PageFile;
+	logname = PageLog;
+      }
+
+      if (cupsdCheckLogFile(lf, logname))
+	cupsFileWrite(*lf, batch, batchlen);
+
+      written  |= 1 << batchlog;
+      batchlen = 0;
+    }
+
+    if (tail == head)
+      break;
+  }
+
+ /*
+  * Flush the log files we wrote to...
+  */
+
+  for (i = CUPSD_LOGREC_ACCESS; i <= CUPSD_LOGREC_PAGE; i ++)
+  {
+    if (!(written & (1 << i)))
+      continue;
+
+    lf = i == CUPSD_LOGREC_ACCESS ? &AccessFile :
+         i == CUPSD_LOGREC_ERROR ? &ErrorFile : &PageFile;
+
+    if (*lf)
+      cupsFileFlush(*lf);
+  }
+
+  return (written);
+}
+
+
+/*
+ * 'log_queue()' - Queue a line for the log writer.
+ *
+ * Must be called with log_mutex held.  Long lines are truncated.
+ */
+
+static int				/* O - 1 if queued, 0 if dropped */
+log_queue(int        log,		/* I - Log file (CUPSD_LOGREC_xxx) */
+          const char *prefix,		/* I - Prefix for line */
+	  const char *line)		/* I - Line without newline */
+{
+  size_t		prefixlen,	/* Length of prefix */
+			linelen,	/* Length of line */
+			size,		/* Space used by record */
+			space,		/* Space before end of buffer */
+			head,		/* Offset of next queued line */
+			used;		/* Space used in buffer */
+  cupsd_logrec_t	*rec;		/* New record */
+  char			*ptr;		/* Pointer into record */
+
+
+  prefixlen = strlen(prefix);
+  linelen   = strlen(line);
+
+  if ((prefixlen + linelen + 1) > CUPSD_LOG_BATCH)
+    linelen = CUPSD_LOG_BATCH - prefixlen - 1;
+
+  size  = CUPSD_LOGREC_SIZE(prefixlen + linelen + 1);
+  head  = log_head;
+  used  = head - log_load(log_tail);
+  space = CUPSD_LOG_BUFSIZE - head % CUPSD_LOG_BUFSIZE;
+
+ /*
+  * Records are never split, so a record that doesn't fit before the end of
+  * the buffer also uses the rest of it...
+  */
+
+  if ((used + size + (size > space ? space : 0)) > CUPSD_LOG_BUFSIZE)
+    return (0);
+
+  if (size > space)
+  {
+    rec         = (cupsd_logrec_t *)(log_buffer + head % CUPSD_LOG_BUFSIZE);
+    rec->log    = CUPSD_LOGREC_SKIP;
+    rec->length = (int)(space - sizeof(cupsd_logrec_t));
+    head        += space;
+  }
+
+  rec         = (cupsd_logrec_t *)(log_buffer + head % CUPSD_LOG_BUFSIZE);
+  rec->log    = log;
+  rec->length = (int)(prefixlen + linelen + 1);
+  ptr         = (char *)(rec + 1);
+
+  memcpy(ptr, prefix, prefixlen);
+  memcpy(ptr + prefixlen, line, linelen);
+  ptr[prefixlen + linelen] = '\n';
+
+  log_store(log_head, head + size);
+
+ /*
+  * Wake up the writer early once the buffer starts filling up...
+  */
+
+  if (used < (CUPSD_LOG_BUFSIZE / 4) &&
+      (head + size - log_tail) >= (CUPSD_LOG_BUFSIZE / 4))
+    write(log_wake[1], "", 1);
+
+  return (1);
+}
+
+
+/*
+ * 'log_writer()' - Write queued lines to the log files.
+ */
+
+static void *				/* O - Thread exit status (unused) */
+log_writer(void *arg)			/* I - Thread data (unused) */
+{
+  int		i,			/* Looping var */
+		stop,			/* Stop after this pass? */
+		written,		/* Log files written */
+		unsynced;		/* Log files not synced */
+  time_t	curtime,		/* Current time */
+		synctime;		/* Time of last sync */
+  struct pollfd	pfd;			/* Wake up pipe */
+  char		junk[256];		/* Wake up data */
+  cups_file_t	*lf;			/* Log file */
+  sigset_t	mask;			/* Signal mask */
+
+
+ /*
+  * Nobody joins the writer, and signals belong to the main loop...
+  */
+
+  pthread_detach(pthread_self());
+
+  sigfillset(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+  (void)arg;
+
+  pfd.fd     = log_wake[0];
+  pfd.events = POLLIN;
+  unsynced   = 0;
+  synctime   = time(NULL);
+
+  do
+  {
+   /*
+    * Wait for lines to accumulate, then write them...
+    */
+
+    if ((stop = log_load(log_stop)) == 0 &&
+        poll(&pfd, 1, CUPSD_LOG_FLUSH) > 0)
+      read(log_wake[0], junk, sizeof(junk));
+
+    written  = log_drain();
+    unsynced |= written;
+
+   /*
+    * Sync the log files every few seconds...
+    */
+
+    curtime = time(NULL);
+
+    if (unsynced && (stop || (curtime - synctime) >= CUPSD_LOG_SYNC))
+    {
+      for (i = CUPSD_LOGREC_ACCESS; i <= CUPSD_LOGREC_PAGE; i ++)
+      {
+        if (!(unsynced & (1 << i)))
+	  continue;
+
+	lf = i == CUPSD_LOGREC_ACCESS ? AccessFile :
+	     i == CUPSD_LOGREC_ERROR ? ErrorFile : PageFile;
+
+        if (lf)
+	  fsync(cupsFileNumber(lf));
+      }
+
+      unsynced = 0;
+      synctime = curtime;
+    }
+  }
+  while (!stop);
+
+  while (write(log_done[1], "", 1) < 0 && errno == EINTR);
+
+  return (NULL);
+}
+#endif /* HAVE_PTHREAD_H */
+
+
 /*
  * End of "$Id$".
  */
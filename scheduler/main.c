@@ -649,12 +649,13 @@ main(int  argc,				/* I - Number of command-line args */
   * Loop forever...
   */
 
-  current_time  = time(NULL);
-  event_time    = current_time;
-  expire_time   = current_time;
-  fds           = 1;
-  report_time   = 0;
-  senddoc_time  = current_time;
+  current_time   = time(NULL);
+  event_time     = current_time;
+  expire_time    = current_time;
+  fds            = 1;
+  report_time    = 0;
+  senddoc_time   = current_time;
+  StatsStartTime = current_time;
 
   while (!stop_scheduler)
   {
@@ -845,6 +846,21 @@ main(int  argc,				/* I - Number of command-line args */
     if (DirtyCleanTime && current_time >= DirtyCleanTime)
       cupsdCleanDirty();
 
+   /*
+    * Start or stop an idle filter worker process when there is nothing else
+    * to do...
+    */
+
+    if (!fds)
+      cupsdCheckWorkers();
+
+   /*
+    * Compress preserved job files a piece at a time when idle...
+    */
+
+    if (!fds)
+      cupsdCompressJobFiles();
+
 #ifdef __APPLE__
    /*
     * If we are going to sleep and still have pending jobs, stop them after
@@ -964,10 +980,11 @@ main(int  argc,				/* I - Number of command-line args */
     }
 
    /*
-    * Update any pending multi-file documents...
+    * Update any pending multi-file documents and expired job timers...
     */
 
-    if ((current_time - senddoc_time) >= 10)
+    if ((current_time - senddoc_time) >= 10 ||
+        (JobTimerUpdate && current_time > JobTimerUpdate))
     {
       cupsdCheckJobs();
       senddoc_time = current_time;
@@ -1740,9 +1757,9 @@ static long				/* O - Number of seconds */
 select_timeout(int fds)			/* I - Number of descriptors returned */
 {
   long			timeout;	/* Timeout for select */
-  time_t		now;		/* Current time */
+  time_t		now,		/* Current time */
+			driverd;	/* Time to stop cups-driverd */
   cupsd_client_t	*con;		/* Client information */
-  cupsd_job_t		*job;		/* Job information */
   cupsd_subscription_t	*sub;		/* Subscription information */
   const char		*why;		/* Debugging aid */
 
@@ -1762,6 +1779,22 @@ select_timeout(int fds)			/* I - Number of descriptors returned */
     if (con->http->used > 0)
       return (0);
 
+ /*
+  * Keep polling while idle filter worker processes need to be started or
+  * stopped...
+  */
+
+  if (cupsdNeedWorkers())
+    return (0);
+
+ /*
+  * Likewise when preserved job files are waiting to be compressed and no
+  * jobs are printing...
+  */
+
+  if (!cupsArrayCount(PrintingJobs) && cupsdNeedJobCompression())
+    return (0);
+
  /*
   * If select has been active in the last second (fds > 0) or we have
   * many resources in use then don't bother trying to optimize the
@@ -1830,6 +1863,16 @@ select_timeout(int fds)			/* I - Number of descriptors returned */
     why     = "write dirty config/state files";
   }
 
+ /*
+  * Stop an idle cups-driverd service...
+  */
+
+  if ((driverd = cupsdGetDriverdTimeout()) > 0 && timeout > driverd)
+  {
+    timeout = driverd;
+    why     = "stop idle cups-driverd";
+  }
+
  /*
   * Check for any job activity...
   */
@@ -1840,34 +1883,16 @@ select_timeout(int fds)			/* I - Number of descriptors returned */
     why     = "update job history";
   }
 
-  for (job = (cupsd_job_t *)cupsArrayFirst(ActiveJobs);
-       job;
-       job = (cupsd_job_t *)cupsArrayNext(ActiveJobs))
+  if (JobTimerUpdate && timeout > JobTimerUpdate)
   {
-    if (job->cancel_time && job->cancel_time < timeout)
-    {
-      timeout = job->cancel_time;
-      why     = "cancel stuck jobs";
-    }
-
-    if (job->kill_time && job->kill_time < timeout)
-    {
-      timeout = job->kill_time;
-      why     = "kill unresponsive jobs";
-    }
-
-    if (job->state_value == IPP_JOB_HELD && job->hold_until < timeout)
-    {
-      timeout = job->hold_until;
-      why     = "release held jobs";
-    }
+    timeout = JobTimerUpdate;
+    why     = "cancel, kill, or release jobs";
+  }
 
-    if (job->state_value == IPP_JOB_PENDING && timeout > (now + 10))
-    {
-      timeout = now + 10;
-      why     = "start pending jobs";
-      break;
-    }
+  if (PendingJobCount > 0 && timeout > (now + 10))
+  {
+    timeout = now + 10;
+    why     = "start pending jobs";
   }
 
 #ifdef HAVE_MALLINFO
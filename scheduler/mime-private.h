@@ -31,6 +31,7 @@ extern "C" {
  * Prototypes...
  */
 
+extern void	_mimeDeleteFileIndex(mime_t *mime);
 extern void	_mimeError(mime_t *mime, const char *format, ...)
 		__attribute__ ((__format__ (__printf__, 2, 3)));
 
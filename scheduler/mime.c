@@ -111,6 +111,8 @@ mimeDelete(mime_t *mime)		/* I - MIME database */
   * Free the types and filters arrays, and then the MIME database structure.
   */
 
+  _mimeDeleteFileIndex(mime);
+
   cupsArrayDelete(mime->types);
   cupsArrayDelete(mime->filters);
   cupsArrayDelete(mime->srcs);
@@ -180,6 +182,7 @@ mimeDeleteType(mime_t      *mime,	/* I - MIME database */
 #endif /* DEBUG */
 
   cupsArrayRemove(mime->types, mt);
+  _mimeDeleteFileIndex(mime);
 
   mime_delete_rules(mt->rules);
   free(mt);
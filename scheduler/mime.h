@@ -112,6 +112,7 @@ typedef struct _mime_s			/**** MIME Database ****/
   cups_array_t		*srcs;		/* Filters sorted by source type */
   mime_error_cb_t	error_cb;	/* Error message callback */
   void			*error_ctx;	/* Pointer for callback */
+  struct _mime_fileindex_s *fileindex;	/* Compiled type detection rules */
 } mime_t;
 
 
@@ -38,24 +38,119 @@
 #endif /* __APPLE__ */
 
 
+/*
+ * Background PPD loading...
+ *
+ * When printers.conf is loaded, the PPD file (or PPD cache) of each printer
+ * is read by a pool of loader threads.  A loader works on a private copy of
+ * the printer fields that load_ppd() uses, so it never touches scheduler
+ * state; log messages are saved and the results are merged into the printer
+ * by the main loop.  Jobs are not started on a printer until its PPD file has
+ * been merged, and cupsdFinishLoadingPrinter() loads it right away (or waits
+ * for the loader) when a request needs the printer sooner.
+ */
+
+#define CUPSD_LOADERS_MAX	8	/* Maximum number of PPD loaders */
+
+#define CUPSD_LOAD_QUEUED	0	/* Waiting for a loader */
+#define CUPSD_LOAD_RUNNING	1	/* Being loaded by a loader */
+#define CUPSD_LOAD_DONE		2	/* Loaded by a loader */
+#define CUPSD_LOAD_CANCELED	3	/* Loaded by the main loop or deleted */
+
+typedef struct cupsd_ppdload_s		/**** Background PPD load ****/
+{
+  cupsd_printer_t	*printer;	/* Printer or NULL if done/deleted */
+  cupsd_printer_t	copy;		/* Copy of printer fields to load */
+  cups_array_t		*messages;	/* Log messages from the loader */
+  int			state,		/* CUPSD_LOAD_xxx, set under load_mutex */
+			loaded;		/* Copy has the loaded attributes? */
+} cupsd_ppdload_t;
+
+
+/*
+ * Shared PPD attributes...
+ *
+ * The attributes and cache that load_ppd() builds depend only on the
+ * contents of the PPD file, so printers with identical PPD files share a
+ * single, reference-counted copy keyed by the MD5 digest of the file.  Shared
+ * records are never modified; when a printer's PPD file changes (for example
+ * when lpadmin sets new defaults) the printer drops its reference and loads
+ * or shares a record for the new contents.
+ */
+
+typedef struct cupsd_ppdinfo_s		/**** Shared PPD attributes ****/
+{
+  unsigned char	digest[16];		/* MD5 digest of PPD file */
+  int		ref_count;		/* Number of printers using the record */
+  ipp_t		*ppd_attrs;		/* PPD attributes */
+  _ppd_cache_t	*pc;			/* PPD cache and mapping data */
+  cups_ptype_t	type;			/* Printer type bits from PPD */
+  char		*make_model,		/* Make and model from PPD */
+		*cache_name;		/* Cache file with these attributes */
+  ino_t		cache_ino;		/* Inode number of cache file */
+  time_t	cache_mtime;		/* Modification time of cache file */
+} cupsd_ppdinfo_t;
+
+
 /*
  * Local functions...
  */
 
+static void	add_ppd_info(cupsd_printer_t *p, unsigned char *digest,
+		             const char *cache_name);
 static void	add_printer_defaults(cupsd_printer_t *p);
 static void	add_printer_filter(cupsd_printer_t *p, mime_type_t *type,
 				   const char *filter);
 static void	add_printer_formats(cupsd_printer_t *p);
+static void	apply_ppd(cupsd_printer_t *p);
+static int	compare_ppd_info(cupsd_ppdinfo_t *a, cupsd_ppdinfo_t *b);
 static int	compare_printers(void *first, void *second, void *data);
+static void	copy_ppd_cache(cupsd_ppdinfo_t *info, const char *cache_name);
 static void	delete_printer_filters(cupsd_printer_t *p);
 static void	dirty_printer(cupsd_printer_t *p);
-static void	load_ppd(cupsd_printer_t *p);
+static cupsd_encoded_t *encode_attrs(ipp_t *attrs, ipp_t *ppd_attrs);
+static ssize_t	encode_cb(cupsd_encoded_t *enc, ipp_uchar_t *buffer,
+		          size_t bytes);
+static void	finish_ppd_load(void *data);
+static void	finish_printer(cupsd_printer_t *p);
+static void	free_encoded(cupsd_encoded_t **enc);
+static void	free_ppd_load(cupsd_ppdload_t *load);
+static int	hash_ppd(const char *filename, unsigned char *digest);
+static void	load_ppd(cupsd_printer_t *p, cups_array_t *messages);
 static void	log_ipp_conformance(cupsd_printer_t *p, const char *reason);
+static void	log_ppd(cups_array_t *messages, int level, const char *message,
+		        ...) __attribute__((__format__(__printf__, 3, 4)));
 static ipp_t	*new_media_col(_pwg_size_t *size, const char *source,
 		               const char *type);
+static void	queue_ppd_load(cupsd_printer_t *p);
+static void	release_ppd(cupsd_printer_t *p);
+static void	*run_ppd_loader(void *arg);
+static int	share_ppd(cupsd_printer_t *p, unsigned char *digest);
+static void	start_ppd_loaders(void);
+static void	write_printer(cups_file_t *fp, cupsd_printer_t *printer);
 static void	write_xml_string(cups_file_t *fp, const char *s);
 
 
+/*
+ * Local globals...
+ */
+
+static int	printer_records = -1;	/* Stale records in printers.conf or -1 */
+static _cups_mutex_t load_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex for load states */
+static int	load_pipes[2] = { -1, -1 },
+					/* Pipes for queued loads */
+		load_done_pipes[2] = { -1, -1 },
+					/* Pipes for finished loads */
+		num_loaders = 0,	/* Number of loader threads */
+		num_loads = 0,		/* Number of loads in progress */
+		load_count = 0;		/* Number of loads queued */
+static double	load_start = 0.0;	/* Time loading started */
+static cups_array_t *ppd_infos = NULL;	/* Shared PPD attributes */
+static _cups_mutex_t info_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex for shared PPD attributes */
+
+
 /*
  * 'cupsdAddPrinter()' - Add a printer to the system.
  */
@@ -108,7 +203,8 @@ cupsdAddPrinter(const char *name)	/* I - Name of printer */
   cupsdSetString(&p->error_policy, ErrorPolicy);
   cupsdSetString(&p->op_policy, DefaultPolicy);
 
-  p->op_policy_ptr = DefaultPolicyPtr;
+  p->op_policy_ptr     = DefaultPolicyPtr;
+  p->spool_compression = -1;
 
  /*
   * Insert the printer in the printer list alphabetically...
@@ -228,6 +324,7 @@ cupsdCreateCommonData(void)
 		  CUPS_AUTHENTICATE_JOB,
 		  CUPS_GET_PPD,
 		  CUPS_GET_DOCUMENT,
+		  CUPS_GET_STATISTICS,
 		  IPP_RESTART_JOB
 		};
   static const char * const charsets[] =/* charset-supported values */
@@ -361,6 +458,8 @@ cupsdCreateCommonData(void)
   if (CommonData)
     ippDelete(CommonData);
 
+  free_encoded(&CommonEncoded);
+
   CommonData = ippNew();
 
  /*
@@ -688,6 +787,21 @@ cupsdDeletePrinter(
 
   cupsArraySave(Printers);
 
+ /*
+  * Forget any PPD file that is still being loaded...
+  */
+
+  if (p->ppd_load)
+  {
+    _cupsMutexLock(&load_mutex);
+    if (p->ppd_load->state == CUPSD_LOAD_QUEUED)
+      p->ppd_load->state = CUPSD_LOAD_CANCELED;
+    _cupsMutexUnlock(&load_mutex);
+
+    p->ppd_load->printer = NULL;
+    p->ppd_load          = NULL;
+  }
+
  /*
   * Stop printing on this printer...
   */
@@ -741,7 +855,9 @@ cupsdDeletePrinter(
     _cupsStrFree(p->reasons[i]);
 
   ippDelete(p->attrs);
-  ippDelete(p->ppd_attrs);
+  release_ppd(p);
+
+  free_encoded(&p->encoded);
 
   mimeDeleteType(MimeDatabase, p->filetype);
   mimeDeleteType(MimeDatabase, p->prefiltertype);
@@ -787,6 +903,38 @@ cupsdDeletePrinter(
 }
 
 
+/*
+ * 'cupsdEncodeCommonData()' - Get the pre-encoded common printer attributes.
+ */
+
+cupsd_encoded_t *			/* O - Encoded attributes or NULL */
+cupsdEncodeCommonData(void)
+{
+  if (!CommonEncoded && CommonData)
+    CommonEncoded = encode_attrs(CommonData, NULL);
+
+  return (CommonEncoded);
+}
+
+
+/*
+ * 'cupsdEncodePrinterAttrs()' - Get the pre-encoded printer attributes.
+ *
+ * The encoded data covers the printer's attrs and ppd_attrs and is rebuilt on
+ * demand after the printer attributes change.
+ */
+
+cupsd_encoded_t *			/* O - Encoded attributes or NULL */
+cupsdEncodePrinterAttrs(
+    cupsd_printer_t *p)			/* I - Printer */
+{
+  if (!p->encoded && p->attrs)
+    p->encoded = encode_attrs(p->attrs, p->ppd_attrs);
+
+  return (p->encoded);
+}
+
+
 /*
  * 'cupsdFindDest()' - Find a destination in the list.
  */
@@ -819,6 +967,61 @@ cupsdFindPrinter(const char *name)	/* I - Name of printer to find */
 }
 
 
+/*
+ * 'cupsdFinishLoadingPrinter()' - Finish loading the PPD file for a printer.
+ *
+ * For classes, the PPD files of all member printers are loaded.
+ */
+
+void
+cupsdFinishLoadingPrinter(
+    cupsd_printer_t *p)			/* I - Printer or class */
+{
+  int			i;		/* Looping var */
+  cupsd_ppdload_t	*load;		/* Background load */
+  int			claimed;	/* Load it here? */
+
+
+  if (p->type & CUPS_PRINTER_CLASS)
+  {
+    for (i = 0; i < p->num_printers; i ++)
+      cupsdFinishLoadingPrinter(p->printers[i]);
+
+    return;
+  }
+
+  if ((load = p->ppd_load) == NULL)
+    return;
+
+  _cupsMutexLock(&load_mutex);
+  if ((claimed = load->state == CUPSD_LOAD_QUEUED) != 0)
+    load->state = CUPSD_LOAD_CANCELED;
+  _cupsMutexUnlock(&load_mutex);
+
+  if (claimed)
+  {
+   /*
+    * No loader has started on this printer yet, so load it now; the loader
+    * just hands it back when it gets to it...
+    */
+
+    load_ppd(&load->copy, NULL);
+    load->loaded = 1;
+
+    finish_printer(p);
+  }
+  else
+  {
+   /*
+    * Wait for the loader...
+    */
+
+    while (p->ppd_load == load && num_loaders > 0)
+      finish_ppd_load(NULL);
+  }
+}
+
+
 /*
  * 'cupsdLoadAllPrinters()' - Load printers from the printers.conf file.
  */
@@ -833,25 +1036,59 @@ cupsdLoadAllPrinters(void)
 			*value,		/* Pointer to value */
 			*valueptr;	/* Pointer into value */
   cupsd_printer_t	*p;		/* Current printer */
+  cups_array_t		*records;	/* Current printer records */
+  int			skip;		/* Skipping an old record? */
 
 
  /*
   * Open the printers.conf file...
   */
 
+  printer_records = -1;
+
   snprintf(line, sizeof(line), "%s/printers.conf", ServerRoot);
   if ((fp = cupsdOpenConfFile(line)) == NULL)
     return;
 
+ /*
+  * Wait for any loads from a previous configuration, then start the PPD
+  * loaders...
+  */
+
+  while (num_loaders > 0)
+    finish_ppd_load(NULL);
+
+  start_ppd_loaders();
+
+ /*
+  * Find the current copy of each printer, since changed printers are
+  * appended to the file...
+  */
+
+  records = cupsdFindConfRecords(fp, &printer_records);
+
  /*
   * Read printer configurations until we hit EOF...
   */
 
   linenum = 0;
   p       = NULL;
+  skip    = 0;
 
   while (cupsFileGetConf(fp, line, sizeof(line), &value, &linenum))
   {
+    if (skip)
+    {
+     /*
+      * Skip older (or incomplete) copies of a printer...
+      */
+
+      if (!_cups_strcasecmp(line, "</Printer>"))
+        skip = 0;
+
+      continue;
+    }
+
    /*
     * Decode the directive...
     */
@@ -863,7 +1100,10 @@ cupsdLoadAllPrinters(void)
       * <Printer name> or <DefaultPrinter name>
       */
 
-      if (p == NULL && value)
+      if (p == NULL && value &&
+          !cupsdIsCurrentConfRecord(records, value, linenum))
+        skip = 1;
+      else if (p == NULL && value)
       {
        /*
         * Add the printer and a base file type...
@@ -891,9 +1131,11 @@ cupsdLoadAllPrinters(void)
       if (p != NULL)
       {
        /*
-        * Close out the current printer...
+        * Close out the current printer, loading the PPD file in the
+	* background...
 	*/
 
+        queue_ppd_load(p);
         cupsdSetPrinterAttrs(p);
 
         if (strncmp(p->device_uri, "file:", 5) &&
@@ -1192,6 +1434,14 @@ cupsdLoadAllPrinters(void)
 	cupsdLogMessage(CUPSD_LOG_ERROR,
 	                "Syntax error on line %d of printers.conf.", linenum);
     }
+    else if (!_cups_strcasecmp(line, "SpoolCompression"))
+    {
+      if (value && isdigit(*value & 255))
+        p->spool_compression = atoi(value);
+      else
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of printers.conf.", linenum);
+    }
     else if (!_cups_strcasecmp(line, "OpPolicy"))
     {
       if (value)
@@ -1256,7 +1506,34 @@ cupsdLoadAllPrinters(void)
     }
   }
 
+  cupsArrayDelete(records);
   cupsFileClose(fp);
+
+ /*
+  * Rewrite the file right away if it holds older or incomplete copies of a
+  * printer, since other programs that read printers.conf (including older
+  * versions of cupsd) would otherwise see duplicate printers...
+  */
+
+  if (printer_records)
+  {
+    printer_records = -1;
+    cupsdSaveAllPrinters();
+  }
+
+ /*
+  * No more loads; the loaders exit once they are done...
+  */
+
+  if (load_pipes[1] >= 0)
+  {
+    cupsdLogMessage(CUPSD_LOG_DEBUG,
+                    "Loading %d PPD files using %d threads.", load_count,
+		    num_loaders);
+
+    close(load_pipes[1]);
+    load_pipes[1] = -1;
+  }
 }
 
 
@@ -1320,25 +1597,63 @@ cupsdRenamePrinter(
 void
 cupsdSaveAllPrinters(void)
 {
-  int			i;		/* Looping var */
   cups_file_t		*fp;		/* printers.conf file */
   char			filename[1024],	/* printers.conf filename */
-			temp[1024],	/* Temporary string */
-			value[2048],	/* Value string */
-			*ptr,		/* Pointer into value */
-			*name;		/* Current user/group name */
+			temp[1024];	/* Temporary string */
   cupsd_printer_t	*printer;	/* Current printer class */
   time_t		curtime;	/* Current time */
   struct tm		*curdate;	/* Current date */
-  cups_option_t		*option;	/* Current option */
-  ipp_attribute_t	*marker;	/* Current marker attribute */
+  int			records;	/* Number of records written */
+
 
+  snprintf(filename, sizeof(filename), "%s/printers.conf", ServerRoot);
 
  /*
-  * Create the printers.conf file...
+  * Append the changed printers to the printers.conf file if we can...
   */
 
-  snprintf(filename, sizeof(filename), "%s/printers.conf", ServerRoot);
+  if (!(DirtyFiles & (CUPSD_DIRTY_PRINTERS | CUPSD_DIRTY_COMPACT)) &&
+      printer_records >= 0 &&
+      printer_records <= (cupsArrayCount(Printers) + MAX_CONF_RECORDS))
+  {
+    if ((fp = cupsdAppendConfFile(filename)) != NULL)
+    {
+      for (printer = (cupsd_printer_t *)cupsArrayFirst(Printers), records = 0;
+	   printer;
+	   printer = (cupsd_printer_t *)cupsArrayNext(Printers))
+      {
+	if ((printer->type & CUPS_PRINTER_CLASS) || !printer->dirty)
+	  continue;
+
+	write_printer(fp, printer);
+
+	printer->dirty = 0;
+	records ++;
+      }
+
+      if (!cupsdCloseAppendedConfFile(fp, filename))
+      {
+	cupsdLogMessage(CUPSD_LOG_DEBUG,
+	                "Appended %d records to printers.conf.", records);
+
+	printer_records += records;
+	return;
+      }
+    }
+  }
+  else if (!((DirtyFiles | DirtyRecords) & CUPSD_DIRTY_PRINTERS) &&
+           printer_records == 0)
+  {
+   /*
+    * Nothing to compact...
+    */
+
+    return;
+  }
+
+ /*
+  * Otherwise create a new printers.conf file...
+  */
 
   if ((fp = cupsdCreateConfFile(filename, ConfigFilePerm & 0600)) == NULL)
     return;
@@ -1376,219 +1691,15 @@ cupsdSaveAllPrinters(void)
     * Write printers as needed...
     */
 
-    if (printer == DefaultPrinter)
-      cupsFilePrintf(fp, "<DefaultPrinter %s>\n", printer->name);
-    else
-      cupsFilePrintf(fp, "<Printer %s>\n", printer->name);
-
-    cupsFilePrintf(fp, "UUID %s\n", printer->uuid);
-
-    if (printer->num_auth_info_required > 0)
-    {
-      switch (printer->num_auth_info_required)
-      {
-        case 1 :
-            strlcpy(value, printer->auth_info_required[0], sizeof(value));
-	    break;
-
-        case 2 :
-            snprintf(value, sizeof(value), "%s,%s",
-	             printer->auth_info_required[0],
-		     printer->auth_info_required[1]);
-	    break;
-
-        case 3 :
-	default :
-            snprintf(value, sizeof(value), "%s,%s,%s",
-	             printer->auth_info_required[0],
-		     printer->auth_info_required[1],
-		     printer->auth_info_required[2]);
-	    break;
-      }
-
-      cupsFilePutConf(fp, "AuthInfoRequired", value);
-    }
-
-    if (printer->info)
-      cupsFilePutConf(fp, "Info", printer->info);
-
-    if (printer->location)
-      cupsFilePutConf(fp, "Location", printer->location);
-
-    if (printer->make_model)
-      cupsFilePutConf(fp, "MakeModel", printer->make_model);
-
-    cupsFilePutConf(fp, "DeviceURI", printer->device_uri);
-
-    if (printer->port_monitor)
-      cupsFilePutConf(fp, "PortMonitor", printer->port_monitor);
-
-    if (printer->state == IPP_PRINTER_STOPPED)
-    {
-      cupsFilePuts(fp, "State Stopped\n");
-
-      if (printer->state_message)
-        cupsFilePutConf(fp, "StateMessage", printer->state_message);
-    }
-    else
-      cupsFilePuts(fp, "State Idle\n");
-
-    cupsFilePrintf(fp, "StateTime %d\n", (int)printer->state_time);
-
-    for (i = 0; i < printer->num_reasons; i ++)
-      if (strcmp(printer->reasons[i], "connecting-to-device") &&
-          strcmp(printer->reasons[i], "cups-insecure-filter-warning") &&
-          strcmp(printer->reasons[i], "cups-missing-filter-warning"))
-        cupsFilePutConf(fp, "Reason", printer->reasons[i]);
-
-    cupsFilePrintf(fp, "Type %d\n", printer->type);
-
-    if (printer->accepting)
-      cupsFilePuts(fp, "Accepting Yes\n");
-    else
-      cupsFilePuts(fp, "Accepting No\n");
-
-    if (printer->shared)
-      cupsFilePuts(fp, "Shared Yes\n");
-    else
-      cupsFilePuts(fp, "Shared No\n");
-
-    snprintf(value, sizeof(value), "%s %s", printer->job_sheets[0],
-             printer->job_sheets[1]);
-    cupsFilePutConf(fp, "JobSheets", value);
-
-    cupsFilePrintf(fp, "QuotaPeriod %d\n", printer->quota_period);
-    cupsFilePrintf(fp, "PageLimit %d\n", printer->page_limit);
-    cupsFilePrintf(fp, "KLimit %d\n", printer->k_limit);
-
-    for (name = (char *)cupsArrayFirst(printer->users);
-         name;
-	 name = (char *)cupsArrayNext(printer->users))
-      cupsFilePutConf(fp, printer->deny_users ? "DenyUser" : "AllowUser", name);
-
-    if (printer->op_policy)
-      cupsFilePutConf(fp, "OpPolicy", printer->op_policy);
-    if (printer->error_policy)
-      cupsFilePutConf(fp, "ErrorPolicy", printer->error_policy);
-
-    for (i = printer->num_options, option = printer->options;
-         i > 0;
-	 i --, option ++)
-    {
-      snprintf(value, sizeof(value), "%s %s", option->name, option->value);
-      cupsFilePutConf(fp, "Option", value);
-    }
-
-    if ((marker = ippFindAttribute(printer->attrs, "marker-colors",
-                                   IPP_TAG_NAME)) != NULL)
-    {
-      snprintf(value, sizeof(value), "%s ", marker->name);
-
-      for (i = 0, ptr = value + strlen(value);
-           i < marker->num_values && ptr < (value + sizeof(value) - 1);
-	   i ++)
-      {
-        if (i)
-	  *ptr++ = ',';
-
-        strlcpy(ptr, marker->values[i].string.text,
-	        value + sizeof(value) - ptr);
-        ptr += strlen(ptr);
-      }
-
-      *ptr = '\0';
-      cupsFilePutConf(fp, "Attribute", value);
-    }
-
-    if ((marker = ippFindAttribute(printer->attrs, "marker-levels",
-                                   IPP_TAG_INTEGER)) != NULL)
-    {
-      cupsFilePrintf(fp, "Attribute %s %d", marker->name,
-                     marker->values[0].integer);
-      for (i = 1; i < marker->num_values; i ++)
-        cupsFilePrintf(fp, ",%d", marker->values[i].integer);
-      cupsFilePuts(fp, "\n");
-    }
-
-    if ((marker = ippFindAttribute(printer->attrs, "marker-low-levels",
-                                   IPP_TAG_INTEGER)) != NULL)
-    {
-      cupsFilePrintf(fp, "Attribute %s %d", marker->name,
-                     marker->values[0].integer);
-      for (i = 1; i < marker->num_values; i ++)
-        cupsFilePrintf(fp, ",%d", marker->values[i].integer);
-      cupsFilePuts(fp, "\n");
-    }
-
-    if ((marker = ippFindAttribute(printer->attrs, "marker-high-levels",
-                                   IPP_TAG_INTEGER)) != NULL)
-    {
-      cupsFilePrintf(fp, "Attribute %s %d", marker->name,
-                     marker->values[0].integer);
-      for (i = 1; i < marker->num_values; i ++)
-        cupsFilePrintf(fp, ",%d", marker->values[i].integer);
-      cupsFilePuts(fp, "\n");
-    }
-
-    if ((marker = ippFindAttribute(printer->attrs, "marker-message",
-                                   IPP_TAG_TEXT)) != NULL)
-    {
-      snprintf(value, sizeof(value), "%s %s", marker->name,
-               marker->values[0].string.text);
-
-      cupsFilePutConf(fp, "Attribute", value);
-    }
-
-    if ((marker = ippFindAttribute(printer->attrs, "marker-names",
-                                   IPP_TAG_NAME)) != NULL)
-    {
-      snprintf(value, sizeof(value), "%s ", marker->name);
-
-      for (i = 0, ptr = value + strlen(value);
-           i < marker->num_values && ptr < (value + sizeof(value) - 1);
-	   i ++)
-      {
-        if (i)
-	  *ptr++ = ',';
-
-        strlcpy(ptr, marker->values[i].string.text,
-	        value + sizeof(value) - ptr);
-        ptr += strlen(ptr);
-      }
-
-      *ptr = '\0';
-      cupsFilePutConf(fp, "Attribute", value);
-    }
-
-    if ((marker = ippFindAttribute(printer->attrs, "marker-types",
-                                   IPP_TAG_KEYWORD)) != NULL)
-    {
-      snprintf(value, sizeof(value), "%s ", marker->name);
-
-      for (i = 0, ptr = value + strlen(value);
-           i < marker->num_values && ptr < (value + sizeof(value) - 1);
-	   i ++)
-      {
-        if (i)
-	  *ptr++ = ',';
-
-        strlcpy(ptr, marker->values[i].string.text,
-	        value + sizeof(value) - ptr);
-        ptr += strlen(ptr);
-      }
-
-      *ptr = '\0';
-      cupsFilePutConf(fp, "Attribute", value);
-    }
-
-    if (printer->marker_time)
-      cupsFilePrintf(fp, "Attribute marker-change-time %ld\n",
-                     (long)printer->marker_time);
+    write_printer(fp, printer);
 
-    cupsFilePuts(fp, "</Printer>\n");
+    printer->dirty = 0;
   }
 
-  cupsdCloseCreatedConfFile(fp, filename);
+  if (cupsdCloseCreatedConfFile(fp, filename))
+    printer_records = -1;
+  else
+    printer_records = 0;
 }
 
 
@@ -1888,6 +1999,8 @@ cupsdSetPrinterAttr(
   * Then add or update the attribute as needed...
   */
 
+  free_encoded(&p->encoded);
+
   if (!strcmp(name, "marker-levels") || !strcmp(name, "marker-low-levels") ||
       !strcmp(name, "marker-high-levels"))
   {
@@ -2079,6 +2192,8 @@ cupsdSetPrinterAttrs(cupsd_printer_t *p)/* I - Printer to setup */
   * Create the required IPP attributes for a printer...
   */
 
+  free_encoded(&p->encoded);
+
   oldattrs = p->attrs;
   p->attrs = ippNew();
 
@@ -2118,6 +2233,9 @@ cupsdSetPrinterAttrs(cupsd_printer_t *p)/* I - Printer to setup */
                 "job-k-limit", p->k_limit);
   ippAddInteger(p->attrs, IPP_TAG_PRINTER, IPP_TAG_INTEGER,
                 "job-page-limit", p->page_limit);
+  if (p->spool_compression >= 0)
+    ippAddInteger(p->attrs, IPP_TAG_PRINTER, IPP_TAG_INTEGER,
+                  "spool-compression", p->spool_compression);
   if (p->num_auth_info_required > 0 && strcmp(p->auth_info_required[0], "none"))
     ippAddStrings(p->attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD,
 		  "auth-info-required", p->num_auth_info_required, NULL,
@@ -2191,11 +2309,14 @@ cupsdSetPrinterAttrs(cupsd_printer_t *p)/* I - Printer to setup */
     ippAddString(p->attrs, IPP_TAG_PRINTER, IPP_TAG_URI, "device-uri", NULL,
 		 p->sanitized_device_uri);
 
+    ippAddString(p->attrs, IPP_TAG_PRINTER, IPP_TAG_NAME, "port-monitor",
+		 NULL, p->port_monitor ? p->port_monitor : "none");
+
    /*
     * Assign additional attributes from the PPD file (if any)...
     */
 
-    load_ppd(p);
+    apply_ppd(p);
 
    /*
     * Add filters for printer...
@@ -2870,6 +2991,8 @@ cupsdValidateDest(
     return (NULL);
   else if (p != NULL)
   {
+    cupsdFinishLoadingPrinter(p);
+
     if (printer)
       *printer = p;
 
@@ -2928,6 +3051,8 @@ cupsdValidateDest(
     if (!_cups_strcasecmp(p->hostname, localname) &&
         !_cups_strcasecmp(p->name, rptr))
     {
+      cupsdFinishLoadingPrinter(p);
+
       if (printer)
         *printer = p;
 
@@ -3123,35 +3248,105 @@ cupsdWritePrintcap(void)
 
 
 /*
- * 'add_printer_defaults()' - Add name-default attributes to the printer attributes.
+ * 'add_ppd_info()' - Share the PPD attributes of a printer with other
+ *                    printers using the same PPD file.
  */
 
 static void
-add_printer_defaults(cupsd_printer_t *p)/* I - Printer */
+add_ppd_info(cupsd_printer_t *p,	/* I - Printer */
+             unsigned char   *digest,	/* I - MD5 digest of PPD file */
+	     const char      *cache_name)
+					/* I - Cache file or empty string */
 {
-  int		i;			/* Looping var */
-  int		num_options;		/* Number of default options */
-  cups_option_t	*options,		/* Default options */
-		*option;		/* Current option */
-  char		name[256];		/* name-default */
+  cupsd_ppdinfo_t	key,		/* Search key */
+			*info;		/* Shared attributes */
+  struct stat		cache_info;	/* Cache file info */
 
 
- /*
-  * Maintain a common array of default attribute names...
-  */
+  memcpy(key.digest, digest, sizeof(key.digest));
 
-  if (!CommonDefaults)
+  _cupsMutexLock(&info_mutex);
+
+  if (!ppd_infos)
+    ppd_infos = cupsArrayNew((cups_array_func_t)compare_ppd_info, NULL);
+
+  if ((info = (cupsd_ppdinfo_t *)cupsArrayFind(ppd_infos, &key)) != NULL)
   {
-    CommonDefaults = cupsArrayNew((cups_array_func_t)strcmp, NULL);
+   /*
+    * Another loader got here first, use its copy...
+    */
 
-    cupsArrayAdd(CommonDefaults, _cupsStrAlloc("copies-default"));
-    cupsArrayAdd(CommonDefaults, _cupsStrAlloc("document-format-default"));
-    cupsArrayAdd(CommonDefaults, _cupsStrAlloc("finishings-default"));
-    cupsArrayAdd(CommonDefaults, _cupsStrAlloc("job-account-id-default"));
-    cupsArrayAdd(CommonDefaults,
-                 _cupsStrAlloc("job-accounting-user-id-default"));
-    cupsArrayAdd(CommonDefaults, _cupsStrAlloc("job-cancel-after-default"));
-    cupsArrayAdd(CommonDefaults, _cupsStrAlloc("job-hold-until-default"));
+    info->ref_count ++;
+
+    _cupsMutexUnlock(&info_mutex);
+
+    ippDelete(p->ppd_attrs);
+    _ppdCacheDestroy(p->pc);
+
+    p->ppd_attrs = info->ppd_attrs;
+    p->pc        = info->pc;
+    p->ppd_info  = info;
+    return;
+  }
+
+  if ((info = calloc(1, sizeof(cupsd_ppdinfo_t))) != NULL)
+  {
+    memcpy(info->digest, digest, sizeof(info->digest));
+
+    info->ref_count = 1;
+    info->ppd_attrs = p->ppd_attrs;
+    info->pc        = p->pc;
+    info->type      = p->type & CUPS_PRINTER_OPTIONS;
+
+    if (p->make_model)
+      info->make_model = strdup(p->make_model);
+
+    if (*cache_name && !stat(cache_name, &cache_info))
+    {
+      info->cache_name  = strdup(cache_name);
+      info->cache_ino   = cache_info.st_ino;
+      info->cache_mtime = cache_info.st_mtime;
+    }
+
+    cupsArrayAdd(ppd_infos, info);
+
+    p->ppd_info = info;
+  }
+
+  _cupsMutexUnlock(&info_mutex);
+}
+
+
+/*
+ * 'add_printer_defaults()' - Add name-default attributes to the printer attributes.
+ */
+
+static void
+add_printer_defaults(cupsd_printer_t *p)/* I - Printer */
+{
+  int		i;			/* Looping var */
+  int		num_options;		/* Number of default options */
+  cups_option_t	*options,		/* Default options */
+		*option;		/* Current option */
+  char		name[256];		/* name-default */
+
+
+ /*
+  * Maintain a common array of default attribute names...
+  */
+
+  if (!CommonDefaults)
+  {
+    CommonDefaults = cupsArrayNew((cups_array_func_t)strcmp, NULL);
+
+    cupsArrayAdd(CommonDefaults, _cupsStrAlloc("copies-default"));
+    cupsArrayAdd(CommonDefaults, _cupsStrAlloc("document-format-default"));
+    cupsArrayAdd(CommonDefaults, _cupsStrAlloc("finishings-default"));
+    cupsArrayAdd(CommonDefaults, _cupsStrAlloc("job-account-id-default"));
+    cupsArrayAdd(CommonDefaults,
+                 _cupsStrAlloc("job-accounting-user-id-default"));
+    cupsArrayAdd(CommonDefaults, _cupsStrAlloc("job-cancel-after-default"));
+    cupsArrayAdd(CommonDefaults, _cupsStrAlloc("job-hold-until-default"));
     cupsArrayAdd(CommonDefaults, _cupsStrAlloc("job-priority-default"));
     cupsArrayAdd(CommonDefaults, _cupsStrAlloc("job-sheets-default"));
     cupsArrayAdd(CommonDefaults, _cupsStrAlloc("media-col-default"));
@@ -3539,6 +3734,101 @@ add_printer_formats(cupsd_printer_t *p)	/* I - Printer */
 }
 
 
+/*
+ * 'apply_ppd()' - Set the PPD attributes of a printer, loading them as needed.
+ */
+
+static void
+apply_ppd(cupsd_printer_t *p)		/* I - Printer */
+{
+  cupsd_ppdload_t	*load;		/* Background load */
+  ipp_attribute_t	*attr;		/* printer-uri-supported attribute */
+  char			*message;	/* Saved log message */
+
+
+  if ((load = p->ppd_load) == NULL)
+  {
+   /*
+    * Load the PPD file or cache now...
+    */
+
+    load_ppd(p, NULL);
+
+    if (p->dirty)
+      cupsdMarkDirtyRecords(CUPSD_DIRTY_PRINTERS);
+  }
+  else if (!load->loaded)
+  {
+   /*
+    * Still loading in the background; just report the make and model from
+    * printers.conf until the loader is done...
+    */
+
+    release_ppd(p);
+
+    p->ppd_attrs = ippNew();
+
+    ippAddString(p->ppd_attrs, IPP_TAG_PRINTER, IPP_TAG_TEXT,
+                 "printer-make-and-model", NULL,
+		 p->make_model ? p->make_model : "Local Printer");
+  }
+  else
+  {
+   /*
+    * Merge the loaded attributes; the messages are prefixed with the log
+    * level...
+    */
+
+    p->ppd_load   = NULL;
+    load->printer = NULL;
+
+    for (message = (char *)cupsArrayFirst(load->messages);
+         message;
+	 message = (char *)cupsArrayNext(load->messages))
+      cupsdLogMessage(*message - '0', "%s", message + 1);
+
+    release_ppd(p);
+
+    p->ppd_attrs = load->copy.ppd_attrs;
+    p->pc        = load->copy.pc;
+    p->ppd_info  = load->copy.ppd_info;
+    p->type      = (p->type & ~(CUPS_PRINTER_OPTIONS | CUPS_PRINTER_REMOTE)) |
+                   (load->copy.type &
+		    (CUPS_PRINTER_OPTIONS | CUPS_PRINTER_REMOTE));
+    p->raw       = load->copy.raw;
+    p->remote    = load->copy.remote;
+
+    load->copy.ppd_attrs = NULL;
+    load->copy.pc        = NULL;
+    load->copy.ppd_info  = NULL;
+
+    cupsdSetString(&p->make_model, load->copy.make_model);
+
+    if ((attr = ippFindAttribute(load->copy.attrs, "printer-uri-supported",
+                                 IPP_TAG_URI)) != NULL)
+      ippCopyAttribute(p->attrs, attr, 0);
+
+    if (load->copy.dirty)
+    {
+      p->dirty = 1;
+      cupsdMarkDirtyRecords(CUPSD_DIRTY_PRINTERS);
+    }
+  }
+}
+
+
+/*
+ * 'compare_ppd_info()' - Compare two shared PPD attribute records.
+ */
+
+static int				/* O - Result of comparison */
+compare_ppd_info(cupsd_ppdinfo_t *a,	/* I - First record */
+                 cupsd_ppdinfo_t *b)	/* I - Second record */
+{
+  return (memcmp(a->digest, b->digest, sizeof(a->digest)));
+}
+
+
 /*
  * 'compare_printers()' - Compare two printers.
  */
@@ -3555,6 +3845,56 @@ compare_printers(void *first,		/* I - First printer */
 }
 
 
+/*
+ * 'copy_ppd_cache()' - Copy the cache file of shared PPD attributes.
+ *
+ * The copy is skipped if the cache file has been replaced since the shared
+ * attributes were loaded, since it may then be for a different PPD file.
+ */
+
+static void
+copy_ppd_cache(cupsd_ppdinfo_t *info,	/* I - Shared attributes */
+               const char      *cache_name)
+					/* I - Cache file to write */
+{
+  cups_file_t	*src,			/* Source file */
+		*dst;			/* Destination file */
+  struct stat	src_info;		/* Source file info */
+  char		newfile[1024],		/* New cache filename */
+		buffer[8192];		/* Copy buffer */
+  ssize_t	bytes;			/* Bytes read */
+
+
+  if (!info->cache_name || !strcmp(info->cache_name, cache_name) ||
+      stat(info->cache_name, &src_info) ||
+      src_info.st_ino != info->cache_ino ||
+      src_info.st_mtime != info->cache_mtime)
+    return;
+
+  if (snprintf(newfile, sizeof(newfile), "%s.N",
+               cache_name) >= (int)sizeof(newfile))
+    return;
+
+  if ((src = cupsFileOpen(info->cache_name, "r")) == NULL)
+    return;
+
+  if ((dst = cupsFileOpen(newfile, "w")) == NULL)
+  {
+    cupsFileClose(src);
+    return;
+  }
+
+  while ((bytes = cupsFileRead(src, buffer, sizeof(buffer))) > 0)
+    if (cupsFileWrite(dst, buffer, (size_t)bytes) < 0)
+      break;
+
+  cupsFileClose(src);
+
+  if (cupsFileClose(dst) || bytes != 0 || rename(newfile, cache_name))
+    unlink(newfile);
+}
+
+
 /*
  * 'delete_printer_filters()' - Delete all MIME filters for a printer.
  */
@@ -3613,22 +3953,369 @@ delete_printer_filters(
 static void
 dirty_printer(cupsd_printer_t *p)	/* I - Printer */
 {
+  p->dirty = 1;
+
   if (p->type & CUPS_PRINTER_CLASS)
-    cupsdMarkDirty(CUPSD_DIRTY_CLASSES);
+    cupsdMarkDirtyRecords(CUPSD_DIRTY_CLASSES);
   else
-    cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+    cupsdMarkDirtyRecords(CUPSD_DIRTY_PRINTERS);
 
   if (PrintcapFormat == PRINTCAP_PLIST)
     cupsdMarkDirty(CUPSD_DIRTY_PRINTCAP);
 }
 
 
+/*
+ * 'encode_attrs()' - Pre-encode printer attributes for responses.
+ *
+ * Each named attribute is encoded once in IPP wire format so that
+ * copy_printer_attrs() can append runs of requested attributes to a response
+ * without copying and re-encoding the values every time.
+ */
+
+static cupsd_encoded_t *		/* O - Encoded attributes or NULL */
+encode_attrs(ipp_t *attrs,		/* I - Printer attributes */
+             ipp_t *ppd_attrs)		/* I - PPD attributes or NULL */
+{
+  int			i;		/* Looping var */
+  cupsd_encoded_t	*enc;		/* Encoded attributes */
+  cupsd_encattr_t	*encattr;	/* Current encoded attribute */
+  int			alloc_attrs;	/* Allocated attributes */
+  ipp_t			*from,		/* Source attributes */
+			*temp;		/* Temporary message */
+  ipp_attribute_t	*attr;		/* Current attribute */
+  size_t		start;		/* Start of attribute data */
+
+
+  if ((enc = calloc(1, sizeof(cupsd_encoded_t))) == NULL)
+    return (NULL);
+
+  for (i = 0, alloc_attrs = 0; i < 2; i ++)
+  {
+    if ((from = i ? ppd_attrs : attrs) == NULL)
+      continue;
+
+    for (attr = from->attrs; attr; attr = attr->next)
+    {
+     /*
+      * Skip separators and attributes that are never sent...
+      */
+
+      if (!attr->name || attr->group_tag == IPP_TAG_ZERO)
+        continue;
+
+      if (!strcmp(attr->name, "document-password") ||
+          !strcmp(attr->name, "job-authorization-uri") ||
+          !strcmp(attr->name, "job-password") ||
+          !strcmp(attr->name, "job-password-encryption") ||
+          !strcmp(attr->name, "job-printer-uri"))
+        continue;
+
+      if (enc->num_attrs >= alloc_attrs)
+      {
+        alloc_attrs += 64;
+
+        if ((encattr = realloc(enc->attrs, (size_t)alloc_attrs *
+	                                       sizeof(cupsd_encattr_t))) == NULL)
+          goto error;
+
+        enc->attrs = encattr;
+      }
+
+     /*
+      * Write the attribute by itself and then strip the message header,
+      * group tag, and end tag...
+      */
+
+      if ((temp = ippNew()) == NULL)
+        goto error;
+
+      start = enc->datalen;
+
+      if (!ippCopyAttribute(temp, attr, 1) ||
+          ippWriteIO(enc, (ipp_iocb_t)encode_cb, 1, NULL, temp) !=
+	      IPP_STATE_DATA || enc->datalen < start + 10)
+      {
+        ippDelete(temp);
+        goto error;
+      }
+
+      ippDelete(temp);
+
+      memmove(enc->data + start, enc->data + start + 9,
+              enc->datalen - start - 10);
+      enc->datalen -= 10;
+
+      encattr             = enc->attrs + enc->num_attrs;
+      encattr->name       = _cupsStrAlloc(attr->name);
+      encattr->group      = attr->group_tag;
+      encattr->collection = (attr->value_tag & IPP_TAG_CUPS_MASK) ==
+                                IPP_TAG_BEGIN_COLLECTION;
+      encattr->offset     = start;
+      encattr->length     = enc->datalen - start;
+
+      enc->num_attrs ++;
+    }
+  }
+
+  return (enc);
+
+ /*
+  * If we get here, something went wrong...
+  */
+
+  error:
+
+  cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to pre-encode printer attributes.");
+
+  free_encoded(&enc);
+
+  return (NULL);
+}
+
+
+/*
+ * 'encode_cb()' - Append IPP data to the pre-encoded attributes.
+ */
+
+static ssize_t				/* O - Number of bytes written */
+encode_cb(cupsd_encoded_t *enc,		/* I - Encoded attributes */
+          ipp_uchar_t     *buffer,	/* I - Data to write */
+	  size_t          bytes)	/* I - Number of bytes */
+{
+  ipp_uchar_t	*data;			/* New data buffer */
+  size_t	datasize;		/* New data buffer size */
+
+
+  if (enc->datalen + bytes > enc->datasize)
+  {
+    for (datasize = enc->datasize ? enc->datasize : 4096;
+         datasize < enc->datalen + bytes;
+	 datasize *= 2);
+
+    if ((data = realloc(enc->data, datasize)) == NULL)
+      return (-1);
+
+    enc->data     = data;
+    enc->datasize = datasize;
+  }
+
+  memcpy(enc->data + enc->datalen, buffer, bytes);
+  enc->datalen += bytes;
+
+  return ((ssize_t)bytes);
+}
+
+
+/*
+ * 'finish_ppd_load()' - Finish a background PPD load.
+ */
+
+static void
+finish_ppd_load(void *data)		/* I - Callback data (unused) */
+{
+  cupsd_ppdload_t	*load;		/* Background load */
+  ssize_t		bytes;		/* Bytes read */
+
+
+  (void)data;
+
+  while ((bytes = read(load_done_pipes[0], &load, sizeof(load))) < 0 &&
+         errno == EINTR);
+
+  if (bytes != sizeof(load))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to read from PPD loaders - %s",
+                    bytes < 0 ? strerror(errno) : "short read");
+    num_loaders = 0;
+  }
+  else if (!load)
+  {
+   /*
+    * A loader has exited...
+    */
+
+    num_loaders --;
+  }
+  else
+  {
+    num_loads --;
+
+    if (load->printer)
+    {
+      load->loaded = 1;
+
+      finish_printer(load->printer);
+    }
+
+    free_ppd_load(load);
+  }
+
+  if (!num_loaders && load_pipes[1] < 0)
+  {
+    cupsdRemoveSelect(load_done_pipes[0]);
+    cupsdClosePipe(load_pipes);
+    cupsdClosePipe(load_done_pipes);
+
+    if (load_count > 0)
+      cupsdLogMessage(CUPSD_LOG_INFO, "Loaded %d PPD files in %.1f seconds.",
+                      load_count, cupsdGetStatTime() - load_start);
+
+    load_count = 0;
+  }
+}
+
+
+/*
+ * 'finish_printer()' - Finish setting up a printer once its PPD file is
+ *                      loaded.
+ */
+
+static void
+finish_printer(cupsd_printer_t *p)	/* I - Printer */
+{
+  int			i;		/* Looping var */
+  cupsd_printer_t	*pclass;	/* Current class */
+
+
+  cupsdSetPrinterAttrs(p);
+
+ /*
+  * Update the classes this printer belongs to...
+  */
+
+  cupsArraySave(Printers);
+
+  for (pclass = (cupsd_printer_t *)cupsArrayFirst(Printers);
+       pclass;
+       pclass = (cupsd_printer_t *)cupsArrayNext(Printers))
+  {
+    if (!(pclass->type & CUPS_PRINTER_CLASS))
+      continue;
+
+    for (i = 0; i < pclass->num_printers; i ++)
+      if (pclass->printers[i] == p)
+      {
+        cupsdSetPrinterAttrs(pclass);
+	break;
+      }
+  }
+
+  cupsArrayRestore(Printers);
+
+ /*
+  * Start any jobs that were waiting for the printer...
+  */
+
+  if (PendingJobCount > 0)
+    cupsdCheckJobs();
+}
+
+
+/*
+ * 'free_encoded()' - Free pre-encoded attributes.
+ */
+
+static void
+free_encoded(cupsd_encoded_t **enc)	/* IO - Encoded attributes */
+{
+  int	i;				/* Looping var */
+
+
+  if (!*enc)
+    return;
+
+  for (i = 0; i < (*enc)->num_attrs; i ++)
+    _cupsStrFree((*enc)->attrs[i].name);
+
+  free((*enc)->attrs);
+  free((*enc)->data);
+  free(*enc);
+
+  *enc = NULL;
+}
+
+
+/*
+ * 'free_ppd_load()' - Free a background PPD load.
+ */
+
+static void
+free_ppd_load(cupsd_ppdload_t *load)	/* I - Background load */
+{
+  char	*message;			/* Saved log message */
+
+
+  for (message = (char *)cupsArrayFirst(load->messages);
+       message;
+       message = (char *)cupsArrayNext(load->messages))
+    free(message);
+
+  cupsArrayDelete(load->messages);
+
+  ippDelete(load->copy.attrs);
+  release_ppd(&load->copy);
+
+  cupsdClearString(&load->copy.name);
+  cupsdClearString(&load->copy.device_uri);
+  cupsdClearString(&load->copy.port_monitor);
+  cupsdClearString(&load->copy.make_model);
+
+  free(load);
+}
+
+
+/*
+ * 'hash_ppd()' - Compute the MD5 digest of a PPD file.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+hash_ppd(const char    *filename,	/* I - PPD filename */
+         unsigned char *digest)		/* O - MD5 digest (16 bytes) */
+{
+  int			fd;		/* PPD file */
+  ssize_t		bytes;		/* Bytes read */
+  unsigned char		buffer[16384];	/* Read buffer */
+  _cups_md5_state_t	md5;		/* MD5 state */
+
+
+  if ((fd = open(filename, O_RDONLY)) < 0)
+    return (0);
+
+  _cupsMD5Init(&md5);
+
+  while ((bytes = read(fd, buffer, sizeof(buffer))) != 0)
+  {
+    if (bytes < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      close(fd);
+      return (0);
+    }
+
+    _cupsMD5Append(&md5, buffer, (int)bytes);
+  }
+
+  close(fd);
+
+  _cupsMD5Finish(&md5, digest);
+
+  return (1);
+}
+
+
 /*
  * 'load_ppd()' - Load a cached PPD file, updating the cache as needed.
+ *
+ * When called from a loader thread "p" is a private copy of the printer and
+ * log messages are saved in the "messages" array.
  */
 
 static void
-load_ppd(cupsd_printer_t *p)		/* I - Printer */
+load_ppd(cupsd_printer_t *p,		/* I - Printer */
+         cups_array_t    *messages)	/* I - Saved log messages or NULL */
 {
   int		i, j, k;		/* Looping vars */
   char		cache_name[1024];	/* Cache filename */
@@ -3654,6 +4341,8 @@ load_ppd(cupsd_printer_t *p)		/* I - Printer */
 		*pwgtype;		/* Current PWG type */
   ipp_attribute_t *attr;		/* Attribute data */
   _ipp_value_t	*val;			/* Attribute value */
+  unsigned char	digest[16];		/* MD5 digest of PPD file */
+  int		have_digest;		/* Do we have a digest? */
   int		num_finishings,		/* Number of finishings */
 		finishings[5];		/* finishings-supported values */
   int		num_qualities,		/* Number of print-quality values */
@@ -3684,27 +4373,48 @@ load_ppd(cupsd_printer_t *p)		/* I - Printer */
   if (stat(cache_name, &cache_info))
     cache_info.st_mtime = 0;
 
-  snprintf(ppd_name, sizeof(ppd_name), "%s/ppd/%s.ppd", ServerRoot, p->name);
-  if (stat(ppd_name, &ppd_info))
-    ppd_info.st_mtime = 1;
+  snprintf(ppd_name, sizeof(ppd_name), "%s/ppd/%s.ppd", ServerRoot, p->name);
+  if (stat(ppd_name, &ppd_info))
+    ppd_info.st_mtime = 1;
+
+  release_ppd(p);
+
+ /*
+  * Share the attributes of another printer using the same PPD file, if
+  * any...
+  */
+
+  if ((have_digest = hash_ppd(ppd_name, digest)) != 0 && share_ppd(p, digest))
+  {
+    log_ppd(messages, CUPSD_LOG_DEBUG,
+            "load_ppd: Sharing attributes for %s with other printers...",
+	    ppd_name);
 
-  ippDelete(p->ppd_attrs);
-  p->ppd_attrs = NULL;
+    if (cache_info.st_mtime < ppd_info.st_mtime)
+      copy_ppd_cache(p->ppd_info, cache_name);
 
-  _ppdCacheDestroy(p->pc);
-  p->pc = NULL;
+    return;
+  }
 
   if (cache_info.st_mtime >= ppd_info.st_mtime)
   {
-    cupsdLogMessage(CUPSD_LOG_DEBUG, "load_ppd: Loading %s...", cache_name);
+    log_ppd(messages, CUPSD_LOG_DEBUG, "load_ppd: Loading %s...", cache_name);
 
     if ((p->pc = _ppdCacheCreateWithFile(cache_name, &p->ppd_attrs)) != NULL &&
         p->ppd_attrs)
     {
      /*
-      * Loaded successfully!
+      * Loaded successfully!  Older cache files also contain the printer's
+      * port-monitor, which is now part of the printer attributes...
       */
 
+      if ((attr = ippFindAttribute(p->ppd_attrs, "port-monitor",
+                                   IPP_TAG_NAME)) != NULL)
+        ippDeleteAttribute(p->ppd_attrs, attr);
+
+      if (have_digest)
+        add_ppd_info(p, digest, cache_name);
+
       return;
     }
   }
@@ -3713,9 +4423,9 @@ load_ppd(cupsd_printer_t *p)		/* I - Printer */
   * Reload PPD attributes from disk...
   */
 
-  cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+  p->dirty = 1;
 
-  cupsdLogMessage(CUPSD_LOG_DEBUG, "load_ppd: Loading %s...", ppd_name);
+  log_ppd(messages, CUPSD_LOG_DEBUG, "load_ppd: Loading %s...", ppd_name);
 
   p->type &= ~CUPS_PRINTER_OPTIONS;
   p->type |= CUPS_PRINTER_BW;
@@ -3734,8 +4444,8 @@ load_ppd(cupsd_printer_t *p)		/* I - Printer */
     p->pc = _ppdCacheCreateWithPPD(ppd);
 
     if (!p->pc)
-      cupsdLogMessage(CUPSD_LOG_WARN, "Unable to create cache of \"%s\": %s",
-                      ppd_name, cupsLastErrorString());
+      log_ppd(messages, CUPSD_LOG_WARN, "Unable to create cache of \"%s\": %s",
+              ppd_name, cupsLastErrorString());
 
     ppdMarkDefaults(ppd);
 
@@ -3862,9 +4572,9 @@ load_ppd(cupsd_printer_t *p)		/* I - Printer */
     if (ppd->num_sizes == 0 || !p->pc)
     {
       if (!ppdFindAttr(ppd, "APScannerOnly", NULL))
-	cupsdLogMessage(CUPSD_LOG_CRIT,
-			"The PPD file for printer %s contains no media "
-			"options and is therefore invalid!", p->name);
+	log_ppd(messages, CUPSD_LOG_CRIT,
+		"The PPD file for printer %s contains no media "
+		"options and is therefore invalid!", p->name);
 
       ippAddString(p->ppd_attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD,
 		   "media-default", NULL, "unknown");
@@ -4321,9 +5031,9 @@ load_ppd(cupsd_printer_t *p)		/* I - Printer */
 
 	if (xdpi <= 0 || ydpi <= 0)
 	{
-	  cupsdLogMessage(CUPSD_LOG_WARN,
-	                  "Bad resolution \"%s\" for printer %s.",
-			  choice->choice, p->name);
+	  log_ppd(messages, CUPSD_LOG_WARN,
+	          "Bad resolution \"%s\" for printer %s.", choice->choice,
+		  p->name);
 	  xdpi = ydpi = 300;
 	}
 
@@ -4355,9 +5065,9 @@ load_ppd(cupsd_printer_t *p)		/* I - Printer */
 
       if (xdpi <= 0 || ydpi <= 0)
       {
-	cupsdLogMessage(CUPSD_LOG_WARN,
-			"Bad default resolution \"%s\" for printer %s.",
-			ppd_attr->value, p->name);
+	log_ppd(messages, CUPSD_LOG_WARN,
+		"Bad default resolution \"%s\" for printer %s.",
+		ppd_attr->value, p->name);
 	xdpi = ydpi = 300;
       }
 
@@ -4554,12 +5264,9 @@ load_ppd(cupsd_printer_t *p)		/* I - Printer */
     }
 
    /*
-    * Show current and available port monitors for this printer...
+    * Show available port monitors for this printer...
     */
 
-    ippAddString(p->ppd_attrs, IPP_TAG_PRINTER, IPP_TAG_NAME, "port-monitor",
-		 NULL, p->port_monitor ? p->port_monitor : "none");
-
     for (i = 1, ppd_attr = ppdFindAttr(ppd, "cupsPortMonitor", NULL);
 	 ppd_attr;
 	 i ++, ppd_attr = ppdFindNextAttr(ppd, "cupsPortMonitor", NULL));
@@ -4602,7 +5309,7 @@ load_ppd(cupsd_printer_t *p)		/* I - Printer */
     if ((ppd_attr = ppdFindAttr(ppd, "APPrinterIconPath", NULL)) != NULL &&
         ppd_attr->value &&
 	!_cupsFileCheck(ppd_attr->value, _CUPS_FILE_CHECK_FILE, !RunUser,
-	                cupsdLogFCMessage, p))
+	                messages ? NULL : cupsdLogFCMessage, p))
     {
       CGImageRef	imageRef = NULL;/* Current icon image */
       CGImageRef	biggestIconRef = NULL;
@@ -4738,18 +5445,17 @@ load_ppd(cupsd_printer_t *p)		/* I - Printer */
 
     pstatus = ppdLastError(&pline);
 
-    cupsdLogMessage(CUPSD_LOG_ERROR, "PPD file for %s cannot be loaded!",
-		    p->name);
+    log_ppd(messages, CUPSD_LOG_ERROR, "PPD file for %s cannot be loaded!",
+	    p->name);
 
     if (pstatus <= PPD_ALLOC_ERROR)
-      cupsdLogMessage(CUPSD_LOG_ERROR, "%s", strerror(errno));
+      log_ppd(messages, CUPSD_LOG_ERROR, "%s", strerror(errno));
     else
-      cupsdLogMessage(CUPSD_LOG_ERROR, "%s on line %d.",
-		      ppdErrorString(pstatus), pline);
+      log_ppd(messages, CUPSD_LOG_ERROR, "%s on line %d.",
+	      ppdErrorString(pstatus), pline);
 
-    cupsdLogMessage(CUPSD_LOG_INFO,
-		    "Hint: Run \"cupstestppd %s\" and fix any errors.",
-		    ppd_name);
+    log_ppd(messages, CUPSD_LOG_INFO,
+	    "Hint: Run \"cupstestppd %s\" and fix any errors.", ppd_name);
   }
   else
   {
@@ -4850,9 +5556,13 @@ load_ppd(cupsd_printer_t *p)		/* I - Printer */
     * Save cached PPD attributes to disk...
     */
 
-    cupsdLogMessage(CUPSD_LOG_DEBUG, "load_ppd: Saving %s...", cache_name);
+    log_ppd(messages, CUPSD_LOG_DEBUG, "load_ppd: Saving %s...", cache_name);
 
-    _ppdCacheWriteFile(p->pc, cache_name, p->ppd_attrs);
+    if (!_ppdCacheWriteFile(p->pc, cache_name, p->ppd_attrs))
+      cache_name[0] = '\0';
+
+    if (have_digest)
+      add_ppd_info(p, digest, cache_name);
   }
   else
   {
@@ -4943,6 +5653,42 @@ log_ipp_conformance(
 }
 
 
+/*
+ * 'log_ppd()' - Log or save a message while loading a PPD file.
+ */
+
+static void
+log_ppd(cups_array_t *messages,		/* I - Saved log messages or NULL */
+        int          level,		/* I - Log level */
+	const char   *message,		/* I - printf-style message string */
+	...)				/* I - Additional args as needed */
+{
+  va_list	ap;			/* Argument pointer */
+  char		buffer[1024];		/* Formatted message */
+
+
+  if (level > LogLevel)
+    return;
+
+  va_start(ap, message);
+  vsnprintf(buffer + 1, sizeof(buffer) - 1, message, ap);
+  va_end(ap);
+
+  if (messages)
+  {
+   /*
+    * Save the message with the log level in front...
+    */
+
+    buffer[0] = (char)('0' + level);
+
+    cupsArrayAdd(messages, strdup(buffer));
+  }
+  else
+    cupsdLogMessage(level, "%s", buffer + 1);
+}
+
+
 /*
  * 'new_media_col()' - Create a media-col collection value.
  */
@@ -4987,6 +5733,482 @@ new_media_col(_pwg_size_t *size,	/* I - media-size/margin values */
 }
 
 
+/*
+ * 'queue_ppd_load()' - Queue the PPD file of a printer for a loader.
+ *
+ * The PPD file is loaded synchronously by cupsdSetPrinterAttrs() when no
+ * loaders are running or the queue is full.
+ */
+
+static void
+queue_ppd_load(cupsd_printer_t *p)	/* I - Printer */
+{
+  cupsd_ppdload_t	*load;		/* Background load */
+
+
+  if (load_pipes[1] < 0 || p->ppd_load)
+    return;
+
+  if ((load = calloc(1, sizeof(cupsd_ppdload_t))) == NULL)
+    return;
+
+  load->printer    = p;
+  load->messages   = cupsArrayNew(NULL, NULL);
+  load->copy.attrs = ippNew();
+  load->copy.type  = p->type;
+
+  cupsdSetString(&load->copy.name, p->name);
+  cupsdSetString(&load->copy.device_uri, p->device_uri);
+  cupsdSetString(&load->copy.port_monitor, p->port_monitor);
+  cupsdSetString(&load->copy.make_model, p->make_model);
+
+  if (!load->messages ||
+      write(load_pipes[1], &load, sizeof(load)) != sizeof(load))
+  {
+    free_ppd_load(load);
+    return;
+  }
+
+  p->ppd_load = load;
+
+  num_loads ++;
+  load_count ++;
+}
+
+
+/*
+ * 'release_ppd()' - Release the PPD attributes of a printer.
+ */
+
+static void
+release_ppd(cupsd_printer_t *p)		/* I - Printer */
+{
+  cupsd_ppdinfo_t	*info;		/* Shared attributes */
+
+
+  if ((info = p->ppd_info) != NULL)
+  {
+    _cupsMutexLock(&info_mutex);
+
+    if (-- info->ref_count == 0)
+      cupsArrayRemove(ppd_infos, info);
+    else
+      info = NULL;
+
+    _cupsMutexUnlock(&info_mutex);
+
+    if (info)
+    {
+      ippDelete(info->ppd_attrs);
+      _ppdCacheDestroy(info->pc);
+      free(info->make_model);
+      free(info->cache_name);
+      free(info);
+    }
+  }
+  else
+  {
+    ippDelete(p->ppd_attrs);
+    _ppdCacheDestroy(p->pc);
+  }
+
+  p->ppd_attrs = NULL;
+  p->pc        = NULL;
+  p->ppd_info  = NULL;
+}
+
+
+/*
+ * 'run_ppd_loader()' - Load PPD files in a loader thread.
+ */
+
+static void *				/* O - Thread exit status (unused) */
+run_ppd_loader(void *arg)		/* I - Thread data (unused) */
+{
+  cupsd_ppdload_t	*load;		/* Background load */
+  int			state;		/* Load state */
+#ifdef HAVE_PTHREAD_H
+  sigset_t		mask;		/* Signal mask */
+
+
+ /*
+  * Nobody joins the loaders, and signals belong to the main loop...
+  */
+
+  pthread_detach(pthread_self());
+
+  sigfillset(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+#endif /* HAVE_PTHREAD_H */
+
+  (void)arg;
+
+  while (read(load_pipes[0], &load, sizeof(load)) == sizeof(load))
+  {
+   /*
+    * Skip loads that the main loop has already done or cancelled...
+    */
+
+    _cupsMutexLock(&load_mutex);
+    if ((state = load->state) == CUPSD_LOAD_QUEUED)
+      load->state = CUPSD_LOAD_RUNNING;
+    _cupsMutexUnlock(&load_mutex);
+
+    if (state == CUPSD_LOAD_QUEUED)
+    {
+      load_ppd(&load->copy, load->messages);
+
+      _cupsMutexLock(&load_mutex);
+      load->state = CUPSD_LOAD_DONE;
+      _cupsMutexUnlock(&load_mutex);
+    }
+
+    if (write(load_done_pipes[1], &load, sizeof(load)) != sizeof(load))
+      break;
+  }
+
+  load = NULL;
+
+  while (write(load_done_pipes[1], &load, sizeof(load)) < 0 && errno == EINTR);
+
+  return (NULL);
+}
+
+
+/*
+ * 'share_ppd()' - Use the shared PPD attributes for a PPD file, if any.
+ */
+
+static int				/* O - 1 if shared, 0 otherwise */
+share_ppd(cupsd_printer_t *p,		/* I - Printer */
+          unsigned char   *digest)	/* I - MD5 digest of PPD file */
+{
+  cupsd_ppdinfo_t	key,		/* Search key */
+			*info;		/* Shared attributes */
+
+
+  memcpy(key.digest, digest, sizeof(key.digest));
+
+  _cupsMutexLock(&info_mutex);
+
+  if ((info = (cupsd_ppdinfo_t *)cupsArrayFind(ppd_infos, &key)) != NULL)
+    info->ref_count ++;
+
+  _cupsMutexUnlock(&info_mutex);
+
+  if (!info)
+    return (0);
+
+  p->ppd_attrs = info->ppd_attrs;
+  p->pc        = info->pc;
+  p->ppd_info  = info;
+
+  if ((p->type & CUPS_PRINTER_OPTIONS) != info->type)
+  {
+    p->type  = (p->type & ~CUPS_PRINTER_OPTIONS) | info->type;
+    p->dirty = 1;
+  }
+
+  if (info->make_model &&
+      (!p->make_model || strcmp(p->make_model, info->make_model)))
+  {
+    cupsdSetString(&p->make_model, info->make_model);
+    p->dirty = 1;
+  }
+
+  return (1);
+}
+
+
+/*
+ * 'start_ppd_loaders()' - Start the PPD loader threads.
+ */
+
+static void
+start_ppd_loaders(void)
+{
+  int	count;				/* Number of loaders to start */
+
+
+  if ((count = (int)sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+    count = 1;
+  else if (count > CUPSD_LOADERS_MAX)
+    count = CUPSD_LOADERS_MAX;
+
+  if (cupsdOpenPipe(load_pipes))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to create pipes for PPD loaders - %s",
+		    strerror(errno));
+    return;
+  }
+
+  if (cupsdOpenPipe(load_done_pipes))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to create pipes for PPD loaders - %s",
+		    strerror(errno));
+    cupsdClosePipe(load_pipes);
+    return;
+  }
+
+ /*
+  * Never block when queuing; if the pipe is full the PPD file is just loaded
+  * the usual way...
+  */
+
+  fcntl(load_pipes[1], F_SETFL, fcntl(load_pipes[1], F_GETFL) | O_NONBLOCK);
+
+  for (num_loaders = 0; num_loaders < count; num_loaders ++)
+    if (!_cupsThreadCreate((_cups_thread_func_t)run_ppd_loader, NULL))
+      break;
+
+  if (!num_loaders)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to start PPD loaders.");
+    cupsdClosePipe(load_pipes);
+    cupsdClosePipe(load_done_pipes);
+    return;
+  }
+
+  cupsdAddSelect(load_done_pipes[0], (cupsd_selfunc_t)finish_ppd_load, NULL,
+                 NULL);
+
+  load_start = cupsdGetStatTime();
+}
+
+
+/*
+ * 'write_printer()' - Write a printer record to printers.conf.
+ */
+
+static void
+write_printer(cups_file_t     *fp,	/* I - printers.conf file */
+              cupsd_printer_t *printer)	/* I - Printer */
+{
+  int			i;		/* Looping var */
+  char			value[2048],	/* Value string */
+			*ptr,		/* Pointer into value */
+			*name;		/* Current user/group name */
+  cups_option_t		*option;	/* Current option */
+  ipp_attribute_t	*marker;	/* Current marker attribute */
+
+
+  if (printer == DefaultPrinter)
+    cupsFilePrintf(fp, "<DefaultPrinter %s>\n", printer->name);
+  else
+    cupsFilePrintf(fp, "<Printer %s>\n", printer->name);
+
+  cupsFilePrintf(fp, "UUID %s\n", printer->uuid);
+
+  if (printer->num_auth_info_required > 0)
+  {
+    switch (printer->num_auth_info_required)
+    {
+      case 1 :
+	  strlcpy(value, printer->auth_info_required[0], sizeof(value));
+	  break;
+
+      case 2 :
+	  snprintf(value, sizeof(value), "%s,%s",
+		   printer->auth_info_required[0],
+		   printer->auth_info_required[1]);
+	  break;
+
+      case 3 :
+      default :
+	  snprintf(value, sizeof(value), "%s,%s,%s",
+		   printer->auth_info_required[0],
+		   printer->auth_info_required[1],
+		   printer->auth_info_required[2]);
+	  break;
+    }
+
+    cupsFilePutConf(fp, "AuthInfoRequired", value);
+  }
+
+  if (printer->info)
+    cupsFilePutConf(fp, "Info", printer->info);
+
+  if (printer->location)
+    cupsFilePutConf(fp, "Location", printer->location);
+
+  if (printer->make_model)
+    cupsFilePutConf(fp, "MakeModel", printer->make_model);
+
+  cupsFilePutConf(fp, "DeviceURI", printer->device_uri);
+
+  if (printer->port_monitor)
+    cupsFilePutConf(fp, "PortMonitor", printer->port_monitor);
+
+  if (printer->state == IPP_PRINTER_STOPPED)
+  {
+    cupsFilePuts(fp, "State Stopped\n");
+
+    if (printer->state_message)
+      cupsFilePutConf(fp, "StateMessage", printer->state_message);
+  }
+  else
+    cupsFilePuts(fp, "State Idle\n");
+
+  cupsFilePrintf(fp, "StateTime %d\n", (int)printer->state_time);
+
+  for (i = 0; i < printer->num_reasons; i ++)
+    if (strcmp(printer->reasons[i], "connecting-to-device") &&
+	strcmp(printer->reasons[i], "cups-insecure-filter-warning") &&
+	strcmp(printer->reasons[i], "cups-missing-filter-warning"))
+      cupsFilePutConf(fp, "Reason", printer->reasons[i]);
+
+  cupsFilePrintf(fp, "Type %d\n", printer->type);
+
+  if (printer->accepting)
+    cupsFilePuts(fp, "Accepting Yes\n");
+  else
+    cupsFilePuts(fp, "Accepting No\n");
+
+  if (printer->shared)
+    cupsFilePuts(fp, "Shared Yes\n");
+  else
+    cupsFilePuts(fp, "Shared No\n");
+
+  snprintf(value, sizeof(value), "%s %s", printer->job_sheets[0],
+	   printer->job_sheets[1]);
+  cupsFilePutConf(fp, "JobSheets", value);
+
+  cupsFilePrintf(fp, "QuotaPeriod %d\n", printer->quota_period);
+  cupsFilePrintf(fp, "PageLimit %d\n", printer->page_limit);
+  cupsFilePrintf(fp, "KLimit %d\n", printer->k_limit);
+  if (printer->spool_compression >= 0)
+    cupsFilePrintf(fp, "SpoolCompression %d\n", printer->spool_compression);
+
+  for (name = (char *)cupsArrayFirst(printer->users);
+       name;
+       name = (char *)cupsArrayNext(printer->users))
+    cupsFilePutConf(fp, printer->deny_users ? "DenyUser" : "AllowUser", name);
+
+  if (printer->op_policy)
+    cupsFilePutConf(fp, "OpPolicy", printer->op_policy);
+  if (printer->error_policy)
+    cupsFilePutConf(fp, "ErrorPolicy", printer->error_policy);
+
+  for (i = printer->num_options, option = printer->options;
+       i > 0;
+       i --, option ++)
+  {
+    snprintf(value, sizeof(value), "%s %s", option->name, option->value);
+    cupsFilePutConf(fp, "Option", value);
+  }
+
+  if ((marker = ippFindAttribute(printer->attrs, "marker-colors",
+				 IPP_TAG_NAME)) != NULL)
+  {
+    snprintf(value, sizeof(value), "%s ", marker->name);
+
+    for (i = 0, ptr = value + strlen(value);
+	 i < marker->num_values && ptr < (value + sizeof(value) - 1);
+	 i ++)
+    {
+      if (i)
+	*ptr++ = ',';
+
+      strlcpy(ptr, marker->values[i].string.text,
+	      value + sizeof(value) - ptr);
+      ptr += strlen(ptr);
+    }
+
+    *ptr = '\0';
+    cupsFilePutConf(fp, "Attribute", value);
+  }
+
+  if ((marker = ippFindAttribute(printer->attrs, "marker-levels",
+				 IPP_TAG_INTEGER)) != NULL)
+  {
+    cupsFilePrintf(fp, "Attribute %s %d", marker->name,
+		   marker->values[0].integer);
+    for (i = 1; i < marker->num_values; i ++)
+      cupsFilePrintf(fp, ",%d", marker->values[i].integer);
+    cupsFilePuts(fp, "\n");
+  }
+
+  if ((marker = ippFindAttribute(printer->attrs, "marker-low-levels",
+				 IPP_TAG_INTEGER)) != NULL)
+  {
+    cupsFilePrintf(fp, "Attribute %s %d", marker->name,
+		   marker->values[0].integer);
+    for (i = 1; i < marker->num_values; i ++)
+      cupsFilePrintf(fp, ",%d", marker->values[i].integer);
+    cupsFilePuts(fp, "\n");
+  }
+
+  if ((marker = ippFindAttribute(printer->attrs, "marker-high-levels",
+				 IPP_TAG_INTEGER)) != NULL)
+  {
+    cupsFilePrintf(fp, "Attribute %s %d", marker->name,
+		   marker->values[0].integer);
+    for (i = 1; i < marker->num_values; i ++)
+      cupsFilePrintf(fp, ",%d", marker->values[i].integer);
+    cupsFilePuts(fp, "\n");
+  }
+
+  if ((marker = ippFindAttribute(printer->attrs, "marker-message",
+				 IPP_TAG_TEXT)) != NULL)
+  {
+    snprintf(value, sizeof(value), "%s %s", marker->name,
+	     marker->values[0].string.text);
+
+    cupsFilePutConf(fp, "Attribute", value);
+  }
+
+  if ((marker = ippFindAttribute(printer->attrs, "marker-names",
+				 IPP_TAG_NAME)) != NULL)
+  {
+    snprintf(value, sizeof(value), "%s ", marker->name);
+
+    for (i = 0, ptr = value + strlen(value);
+	 i < marker->num_values && ptr < (value + sizeof(value) - 1);
+	 i ++)
+    {
+      if (i)
+	*ptr++ = ',';
+
+      strlcpy(ptr, marker->values[i].string.text,
+	      value + sizeof(value) - ptr);
+      ptr += strlen(ptr);
+    }
+
+    *ptr = '\0';
+    cupsFilePutConf(fp, "Attribute", value);
+  }
+
+  if ((marker = ippFindAttribute(printer->attrs, "marker-types",
+				 IPP_TAG_KEYWORD)) != NULL)
+  {
+    snprintf(value, sizeof(value), "%s ", marker->name);
+
+    for (i = 0, ptr = value + strlen(value);
+	 i < marker->num_values && ptr < (value + sizeof(value) - 1);
+	 i ++)
+    {
+      if (i)
+	*ptr++ = ',';
+
+      strlcpy(ptr, marker->values[i].string.text,
+	      value + sizeof(value) - ptr);
+      ptr += strlen(ptr);
+    }
+
+    *ptr = '\0';
+    cupsFilePutConf(fp, "Attribute", value);
+  }
+
+  if (printer->marker_time)
+    cupsFilePrintf(fp, "Attribute marker-change-time %ld\n",
+		   (long)printer->marker_time);
+
+  cupsFilePuts(fp, "</Printer>\n");
+}
+
+
 /*
  * 'write_xml_string()' - Write a string with XML escaping.
  */
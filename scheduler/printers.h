@@ -57,6 +57,24 @@ typedef AvahiStringList *cupsd_txt_t;	/* TXT record */
 
 typedef struct cupsd_job_s cupsd_job_t;
 
+typedef struct cupsd_encattr_s		/**** Pre-encoded attribute ****/
+{
+  char		*name;			/* Attribute name */
+  ipp_tag_t	group;			/* Attribute group */
+  int		collection;		/* Collection value? */
+  size_t	offset,			/* Offset in encoded data */
+		length;			/* Length of encoded data */
+} cupsd_encattr_t;
+
+typedef struct cupsd_encoded_s		/**** Pre-encoded attributes ****/
+{
+  int		num_attrs;		/* Number of attributes */
+  cupsd_encattr_t *attrs;		/* Attributes */
+  size_t	datalen,		/* Length of encoded data */
+		datasize;		/* Allocated size of encoded data */
+  ipp_uchar_t	*data;			/* Encoded data */
+} cupsd_encoded_t;
+
 struct cupsd_printer_s
 {
   char		*uri,			/* Printer URI */
@@ -92,12 +110,14 @@ struct cupsd_printer_s
   cupsd_job_t	*job;			/* Current job in queue */
   ipp_t		*attrs,			/* Attributes supported by this printer */
 		*ppd_attrs;		/* Attributes based on the PPD */
+  cupsd_encoded_t *encoded;		/* Pre-encoded attrs and ppd_attrs */
   int		num_printers,		/* Number of printers in class */
 		last_printer;		/* Last printer job was sent to */
   struct cupsd_printer_s **printers;	/* Printers in class */
   int		quota_period,		/* Period for quotas */
 		page_limit,		/* Maximum number of pages */
 		k_limit;		/* Maximum number of kilobytes */
+  int		spool_compression;	/* Compression level for preserved files */
   cups_array_t	*quotas;		/* Quota records */
   int		deny_users;		/* 1 = deny, 0 = allow */
   cups_array_t	*users;			/* Allowed/denied users */
@@ -110,6 +130,9 @@ struct cupsd_printer_s
 		*alert_description;	/* PSX printer-alert-description value */
   time_t	marker_time;		/* Last time marker attributes were updated */
   _ppd_cache_t	*pc;			/* PPD cache and mapping data */
+  int		dirty;			/* Do we need to write the record? */
+  struct cupsd_ppdload_s *ppd_load;	/* PPD file being loaded, if any */
+  struct cupsd_ppdinfo_s *ppd_info;	/* Shared PPD attributes, if any */
 
 #if defined(HAVE_DNSSD) || defined(HAVE_AVAHI)
   char		*reg_name,		/* Name used for service registration */
@@ -131,6 +154,8 @@ struct cupsd_printer_s
 
 VAR ipp_t		*CommonData	VALUE(NULL);
 					/* Common printer object attrs */
+VAR cupsd_encoded_t	*CommonEncoded	VALUE(NULL);
+					/* Pre-encoded CommonData */
 VAR cups_array_t	*CommonDefaults	VALUE(NULL);
 					/* Common -default option names */
 VAR cups_array_t	*Printers	VALUE(NULL);
@@ -151,11 +176,14 @@ VAR cupsd_policy_t	*DefaultPolicyPtr
 extern cupsd_printer_t	*cupsdAddPrinter(const char *name);
 extern void		cupsdCreateCommonData(void);
 extern void		cupsdDeleteAllPrinters(void);
+extern cupsd_encoded_t	*cupsdEncodeCommonData(void);
+extern cupsd_encoded_t	*cupsdEncodePrinterAttrs(cupsd_printer_t *p);
 extern int		cupsdDeletePrinter(cupsd_printer_t *p, int update);
 extern cupsd_printer_t	*cupsdFindDest(const char *name);
 extern cupsd_printer_t	*cupsdFindPrinter(const char *name);
 extern cupsd_quota_t	*cupsdFindQuota(cupsd_printer_t *p,
 			                const char *username);
+extern void		cupsdFinishLoadingPrinter(cupsd_printer_t *p);
 extern void		cupsdFreeQuotas(cupsd_printer_t *p);
 extern void		cupsdLoadAllPrinters(void);
 extern void		cupsdRenamePrinter(cupsd_printer_t *p,
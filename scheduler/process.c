@@ -16,11 +16,22 @@
  *
  *   cupsdCreateProfile()  - Create an execution profile for a subprocess.
  *   cupsdDestroyProfile() - Delete an execution profile.
+ *   cupsdCheckWorkers()   - Start or stop idle worker processes as needed.
  *   cupsdEndProcess()     - End a process.
  *   cupsdFinishProcess()  - Finish a process and get its name.
+ *   cupsdGetDriverdTimeout() - Get the time when the idle cups-driverd
+ *                              service is stopped.
+ *   cupsdNeedWorkers()    - Check whether idle worker processes need to be
+ *                           started or stopped.
+ *   cupsdRunDriverd()     - Run a request using the cups-driverd service.
  *   cupsdStartProcess()   - Start a process.
+ *   cupsdStopDriverd()    - Stop the cups-driverd service.
  *   compare_procs()       - Compare two processes.
  *   cupsd_requote()       - Make a regular-expression version of a string.
+ *   send_request()        - Send a request to a worker or cups-driverd.
+ *   start_driverd()       - Start the cups-driverd service.
+ *   start_worker()        - Start an idle worker process.
+ *   use_worker()          - Run a command using an idle worker process.
  */
 
 /*
@@ -32,6 +43,10 @@
 #ifdef __APPLE__
 #  include <libgen.h>
 #endif /* __APPLE__ */
+#ifdef HAVE_POSIX_SPAWN
+#  include <spawn.h>
+extern char **environ;
+#endif /* HAVE_POSIX_SPAWN */
 
 
 /*
@@ -45,12 +60,28 @@ typedef struct
   char	name[1];			/* Name of process */
 } cupsd_proc_t;
 
+typedef struct
+{
+  int	pid,				/* Process ID */
+	fd;				/* Request socket */
+} cupsd_worker_t;
+
 
 /*
  * Local globals...
  */
 
 static cups_array_t	*process_array = NULL;
+static cups_array_t	*worker_array = NULL;
+					/* Idle worker processes */
+static time_t		worker_time = 0;
+					/* Time to retry starting workers */
+static int		driverd_fd = -1,
+					/* cups-driverd request socket */
+			driverd_pid = 0;
+					/* cups-driverd process ID */
+static time_t		driverd_time = 0;
+					/* Time of last cups-driverd request */
 
 
 /*
@@ -61,6 +92,51 @@ static int	compare_procs(cupsd_proc_t *a, cupsd_proc_t *b);
 #ifdef HAVE_SANDBOX_H
 static char	*cupsd_requote(char *dst, const char *src, size_t dstsize);
 #endif /* HAVE_SANDBOX_H */
+static int	send_request(int sock, char *argv[], char *envp[], int fds[5]);
+static int	start_driverd(void);
+static int	start_worker(void);
+static int	use_worker(char *argv[], char *envp[], int infd, int outfd,
+		           int errfd, int backfd, int sidefd);
+
+
+/*
+ * 'cupsdCheckWorkers()' - Start or stop idle worker processes as needed.
+ *
+ * Only one worker is started per call so that the main loop can keep serving
+ * clients while the pool is refilled.
+ */
+
+void
+cupsdCheckWorkers(void)
+{
+  cupsd_worker_t	*worker;		/* Current worker */
+
+
+ /*
+  * Stop the cups-driverd service once it has been idle for DriverdTimeout
+  * seconds...
+  */
+
+  if (driverd_fd >= 0 && time(NULL) >= cupsdGetDriverdTimeout())
+    cupsdStopDriverd();
+
+ /*
+  * Close the request sockets of extra workers, which exit as soon as they
+  * see the end-of-file...
+  */
+
+  while (cupsArrayCount(worker_array) > FilterWorkers)
+  {
+    worker = (cupsd_worker_t *)cupsArrayFirst(worker_array);
+
+    cupsArrayRemove(worker_array, worker);
+    close(worker->fd);
+    free(worker);
+  }
+
+  if (cupsdNeedWorkers() && !start_worker())
+    worker_time = time(NULL) + 60;
+}
 
 
 /*
@@ -275,8 +351,32 @@ cupsdFinishProcess(int  pid,		/* I - Process ID */
 {
   cupsd_proc_t	key,			/* Search key */
 		*proc;			/* Matching process */
+  cupsd_worker_t *worker;		/* Idle worker process */
 
 
+ /*
+  * Forget about idle workers that have gone away...
+  */
+
+  for (worker = (cupsd_worker_t *)cupsArrayFirst(worker_array);
+       worker;
+       worker = (cupsd_worker_t *)cupsArrayNext(worker_array))
+    if (worker->pid == pid)
+    {
+      cupsArrayRemove(worker_array, worker);
+      close(worker->fd);
+      free(worker);
+      break;
+    }
+
+  if (pid == driverd_pid)
+  {
+    close(driverd_fd);
+
+    driverd_fd  = -1;
+    driverd_pid = 0;
+  }
+
   key.pid = pid;
 
   if ((proc = (cupsd_proc_t *)cupsArrayFind(process_array, &key)) != NULL)
@@ -305,6 +405,95 @@ cupsdFinishProcess(int  pid,		/* I - Process ID */
 }
 
 
+/*
+ * 'cupsdGetDriverdTimeout()' - Get the time when the idle cups-driverd
+ *                              service is stopped.
+ */
+
+time_t					/* O - Stop time or 0 if not running */
+cupsdGetDriverdTimeout(void)
+{
+  if (driverd_fd >= 0)
+    return (driverd_time + DriverdTimeout);
+  else
+    return (0);
+}
+
+
+/*
+ * 'cupsdNeedWorkers()' - Check whether idle worker processes need to be
+ *                        started or stopped.
+ */
+
+int					/* O - 1 if needed, 0 otherwise */
+cupsdNeedWorkers(void)
+{
+  int	count = cupsArrayCount(worker_array);
+					/* Number of idle workers */
+
+
+ /*
+  * Don't start more workers while the filter limit keeps us from running
+  * jobs, or for a minute after a failure...
+  */
+
+  if (count > 0 && count > FilterWorkers)
+    return (1);
+  else
+    return (count < FilterWorkers &&
+            (FilterLimit <= 0 || FilterLevel < FilterLimit) &&
+	    time(NULL) >= worker_time);
+}
+
+
+/*
+ * 'cupsdRunDriverd()' - Run a request using the cups-driverd service.
+ *
+ * The service is started as needed and writes the response to the given
+ * file descriptor.  When the service cannot be used, the caller runs
+ * cups-driverd itself.
+ */
+
+int					/* O - Process ID of service or 0 */
+cupsdRunDriverd(char *argv[],		/* I - "cups-driverd" arguments */
+                int  outfd)		/* I - Standard output file descriptor */
+{
+  int	status,				/* Status of request */
+	fds[5];				/* File descriptors */
+
+
+  if (DriverdTimeout <= 0 || (driverd_fd < 0 && !start_driverd()))
+    return (0);
+
+  fds[0] = -1;
+  fds[1] = outfd;
+  fds[2] = -1;
+  fds[3] = -1;
+  fds[4] = -1;
+
+  if ((status = send_request(driverd_fd, argv, NULL, fds)) <= 0)
+  {
+   /*
+    * Stop the service if it has gone away; a full socket just means it is
+    * busy with other requests...
+    */
+
+    cupsdLogMessage(CUPSD_LOG_DEBUG,
+                    "Unable to send request to cups-driverd PID %d - %s.",
+		    driverd_pid, strerror(errno));
+
+    if (!status && errno != EAGAIN && errno != EWOULDBLOCK)
+      cupsdStopDriverd();
+
+    return (0);
+  }
+
+  driverd_time = time(NULL);
+
+  return (driverd_pid);
+}
+
+
 /*
  * 'cupsdStartProcess()' - Start a process.
  */
@@ -325,14 +514,23 @@ cupsdStartProcess(
     int         *pid)			/* O - Process ID */
 {
   int		i;			/* Looping var */
-  const char	*exec_path = command;	/* Command to be exec'd */
-  char		*real_argv[103],	/* Real command-line arguments */
-		cups_exec[1024];	/* Path to "cups-exec" program */
+  char		*real_argv[106],	/* Real command-line arguments */
+		cups_exec[1024],	/* Path to "cups-exec" program */
+		user_str[16],		/* UID string */
+		group_str[16],		/* GID string */
+		nice_str[16];		/* Nice value string */
   int		user;			/* Command UID */
   cupsd_proc_t	*proc;			/* New process record */
-#if defined(HAVE_SIGACTION) && !defined(HAVE_SIGSET)
+#ifdef HAVE_POSIX_SPAWN
+  int		status;			/* posix_spawn() status */
+  short		flags;			/* Spawn attribute flags */
+  posix_spawnattr_t attrs;		/* Spawn attributes */
+  posix_spawn_file_actions_t actions;	/* Spawn file actions */
+  sigset_t	defsignals,		/* Signals to reset to the default */
+		childmask;		/* Signal mask for the child */
+#elif defined(HAVE_SIGACTION) && !defined(HAVE_SIGSET)
   struct sigaction action;		/* POSIX signal handler */
-#endif /* HAVE_SIGACTION && !HAVE_SIGSET */
+#endif /* HAVE_POSIX_SPAWN */
 #if defined(__APPLE__)
   char		processPath[1024],	/* CFProcessPath environment variable */
 		linkpath[1024];		/* Link path for symlinks... */
@@ -393,35 +591,159 @@ cupsdStartProcess(
 #endif	/* __APPLE__ */
 
  /*
-  * Use helper program when we have a sandbox profile...
+  * Run the command through the "cups-exec" helper program, which changes
+  * the user, group, nice value, umask, and sandbox profile of the child
+  * after it has been started.  This keeps the work done between fork and
+  * exec to file descriptor and signal setup, which posix_spawn() can do
+  * without copying our (potentially large) address space.  Job filters and
+  * backends are handed to an idle "cups-exec" worker process instead when
+  * FilterWorkers is set...
   */
 
-  if (profile)
+  snprintf(cups_exec, sizeof(cups_exec), "%s/daemon/cups-exec", ServerBin);
+  snprintf(user_str, sizeof(user_str), "%d", user);
+  snprintf(group_str, sizeof(group_str), "%d", (int)Group);
+  snprintf(nice_str, sizeof(nice_str), "%d", root ? 0 : FilterNice);
+
+  real_argv[0] = cups_exec;
+  real_argv[1] = profile ? (char *)profile : "none";
+  real_argv[2] = user_str;
+  real_argv[3] = group_str;
+  real_argv[4] = nice_str;
+  real_argv[5] = (char *)command;
+
+  for (i = 0;
+       i < (int)(sizeof(real_argv) / sizeof(real_argv[0]) - 7) && argv[i];
+       i ++)
+    real_argv[i + 6] = argv[i];
+
+  real_argv[i + 6] = NULL;
+
+#ifdef HAVE_POSIX_SPAWN
+ /*
+  * Setup the attributes: put the child in its own process group so that we
+  * can kill any child processes it creates, and start it with the default
+  * handlers for the signals we catch and no blocked signals...
+  */
+
+  posix_spawnattr_init(&attrs);
+
+  flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+#  ifdef POSIX_SPAWN_USEVFORK
+  flags |= POSIX_SPAWN_USEVFORK;
+#  endif /* POSIX_SPAWN_USEVFORK */
+
+  if (!RunUser)
   {
-    snprintf(cups_exec, sizeof(cups_exec), "%s/daemon/cups-exec", ServerBin);
+    flags |= POSIX_SPAWN_SETPGROUP;
+    posix_spawnattr_setpgroup(&attrs, 0);
+  }
 
-    real_argv[0] = cups_exec;
-    real_argv[1] = profile;
-    real_argv[2] = (char *)command;
+  posix_spawnattr_setflags(&attrs, flags);
 
-    for (i = 0;
-         i < (int)(sizeof(real_argv) / sizeof(real_argv[0]) - 4) && argv[i];
-	 i ++)
-      real_argv[i + 3] = argv[i];
+  sigemptyset(&defsignals);
+  sigaddset(&defsignals, SIGTERM);
+  sigaddset(&defsignals, SIGCHLD);
+  sigaddset(&defsignals, SIGPIPE);
+  posix_spawnattr_setsigdefault(&attrs, &defsignals);
 
-    real_argv[i + 3] = NULL;
+  sigemptyset(&childmask);
+  posix_spawnattr_setsigmask(&attrs, &childmask);
 
-    argv      = real_argv;
-    exec_path = cups_exec;
+ /*
+  * Then the file actions for stdin, stdout, stderr, and the back and side
+  * channels...
+  */
+
+  posix_spawn_file_actions_init(&actions);
+
+  if (errfd != 2)
+  {
+    if (errfd < 0)
+      posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+    else
+    {
+      posix_spawn_file_actions_adddup2(&actions, errfd, 2);
+      posix_spawn_file_actions_addclose(&actions, errfd);
+    }
+  }
+
+  if (infd != 0)
+  {
+    if (infd < 0)
+      posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+    else
+    {
+      posix_spawn_file_actions_adddup2(&actions, infd, 0);
+      posix_spawn_file_actions_addclose(&actions, infd);
+    }
+  }
+
+  if (outfd != 1)
+  {
+    if (outfd < 0)
+      posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+    else
+    {
+      posix_spawn_file_actions_adddup2(&actions, outfd, 1);
+      posix_spawn_file_actions_addclose(&actions, outfd);
+    }
   }
 
+ /*
+  * The child's copies of the back and side channel descriptors share the
+  * file status flags with ours, so make them non-blocking here...
+  */
+
+  if (backfd != 3 && backfd >= 0)
+  {
+    posix_spawn_file_actions_adddup2(&actions, backfd, 3);
+    posix_spawn_file_actions_addclose(&actions, backfd);
+    fcntl(backfd, F_SETFL, O_NDELAY);
+  }
+
+  if (sidefd != 4 && sidefd >= 0)
+  {
+    posix_spawn_file_actions_adddup2(&actions, sidefd, 4);
+    posix_spawn_file_actions_addclose(&actions, sidefd);
+    fcntl(sidefd, F_SETFL, O_NDELAY);
+  }
+
+ /*
+  * Block signals before spawning so that the child can't be reaped before
+  * it is added to the process array...
+  */
+
+  cupsdHoldSignals();
+
+  if ((!job || (*pid = use_worker(real_argv + 1, envp, infd, outfd, errfd,
+                                  backfd, sidefd)) == 0) &&
+      (status = posix_spawn(pid, cups_exec, &actions, &attrs, real_argv,
+                            envp ? envp : environ)) != 0)
+  {
+   /*
+    * Error - couldn't start a new process!
+    */
+
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to start %s - %s.", command,
+                    strerror(status));
+
+    *pid = 0;
+  }
+
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attrs);
+
+#else
  /*
   * Block signals before forking...
   */
 
   cupsdHoldSignals();
 
-  if ((*pid = fork()) == 0)
+  if ((!job || (*pid = use_worker(real_argv + 1, envp, infd, outfd, errfd,
+                                  backfd, sidefd)) == 0) &&
+      (*pid = fork()) == 0)
   {
    /*
     * Child process goes here; update stderr as needed...
@@ -444,13 +766,13 @@ cupsdStartProcess(
     * processes it creates.
     */
 
-#ifdef HAVE_SETPGID
+#  ifdef HAVE_SETPGID
     if (!RunUser && setpgid(0, 0))
       exit(errno + 100);
-#else
+#  else
     if (!RunUser && setpgrp())
       exit(errno + 100);
-#endif /* HAVE_SETPGID */
+#  endif /* HAVE_SETPGID */
 
    /*
     * Update the remaining file descriptors as needed...
@@ -494,46 +816,15 @@ cupsdStartProcess(
       fcntl(4, F_SETFL, O_NDELAY);
     }
 
-   /*
-    * Change the priority of the process based on the FilterNice setting.
-    * (this is not done for root processes...)
-    */
-
-    if (!root)
-      nice(FilterNice);
-
-   /*
-    * Reset group membership to just the main one we belong to.
-    */
-
-    if (!RunUser && setgid(Group))
-      exit(errno + 100);
-
-    if (!RunUser && setgroups(1, &Group))
-      exit(errno + 100);
-
-   /*
-    * Change user to something "safe"...
-    */
-
-    if (!RunUser && user && setuid(user))
-      exit(errno + 100);
-
-   /*
-    * Change umask to restrict permissions on created files...
-    */
-
-    umask(077);
-
    /*
     * Unblock signals before doing the exec...
     */
 
-#ifdef HAVE_SIGSET
+#  ifdef HAVE_SIGSET
     sigset(SIGTERM, SIG_DFL);
     sigset(SIGCHLD, SIG_DFL);
     sigset(SIGPIPE, SIG_DFL);
-#elif defined(HAVE_SIGACTION)
+#  elif defined(HAVE_SIGACTION)
     memset(&action, 0, sizeof(action));
 
     sigemptyset(&action.sa_mask);
@@ -542,11 +833,11 @@ cupsdStartProcess(
     sigaction(SIGTERM, &action, NULL);
     sigaction(SIGCHLD, &action, NULL);
     sigaction(SIGPIPE, &action, NULL);
-#else
+#  else
     signal(SIGTERM, SIG_DFL);
     signal(SIGCHLD, SIG_DFL);
     signal(SIGPIPE, SIG_DFL);
-#endif /* HAVE_SIGSET */
+#  endif /* HAVE_SIGSET */
 
     cupsdReleaseSignals();
 
@@ -556,9 +847,9 @@ cupsdStartProcess(
     */
 
     if (envp)
-      execve(exec_path, argv, envp);
+      execve(cups_exec, real_argv, envp);
     else
-      execv(exec_path, argv);
+      execv(cups_exec, real_argv);
 
     exit(errno + 100);
   }
@@ -573,8 +864,12 @@ cupsdStartProcess(
 
     *pid = 0;
   }
-  else
+#endif /* HAVE_POSIX_SPAWN */
+
+  if (*pid)
   {
+    ProcessesStarted ++;
+
     if (!process_array)
       process_array = cupsArrayNew((cups_array_func_t)compare_procs, NULL);
 
@@ -590,6 +885,8 @@ cupsdStartProcess(
       }
     }
   }
+  else
+    ProcessesFailed ++;
 
   cupsdReleaseSignals();
 
@@ -604,6 +901,28 @@ cupsdStartProcess(
 }
 
 
+/*
+ * 'cupsdStopDriverd()' - Stop the cups-driverd service.
+ *
+ * The service exits once it has read the requests it already has.
+ */
+
+void
+cupsdStopDriverd(void)
+{
+  if (driverd_fd < 0)
+    return;
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG, "Stopping cups-driverd PID %d.",
+                  driverd_pid);
+
+  close(driverd_fd);
+
+  driverd_fd  = -1;
+  driverd_pid = 0;
+}
+
+
 /*
  * 'compare_procs()' - Compare two processes.
  */
@@ -654,6 +973,317 @@ cupsd_requote(char       *dst,		/* I - Destination buffer */
 #endif /* HAVE_SANDBOX_H */
 
 
+/*
+ * 'start_worker()' - Start an idle worker process.
+ *
+ * Workers are "cups-exec" processes started as root (or RunUser) that wait
+ * for a single request on their standard input socket.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+start_worker(void)
+{
+  int			fds[2],		/* Request socket pair */
+			pid;		/* Process ID */
+  char			command[1024],	/* Path to "cups-exec" program */
+			*argv[3];	/* Command-line arguments */
+  cupsd_worker_t	*worker;	/* New worker */
+
+
+  if (socketpair(AF_LOCAL, SOCK_STREAM, 0, fds))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to create worker process socket - %s.",
+                    strerror(errno));
+    return (0);
+  }
+
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+  snprintf(command, sizeof(command), "%s/daemon/cups-exec", ServerBin);
+
+  argv[0] = "cups-exec";
+  argv[1] = "-w";
+  argv[2] = NULL;
+
+  if (!cupsdStartProcess(command, argv, NULL, fds[1], -1, -1, -1, -1, 1, NULL,
+                         NULL, &pid))
+  {
+    close(fds[0]);
+    close(fds[1]);
+    return (0);
+  }
+
+  close(fds[1]);
+
+  if (!worker_array)
+    worker_array = cupsArrayNew(NULL, NULL);
+
+  if (!worker_array ||
+      (worker = (cupsd_worker_t *)calloc(1, sizeof(cupsd_worker_t))) == NULL)
+  {
+    close(fds[0]);
+    return (0);
+  }
+
+  worker->pid = pid;
+  worker->fd  = fds[0];
+
+  cupsArrayAdd(worker_array, worker);
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "start_worker: Started worker PID %d.",
+                  pid);
+
+  return (1);
+}
+
+
+/*
+ * 'send_request()' - Send a request to a worker or cups-driverd.
+ *
+ * The request is a header with the length of the data that follows, a mask
+ * of the file descriptors that are passed, and the number of arguments and
+ * environment strings, followed by the nul-terminated strings themselves.
+ */
+
+static int				/* O - 1 on success, 0 if not sent, -1 on bad request */
+send_request(int  sock,			/* I - Request socket */
+             char *argv[],		/* I - Arguments */
+             char *envp[],		/* I - Environment or NULL */
+             int  fds[5])		/* I - File descriptors or -1 */
+{
+  int			i,		/* Looping var */
+			sendfds[5],	/* File descriptors to send */
+			numfds,		/* Number of file descriptors to send */
+			header[4];	/* Request header */
+  size_t		length;		/* Length of request data */
+  ssize_t		bytes;		/* Bytes sent */
+  char			*data,		/* Request data */
+			*dataptr;	/* Pointer into request data */
+  struct iovec		iov[2];		/* Request header and data */
+  struct msghdr		msg;		/* Request message */
+  struct cmsghdr	*cmsg;		/* Control message */
+  union
+  {
+    struct cmsghdr	hdr;		/* Alignment */
+    char		buf[CMSG_SPACE(sizeof(sendfds))];
+					/* Control message buffer */
+  }			control;	/* Control message */
+
+
+ /*
+  * Build the request...
+  */
+
+  for (header[2] = 0, length = 0; argv[header[2]]; header[2] ++)
+    length += strlen(argv[header[2]]) + 1;
+
+  for (header[3] = 0; envp && envp[header[3]]; header[3] ++)
+    length += strlen(envp[header[3]]) + 1;
+
+  if (length > 65536 || (data = malloc(length)) == NULL)
+    return (-1);
+
+  for (i = 0, dataptr = data; i < header[2]; i ++)
+  {
+    strcpy(dataptr, argv[i]);
+    dataptr += strlen(dataptr) + 1;
+  }
+
+  for (i = 0; i < header[3]; i ++)
+  {
+    strcpy(dataptr, envp[i]);
+    dataptr += strlen(dataptr) + 1;
+  }
+
+  header[0] = (int)length;
+  header[1] = 0;
+
+  for (i = 0, numfds = 0; i < 5; i ++)
+    if (fds[i] >= 0)
+    {
+      header[1]          |= 1 << i;
+      sendfds[numfds ++] = fds[i];
+    }
+
+  iov[0].iov_base = (void *)header;
+  iov[0].iov_len  = sizeof(header);
+  iov[1].iov_base = data;
+  iov[1].iov_len  = length;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov    = iov;
+  msg.msg_iovlen = 2;
+
+  if (numfds > 0)
+  {
+    memset(&control, 0, sizeof(control));
+
+    msg.msg_control    = control.buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * (size_t)numfds);
+
+    cmsg             = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_RIGHTS;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(int) * (size_t)numfds);
+
+    memcpy(CMSG_DATA(cmsg), sendfds, sizeof(int) * (size_t)numfds);
+  }
+
+ /*
+  * Send it...
+  */
+
+  bytes = sendmsg(sock, &msg, 0);
+
+  free(data);
+
+  if (bytes == (ssize_t)(sizeof(header) + length))
+    return (1);
+
+  if (bytes >= 0)
+    errno = EIO;			/* Short write */
+
+  return (0);
+}
+
+
+/*
+ * 'start_driverd()' - Start the cups-driverd service.
+ *
+ * The service reads requests from its standard input socket and keeps the
+ * PPD database in memory between requests.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+start_driverd(void)
+{
+  int			fds[2];		/* Request socket pair */
+  char			command[1024],	/* Path to "cups-driverd" program */
+			*argv[3],	/* Command-line arguments */
+			*envp[MAX_ENV];	/* Environment */
+
+
+  if (socketpair(AF_LOCAL, SOCK_STREAM, 0, fds))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to create cups-driverd socket - %s.",
+                    strerror(errno));
+    return (0);
+  }
+
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+  snprintf(command, sizeof(command), "%s/daemon/cups-driverd", ServerBin);
+
+  argv[0] = "cups-driverd";
+  argv[1] = "daemon";
+  argv[2] = NULL;
+
+  cupsdLoadEnv(envp, (int)(sizeof(envp) / sizeof(envp[0])));
+
+  if (!cupsdStartProcess(command, argv, envp, fds[1], -1, CGIPipes[1], -1, -1,
+                         0, DefaultProfile, NULL, &driverd_pid))
+  {
+    close(fds[0]);
+    close(fds[1]);
+    driverd_pid = 0;
+    return (0);
+  }
+
+  close(fds[1]);
+
+  driverd_fd   = fds[0];
+  driverd_time = time(NULL);
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG, "Started cups-driverd PID %d.",
+                  driverd_pid);
+
+  return (1);
+}
+
+
+/*
+ * 'use_worker()' - Run a command using an idle worker process.
+ *
+ * Signals must be held by the caller.
+ */
+
+static int				/* O - Process ID or 0 if none */
+use_worker(char *argv[],		/* I - "cups-exec" arguments */
+           char *envp[],		/* I - Environment or NULL */
+           int  infd,			/* I - Standard input file descriptor */
+           int  outfd,			/* I - Standard output file descriptor */
+           int  errfd,			/* I - Standard error file descriptor */
+           int  backfd,			/* I - Backchannel file descriptor */
+           int  sidefd)			/* I - Sidechannel file descriptor */
+{
+  int			pid,		/* Process ID */
+			status,		/* Status of request */
+			fds[5];		/* File descriptors */
+  cupsd_worker_t	*worker;	/* Worker process */
+  cupsd_proc_t		key,		/* Search key */
+			*proc;		/* Worker process record */
+
+
+  if (!cupsArrayCount(worker_array))
+    return (0);
+
+  fds[0] = infd;
+  fds[1] = outfd;
+  fds[2] = errfd;
+  fds[3] = backfd;
+  fds[4] = sidefd;
+
+ /*
+  * Send it to the oldest idle worker; each worker is only used once, so
+  * close our end of the socket when we are done with it...
+  */
+
+  pid = 0;
+
+  while ((worker = (cupsd_worker_t *)cupsArrayFirst(worker_array)) != NULL)
+  {
+    if ((status = send_request(worker->fd, argv, envp, fds)) < 0)
+      break;
+
+    cupsArrayRemove(worker_array, worker);
+
+    if (status)
+      pid = worker->pid;
+    else
+      cupsdLogMessage(CUPSD_LOG_DEBUG,
+                      "Unable to send request to worker PID %d - %s.",
+		      worker->pid, strerror(errno));
+
+    close(worker->fd);
+    free(worker);
+
+    if (pid)
+      break;
+  }
+
+ /*
+  * Forget the worker's process record; our caller adds a new one for the
+  * command...
+  */
+
+  key.pid = pid;
+
+  if (pid && (proc = (cupsd_proc_t *)cupsArrayFind(process_array,
+                                                   &key)) != NULL)
+  {
+    cupsArrayRemove(process_array, proc);
+    free(proc);
+  }
+
+  return (pid);
+}
+
+
 /*
  * End of "$Id$".
  */
@@ -406,6 +406,7 @@ cupsdDoSelect(long timeout)		/* I - Timeout in seconds */
 {
   int			nfds;		/* Number of file descriptors */
   _cupsd_fd_t		*fdptr;		/* Current file descriptor */
+  double		start;		/* Time the wait returned */
 #ifdef HAVE_KQUEUE
   int			i;		/* Looping var */
   struct kevent		*event;		/* Current event */
@@ -425,6 +426,8 @@ cupsdDoSelect(long timeout)		/* I - Timeout in seconds */
   else
     nfds = kevent(cupsd_kqueue_fd, NULL, 0, cupsd_kqueue_events, MaxFDs, NULL);
 
+  start = cupsdGetStatTime();
+
   cupsd_kqueue_changes = 0;
 
   for (i = nfds, event = cupsd_kqueue_events; i > 0; i --, event ++)
@@ -466,6 +469,8 @@ cupsdDoSelect(long timeout)		/* I - Timeout in seconds */
     else
       nfds = epoll_wait(cupsd_epoll_fd, cupsd_epoll_events, MaxFDs, -1);
 
+    start = cupsdGetStatTime();
+
     if (nfds < 0 && errno != EINTR)
     {
       close(cupsd_epoll_fd);
@@ -559,6 +564,8 @@ cupsdDoSelect(long timeout)		/* I - Timeout in seconds */
   else
     nfds = poll(cupsd_pollfds, count, -1);
 
+  start = cupsdGetStatTime();
+
   if (nfds > 0)
   {
    /*
@@ -619,6 +626,8 @@ cupsdDoSelect(long timeout)		/* I - Timeout in seconds */
     nfds = select(maxfd, &cupsd_current_input, &cupsd_current_output, NULL,
                   NULL);
 
+  start = cupsdGetStatTime();
+
   if (nfds > 0)
   {
    /*
@@ -665,9 +674,20 @@ cupsdDoSelect(long timeout)		/* I - Timeout in seconds */
 #endif /* HAVE_EPOLL || HAVE_KQUEUE */
 
  /*
-  * Return the number of file descriptors handled...
+  * Update the statistics and return the number of file descriptors
+  * handled...
   */
 
+  SelectCalls ++;
+
+  if (nfds > 0)
+  {
+    SelectWakeups ++;
+    SelectEvents += (unsigned long)nfds;
+
+    cupsdAddStat(&SelectStats, start);
+  }
+
   return (nfds);
 }
 
@@ -77,6 +77,18 @@ cupsdStartServer(void)
     cupsdAddSelect(CGIPipes[0], (cupsd_selfunc_t)cupsdUpdateCGI, NULL, NULL);
   }
 
+ /*
+  * Start the threads that encode large IPP responses...
+  */
+
+  cupsdStartWorkers();
+
+ /*
+  * Write log files from a separate thread...
+  */
+
+  cupsdStartLogWriter();
+
  /*
   * Mark that the server has started and printers and jobs may be changed...
   */
@@ -110,6 +122,8 @@ cupsdStopServer(void)
   */
 
   cupsdCloseAllClients();
+  cupsdStopWorkers();
+  cupsdStopDriverd();
   cupsdStopListening();
   cupsdStopBrowsing();
   cupsdStopAllNotifiers();
@@ -140,6 +154,8 @@ cupsdStopServer(void)
   * Close all log files...
   */
 
+  cupsdStopLogWriter();
+
   if (AccessFile != NULL)
   {
     cupsFileClose(AccessFile);
@@ -169,11 +185,12 @@ cupsdStopServer(void)
   DefaultProfile = NULL;
 
  /*
-  * Write out any dirty files...
+  * Write out any dirty files, rewriting any .conf files that have had
+  * records appended to them...
   */
 
-  if (DirtyFiles)
-    cupsdCleanDirty();
+  DirtyFiles |= CUPSD_DIRTY_COMPACT;
+  cupsdCleanDirty();
 
   started = 0;
 }
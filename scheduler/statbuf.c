@@ -14,9 +14,10 @@
  *
  * Contents:
  *
- *   cupsdStatBufDelete() - Destroy a status buffer.
- *   cupsdStatBufNew()    - Create a new status buffer.
- *   cupsdStatBufUpdate() - Update the status buffer.
+ *   cupsdStatBufDelete()  - Destroy a status buffer.
+ *   cupsdStatBufHasLine() - Check whether a full line is buffered.
+ *   cupsdStatBufNew()     - Create a new status buffer.
+ *   cupsdStatBufUpdate()  - Update the status buffer.
  */
 
 /*
@@ -27,6 +28,52 @@
 #include <stdarg.h>
 
 
+/*
+ * Local globals...
+ */
+
+static const struct			/**** Message prefixes */
+{
+  const char	*prefix;		/* Prefix string */
+  int		length,			/* Length of prefix */
+		loglevel;		/* Log level */
+}			sb_prefixes[32] =
+{					/* Indexed by cupsdStatBufUpdate() hash */
+  { "DEBUG2",   6, CUPSD_LOG_DEBUG2 },
+  { "ALERT",    5, CUPSD_LOG_ALERT },
+  { NULL,       0, 0 },
+  { "PPD",      3, CUPSD_LOG_PPD },
+  { "INFO",     4, CUPSD_LOG_INFO },
+  { "WARNING",  7, CUPSD_LOG_WARN },
+  { "PAGE",     4, CUPSD_LOG_PAGE },
+  { NULL,       0, 0 },
+  { NULL,       0, 0 },
+  { NULL,       0, 0 },
+  { NULL,       0, 0 },
+  { NULL,       0, 0 },
+  { NULL,       0, 0 },
+  { NULL,       0, 0 },
+  { "JOBSTATE", 8, CUPSD_LOG_JOBSTATE },
+  { NULL,       0, 0 },
+  { "ATTR",     4, CUPSD_LOG_ATTR },
+  { NULL,       0, 0 },
+  { NULL,       0, 0 },
+  { "EMERG",    5, CUPSD_LOG_EMERG },
+  { "CRIT",     4, CUPSD_LOG_CRIT },
+  { NULL,       0, 0 },
+  { NULL,       0, 0 },
+  { NULL,       0, 0 },
+  { NULL,       0, 0 },
+  { "STATE",    5, CUPSD_LOG_STATE },
+  { NULL,       0, 0 },
+  { NULL,       0, 0 },
+  { "NOTICE",   6, CUPSD_LOG_NOTICE },
+  { "ERROR",    5, CUPSD_LOG_ERROR },
+  { NULL,       0, 0 },
+  { "DEBUG",    5, CUPSD_LOG_DEBUG }
+};
+
+
 /*
  * 'cupsdStatBufDelete()' - Destroy a status buffer.
  */
@@ -51,6 +98,20 @@ cupsdStatBufDelete(cupsd_statbuf_t *sb)	/* I - Status buffer */
 }
 
 
+/*
+ * 'cupsdStatBufHasLine()' - Check whether a full line is buffered.
+ *
+ * Callers use this to process all of the lines they have been sent without
+ * blocking on another read.
+ */
+
+int					/* O - 1 if a line is buffered, 0 otherwise */
+cupsdStatBufHasLine(cupsd_statbuf_t *sb)	/* I - Status buffer */
+{
+  return (sb->bufeol >= 0);
+}
+
+
 /*
  * 'cupsdStatBufNew()' - Create a new status buffer.
  */
@@ -81,7 +142,8 @@ cupsdStatBufNew(int        fd,		/* I - File descriptor of pipe */
     * Assign the file descriptor...
     */
 
-    sb->fd = fd;
+    sb->fd     = fd;
+    sb->bufeol = -1;
 
    /*
     * Format the prefix string, if any.  This is usually "[Job 123]"
@@ -114,43 +176,57 @@ cupsdStatBufNew(int        fd,		/* I - File descriptor of pipe */
 
 /*
  * 'cupsdStatBufUpdate()' - Update the status buffer.
+ *
+ * The returned line points into the status buffer and is valid until the
+ * next call.
  */
 
 char *					/* O - Line from buffer, "", or NULL */
 cupsdStatBufUpdate(
     cupsd_statbuf_t *sb,		/* I - Status buffer */
-    int             *loglevel,		/* O - Log level */
-    char            *line,		/* I - Line buffer */
-    int             linelen)		/* I - Size of line buffer */
+    int             *loglevel)		/* O - Log level */
 {
-  int		bytes;			/* Number of bytes read */
-  char		*lineptr,		/* Pointer to end of line in buffer */
-		*message;		/* Pointer to message text */
+  ssize_t		bytes;		/* Number of bytes read */
+  int			length,		/* Length of message prefix */
+			hash;		/* Hash of message prefix */
+  char			*line,		/* Start of line in buffer */
+			*lineptr,	/* Pointer to end of line in buffer */
+			*message;	/* Pointer to message text */
 
 
  /*
   * Check if the buffer already contains a full line...
   */
 
-  if ((lineptr = strchr(sb->buffer, '\n')) == NULL)
+  if (sb->bufeol < 0)
   {
    /*
-    * No, read more data...
+    * No, move any partial line to the front of the buffer and read more
+    * data...
     */
 
-    if ((bytes = read(sb->fd, sb->buffer + sb->bufused,
-                      CUPSD_SB_BUFFER_SIZE - sb->bufused - 1)) > 0)
+    if (sb->bufstart > 0)
     {
-      sb->bufused += bytes;
-      sb->buffer[sb->bufused] = '\0';
+      sb->bufused -= sb->bufstart;
+      sb->bufscan -= sb->bufstart;
 
-     /*
-      * Guard against a line longer than the max buffer size...
-      */
+      memmove(sb->buffer, sb->buffer + sb->bufstart, (size_t)sb->bufused);
 
-      if ((lineptr = strchr(sb->buffer, '\n')) == NULL &&
-          sb->bufused == (CUPSD_SB_BUFFER_SIZE - 1))
-	lineptr = sb->buffer + sb->bufused;
+      sb->bufstart = 0;
+    }
+
+    if ((bytes = read(sb->fd, sb->buffer + sb->bufused,
+                      (size_t)(CUPSD_SB_BUFFER_SIZE - sb->bufused - 1))) > 0)
+    {
+      sb->bufused += (int)bytes;
+
+      if ((lineptr = memchr(sb->buffer + sb->bufscan, '\n',
+                            (size_t)(sb->bufused - sb->bufscan))) != NULL)
+        sb->bufeol = (int)(lineptr - sb->buffer);
+      else if (sb->bufused == (CUPSD_SB_BUFFER_SIZE - 1))
+	sb->bufeol = sb->bufused;	/* Line longer than the buffer */
+      else
+        sb->bufscan = sb->bufused;
     }
     else if (bytes < 0 && errno == EINTR)
     {
@@ -158,125 +234,96 @@ cupsdStatBufUpdate(
       * Return an empty line if we are interrupted...
       */
 
-      *loglevel = CUPSD_LOG_NONE;
-      line[0]   = '\0';
+      *loglevel                = CUPSD_LOG_NONE;
+      sb->buffer[sb->bufused] = '\0';
 
-      return (line);
+      return (sb->buffer + sb->bufused);
     }
-    else
+    else if (sb->bufused > 0)
     {
      /*
-      * End-of-file, so use the whole buffer...
+      * End-of-file, so use the rest of the buffer...
       */
 
-      lineptr  = sb->buffer + sb->bufused;
-      *lineptr = '\0';
+      sb->bufeol = sb->bufused;
     }
-
-   /*
-    * Final check for end-of-file...
-    */
-
-    if (sb->bufused == 0 && bytes == 0)
-      lineptr = NULL;
   }
 
-  if (!lineptr)
+  if (sb->bufeol < 0)
   {
    /*
-    * End of file...
+    * End of file or no full line yet...
     */
 
     *loglevel = CUPSD_LOG_NONE;
-    line[0]   = '\0';
 
     return (NULL);
   }
 
  /*
-  * Terminate the line and process it...
+  * Terminate the line and find the end of the next one, if any...
   */
 
-  *lineptr++ = '\0';
-
- /*
-  * Figure out the logging level...
-  */
+  line                   = sb->buffer + sb->bufstart;
+  sb->buffer[sb->bufeol] = '\0';
 
-  if (!strncmp(sb->buffer, "EMERG:", 6))
+  if ((sb->bufeol + 1) < sb->bufused)
   {
-    *loglevel = CUPSD_LOG_EMERG;
-    message   = sb->buffer + 6;
-  }
-  else if (!strncmp(sb->buffer, "ALERT:", 6))
-  {
-    *loglevel = CUPSD_LOG_ALERT;
-    message   = sb->buffer + 6;
-  }
-  else if (!strncmp(sb->buffer, "CRIT:", 5))
-  {
-    *loglevel = CUPSD_LOG_CRIT;
-    message   = sb->buffer + 5;
-  }
-  else if (!strncmp(sb->buffer, "ERROR:", 6))
-  {
-    *loglevel = CUPSD_LOG_ERROR;
-    message   = sb->buffer + 6;
-  }
-  else if (!strncmp(sb->buffer, "WARNING:", 8))
-  {
-    *loglevel = CUPSD_LOG_WARN;
-    message   = sb->buffer + 8;
-  }
-  else if (!strncmp(sb->buffer, "NOTICE:", 7))
-  {
-    *loglevel = CUPSD_LOG_NOTICE;
-    message   = sb->buffer + 7;
-  }
-  else if (!strncmp(sb->buffer, "INFO:", 5))
-  {
-    *loglevel = CUPSD_LOG_INFO;
-    message   = sb->buffer + 5;
-  }
-  else if (!strncmp(sb->buffer, "DEBUG:", 6))
-  {
-    *loglevel = CUPSD_LOG_DEBUG;
-    message   = sb->buffer + 6;
-  }
-  else if (!strncmp(sb->buffer, "DEBUG2:", 7))
-  {
-    *loglevel = CUPSD_LOG_DEBUG2;
-    message   = sb->buffer + 7;
-  }
-  else if (!strncmp(sb->buffer, "PAGE:", 5))
-  {
-    *loglevel = CUPSD_LOG_PAGE;
-    message   = sb->buffer + 5;
-  }
-  else if (!strncmp(sb->buffer, "STATE:", 6))
-  {
-    *loglevel = CUPSD_LOG_STATE;
-    message   = sb->buffer + 6;
-  }
-  else if (!strncmp(sb->buffer, "JOBSTATE:", 9))
-  {
-    *loglevel = CUPSD_LOG_JOBSTATE;
-    message   = sb->buffer + 9;
+    sb->bufstart = sb->bufeol + 1;
+
+    if ((lineptr = memchr(sb->buffer + sb->bufstart, '\n',
+                          (size_t)(sb->bufused - sb->bufstart))) != NULL)
+    {
+      sb->bufeol = (int)(lineptr - sb->buffer);
+    }
+    else
+    {
+      sb->bufeol  = -1;
+      sb->bufscan = sb->bufused;
+    }
   }
-  else if (!strncmp(sb->buffer, "ATTR:", 5))
+  else
   {
-    *loglevel = CUPSD_LOG_ATTR;
-    message   = sb->buffer + 5;
+   /*
+    * All of the buffer data has been used up...
+    */
+
+    sb->bufused  = 0;
+    sb->bufstart = 0;
+    sb->bufscan  = 0;
+    sb->bufeol   = -1;
   }
-  else if (!strncmp(sb->buffer, "PPD:", 4))
+
+ /*
+  * Figure out the logging level from the "PREFIX:" of the line; the hash
+  * gives each known prefix its own slot in sb_prefixes...
+  */
+
+  for (lineptr = line; lineptr < (line + 9) && *lineptr && *lineptr != ':';
+       lineptr ++);
+
+  length = (int)(lineptr - line);
+
+  if (*lineptr == ':' && length >= 3)
   {
-    *loglevel = CUPSD_LOG_PPD;
-    message   = sb->buffer + 4;
+    hash = (4 * (line[0] & 255) + 2 * (line[1] & 255) + length) & 31;
+
+    if (sb_prefixes[hash].length == length &&
+        !strncmp(line, sb_prefixes[hash].prefix, (size_t)length))
+    {
+      *loglevel = sb_prefixes[hash].loglevel;
+      message   = lineptr + 1;
+    }
+    else
+    {
+      *loglevel = CUPSD_LOG_DEBUG;
+      message   = line;
+    }
   }
   else
   {
     *loglevel = CUPSD_LOG_DEBUG;
-    message   = sb->buffer;
+    message   = line;
   }
 
  /*
@@ -305,28 +352,10 @@ cupsdStatBufUpdate(
 	cupsdLogMessage(*loglevel, "%s %s", sb->prefix, message);
     }
     else if (*loglevel < CUPSD_LOG_NONE && LogLevel >= CUPSD_LOG_DEBUG)
-      cupsdLogMessage(CUPSD_LOG_DEBUG2, "%s %s", sb->prefix, sb->buffer);
+      cupsdLogMessage(CUPSD_LOG_DEBUG2, "%s %s", sb->prefix, line);
   }
 
- /*
-  * Copy the message to the line buffer...
-  */
-
-  strlcpy(line, message, linelen);
-
- /*
-  * Copy over the buffer data we've used up...
-  */
-
-  if (lineptr < sb->buffer + sb->bufused)
-    _cups_strcpy(sb->buffer, lineptr);
-
-  sb->bufused -= lineptr - sb->buffer;
-
-  if (sb->bufused < 0)
-    sb->bufused = 0;
-
-  return (line);
+  return (message);
 }
 
 
@@ -29,7 +29,10 @@ typedef struct				/**** Status buffer */
 {
   int	fd;				/* File descriptor to read from */
   char	prefix[64];			/* Prefix for log messages */
-  int	bufused;			/* How much is used in buffer */
+  int	bufused,			/* How much is used in buffer */
+	bufstart,			/* Start of next line in buffer */
+	bufscan,			/* How much was checked for newlines */
+	bufeol;				/* End of next line in buffer or -1 */
   char	buffer[CUPSD_SB_BUFFER_SIZE];	/* Buffer */
 } cupsd_statbuf_t;
 
@@ -39,9 +42,9 @@ typedef struct				/**** Status buffer */
  */
 
 extern void		cupsdStatBufDelete(cupsd_statbuf_t *sb);
+extern int		cupsdStatBufHasLine(cupsd_statbuf_t *sb);
 extern cupsd_statbuf_t	*cupsdStatBufNew(int fd, const char *prefix, ...);
-extern char		*cupsdStatBufUpdate(cupsd_statbuf_t *sb, int *loglevel,
-			                    char *line, int linelen);
+extern char		*cupsdStatBufUpdate(cupsd_statbuf_t *sb, int *loglevel);
 
 
 /*
@@ -0,0 +1,486 @@
+/*
+ * "$Id$"
+ *
+ *   Performance statistics for the CUPS scheduler.
+ *
+ *   Copyright 2013 by Apple Inc.
+ *
+ *   These coded instructions, statements, and computer programs are the
+ *   property of Apple Inc. and are protected by Federal copyright
+ *   law.  Distribution and use rights are outlined in the file "LICENSE.txt"
+ *   which should have been included with this file.  If this file is
+ *   file is missing or damaged, see the license at "http://www.cups.org/".
+ *
+ * Contents:
+ *
+ *   cupsdAddIPPStat()   - Record the time taken by an IPP operation.
+ *   cupsdAddStat()      - Record a latency sample.
+ *   cupsdAddStatAttrs() - Add the current statistics to an IPP message.
+ *   cupsdGetMetrics()   - Get the current statistics as text.
+ *   cupsdGetStatTime()  - Get the current time for latency samples.
+ *   add_stat_col()      - Add a collection for a latency statistic.
+ *   get_counters()      - Get the current counter and gauge values.
+ *   ipp_stat_name()     - Get the operation name for an IPPStats index.
+ *   metrics_printf()    - Append formatted text to the metrics buffer.
+ *   metrics_stat()      - Append a latency histogram to the metrics buffer.
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "cupsd.h"
+#include <stdarg.h>
+
+
+/*
+ * Design Notes for Statistics
+ * ---------------------------
+ *
+ * All of the counters are updated from the main loop, so no locking is
+ * needed.  Latencies are kept as a count, total, maximum, and a histogram
+ * with fixed bucket bounds (stat_bounds) so that the cost of recording a
+ * sample does not depend on the number of samples.
+ *
+ * The same values are reported by the CUPS-Get-Statistics operation in ipp.c
+ * (cupsdAddStatAttrs) and the "/metrics" resource in client.c
+ * (cupsdGetMetrics).  The text format is the Prometheus exposition format:
+ * counter names end with "_total", and attribute names have their dashes
+ * replaced by underscores and a "cupsd_" prefix.
+ */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct cupsd_statval_s		/**** Counter or gauge value ****/
+{
+  const char	*name;			/* IPP attribute name */
+  int		counter;		/* 1 = counter, 0 = gauge */
+  double	value;			/* Current value */
+} cupsd_statval_t;
+
+typedef struct cupsd_metrics_s		/**** Metrics text buffer ****/
+{
+  char		*data;			/* Text */
+  size_t	length,			/* Length of text */
+		size;			/* Size of buffer */
+} cupsd_metrics_t;
+
+
+/*
+ * Local globals...
+ */
+
+static const double	stat_bounds[CUPSD_STAT_BUCKETS - 1] =
+			{		/* Histogram bucket upper bounds */
+			  0.0001, 0.00025, 0.0005,
+			  0.001, 0.0025, 0.005,
+			  0.01, 0.025, 0.05,
+			  0.1, 0.25
+			};
+
+
+/*
+ * Local functions...
+ */
+
+static void	add_stat_col(ipp_t *ipp, const char *name, const char *opname,
+		             cupsd_stat_t *stat);
+static int	get_counters(cupsd_statval_t *values, int max_values);
+static const char *ipp_stat_name(int i);
+static void	metrics_printf(cupsd_metrics_t *m, const char *format, ...)
+		__attribute__ ((__format__ (__printf__, 2, 3)));
+static void	metrics_stat(cupsd_metrics_t *m, const char *name,
+		             const char *opname, cupsd_stat_t *stat);
+
+
+/*
+ * 'cupsdAddIPPStat()' - Record the time taken by an IPP operation.
+ */
+
+void
+cupsdAddIPPStat(ipp_op_t op,		/* I - Operation */
+                double   start)		/* I - Start time */
+{
+  if (op >= 0 && op < CUPSD_STAT_STD_OPS)
+    cupsdAddStat(IPPStats + op, start);
+  else if (op >= IPP_OP_PRIVATE && op < IPP_OP_PRIVATE + CUPSD_STAT_CUPS_OPS)
+    cupsdAddStat(IPPStats + CUPSD_STAT_STD_OPS + op - IPP_OP_PRIVATE, start);
+  else
+    cupsdAddStat(IPPStats + CUPSD_STAT_OPS - 1, start);
+}
+
+
+/*
+ * 'cupsdAddStat()' - Record a latency sample.
+ */
+
+void
+cupsdAddStat(cupsd_stat_t *stat,	/* I - Statistic */
+             double       start)	/* I - Start time */
+{
+  int		i;			/* Looping var */
+  double	elapsed;		/* Elapsed time */
+
+
+  if ((elapsed = cupsdGetStatTime() - start) < 0.0)
+    elapsed = 0.0;
+
+  stat->count ++;
+  stat->total += elapsed;
+
+  if (elapsed > stat->max)
+    stat->max = elapsed;
+
+  for (i = 0; i < (CUPSD_STAT_BUCKETS - 1); i ++)
+    if (elapsed <= stat_bounds[i])
+      break;
+
+  stat->buckets[i] ++;
+}
+
+
+/*
+ * 'cupsdAddStatAttrs()' - Add the current statistics to an IPP message.
+ */
+
+void
+cupsdAddStatAttrs(ipp_t *ipp)		/* I - IPP message */
+{
+  int			i,		/* Looping var */
+			num_values;	/* Number of counter values */
+  cupsd_statval_t	values[64];	/* Counter values */
+  int			bounds[CUPSD_STAT_BUCKETS - 1];
+					/* Bucket bounds in microseconds */
+
+
+  ippAddInteger(ipp, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "statistics-up-time",
+                (int)(time(NULL) - StatsStartTime));
+
+  for (i = 0; i < (CUPSD_STAT_BUCKETS - 1); i ++)
+    bounds[i] = (int)(stat_bounds[i] * 1000000.0 + 0.5);
+
+  ippAddIntegers(ipp, IPP_TAG_PRINTER, IPP_TAG_INTEGER,
+                 "statistics-bucket-bounds", CUPSD_STAT_BUCKETS - 1, bounds);
+
+  num_values = get_counters(values, (int)(sizeof(values) / sizeof(values[0])));
+
+  for (i = 0; i < num_values; i ++)
+    ippAddInteger(ipp, IPP_TAG_PRINTER, IPP_TAG_INTEGER, values[i].name,
+                  values[i].value > INT_MAX ? INT_MAX : (int)values[i].value);
+
+  add_stat_col(ipp, "check-jobs-statistics", NULL, &CheckJobsStats);
+  add_stat_col(ipp, "dirty-clean-statistics", NULL, &DirtyCleanStats);
+  add_stat_col(ipp, "select-callback-statistics", NULL, &SelectStats);
+
+  for (i = 0; i < CUPSD_STAT_OPS; i ++)
+    if (IPPStats[i].count)
+      add_stat_col(ipp, "ipp-operation-statistics", ipp_stat_name(i),
+                   IPPStats + i);
+}
+
+
+/*
+ * 'cupsdGetMetrics()' - Get the current statistics as text.
+ *
+ * The returned string must be freed with free().
+ */
+
+char *					/* O - Metrics text or NULL */
+cupsdGetMetrics(size_t *length)		/* O - Length of text */
+{
+  int			i,		/* Looping var */
+			num_values;	/* Number of counter values */
+  cupsd_statval_t	values[64];	/* Counter values */
+  cupsd_metrics_t	m;		/* Metrics buffer */
+  char			name[256],	/* Metric name */
+			*nameptr;	/* Pointer into name */
+
+
+  memset(&m, 0, sizeof(m));
+
+  metrics_printf(&m, "# TYPE cupsd_statistics_up_time_seconds gauge\n"
+                     "cupsd_statistics_up_time_seconds %ld\n",
+		 (long)(time(NULL) - StatsStartTime));
+
+  num_values = get_counters(values, (int)(sizeof(values) / sizeof(values[0])));
+
+  for (i = 0; i < num_values; i ++)
+  {
+    snprintf(name, sizeof(name), "cupsd_%s%s", values[i].name,
+             values[i].counter ? "_total" : "");
+
+    for (nameptr = name; *nameptr; nameptr ++)
+      if (*nameptr == '-')
+        *nameptr = '_';
+
+    metrics_printf(&m, "# TYPE %s %s\n%s %.0f\n", name,
+                   values[i].counter ? "counter" : "gauge", name,
+		   values[i].value);
+  }
+
+  metrics_stat(&m, "cupsd_check_jobs_seconds", NULL, &CheckJobsStats);
+  metrics_stat(&m, "cupsd_dirty_clean_seconds", NULL, &DirtyCleanStats);
+  metrics_stat(&m, "cupsd_select_callback_seconds", NULL, &SelectStats);
+
+  metrics_printf(&m, "# TYPE cupsd_ipp_operation_seconds histogram\n");
+
+  for (i = 0; i < CUPSD_STAT_OPS; i ++)
+    if (IPPStats[i].count)
+      metrics_stat(&m, "cupsd_ipp_operation_seconds", ipp_stat_name(i),
+                   IPPStats + i);
+
+  if (!m.data)
+  {
+    *length = 0;
+    return (NULL);
+  }
+
+  *length = m.length;
+
+  return (m.data);
+}
+
+
+/*
+ * 'cupsdGetStatTime()' - Get the current time for latency samples.
+ */
+
+double					/* O - Time in seconds */
+cupsdGetStatTime(void)
+{
+  struct timeval	curtime;	/* Current time */
+
+
+  gettimeofday(&curtime, NULL);
+
+  return (curtime.tv_sec + 0.000001 * curtime.tv_usec);
+}
+
+
+/*
+ * 'add_stat_col()' - Add a collection for a latency statistic.
+ */
+
+static void
+add_stat_col(ipp_t        *ipp,		/* I - IPP message */
+             const char   *name,	/* I - Attribute name */
+	     const char   *opname,	/* I - Operation name or NULL */
+	     cupsd_stat_t *stat)	/* I - Statistic */
+{
+  int			i;		/* Looping var */
+  ipp_t			*col;		/* Collection value */
+  ipp_attribute_t	*attr;		/* Histogram attribute */
+  double		total;		/* Total time in microseconds */
+
+
+  col = ippNew();
+
+  if (opname)
+    ippAddString(col, IPP_TAG_ZERO, IPP_TAG_NAME, "operation-name", NULL,
+                 opname);
+
+  ippAddInteger(col, IPP_TAG_ZERO, IPP_TAG_INTEGER, "count",
+                stat->count > INT_MAX ? INT_MAX : (int)stat->count);
+
+  total = stat->total * 1000000.0;
+  ippAddInteger(col, IPP_TAG_ZERO, IPP_TAG_INTEGER, "total-microseconds",
+                total > INT_MAX ? INT_MAX : (int)total);
+  ippAddInteger(col, IPP_TAG_ZERO, IPP_TAG_INTEGER, "max-microseconds",
+                (int)(stat->max * 1000000.0));
+
+  attr = ippAddIntegers(col, IPP_TAG_ZERO, IPP_TAG_INTEGER, "histogram",
+                        CUPSD_STAT_BUCKETS, NULL);
+  for (i = 0; i < CUPSD_STAT_BUCKETS; i ++)
+    attr->values[i].integer = stat->buckets[i] > INT_MAX ? INT_MAX :
+                                  (int)stat->buckets[i];
+
+  if ((attr = ippFindAttribute(ipp, name, IPP_TAG_BEGIN_COLLECTION)) != NULL)
+    ippSetCollection(ipp, &attr, ippGetCount(attr), col);
+  else
+    ippAddCollection(ipp, IPP_TAG_PRINTER, name, col);
+
+  ippDelete(col);
+}
+
+
+/*
+ * 'get_counters()' - Get the current counter and gauge values.
+ */
+
+static int				/* O - Number of values */
+get_counters(cupsd_statval_t *values,	/* I - Values array */
+             int             max_values)/* I - Size of values array */
+{
+  int			num_values = 0;	/* Number of values */
+  size_t		string_count,	/* String pool count */
+			alloc_bytes,	/* String pool allocated bytes */
+			total_bytes;	/* String pool total bytes */
+
+
+#define ADD_VALUE(n,c,v) \
+  if (num_values < max_values) \
+  { \
+    values[num_values].name    = n; \
+    values[num_values].counter = c; \
+    values[num_values].value   = (double)(v); \
+    num_values ++; \
+  }
+
+  string_count = _cupsStrStatistics(&alloc_bytes, &total_bytes);
+
+  ADD_VALUE("clients", 0, cupsArrayCount(Clients));
+  ADD_VALUE("max-clients", 0, MaxClients);
+  ADD_VALUE("printers", 0, cupsArrayCount(Printers));
+  ADD_VALUE("jobs", 0, cupsArrayCount(Jobs));
+  ADD_VALUE("active-jobs", 0, cupsArrayCount(ActiveJobs));
+  ADD_VALUE("printing-jobs", 0, cupsArrayCount(PrintingJobs));
+  ADD_VALUE("filter-level", 0, FilterLevel);
+  ADD_VALUE("filter-limit", 0, FilterLimit);
+  ADD_VALUE("dirty-clean-interval", 0, DirtyCleanInterval);
+  ADD_VALUE("select-calls", 1, SelectCalls);
+  ADD_VALUE("select-wakeups", 1, SelectWakeups);
+  ADD_VALUE("select-events", 1, SelectEvents);
+  ADD_VALUE("processes-started", 1, ProcessesStarted);
+  ADD_VALUE("processes-failed", 1, ProcessesFailed);
+  ADD_VALUE("printers-conf-writes", 1, DirtyWrites[0]);
+  ADD_VALUE("classes-conf-writes", 1, DirtyWrites[1]);
+  ADD_VALUE("printcap-writes", 1, DirtyWrites[2]);
+  ADD_VALUE("job-journal-writes", 1, DirtyWrites[3]);
+  ADD_VALUE("subscriptions-conf-writes", 1, DirtyWrites[4]);
+  ADD_VALUE("string-pool-count", 0, string_count);
+  ADD_VALUE("string-pool-alloc-bytes", 0, alloc_bytes);
+  ADD_VALUE("string-pool-total-bytes", 0, total_bytes);
+  ADD_VALUE("auth-cache-hits", 1, AuthCacheHits);
+  ADD_VALUE("auth-cache-misses", 1, AuthCacheMisses);
+  ADD_VALUE("group-cache-hits", 1, GroupCacheHits);
+  ADD_VALUE("group-cache-misses", 1, GroupCacheMisses);
+  ADD_VALUE("spool-compressed-files", 1, SpoolCompressedFiles);
+  ADD_VALUE("spool-compression-bytes-in", 1, SpoolBytesIn);
+  ADD_VALUE("spool-compression-bytes-out", 1, SpoolBytesOut);
+  ADD_VALUE("spool-compression-cpu-milliseconds", 1,
+            SpoolCompressTime * 1000.0);
+
+#undef ADD_VALUE
+
+  return (num_values);
+}
+
+
+/*
+ * 'ipp_stat_name()' - Get the operation name for an IPPStats index.
+ */
+
+static const char *			/* O - Operation name */
+ipp_stat_name(int i)			/* I - Index into IPPStats */
+{
+  if (i < CUPSD_STAT_STD_OPS)
+    return (ippOpString((ipp_op_t)i));
+  else if (i < (CUPSD_STAT_OPS - 1))
+    return (ippOpString((ipp_op_t)(IPP_OP_PRIVATE + i - CUPSD_STAT_STD_OPS)));
+  else
+    return ("other");
+}
+
+
+/*
+ * 'metrics_printf()' - Append formatted text to the metrics buffer.
+ */
+
+static void
+metrics_printf(cupsd_metrics_t *m,	/* I - Metrics buffer */
+               const char      *format,	/* I - Printf-style format string */
+	       ...)			/* I - Additional arguments as needed */
+{
+  va_list	ap;			/* Pointer to arguments */
+  int		bytes;			/* Formatted length */
+  size_t	size;			/* New buffer size */
+  char		*data;			/* New buffer */
+
+
+  for (;;)
+  {
+    if (m->data)
+    {
+      va_start(ap, format);
+      bytes = vsnprintf(m->data + m->length, m->size - m->length, format, ap);
+      va_end(ap);
+
+      if (bytes < 0)
+        return;
+
+      if ((size_t)bytes < (m->size - m->length))
+      {
+        m->length += (size_t)bytes;
+	return;
+      }
+    }
+    else
+      bytes = 0;
+
+    size = m->size ? 2 * m->size : 16384;
+    if (size < (m->length + (size_t)bytes + 1))
+      size = m->length + (size_t)bytes + 1;
+
+    if ((data = realloc(m->data, size)) == NULL)
+      return;
+
+    m->data = data;
+    m->size = size;
+  }
+}
+
+
+/*
+ * 'metrics_stat()' - Append a latency histogram to the metrics buffer.
+ */
+
+static void
+metrics_stat(cupsd_metrics_t *m,	/* I - Metrics buffer */
+             const char      *name,	/* I - Metric name */
+	     const char      *opname,	/* I - Operation name or NULL */
+	     cupsd_stat_t    *stat)	/* I - Statistic */
+{
+  int		i;			/* Looping var */
+  unsigned long	count;			/* Cumulative count */
+  char		label[256];		/* Operation label */
+
+
+  if (opname)
+    snprintf(label, sizeof(label), "operation=\"%s\",", opname);
+  else
+  {
+    label[0] = '\0';
+
+    metrics_printf(m, "# TYPE %s histogram\n", name);
+  }
+
+  for (i = 0, count = 0; i < (CUPSD_STAT_BUCKETS - 1); i ++)
+  {
+    count += stat->buckets[i];
+
+    metrics_printf(m, "%s_bucket{%sle=\"%g\"} %lu\n", name, label,
+                   stat_bounds[i], count);
+  }
+
+  metrics_printf(m, "%s_bucket{%sle=\"+Inf\"} %lu\n", name, label,
+                 stat->count);
+
+  if (opname)
+  {
+    snprintf(label, sizeof(label), "{operation=\"%s\"}", opname);
+
+    metrics_printf(m, "%s_sum%s %.6f\n%s_count%s %lu\n", name, label,
+                   stat->total, name, label, stat->count);
+  }
+  else
+    metrics_printf(m, "%s_sum %.6f\n%s_count %lu\n", name, stat->total, name,
+                   stat->count);
+}
+
+
+/*
+ * End of "$Id$".
+ */
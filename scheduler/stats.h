@@ -0,0 +1,80 @@
+/*
+ * "$Id$"
+ *
+ *   Performance statistics definitions for the CUPS scheduler.
+ *
+ *   Copyright 2013 by Apple Inc.
+ *
+ *   These coded instructions, statements, and computer programs are the
+ *   property of Apple Inc. and are protected by Federal copyright
+ *   law.  Distribution and use rights are outlined in the file "LICENSE.txt"
+ *   which should have been included with this file.  If this file is
+ *   file is missing or damaged, see the license at "http://www.cups.org/".
+ */
+
+/*
+ * Constants...
+ */
+
+#define CUPSD_STAT_BUCKETS	12	/* Number of latency histogram buckets */
+#define CUPSD_STAT_STD_OPS	0x80	/* Standard operations 0x00 to 0x7f */
+#define CUPSD_STAT_CUPS_OPS	0x40	/* CUPS operations 0x4000 to 0x403f */
+#define CUPSD_STAT_OPS		(CUPSD_STAT_STD_OPS + CUPSD_STAT_CUPS_OPS + 1)
+					/* IPP operation slots, plus "other" */
+
+
+/*
+ * Types...
+ */
+
+typedef struct cupsd_stat_s		/**** Latency statistics ****/
+{
+  unsigned long	count;			/* Number of samples */
+  double	total,			/* Total time in seconds */
+		max;			/* Longest time in seconds */
+  unsigned long	buckets[CUPSD_STAT_BUCKETS];
+					/* Samples by upper bound */
+} cupsd_stat_t;
+
+
+/*
+ * Globals...
+ */
+
+VAR cupsd_stat_t	IPPStats[CUPSD_STAT_OPS],
+					/* IPP operation latencies */
+			CheckJobsStats,
+					/* cupsdCheckJobs() latencies */
+			DirtyCleanStats,
+					/* cupsdCleanDirty() latencies */
+			SelectStats;
+					/* Time spent in select callbacks */
+VAR unsigned long	SelectCalls	VALUE(0),
+					/* Number of cupsdDoSelect() calls */
+			SelectWakeups	VALUE(0),
+					/* Calls that returned descriptors */
+			SelectEvents	VALUE(0),
+					/* Descriptors returned */
+			ProcessesStarted VALUE(0),
+					/* Processes started */
+			ProcessesFailed	VALUE(0),
+					/* Processes that could not start */
+			DirtyWrites[5];	/* Writes by CUPSD_DIRTY_xxx bit */
+VAR time_t		StatsStartTime	VALUE(0);
+					/* When statistics started */
+
+
+/*
+ * Prototypes...
+ */
+
+extern void	cupsdAddIPPStat(ipp_op_t op, double start);
+extern void	cupsdAddStat(cupsd_stat_t *stat, double start);
+extern void	cupsdAddStatAttrs(ipp_t *ipp);
+extern char	*cupsdGetMetrics(size_t *length);
+extern double	cupsdGetStatTime(void);
+
+
+/*
+ * End of "$Id$".
+ */
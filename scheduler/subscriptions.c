@@ -15,6 +15,8 @@
  * Contents:
  *
  *   cupsdAddEvent()               - Add an event to the global event cache.
+ *   cupsdAddEventHeader()         - Add the per-subscription event
+ *                                   attributes.
  *   cupsdAddSubscription()        - Add a new subscription object.
  *   cupsdDeleteAllSubscriptions() - Delete all subscriptions.
  *   cupsdDeleteSubscription()     - Delete a subscription object.
@@ -25,13 +27,27 @@
  *   cupsdLoadAllSubscriptions()   - Load all subscriptions from the .conf file.
  *   cupsdSaveAllSubscriptions()   - Save all subscriptions to the .conf file.
  *   cupsdStopAllNotifiers()       - Stop all notifier processes.
+ *   cupsd_compare_index()         - Compare two subscription index entries.
  *   cupsd_compare_subscriptions() - Compare two subscriptions.
- *   cupsd_delete_event()          - Delete a single event...
+ *   cupsd_delete_event()          - Release a single event...
+ *   cupsd_encode_event()          - Encode the shared event attributes for
+ *                                   notifiers.
+ *   cupsd_find_index()            - Find (or create) a subscription index
+ *                                   entry.
+ *   cupsd_index_subscription()    - Add a subscription to the index.
+ *   cupsd_new_event()             - Create a new event with the shared
+ *                                   attributes.
  *   cupsd_send_dbus()             - Send a DBUS notification...
  *   cupsd_send_notification()     - Send a notification for the specified
  *                                   event.
  *   cupsd_start_notifier()        - Start a notifier subprocess...
+ *   cupsd_unindex_subscription()  - Remove a subscription from the index.
  *   cupsd_update_notifier()       - Read messages from notifiers.
+ *   cupsd_write_buffer()          - Append encoded IPP data to a memory
+ *                                   buffer.
+ *   cupsd_write_event()           - Write an event to a subscription's
+ *                                   notifier.
+ *   cupsd_write_subscription()    - Write a subscription to the .conf file.
  */
 
 /*
@@ -49,14 +65,82 @@
 #endif /* HAVE_DBUS */
 
 
+/*
+ * Design notes:
+ *
+ * Subscriptions are indexed by scope and event bit so that cupsdAddEvent()
+ * only visits subscriptions that can receive the event.  Each index entry
+ * covers one scope - server-wide subscriptions (no printer or job), the
+ * subscriptions for one printer, or the subscriptions for one job - and
+ * holds one array per event mask bit, sorted by subscription ID.  An event
+ * looks up at most three entries and walks only the arrays for its bits.
+ *
+ * The notification attributes that are the same for every subscription
+ * are built once per event and the cupsd_event_t is shared (reference
+ * counted) between the event caches of all matching subscriptions.  The
+ * per-subscription attributes (subscription ID, sequence number, and user
+ * data) are added by cupsdAddEventHeader() when the event is delivered.
+ * For notifiers the shared attributes are also encoded once, and each
+ * notifier gets a small per-subscription header followed by those bytes.
+ */
+
+
+/*
+ * Local constants...
+ */
+
+#define CUPSD_EVENT_BITS	21	/* Number of bits in CUPSD_EVENT_ALL */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct cupsd_subindex_s		/**** Subscription index entry ****/
+{
+  cupsd_printer_t	*dest;		/* Printer, if any */
+  int			job_id;		/* Job ID, if any */
+  unsigned		mask;		/* Union of event bits in entry */
+  cups_array_t		*subs[CUPSD_EVENT_BITS];
+					/* Subscriptions for each event bit */
+} cupsd_subindex_t;
+
+typedef struct cupsd_ippbuf_s		/**** IPP encoding buffer ****/
+{
+  ipp_uchar_t		*buffer;	/* Buffer */
+  size_t		length,		/* Bytes in buffer */
+			size;		/* Size of buffer */
+} cupsd_ippbuf_t;
+
+
+/*
+ * Local globals...
+ */
+
+static cups_array_t	*sub_index = NULL;
+					/* Subscription index entries */
+static int		sub_records = -1;
+					/* Stale records in .conf file or -1 */
+static int		sub_next_id = 0;/* NextSubscriptionId in .conf file */
+
+
 /*
  * Local functions...
  */
 
+static int	cupsd_compare_index(cupsd_subindex_t *first,
+		                    cupsd_subindex_t *second, void *unused);
 static int	cupsd_compare_subscriptions(cupsd_subscription_t *first,
 		                            cupsd_subscription_t *second,
 		                            void *unused);
 static void	cupsd_delete_event(cupsd_event_t *event);
+static int	cupsd_encode_event(cupsd_event_t *event);
+static cupsd_subindex_t *cupsd_find_index(cupsd_printer_t *dest, int job_id,
+		                          int create);
+static void	cupsd_index_subscription(cupsd_subscription_t *sub);
+static cupsd_event_t *cupsd_new_event(cupsd_eventmask_t event,
+		                      cupsd_printer_t *dest, cupsd_job_t *job,
+				      const char *text);
 #ifdef HAVE_DBUS
 static void	cupsd_send_dbus(cupsd_eventmask_t event, cupsd_printer_t *dest,
 		                cupsd_job_t *job);
@@ -64,7 +148,14 @@ static void	cupsd_send_dbus(cupsd_eventmask_t event, cupsd_printer_t *dest,
 static void	cupsd_send_notification(cupsd_subscription_t *sub,
 		                        cupsd_event_t *event);
 static void	cupsd_start_notifier(cupsd_subscription_t *sub);
+static void	cupsd_unindex_subscription(cupsd_subscription_t *sub);
 static void	cupsd_update_notifier(void);
+static ssize_t	cupsd_write_buffer(cupsd_ippbuf_t *buf, ipp_uchar_t *data,
+		                   size_t bytes);
+static int	cupsd_write_event(cupsd_subscription_t *sub,
+		                  cupsd_event_t *event);
+static void	cupsd_write_subscription(cups_file_t *fp,
+					 cupsd_subscription_t *sub);
 
 
 /*
@@ -79,10 +170,13 @@ cupsdAddEvent(
     const char        *text,		/* I - Notification text */
     ...)				/* I - Additional arguments as needed */
 {
+  int			i,		/* Looping var */
+			b;		/* Current event bit number */
+  unsigned		bit;		/* Current event bit */
   va_list		ap;		/* Pointer to additional arguments */
   char			ftext[1024];	/* Formatted text buffer */
-  ipp_attribute_t	*attr;		/* Printer/job attribute */
   cupsd_event_t		*temp;		/* New event pointer */
+  cupsd_subindex_t	*entries[3];	/* Index entries to visit */
   cupsd_subscription_t	*sub;		/* Current subscription */
 
 
@@ -114,200 +208,118 @@ cupsdAddEvent(
   }
 
  /*
-  * Then loop through the subscriptions and add the event to the corresponding
-  * caches...
+  * Job events are reported against the job's printer...
   */
 
-  for (temp = NULL, sub = (cupsd_subscription_t *)cupsArrayFirst(Subscriptions);
-       sub;
-       sub = (cupsd_subscription_t *)cupsArrayNext(Subscriptions))
-  {
-   /*
-    * Check if this subscription requires this event...
-    */
-
-    if ((sub->mask & event) != 0 &&
-        (sub->dest == dest || !sub->dest) &&
-	(sub->job == job || !sub->job))
-    {
-     /*
-      * Need this event, so create a new event record...
-      */
-
-      if ((temp = (cupsd_event_t *)calloc(1, sizeof(cupsd_event_t))) == NULL)
-      {
-	cupsdLogMessage(CUPSD_LOG_CRIT,
-	                "Unable to allocate memory for event - %s",
-        	        strerror(errno));
-	return;
-      }
-
-      temp->event = event;
-      temp->time  = time(NULL);
-      temp->attrs = ippNew();
-      temp->job   = job;
-
-      if (dest)
-        temp->dest = dest;
-      else if (job)
-        temp->dest = dest = cupsdFindPrinter(job->dest);
-
-     /*
-      * Add common event notification attributes...
-      */
-
-      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_CHARSET,
-                   "notify-charset", NULL, "utf-8");
-
-      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_LANGUAGE,
-                   "notify-natural-language", NULL, "en-US");
-
-      ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
-	            "notify-subscription-id", sub->id);
+  if (!dest && job)
+    dest = cupsdFindPrinter(job->dest);
 
-      ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
-	            "notify-sequence-number", sub->next_event_id);
-
-      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD,
-	           "notify-subscribed-event", NULL, cupsdEventName(event));
+ /*
+  * Only subscriptions without a printer or job, subscriptions for the
+  * event's printer, and subscriptions for the event's job can match, so
+  * just visit those index entries...
+  */
 
-      if (sub->user_data_len > 0)
-        ippAddOctetString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
-	                  "notify-user-data", sub->user_data,
-			  sub->user_data_len);
+  entries[0] = cupsd_find_index(NULL, 0, 0);
+  entries[1] = dest ? cupsd_find_index(dest, 0, 0) : NULL;
+  entries[2] = job ? cupsd_find_index(NULL, job->id, 0) : NULL;
 
-      ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
-	            "printer-up-time", time(NULL));
+  for (i = 0, temp = NULL; i < 3; i ++)
+  {
+    if (!entries[i] || !(entries[i]->mask & event))
+      continue;
 
-      va_start(ap, text);
-      vsnprintf(ftext, sizeof(ftext), text, ap);
-      va_end(ap);
+    for (b = 0; b < CUPSD_EVENT_BITS; b ++)
+    {
+      bit = 1U << b;
 
-      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_TEXT,
-	           "notify-text", NULL, ftext);
+      if (!(event & bit) || !entries[i]->subs[b])
+        continue;
 
-      if (dest)
+      for (sub = (cupsd_subscription_t *)cupsArrayFirst(entries[i]->subs[b]);
+	   sub;
+	   sub = (cupsd_subscription_t *)cupsArrayNext(entries[i]->subs[b]))
       {
        /*
-	* Add printer attributes...
+        * Skip subscriptions that already got this event for a lower bit or
+	* are for a different printer...
 	*/
 
-	ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_URI,
-	             "notify-printer-uri", NULL, dest->uri);
-
-	ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_NAME,
-	             "printer-name", NULL, dest->name);
+        if ((sub->mask & event & (bit - 1)) ||
+	    (sub->dest && sub->dest != dest) ||
+	    (sub->job && sub->job != job))
+	  continue;
 
-	ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_ENUM,
-	              "printer-state", dest->state);
-
-	if (dest->num_reasons == 0)
-	  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
-	               IPP_TAG_KEYWORD, "printer-state-reasons", NULL,
-		       dest->state == IPP_PRINTER_STOPPED ? "paused" : "none");
-	else
-	  ippAddStrings(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
-	                IPP_TAG_KEYWORD, "printer-state-reasons",
-			dest->num_reasons, NULL,
-			(const char * const *)dest->reasons);
-
-	ippAddBoolean(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
-	              "printer-is-accepting-jobs", dest->accepting);
-      }
-
-      if (job)
-      {
        /*
-	* Add job attributes...
+	* Need this event, so create the (shared) event record...
 	*/
 
-	ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
-	              "notify-job-id", job->id);
-	ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_ENUM,
-	              "job-state", job->state_value);
-
-        if ((attr = ippFindAttribute(job->attrs, "job-name",
-	                             IPP_TAG_NAME)) != NULL)
-	  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_NAME,
-	               "job-name", NULL, attr->values[0].string.text);
-
-	switch (job->state_value)
+        if (!temp)
 	{
-	  case IPP_JOB_PENDING :
-              if (dest && dest->state == IPP_PRINTER_STOPPED)
-        	ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
-		             IPP_TAG_KEYWORD, "job-state-reasons", NULL,
-			     "printer-stopped");
-              else
-        	ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
-		             IPP_TAG_KEYWORD, "job-state-reasons", NULL,
-			     "none");
-              break;
-
-	  case IPP_JOB_HELD :
-              if (ippFindAttribute(job->attrs, "job-hold-until", IPP_TAG_KEYWORD) != NULL ||
-		  ippFindAttribute(job->attrs, "job-hold-until", IPP_TAG_NAME) != NULL)
-        	ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
-		             IPP_TAG_KEYWORD, "job-state-reasons", NULL,
-			     "job-hold-until-specified");
-              else
-        	ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
-		             IPP_TAG_KEYWORD, "job-state-reasons", NULL,
-			     "job-incoming");
-              break;
-
-	  case IPP_JOB_PROCESSING :
-              ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
-		           IPP_TAG_KEYWORD, "job-state-reasons", NULL,
-			   "job-printing");
-              break;
-
-	  case IPP_JOB_STOPPED :
-              ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
-		           IPP_TAG_KEYWORD, "job-state-reasons", NULL,
-			   "job-stopped");
-              break;
-
-	  case IPP_JOB_CANCELED :
-              ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
-		           IPP_TAG_KEYWORD, "job-state-reasons", NULL,
-			   "job-canceled-by-user");
-              break;
-
-	  case IPP_JOB_ABORTED :
-              ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
-		           IPP_TAG_KEYWORD, "job-state-reasons", NULL,
-			   "aborted-by-system");
-              break;
-
-	  case IPP_JOB_COMPLETED :
-              ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
-		           IPP_TAG_KEYWORD, "job-state-reasons", NULL,
-			   "job-completed-successfully");
-              break;
+	  va_start(ap, text);
+	  vsnprintf(ftext, sizeof(ftext), text, ap);
+	  va_end(ap);
+
+	  if ((temp = cupsd_new_event(event, dest, job, ftext)) == NULL)
+	    return;
 	}
 
-	ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
-	              "job-impressions-completed",
-		      job->sheets ? job->sheets->values[0].integer : 0);
-      }
+       /*
+	* Send the notification for this subscription...
+	*/
 
-     /*
-      * Send the notification for this subscription...
-      */
+	cupsd_send_notification(sub, temp);
 
-      cupsd_send_notification(sub, temp);
+	sub->dirty = 1;
+      }
     }
   }
 
   if (temp)
-    cupsdMarkDirty(CUPSD_DIRTY_SUBSCRIPTIONS);
+  {
+    if (!temp->refcount)
+      cupsd_delete_event(temp);
+
+    cupsdMarkDirtyRecords(CUPSD_DIRTY_SUBSCRIPTIONS);
+  }
   else
     cupsdLogMessage(CUPSD_LOG_DEBUG, "Discarding unused %s event...",
                     cupsdEventName(event));
 }
 
 
+/*
+ * 'cupsdAddEventHeader()' - Add the per-subscription event attributes.
+ *
+ * The attributes that differ between subscriptions are not stored with
+ * the shared event, so they are added separately when the event is
+ * copied into a Get-Notifications response or sent to a notifier.
+ */
+
+void
+cupsdAddEventHeader(
+    ipp_t                *ipp,		/* I - IPP message */
+    cupsd_subscription_t *sub,		/* I - Subscription object */
+    int                  sequence)	/* I - notify-sequence-number */
+{
+  ippAddString(ipp, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_CHARSET,
+	       "notify-charset", NULL, "utf-8");
+
+  ippAddString(ipp, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_LANGUAGE,
+	       "notify-natural-language", NULL, "en-US");
+
+  ippAddInteger(ipp, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
+		"notify-subscription-id", sub->id);
+
+  ippAddInteger(ipp, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
+		"notify-sequence-number", sequence);
+
+  if (sub->user_data_len > 0)
+    ippAddOctetString(ipp, IPP_TAG_EVENT_NOTIFICATION, "notify-user-data",
+		      sub->user_data, sub->user_data_len);
+}
+
+
 /*
  * 'cupsdAddSubscription()' - Add a new subscription object.
  */
@@ -432,6 +444,7 @@ cupsdAddSubscription(
   temp->pipe           = -1;
   temp->first_event_id = 1;
   temp->next_event_id  = 1;
+  temp->dirty          = 1;
 
   cupsdSetString(&(temp->recipient), uri);
 
@@ -440,6 +453,7 @@ cupsdAddSubscription(
   */
 
   cupsArrayAdd(Subscriptions, temp);
+  cupsd_index_subscription(temp);
 
  /*
   * For RSS subscriptions, run the notifier immediately...
@@ -472,6 +486,9 @@ cupsdDeleteAllSubscriptions(void)
 
   cupsArrayDelete(Subscriptions);
   Subscriptions = NULL;
+
+  cupsArrayDelete(sub_index);
+  sub_index = NULL;
 }
 
 
@@ -496,6 +513,7 @@ cupsdDeleteSubscription(
   */
 
   cupsArrayRemove(Subscriptions, sub);
+  cupsd_unindex_subscription(sub);
 
  /*
   * Free memory...
@@ -732,16 +750,27 @@ cupsdLoadAllSubscriptions(void)
   cupsd_subscription_t	*sub;		/* Current subscription */
   int			hex;		/* Non-zero if reading hex data */
   int			delete_sub;	/* Delete subscription? */
+  cups_array_t		*records;	/* Current subscription records */
+  int			skip;		/* Skipping an old record? */
 
 
  /*
   * Open the subscriptions.conf file...
   */
 
+  sub_records = -1;
+
   snprintf(line, sizeof(line), "%s/subscriptions.conf", ServerRoot);
   if ((fp = cupsdOpenConfFile(line)) == NULL)
     return;
 
+ /*
+  * Find the current copy of each subscription, since changed subscriptions
+  * are appended to the file...
+  */
+
+  records = cupsdFindConfRecords(fp, &sub_records);
+
  /*
   * Read all of the lines from the file...
   */
@@ -749,9 +778,22 @@ cupsdLoadAllSubscriptions(void)
   linenum    = 0;
   sub        = NULL;
   delete_sub = 0;
+  skip       = 0;
 
   while (cupsFileGetConf(fp, line, sizeof(line), &value, &linenum))
   {
+    if (skip)
+    {
+     /*
+      * Skip older (or incomplete) copies of a subscription...
+      */
+
+      if (!_cups_strcasecmp(line, "</Subscription>"))
+        skip = 0;
+
+      continue;
+    }
+
     if (!_cups_strcasecmp(line, "NextSubscriptionId") && value)
     {
      /*
@@ -768,8 +810,16 @@ cupsdLoadAllSubscriptions(void)
       * <Subscription #>
       */
 
-      if (!sub && value && isdigit(value[0] & 255))
+      if (!sub && value && isdigit(value[0] & 255) &&
+          !cupsdIsCurrentConfRecord(records, value, linenum))
+        skip = 1;
+      else if (!sub && value && isdigit(value[0] & 255))
       {
+       /*
+        * The subscription is added with an empty mask, so it is not
+	* indexed until the whole entry has been read...
+	*/
+
         sub = cupsdAddSubscription(CUPSD_EVENT_NONE, NULL, NULL, NULL,
 	                           atoi(value));
       }
@@ -793,6 +843,11 @@ cupsdLoadAllSubscriptions(void)
 
       if (delete_sub)
         cupsdDeleteSubscription(sub, 0);
+      else
+      {
+        sub->dirty = 0;
+        cupsd_index_subscription(sub);
+      }
 
       sub        = NULL;
       delete_sub = 0;
@@ -1065,7 +1120,29 @@ cupsdLoadAllSubscriptions(void)
     }
   }
 
+ /*
+  * Index a partially-read subscription so it still gets events...
+  */
+
+  if (sub && !delete_sub)
+    cupsd_index_subscription(sub);
+
+  sub_next_id = NextSubscriptionId;
+
+  cupsArrayDelete(records);
   cupsFileClose(fp);
+
+ /*
+  * Rewrite the file right away if it holds older or incomplete copies of a
+  * subscription, since older versions of cupsd would otherwise load
+  * duplicate subscriptions...
+  */
+
+  if (sub_records)
+  {
+    sub_records = -1;
+    cupsdSaveAllSubscriptions();
+  }
 }
 
 
@@ -1076,23 +1153,69 @@ cupsdLoadAllSubscriptions(void)
 void
 cupsdSaveAllSubscriptions(void)
 {
-  int			i;		/* Looping var */
   cups_file_t		*fp;		/* subscriptions.conf file */
   char			filename[1024],	/* subscriptions.conf filename */
 			temp[1024];	/* Temporary string */
   cupsd_subscription_t	*sub;		/* Current subscription */
   time_t		curtime;	/* Current time */
   struct tm		*curdate;	/* Current date */
-  unsigned		mask;		/* Current event mask */
-  const char		*name;		/* Current event name */
-  int			hex;		/* Non-zero if we are writing hex data */
+  int			records;	/* Number of records written */
 
 
+  snprintf(filename, sizeof(filename), "%s/subscriptions.conf", ServerRoot);
+
  /*
-  * Create the subscriptions.conf file...
+  * Append the changed subscriptions to the subscriptions.conf file if we
+  * can...
   */
 
-  snprintf(filename, sizeof(filename), "%s/subscriptions.conf", ServerRoot);
+  if (!(DirtyFiles & (CUPSD_DIRTY_SUBSCRIPTIONS | CUPSD_DIRTY_COMPACT)) &&
+      sub_records >= 0 &&
+      sub_records <= (cupsArrayCount(Subscriptions) + MAX_CONF_RECORDS))
+  {
+    if ((fp = cupsdAppendConfFile(filename)) != NULL)
+    {
+      if (sub_next_id != NextSubscriptionId)
+        cupsFilePrintf(fp, "NextSubscriptionId %d\n", NextSubscriptionId);
+
+      for (sub = (cupsd_subscription_t *)cupsArrayFirst(Subscriptions),
+               records = 0;
+	   sub;
+	   sub = (cupsd_subscription_t *)cupsArrayNext(Subscriptions))
+      {
+	if (!sub->dirty)
+	  continue;
+
+	cupsd_write_subscription(fp, sub);
+
+	sub->dirty = 0;
+	records ++;
+      }
+
+      if (!cupsdCloseAppendedConfFile(fp, filename))
+      {
+	cupsdLogMessage(CUPSD_LOG_DEBUG,
+	                "Appended %d records to subscriptions.conf.", records);
+
+	sub_records += records;
+	sub_next_id = NextSubscriptionId;
+	return;
+      }
+    }
+  }
+  else if (!((DirtyFiles | DirtyRecords) & CUPSD_DIRTY_SUBSCRIPTIONS) &&
+           sub_records == 0)
+  {
+   /*
+    * Nothing to compact...
+    */
+
+    return;
+  }
+
+ /*
+  * Otherwise create a new subscriptions.conf file...
+  */
 
   if ((fp = cupsdCreateConfFile(filename, ConfigFilePerm)) == NULL)
     return;
@@ -1120,85 +1243,18 @@ cupsdSaveAllSubscriptions(void)
        sub;
        sub = (cupsd_subscription_t *)cupsArrayNext(Subscriptions))
   {
-    cupsFilePrintf(fp, "<Subscription %d>\n", sub->id);
-
-    if ((name = cupsdEventName((cupsd_eventmask_t)sub->mask)) != NULL)
-    {
-     /*
-      * Simple event list...
-      */
+    cupsd_write_subscription(fp, sub);
 
-      cupsFilePrintf(fp, "Events %s\n", name);
-    }
-    else
-    {
-     /*
-      * Complex event list...
-      */
-
-      cupsFilePuts(fp, "Events");
-
-      for (mask = 1; mask < CUPSD_EVENT_ALL; mask <<= 1)
-        if (sub->mask & mask)
-	  cupsFilePrintf(fp, " %s", cupsdEventName((cupsd_eventmask_t)mask));
-
-      cupsFilePuts(fp, "\n");
-    }
-
-    if (sub->owner)
-      cupsFilePrintf(fp, "Owner %s\n", sub->owner);
-    if (sub->recipient)
-      cupsFilePrintf(fp, "Recipient %s\n", sub->recipient);
-    if (sub->job)
-      cupsFilePrintf(fp, "JobId %d\n", sub->job->id);
-    if (sub->dest)
-      cupsFilePrintf(fp, "PrinterName %s\n", sub->dest->name);
-
-    if (sub->user_data_len > 0)
-    {
-      cupsFilePuts(fp, "UserData ");
-
-      for (i = 0, hex = 0; i < sub->user_data_len; i ++)
-      {
-        if (sub->user_data[i] < ' ' ||
-	    sub->user_data[i] > 0x7f ||
-	    sub->user_data[i] == '<')
-	{
-	  if (!hex)
-	  {
-	    cupsFilePrintf(fp, "<%02X", sub->user_data[i]);
-	    hex = 1;
-	  }
-	  else
-	    cupsFilePrintf(fp, "%02X", sub->user_data[i]);
-	}
-	else
-	{
-	  if (hex)
-	  {
-	    cupsFilePrintf(fp, ">%c", sub->user_data[i]);
-	    hex = 0;
-	  }
-	  else
-	    cupsFilePutChar(fp, sub->user_data[i]);
-	}
-      }
-
-      if (hex)
-        cupsFilePuts(fp, ">\n");
-      else
-        cupsFilePutChar(fp, '\n');
-    }
-
-    cupsFilePrintf(fp, "LeaseDuration %d\n", sub->lease);
-    cupsFilePrintf(fp, "Interval %d\n", sub->interval);
-    cupsFilePrintf(fp, "ExpirationTime %ld\n", (long)sub->expire);
-    cupsFilePrintf(fp, "NextEventId %d\n", sub->next_event_id);
-
-    cupsFilePuts(fp, "</Subscription>\n");
+    sub->dirty = 0;
   }
 
-  cupsdCloseCreatedConfFile(fp, filename);
+  if (cupsdCloseCreatedConfFile(fp, filename))
+    sub_records = -1;
+  else
+  {
+    sub_records = 0;
+    sub_next_id = NextSubscriptionId;
+  }
 }
 
 
@@ -1254,6 +1310,27 @@ cupsdStopAllNotifiers(void)
 }
 
 
+/*
+ * 'cupsd_compare_index()' - Compare two subscription index entries.
+ */
+
+static int				/* O - Result of comparison */
+cupsd_compare_index(
+    cupsd_subindex_t *first,		/* I - First index entry */
+    cupsd_subindex_t *second,		/* I - Second index entry */
+    void             *unused)		/* I - Unused user data pointer */
+{
+  (void)unused;
+
+  if (first->job_id != second->job_id)
+    return (first->job_id - second->job_id);
+  else if (first->dest < second->dest)
+    return (-1);
+  else
+    return (first->dest > second->dest);
+}
+
+
 /*
  * 'cupsd_compare_subscriptions()' - Compare two subscriptions.
  */
@@ -1271,24 +1348,318 @@ cupsd_compare_subscriptions(
 
 
 /*
- * 'cupsd_delete_event()' - Delete a single event...
+ * 'cupsd_delete_event()' - Release a single event...
  *
  * Oldest events must be deleted first, otherwise the subscription cache
- * flushing code will not work properly.
+ * flushing code will not work properly.  Events are shared between
+ * subscriptions, so the memory is only freed when the last reference goes
+ * away.
  */
 
 static void
 cupsd_delete_event(cupsd_event_t *event)/* I - Event to delete */
 {
+  if (-- event->refcount > 0)
+    return;
+
  /*
   * Free memory...
   */
 
   ippDelete(event->attrs);
+  free(event->encoded);
   free(event);
 }
 
 
+/*
+ * 'cupsd_encode_event()' - Encode the shared event attributes for notifiers.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+cupsd_encode_event(
+    cupsd_event_t *event)		/* I - Event */
+{
+  cupsd_ippbuf_t	buf;		/* Encoding buffer */
+  ipp_state_t		state;		/* IPP write state */
+
+
+  if (event->encoded)
+    return (1);
+
+ /*
+  * Encode the whole message into memory; the shared attributes then start
+  * after the 8-byte message header and event-notification group tag...
+  */
+
+  buf.length = 0;
+  buf.size   = ippLength(event->attrs);
+
+  if ((buf.buffer = malloc(buf.size)) == NULL)
+    return (0);
+
+  event->attrs->state = IPP_IDLE;
+
+  while ((state = ippWriteIO(&buf, (ipp_iocb_t)cupsd_write_buffer, 1, NULL,
+                             event->attrs)) != IPP_DATA)
+    if (state == IPP_ERROR)
+      break;
+
+  if (state == IPP_ERROR || buf.length < 10 ||
+      buf.buffer[8] != IPP_TAG_EVENT_NOTIFICATION)
+  {
+    free(buf.buffer);
+    return (0);
+  }
+
+  event->encoded     = buf.buffer;
+  event->encoded_len = buf.length;
+
+  return (1);
+}
+
+
+/*
+ * 'cupsd_find_index()' - Find (or create) a subscription index entry.
+ */
+
+static cupsd_subindex_t *		/* O - Index entry or NULL */
+cupsd_find_index(
+    cupsd_printer_t *dest,		/* I - Printer, if any */
+    int             job_id,		/* I - Job ID, if any */
+    int             create)		/* I - Create entry as needed? */
+{
+  cupsd_subindex_t	key,		/* Search key */
+			*entry;		/* Matching entry */
+
+
+  if (!sub_index)
+  {
+    if (!create)
+      return (NULL);
+
+    if ((sub_index = cupsArrayNew((cups_array_func_t)cupsd_compare_index,
+                                  NULL)) == NULL)
+      return (NULL);
+  }
+
+  key.dest   = dest;
+  key.job_id = job_id;
+
+  if ((entry = (cupsd_subindex_t *)cupsArrayFind(sub_index, &key)) == NULL &&
+      create)
+  {
+    if ((entry = calloc(1, sizeof(cupsd_subindex_t))) == NULL)
+      return (NULL);
+
+    entry->dest   = dest;
+    entry->job_id = job_id;
+
+    cupsArrayAdd(sub_index, entry);
+  }
+
+  return (entry);
+}
+
+
+/*
+ * 'cupsd_index_subscription()' - Add a subscription to the index.
+ */
+
+static void
+cupsd_index_subscription(
+    cupsd_subscription_t *sub)		/* I - Subscription object */
+{
+  int			b;		/* Current event bit number */
+  cupsd_subindex_t	*entry;		/* Index entry */
+
+
+  if (!(sub->mask & CUPSD_EVENT_ALL))
+    return;
+
+  if (sub->job)
+    entry = cupsd_find_index(NULL, sub->job->id, 1);
+  else
+    entry = cupsd_find_index(sub->dest, 0, 1);
+
+  if (!entry)
+  {
+    cupsdLogMessage(CUPSD_LOG_CRIT,
+                    "Unable to allocate memory for subscription index - %s",
+		    strerror(errno));
+    return;
+  }
+
+  for (b = 0; b < CUPSD_EVENT_BITS; b ++)
+  {
+    if (!(sub->mask & (1U << b)))
+      continue;
+
+    if (!entry->subs[b] &&
+        (entry->subs[b] = cupsArrayNew(
+	                      (cups_array_func_t)cupsd_compare_subscriptions,
+			      NULL)) == NULL)
+      continue;
+
+    cupsArrayAdd(entry->subs[b], sub);
+    entry->mask |= 1U << b;
+  }
+}
+
+
+/*
+ * 'cupsd_new_event()' - Create a new event with the shared attributes.
+ */
+
+static cupsd_event_t *			/* O - New event or NULL */
+cupsd_new_event(
+    cupsd_eventmask_t event,		/* I - Event */
+    cupsd_printer_t   *dest,		/* I - Printer associated with event */
+    cupsd_job_t       *job,		/* I - Job associated with event */
+    const char        *text)		/* I - Notification text */
+{
+  ipp_attribute_t	*attr;		/* Printer/job attribute */
+  cupsd_event_t		*temp;		/* New event pointer */
+
+
+  if ((temp = (cupsd_event_t *)calloc(1, sizeof(cupsd_event_t))) == NULL ||
+      (temp->attrs = ippNew()) == NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_CRIT,
+		    "Unable to allocate memory for event - %s",
+		    strerror(errno));
+    free(temp);
+    return (NULL);
+  }
+
+  temp->event = event;
+  temp->time  = time(NULL);
+  temp->dest  = dest;
+  temp->job   = job;
+
+ /*
+  * Add common event notification attributes...
+  */
+
+  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD,
+	       "notify-subscribed-event", NULL, cupsdEventName(event));
+
+  ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
+		"printer-up-time", time(NULL));
+
+  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_TEXT,
+	       "notify-text", NULL, text);
+
+  if (dest)
+  {
+   /*
+    * Add printer attributes...
+    */
+
+    ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_URI,
+		 "notify-printer-uri", NULL, dest->uri);
+
+    ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_NAME,
+		 "printer-name", NULL, dest->name);
+
+    ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_ENUM,
+		  "printer-state", dest->state);
+
+    if (dest->num_reasons == 0)
+      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
+		   IPP_TAG_KEYWORD, "printer-state-reasons", NULL,
+		   dest->state == IPP_PRINTER_STOPPED ? "paused" : "none");
+    else
+      ippAddStrings(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
+		    IPP_TAG_KEYWORD, "printer-state-reasons",
+		    dest->num_reasons, NULL,
+		    (const char * const *)dest->reasons);
+
+    ippAddBoolean(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
+		  "printer-is-accepting-jobs", dest->accepting);
+  }
+
+  if (job)
+  {
+   /*
+    * Add job attributes...
+    */
+
+    ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
+		  "notify-job-id", job->id);
+    ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_ENUM,
+		  "job-state", job->state_value);
+
+    if ((attr = ippFindAttribute(job->attrs, "job-name",
+				 IPP_TAG_NAME)) != NULL)
+      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_NAME,
+		   "job-name", NULL, attr->values[0].string.text);
+
+    switch (job->state_value)
+    {
+      case IPP_JOB_PENDING :
+	  if (dest && dest->state == IPP_PRINTER_STOPPED)
+	    ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
+			 IPP_TAG_KEYWORD, "job-state-reasons", NULL,
+			 "printer-stopped");
+	  else
+	    ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
+			 IPP_TAG_KEYWORD, "job-state-reasons", NULL,
+			 "none");
+	  break;
+
+      case IPP_JOB_HELD :
+	  if (ippFindAttribute(job->attrs, "job-hold-until", IPP_TAG_KEYWORD) != NULL ||
+	      ippFindAttribute(job->attrs, "job-hold-until", IPP_TAG_NAME) != NULL)
+	    ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
+			 IPP_TAG_KEYWORD, "job-state-reasons", NULL,
+			 "job-hold-until-specified");
+	  else
+	    ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
+			 IPP_TAG_KEYWORD, "job-state-reasons", NULL,
+			 "job-incoming");
+	  break;
+
+      case IPP_JOB_PROCESSING :
+	  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
+		       IPP_TAG_KEYWORD, "job-state-reasons", NULL,
+		       "job-printing");
+	  break;
+
+      case IPP_JOB_STOPPED :
+	  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
+		       IPP_TAG_KEYWORD, "job-state-reasons", NULL,
+		       "job-stopped");
+	  break;
+
+      case IPP_JOB_CANCELED :
+	  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
+		       IPP_TAG_KEYWORD, "job-state-reasons", NULL,
+		       "job-canceled-by-user");
+	  break;
+
+      case IPP_JOB_ABORTED :
+	  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
+		       IPP_TAG_KEYWORD, "job-state-reasons", NULL,
+		       "aborted-by-system");
+	  break;
+
+      case IPP_JOB_COMPLETED :
+	  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
+		       IPP_TAG_KEYWORD, "job-state-reasons", NULL,
+		       "job-completed-successfully");
+	  break;
+    }
+
+    ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
+		  "job-impressions-completed",
+		  job->sheets ? job->sheets->values[0].integer : 0);
+  }
+
+  return (temp);
+}
+
+
 #ifdef HAVE_DBUS
 /*
  * 'cupsd_send_dbus()' - Send a DBUS notification...
@@ -1378,9 +1749,6 @@ cupsd_send_notification(
     cupsd_subscription_t *sub,		/* I - Subscription object */
     cupsd_event_t        *event)	/* I - Event to send */
 {
-  ipp_state_t	state;			/* IPP event state */
-
-
   cupsdLogMessage(CUPSD_LOG_DEBUG2,
                   "cupsd_send_notification(sub=%p(%d), event=%p(%s))",
                   sub, sub->id, event, cupsdEventName(event->event));
@@ -1428,6 +1796,7 @@ cupsd_send_notification(
   */
 
   cupsArrayAdd(sub->events, event);
+  event->refcount ++;
 
  /*
   * Deliver the event...
@@ -1445,13 +1814,7 @@ cupsd_send_notification(
       if (sub->pipe < 0)
 	break;
 
-      event->attrs->state = IPP_IDLE;
-
-      while ((state = ippWriteFile(sub->pipe, event->attrs)) != IPP_DATA)
-        if (state == IPP_ERROR)
-	  break;
-
-      if (state == IPP_ERROR)
+      if (cupsd_write_event(sub, event))
       {
         if (errno == EPIPE)
 	{
@@ -1614,6 +1977,54 @@ cupsd_start_notifier(
 }
 
 
+/*
+ * 'cupsd_unindex_subscription()' - Remove a subscription from the index.
+ */
+
+static void
+cupsd_unindex_subscription(
+    cupsd_subscription_t *sub)		/* I - Subscription object */
+{
+  int			b;		/* Current event bit number */
+  cupsd_subindex_t	*entry;		/* Index entry */
+
+
+  if (sub->job)
+    entry = cupsd_find_index(NULL, sub->job->id, 0);
+  else
+    entry = cupsd_find_index(sub->dest, 0, 0);
+
+  if (!entry)
+    return;
+
+  for (b = 0, entry->mask = 0; b < CUPSD_EVENT_BITS; b ++)
+  {
+    if (!entry->subs[b])
+      continue;
+
+    cupsArrayRemove(entry->subs[b], sub);
+
+    if (cupsArrayCount(entry->subs[b]) > 0)
+      entry->mask |= 1U << b;
+    else
+    {
+      cupsArrayDelete(entry->subs[b]);
+      entry->subs[b] = NULL;
+    }
+  }
+
+ /*
+  * Free the entry once the last subscription is gone...
+  */
+
+  if (!entry->mask)
+  {
+    cupsArrayRemove(sub_index, entry);
+    free(entry);
+  }
+}
+
+
 /*
  * 'cupsd_update_notifier()' - Read messages from notifiers.
  */
@@ -1621,19 +2032,220 @@ cupsd_start_notifier(
 void
 cupsd_update_notifier(void)
 {
-  char		message[1024];		/* Pointer to message text */
+  char		*message;		/* Pointer to message text */
   int		loglevel;		/* Log level for message */
 
 
-  while (cupsdStatBufUpdate(NotifierStatusBuffer, &loglevel,
-                            message, sizeof(message)))
+  while ((message = cupsdStatBufUpdate(NotifierStatusBuffer,
+                                       &loglevel)) != NULL)
   {
     if (loglevel == CUPSD_LOG_INFO)
       cupsdLogMessage(CUPSD_LOG_INFO, "%s", message);
 
-    if (!strchr(NotifierStatusBuffer->buffer, '\n'))
+    if (!cupsdStatBufHasLine(NotifierStatusBuffer))
+      break;
+  }
+}
+
+
+/*
+ * 'cupsd_write_buffer()' - Append encoded IPP data to a memory buffer.
+ */
+
+static ssize_t				/* O - Bytes written or -1 on error */
+cupsd_write_buffer(
+    cupsd_ippbuf_t *buf,		/* I - Buffer */
+    ipp_uchar_t    *data,		/* I - Data to write */
+    size_t         bytes)		/* I - Number of bytes */
+{
+  if (bytes > (buf->size - buf->length))
+    return (-1);
+
+  memcpy(buf->buffer + buf->length, data, bytes);
+  buf->length += bytes;
+
+  return ((ssize_t)bytes);
+}
+
+
+/*
+ * 'cupsd_write_event()' - Write an event to a subscription's notifier.
+ */
+
+static int				/* O - 0 on success, -1 on error */
+cupsd_write_event(
+    cupsd_subscription_t *sub,		/* I - Subscription object */
+    cupsd_event_t        *event)	/* I - Event to send */
+{
+  ipp_t			*header;	/* Per-subscription attributes */
+  ipp_uchar_t		buffer[1024];	/* Encoded message header */
+  cupsd_ippbuf_t	buf;		/* Encoding buffer */
+  ipp_state_t		state;		/* IPP write state */
+  const ipp_uchar_t	*ptr;		/* Pointer into data */
+  size_t		bytes;		/* Bytes left to write */
+  ssize_t		written;	/* Bytes written */
+  int			i;		/* Looping var */
+
+
+ /*
+  * Encode the per-subscription attributes, dropping the end-of-attributes
+  * tag so that the shared attributes continue the same group...
+  */
+
+  if (!cupsd_encode_event(event) || (header = ippNew()) == NULL)
+  {
+    errno = ENOMEM;
+    return (-1);
+  }
+
+  cupsdAddEventHeader(header, sub, sub->next_event_id);
+
+  buf.buffer = buffer;
+  buf.length = 0;
+  buf.size   = sizeof(buffer);
+
+  while ((state = ippWriteIO(&buf, (ipp_iocb_t)cupsd_write_buffer, 1, NULL,
+                             header)) != IPP_DATA)
+    if (state == IPP_ERROR)
       break;
+
+  ippDelete(header);
+
+  if (state == IPP_ERROR)
+  {
+    errno = EINVAL;
+    return (-1);
   }
+
+ /*
+  * Then write the header followed by the shared attributes (less their
+  * message header and group tag)...
+  */
+
+  for (i = 0; i < 2; i ++)
+  {
+    if (i == 0)
+    {
+      ptr   = buffer;
+      bytes = buf.length - 1;
+    }
+    else
+    {
+      ptr   = event->encoded + 9;
+      bytes = event->encoded_len - 9;
+    }
+
+    while (bytes > 0)
+    {
+      if ((written = write(sub->pipe, ptr, bytes)) < 0)
+      {
+        if (errno == EINTR)
+	  continue;
+
+	return (-1);
+      }
+
+      ptr   += written;
+      bytes -= (size_t)written;
+    }
+  }
+
+  return (0);
+}
+
+
+
+/*
+ * 'cupsd_write_subscription()' - Write a subscription to the .conf file.
+ */
+
+static void
+cupsd_write_subscription(
+    cups_file_t          *fp,		/* I - subscriptions.conf file */
+    cupsd_subscription_t *sub)		/* I - Subscription */
+{
+  int			i;		/* Looping var */
+  unsigned		mask;		/* Current event mask */
+  const char		*name;		/* Current event name */
+  int			hex;		/* Non-zero if we are writing hex data */
+
+
+  cupsFilePrintf(fp, "<Subscription %d>\n", sub->id);
+
+  if ((name = cupsdEventName((cupsd_eventmask_t)sub->mask)) != NULL)
+  {
+   /*
+    * Simple event list...
+    */
+
+    cupsFilePrintf(fp, "Events %s\n", name);
+  }
+  else
+  {
+   /*
+    * Complex event list...
+    */
+
+    cupsFilePuts(fp, "Events");
+
+    for (mask = 1; mask < CUPSD_EVENT_ALL; mask <<= 1)
+      if (sub->mask & mask)
+	cupsFilePrintf(fp, " %s", cupsdEventName((cupsd_eventmask_t)mask));
+
+    cupsFilePuts(fp, "\n");
+  }
+
+  if (sub->owner)
+    cupsFilePrintf(fp, "Owner %s\n", sub->owner);
+  if (sub->recipient)
+    cupsFilePrintf(fp, "Recipient %s\n", sub->recipient);
+  if (sub->job)
+    cupsFilePrintf(fp, "JobId %d\n", sub->job->id);
+  if (sub->dest)
+    cupsFilePrintf(fp, "PrinterName %s\n", sub->dest->name);
+
+  if (sub->user_data_len > 0)
+  {
+    cupsFilePuts(fp, "UserData ");
+
+    for (i = 0, hex = 0; i < sub->user_data_len; i ++)
+    {
+      if (sub->user_data[i] < ' ' ||
+	  sub->user_data[i] > 0x7f ||
+	  sub->user_data[i] == '<')
+      {
+	if (!hex)
+	{
+	  cupsFilePrintf(fp, "<%02X", sub->user_data[i]);
+	  hex = 1;
+	}
+	else
+	  cupsFilePrintf(fp, "%02X", sub->user_data[i]);
+      }
+      else
+      {
+	if (hex)
+	{
+	  cupsFilePrintf(fp, ">%c", sub->user_data[i]);
+	  hex = 0;
+	}
+	else
+	  cupsFilePutChar(fp, sub->user_data[i]);
+      }
+    }
+
+    if (hex)
+      cupsFilePuts(fp, ">\n");
+    else
+      cupsFilePutChar(fp, '\n');
+  }
+
+  cupsFilePrintf(fp, "LeaseDuration %d\n", sub->lease);
+  cupsFilePrintf(fp, "Interval %d\n", sub->interval);
+  cupsFilePrintf(fp, "ExpirationTime %ld\n", (long)sub->expire);
+  cupsFilePrintf(fp, "NextEventId %d\n", sub->next_event_id);
+
+  cupsFilePuts(fp, "</Subscription>\n");
 }
 
 
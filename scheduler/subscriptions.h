@@ -77,9 +77,12 @@ typedef struct cupsd_event_s		/**** Event structure ****/
 {
   cupsd_eventmask_t	event;		/* Event */
   time_t		time;		/* Time of event */
-  ipp_t			*attrs;		/* Notification message */
+  ipp_t			*attrs;		/* Notification message (shared part) */
   cupsd_printer_t	*dest;		/* Associated printer, if any */
   cupsd_job_t		*job;		/* Associated job, if any */
+  int			refcount;	/* Number of subscriptions using event */
+  ipp_uchar_t		*encoded;	/* Encoded attrs for notifiers */
+  size_t		encoded_len;	/* Length of encoded attrs */
 } cupsd_event_t; 
 
 typedef struct cupsd_subscription_s	/**** Subscription structure ****/
@@ -102,6 +105,7 @@ typedef struct cupsd_subscription_s	/**** Subscription structure ****/
   int			first_event_id,	/* First event-id in cache */
 			next_event_id;	/* Next event-id to use */
   cups_array_t		*events;	/* Cached events */
+  int			dirty;		/* Do we need to write the record? */
 } cupsd_subscription_t;
 
 
@@ -141,6 +145,8 @@ VAR cupsd_statbuf_t *NotifierStatusBuffer VALUE(NULL);
 
 extern void	cupsdAddEvent(cupsd_eventmask_t event, cupsd_printer_t *dest,
 		              cupsd_job_t *job, const char *text, ...);
+extern void	cupsdAddEventHeader(ipp_t *ipp, cupsd_subscription_t *sub,
+		                    int sequence);
 extern cupsd_subscription_t *
 		cupsdAddSubscription(unsigned mask, cupsd_printer_t *dest,
 		                     cupsd_job_t *job, const char *uri,
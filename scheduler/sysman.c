@@ -51,20 +51,35 @@
 void
 cupsdCleanDirty(void)
 {
-  if (DirtyFiles & CUPSD_DIRTY_PRINTERS)
+  int	what = DirtyFiles | DirtyRecords;
+					/* What files need to be saved? */
+  double start = cupsdGetStatTime();	/* Start time for statistics */
+
+
+  if (what & (CUPSD_DIRTY_PRINTERS | CUPSD_DIRTY_COMPACT))
+  {
     cupsdSaveAllPrinters();
+    DirtyWrites[0] ++;
+  }
 
-  if (DirtyFiles & CUPSD_DIRTY_CLASSES)
+  if (what & (CUPSD_DIRTY_CLASSES | CUPSD_DIRTY_COMPACT))
+  {
     cupsdSaveAllClasses();
+    DirtyWrites[1] ++;
+  }
 
   if (DirtyFiles & CUPSD_DIRTY_PRINTCAP)
+  {
     cupsdWritePrintcap();
+    DirtyWrites[2] ++;
+  }
 
   if (DirtyFiles & CUPSD_DIRTY_JOBS)
   {
     cupsd_job_t	*job;			/* Current job */
 
     cupsdSaveAllJobs();
+    DirtyWrites[3] ++;
 
     for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
          job;
@@ -73,13 +88,19 @@ cupsdCleanDirty(void)
         cupsdSaveJob(job);
   }
 
-  if (DirtyFiles & CUPSD_DIRTY_SUBSCRIPTIONS)
+  if (what & (CUPSD_DIRTY_SUBSCRIPTIONS | CUPSD_DIRTY_COMPACT))
+  {
     cupsdSaveAllSubscriptions();
+    DirtyWrites[4] ++;
+  }
 
   DirtyFiles     = CUPSD_DIRTY_NONE;
+  DirtyRecords   = CUPSD_DIRTY_NONE;
   DirtyCleanTime = 0;
 
   cupsdSetBusyState();
+
+  cupsdAddStat(&DirtyCleanStats, start);
 }
 
 
@@ -109,6 +130,31 @@ cupsdMarkDirty(int what)		/* I - What file(s) are dirty? */
 }
 
 
+/*
+ * 'cupsdMarkDirtyRecords()' - Mark config files as having changed records.
+ *
+ * Unlike cupsdMarkDirty(), only the printers, classes, or subscriptions
+ * with their "dirty" member set are written, by appending their records to
+ * the existing file.
+ */
+
+void
+cupsdMarkDirtyRecords(int what)		/* I - What file(s) have dirty records? */
+{
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdMarkDirtyRecords(%c%c%c)",
+		  (what & CUPSD_DIRTY_PRINTERS) ? 'P' : '-',
+		  (what & CUPSD_DIRTY_CLASSES) ? 'C' : '-',
+		  (what & CUPSD_DIRTY_SUBSCRIPTIONS) ? 'S' : '-');
+
+  DirtyRecords |= what;
+
+  if (!DirtyCleanTime)
+    DirtyCleanTime = time(NULL) + DirtyCleanInterval;
+
+  cupsdSetBusyState();
+}
+
+
 /*
  * 'cupsdSetBusyState()' - Let the system know when we are busy doing something.
  */
@@ -949,6 +995,8 @@ sysUpdate(void)
               job->cancel_time = time(NULL) + ippGetInteger(cancel_after, 0);
             else
               job->cancel_time = time(NULL) + MaxJobTime;
+
+            cupsdUpdateJobTimers(job);
           }
         }
       }
@@ -23,6 +23,7 @@
 #define CUPSD_DIRTY_PRINTCAP	4	/* printcap is dirty */
 #define CUPSD_DIRTY_JOBS	8	/* jobs.cache or "c" file(s) are dirty */
 #define CUPSD_DIRTY_SUBSCRIPTIONS 16	/* subscriptions.conf is dirty */
+#define CUPSD_DIRTY_COMPACT	32	/* Rewrite .conf files with appended records */
 
 
 /*
@@ -31,6 +32,8 @@
 
 VAR int			DirtyFiles	VALUE(CUPSD_DIRTY_NONE),
 					/* What files are dirty? */
+			DirtyRecords	VALUE(CUPSD_DIRTY_NONE),
+					/* What files have dirty records? */
 			DirtyCleanInterval VALUE(DEFAULT_KEEPALIVE);
 					/* How often do we write dirty files? */
 VAR time_t		DirtyCleanTime	VALUE(0);
@@ -54,6 +57,7 @@ VAR int			SysEventPipes[2] VALUE2(-1,-1);
 extern void	cupsdAllowSleep(void);
 extern void	cupsdCleanDirty(void);
 extern void	cupsdMarkDirty(int what);
+extern void	cupsdMarkDirtyRecords(int what);
 extern void	cupsdSetBusyState(void);
 extern void	cupsdStartSystemMonitor(void);
 extern void	cupsdStopSystemMonitor(void);
@@ -15,10 +15,12 @@
  * Contents:
  *
  *   main()            - Main entry for the test program.
+ *   add_files()       - Add the files in a directory to an array.
  *   add_ppd_filter()  - Add a printer filter from a PPD.
  *   add_ppd_filters() - Add all filters from a PPD.
  *   print_rules()     - Print the rules for a file type...
  *   type_dir()        - Show the MIME types for a given directory.
+ *   type_speed()      - Show how fast the files in a directory are typed.
  */
 
 /*
@@ -29,6 +31,7 @@
 #include <cups/dir.h>
 #include <cups/debug-private.h>
 #include <cups/ppd-private.h>
+#include <sys/time.h>
 #include "mime.h"
 
 
@@ -36,11 +39,13 @@
  * Local functions...
  */
 
+static void	add_files(cups_array_t *files, const char *dirname);
 static void	add_ppd_filter(mime_t *mime, mime_type_t *filtertype,
 		               const char *filter);
 static void	add_ppd_filters(mime_t *mime, ppd_file_t *ppd);
 static void	print_rules(mime_magic_t *rules);
 static void	type_dir(mime_t *mime, const char *dirname);
+static void	type_speed(mime_t *mime, const char *dirname);
 
 
 /*
@@ -53,6 +58,7 @@ main(int  argc,				/* I - Number of command-line args */
 {
   int		i;			/* Looping vars */
   const char	*filter_path;		/* Filter path */
+  const char	*speed_dir;		/* Directory for typing speed test */
   char		super[MIME_MAX_SUPER],	/* Super-type name */
 		type[MIME_MAX_TYPE];	/* Type name */
   int		compression;		/* Compression of file */
@@ -71,6 +77,7 @@ main(int  argc,				/* I - Number of command-line args */
   dst         = NULL;
   ppd         = NULL;
   filter_path = "../filter:" CUPS_SERVERBIN "/filter";
+  speed_dir   = NULL;
 
   srcinfo.st_size = 0;
 
@@ -94,6 +101,13 @@ main(int  argc,				/* I - Number of command-line args */
       if (i < argc)
         filter_path = argv[i];
     }
+    else if (!strcmp(argv[i], "-b"))
+    {
+      i ++;
+
+      if (i < argc)
+        speed_dir = argv[i];
+    }
     else if (!strcmp(argv[i], "-p"))
     {
       i ++;
@@ -177,7 +191,9 @@ main(int  argc,				/* I - Number of command-line args */
       add_ppd_filters(mime, ppd);
   }
 
-  if (!src)
+  if (speed_dir)
+    type_speed(mime, speed_dir);
+  else if (!src)
   {
     puts("MIME database types:");
     for (src = mimeFirstType(mime); src; src = mimeNextType(mime))
@@ -203,6 +219,39 @@ main(int  argc,				/* I - Number of command-line args */
 }
 
 
+/*
+ * 'add_files()' - Add the files in a directory to an array.
+ */
+
+static void
+add_files(cups_array_t *files,		/* I - Array of filenames */
+          const char   *dirname)	/* I - Directory */
+{
+  cups_dir_t	*dir;			/* Directory */
+  cups_dentry_t	*dent;			/* Directory entry */
+  char		filename[1024];		/* Filename */
+
+
+  if ((dir = cupsDirOpen(dirname)) == NULL)
+    return;
+
+  while ((dent = cupsDirRead(dir)) != NULL)
+  {
+    if (dent->filename[0] == '.')
+      continue;
+
+    snprintf(filename, sizeof(filename), "%s/%s", dirname, dent->filename);
+
+    if (S_ISDIR(dent->fileinfo.st_mode))
+      add_files(files, filename);
+    else if (S_ISREG(dent->fileinfo.st_mode))
+      cupsArrayAdd(files, strdup(filename));
+  }
+
+  cupsDirClose(dir);
+}
+
+
 /*
  * 'add_printer_filter()' - Add a printer filter from a PPD.
  */
@@ -526,6 +575,63 @@ type_dir(mime_t     *mime,		/* I - MIME database */
 }
 
 
+/*
+ * 'type_speed()' - Show how fast the files in a directory are typed.
+ */
+
+static void
+type_speed(mime_t     *mime,		/* I - MIME database */
+           const char *dirname)		/* I - Directory */
+{
+  cups_array_t	*files;			/* Files to type */
+  char		*filename;		/* Current file */
+  int		count,			/* Number of files typed */
+		compression;		/* Compressed file? */
+  struct timeval start,			/* Start time */
+		end;			/* End time */
+  double	secs;			/* Elapsed time */
+
+
+  files = cupsArrayNew(NULL, NULL);
+  add_files(files, dirname);
+
+  if (cupsArrayCount(files) == 0)
+  {
+    printf("%s: No files to type.\n", dirname);
+    cupsArrayDelete(files);
+    return;
+  }
+
+ /*
+  * Type all of the files over and over for at least 1 second...
+  */
+
+  gettimeofday(&start, NULL);
+
+  for (count = 0, secs = 0.0; secs < 1.0;)
+  {
+    for (filename = (char *)cupsArrayFirst(files);
+         filename;
+	 filename = (char *)cupsArrayNext(files), count ++)
+      mimeFileType(mime, filename, NULL, &compression);
+
+    gettimeofday(&end, NULL);
+
+    secs = end.tv_sec - start.tv_sec + 0.000001 * (end.tv_usec - start.tv_usec);
+  }
+
+  printf("Typed %d files from %s in %.3f seconds, %.0f types/sec.\n", count,
+         dirname, secs, count / secs);
+
+  for (filename = (char *)cupsArrayFirst(files);
+       filename;
+       filename = (char *)cupsArrayNext(files))
+    free(filename);
+
+  cupsArrayDelete(files);
+}
+
+
 /*
  * End of "$Id$".
  */
@@ -14,10 +14,11 @@
  *
  * Contents:
  *
- *   main()    - Send multiple IPP requests and report on the average response
- *               time.
- *   do_test() - Run a test on a specific host...
- *   usage()   - Show program usage...
+ *   main()      - Send multiple IPP requests and report on the average
+ *                 response time.
+ *   do_test()   - Run a test on a specific host...
+ *   usage()     - Show program usage...
+ *   wait_job()  - Wait for a job to reach the given state.
  */
 
 /*
@@ -39,7 +40,8 @@
 
 static int	do_test(const char *server, int port,
 		        http_encryption_t encryption, int requests,
-			const char *opstring, int verbose);
+			const char *opstring, int jobstart, int verbose);
+static ipp_jstate_t wait_job(http_t *http, int job_id, ipp_jstate_t state);
 static void	usage(void) __attribute__((noreturn));
 
 
@@ -66,6 +68,7 @@ main(int  argc,				/* I - Number of command-line arguments */
 		end;			/* End time */
   double	elapsed;		/* Elapsed time */
   int		verbose;		/* Verbosity */
+  int		jobstart;		/* Measure job start latency? */
   const char	*opstring;		/* Operation name */
 
 
@@ -79,6 +82,7 @@ main(int  argc,				/* I - Number of command-line arguments */
   port       = ippPort();
   encryption = HTTP_ENCRYPT_IF_REQUESTED;
   verbose    = 0;
+  jobstart   = 0;
   opstring   = NULL;
 
   for (i = 1; i < argc; i ++)
@@ -99,6 +103,10 @@ main(int  argc,				/* I - Number of command-line arguments */
 	      children = atoi(argv[i]);
 	      break;
 
+          case 'j' : /* Measure job start latency */
+	      jobstart = 1;
+	      break;
+
           case 'o' : /* Operation */
 	      i ++;
 	      if (i >= argc)
@@ -149,10 +157,11 @@ main(int  argc,				/* I - Number of command-line arguments */
   start = time(NULL);
 
   if (children < 1)
-    return (do_test(server, port, encryption, requests, opstring, verbose));
+    return (do_test(server, port, encryption, requests, opstring, jobstart,
+                    verbose));
   else if (children == 1)
     good_children = do_test(server, port, encryption, requests, opstring,
-                            verbose) ? 0 : 1;
+                            jobstart, verbose) ? 0 : 1;
   else
   {
     char	options[255],		/* Command-line options for child */
@@ -172,6 +181,9 @@ main(int  argc,				/* I - Number of command-line arguments */
     if (encryption == HTTP_ENCRYPT_REQUIRED)
       strlcat(options, "E", sizeof(options));
 
+    if (jobstart)
+      strlcat(options, "j", sizeof(options));
+
     if (verbose)
       strlcat(options, "v", sizeof(options));
 
@@ -254,16 +266,21 @@ do_test(const char        *server,	/* I - Server to use */
         http_encryption_t encryption,	/* I - Encryption to use */
 	int               requests,	/* I - Number of requests to send */
 	const char        *opstring,	/* I - Operation string */
+	int               jobstart,	/* I - Measure job start latency? */
 	int               verbose)	/* I - Verbose output? */
 {
   int		i;			/* Looping var */
   http_t	*http;			/* Connection to server */
-  ipp_t		*request;		/* IPP Request */
+  ipp_t		*request,		/* IPP Request */
+		*response;		/* IPP Response */
+  ipp_attribute_t *attr;		/* job-id attribute */
   struct timeval start,			/* Start time */
 		end;			/* End time */
   double	reqtime,		/* Time for this request */
 		elapsed;		/* Elapsed time */
   int		op;			/* Current operation */
+  int		jobs;			/* Number of jobs started */
+  double	latency;		/* Total job start latency */
   static ipp_op_t ops[5] =		/* Operations to test... */
 		{
 		  IPP_PRINT_JOB,
@@ -289,7 +306,7 @@ do_test(const char        *server,	/* I - Server to use */
   * Do multiple requests...
   */
 
-  for (elapsed = 0.0, i = 0; i < requests; i ++)
+  for (elapsed = 0.0, latency = 0.0, jobs = 0, i = 0; i < requests; i ++)
   {
    /*
     * Build a request which requires the following attributes:
@@ -300,7 +317,9 @@ do_test(const char        *server,	/* I - Server to use */
     * In addition, IPP_GET_JOBS needs a printer-uri attribute.
     */
 
-    if (opstring)
+    if (jobstart)
+      op = IPP_PRINT_JOB;
+    else if (opstring)
       op = ippOpValue(opstring);
     else
       op = ops[i % (sizeof(ops) / sizeof(ops[0]))];
@@ -326,8 +345,30 @@ do_test(const char        *server,	/* I - Server to use */
       case IPP_PRINT_JOB :
 	  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri",
                        NULL, "ipp://localhost/printers/test");
-	  ippDelete(cupsDoFileRequest(http, request, "/printers/test",
-	                              "../data/testprint.ps"));
+	  response = cupsDoFileRequest(http, request, "/printers/test",
+	                               "../test/testfile.ps");
+
+	  if (jobstart && response &&
+	      (attr = ippFindAttribute(response, "job-id",
+	                               IPP_TAG_INTEGER)) != NULL &&
+	      wait_job(http, attr->values[0].integer,
+	               IPP_JOB_PROCESSING) >= IPP_JOB_PROCESSING)
+	  {
+	   /*
+	    * Time from submission until the job has been started, then wait
+	    * for it to finish so the next job starts on an idle printer...
+	    */
+
+	    gettimeofday(&end, NULL);
+
+	    latency += (end.tv_sec - start.tv_sec) +
+	               0.000001 * (end.tv_usec - start.tv_usec);
+	    jobs ++;
+
+	    wait_job(http, attr->values[0].integer, IPP_JOB_CANCELED);
+	  }
+
+	  ippDelete(response);
           break;
     }
 
@@ -364,6 +405,10 @@ do_test(const char        *server,	/* I - Server to use */
   printf("testspeed(%d): %d requests in %.1fs (%.3fs/r, %.1fr/s)\n",
          (int)getpid(), i, elapsed, elapsed / i, i / elapsed);
 
+  if (jobs > 0)
+    printf("testspeed(%d): %d jobs started in %.6fs on average\n",
+           (int)getpid(), jobs, latency / jobs);
+
   return (0);
 }
 
@@ -375,12 +420,54 @@ do_test(const char        *server,	/* I - Server to use */
 static void
 usage(void)
 {
-  puts("Usage: testspeed [-c children] [-h] [-o operation] [-r requests] [-v] "
-       "[-E] hostname[:port]");
+  puts("Usage: testspeed [-c children] [-h] [-j] [-o operation] [-r requests] "
+       "[-v] [-E] hostname[:port]");
   exit(0);
 }
 
 
+/*
+ * 'wait_job()' - Wait for a job to reach the given state.
+ */
+
+static ipp_jstate_t			/* O - Last job state */
+wait_job(http_t       *http,		/* I - Connection to server */
+         int          job_id,		/* I - Job ID */
+         ipp_jstate_t state)		/* I - Minimum job state */
+{
+  ipp_t		*request,		/* IPP Request */
+		*response;		/* IPP Response */
+  ipp_attribute_t *attr;		/* job-state attribute */
+  ipp_jstate_t	jstate;			/* Current job state */
+  char		uri[1024];		/* Job URI */
+
+
+  snprintf(uri, sizeof(uri), "ipp://localhost/jobs/%d", job_id);
+
+  do
+  {
+    request = ippNewRequest(IPP_GET_JOB_ATTRIBUTES);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "job-uri", NULL,
+                 uri);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
+                 "requested-attributes", NULL, "job-state");
+
+    response = cupsDoRequest(http, request, "/");
+
+    if ((attr = ippFindAttribute(response, "job-state",
+                                 IPP_TAG_ENUM)) != NULL)
+      jstate = (ipp_jstate_t)attr->values[0].integer;
+    else
+      jstate = IPP_JOB_ABORTED;
+
+    ippDelete(response);
+  }
+  while (jstate < state && jstate != IPP_JOB_HELD);
+
+  return (jstate);
+}
+
+
 
 /*
  * End of "$Id$".
@@ -14,13 +14,18 @@
  *
  * Contents:
  *
- *   mimeAddType()        - Add a MIME type to a database.
- *   mimeAddTypeRule()    - Add a detection rule for a file type.
- *   mimeFileType()       - Determine the type of a file.
- *   mimeType()           - Lookup a file type.
- *   mime_compare_types() - Compare two MIME super/type names.
- *   mime_check_rules()   - Check each rule in a list.
- *   mime_patmatch()      - Pattern matching.
+ *   mimeAddType()          - Add a MIME type to a database.
+ *   mimeAddTypeRule()      - Add a detection rule for a file type.
+ *   _mimeDeleteFileIndex() - Free the compiled type detection rules.
+ *   mimeFileType()         - Determine the type of a file.
+ *   mimeType()             - Lookup a file type.
+ *   mime_compare_types()   - Compare two MIME super/type names.
+ *   mime_check_rules()     - Check each rule in a list.
+ *   mime_first_bytes()     - Compute the possible first bytes for a rule list.
+ *   mime_get_patterns()    - Get the filename patterns in a rule list.
+ *   mime_index_types()     - Compile the type detection rules.
+ *   mime_load_buffer()     - Load the file buffer for a rule.
+ *   mime_patmatch()        - Pattern matching.
  */
 
 /*
@@ -30,7 +35,14 @@
 #include <cups/string-private.h>
 #include <cups/debug-private.h>
 #include <locale.h>
-#include "mime.h"
+#include "mime-private.h"
+
+
+/*
+ * Local constants...
+ */
+
+#define MIME_NUM_BYTES	257		/* First byte values plus empty file */
 
 
 /*
@@ -45,6 +57,26 @@ typedef struct _mime_filebuf_s		/**** File buffer for MIME typing ****/
   unsigned char	buffer[MIME_MAX_BUFFER];/* Buffered data */
 } _mime_filebuf_t;
 
+typedef struct _mime_typeindex_s	/**** Compiled rules for a type ****/
+{
+  mime_type_t	*type;			/* File type */
+  int		num_patterns;		/* Number of filename patterns */
+  const char	**patterns;		/* Filename patterns */
+} _mime_typeindex_t;
+
+typedef struct _mime_fileindex_s	/**** Compiled type detection rules ****/
+{
+  unsigned	generation;		/* Generation of rules */
+  int		num_types;		/* Number of types */
+  _mime_typeindex_t *types;		/* Types in database order */
+  const char	**patterns;		/* Filename patterns for all types */
+  int		num_named,		/* Number of types with patterns */
+		*named,			/* Types with filename patterns */
+		first[MIME_NUM_BYTES + 1],
+					/* Candidates for each first byte */
+		*candidates;		/* Candidate types */
+} _mime_fileindex_t;
+
 
 /*
  * Local functions...
@@ -53,6 +85,10 @@ typedef struct _mime_filebuf_s		/**** File buffer for MIME typing ****/
 static int	mime_compare_types(mime_type_t *t0, mime_type_t *t1);
 static int	mime_check_rules(const char *filename, _mime_filebuf_t *fb,
 		                 mime_magic_t *rules);
+static void	mime_first_bytes(mime_magic_t *rules, unsigned char *bytes);
+static int	mime_get_patterns(mime_magic_t *rules, const char **patterns);
+static _mime_fileindex_t *mime_index_types(mime_t *mime);
+static void	mime_load_buffer(_mime_filebuf_t *fb, int offset, int length);
 static int	mime_patmatch(const char *s, const char *pat);
 
 
@@ -60,6 +96,8 @@ static int	mime_patmatch(const char *s, const char *pat);
  * Local globals...
  */
 
+static unsigned		mime_generation = 0;
+					/* Generation of type rules */
 #ifdef DEBUG
 static const char * const debug_ops[] =
 		{			/* Test names... */
@@ -143,6 +181,8 @@ mimeAddType(mime_t     *mime,		/* I - MIME database */
 
   cupsArrayAdd(mime->types, temp);
 
+  mime_generation ++;
+
   DEBUG_printf(("1mimeAddType: Returning %p (new).", temp));
   return (temp);
 }
@@ -179,6 +219,8 @@ mimeAddTypeRule(mime_type_t *mt,	/* I - Type to add to */
   if (!mt || !rule)
     return (-1);
 
+  mime_generation ++;
+
  /*
   * Find the last rule in the top-level of the rules tree.
   */
@@ -582,8 +624,35 @@ mimeAddTypeRule(mime_type_t *mt,	/* I - Type to add to */
 }
 
 
+/*
+ * '_mimeDeleteFileIndex()' - Free the compiled type detection rules.
+ */
+
+void
+_mimeDeleteFileIndex(mime_t *mime)	/* I - MIME database */
+{
+  _mime_fileindex_t	*findex;	/* Compiled rules */
+
+
+  if (!mime || (findex = mime->fileindex) == NULL)
+    return;
+
+  mime->fileindex = NULL;
+
+  free(findex->types);
+  free(findex->patterns);
+  free(findex->named);
+  free(findex->candidates);
+  free(findex);
+}
+
+
 /*
  * 'mimeFileType()' - Determine the type of a file.
+ *
+ * The first part of the file is read once and the type rules are compiled
+ * into a table of candidate types for each possible first byte, so only the
+ * types that can match the file (or its filename) are checked.
  */
 
 mime_type_t *				/* O - Type of file */
@@ -596,6 +665,13 @@ mimeFileType(mime_t     *mime,		/* I - MIME database */
   const char		*base;		/* Base filename of file */
   mime_type_t		*type,		/* File type */
 			*best;		/* Best match */
+  _mime_fileindex_t	*findex;	/* Compiled rules */
+  _mime_typeindex_t	*tindex;	/* Compiled rules for type */
+  int			i,		/* Looping var */
+			*cptr,		/* Current candidate type */
+			*cend,		/* End of candidate types */
+			*nptr,		/* Current type with patterns */
+			*nend;		/* End of types with patterns */
 
 
   DEBUG_printf(("mimeFileType(mime=%p, pathname=\"%s\", filename=\"%s\", "
@@ -623,8 +699,10 @@ mimeFileType(mime_t     *mime,		/* I - MIME database */
     return (NULL);
   }
 
-  fb.offset = -1;
-  fb.length = 0;
+  fb.offset = 0;
+  if ((fb.length = (int)cupsFileRead(fb.fp, (char *)fb.buffer,
+                                     sizeof(fb.buffer))) < 0)
+    fb.length = 0;
 
  /*
   * Figure out the base filename (without directory portion)...
@@ -646,14 +724,62 @@ mimeFileType(mime_t     *mime,		/* I - MIME database */
   * Then check it against all known types...
   */
 
-  for (type = (mime_type_t *)cupsArrayFirst(mime->types), best = NULL;
-       type;
-       type = (mime_type_t *)cupsArrayNext(mime->types))
-    if (mime_check_rules(base, &fb, type->rules))
+  best = NULL;
+
+  if ((findex = mime_index_types(mime)) != NULL)
+  {
+   /*
+    * Merge the candidates for the first byte with the types whose filename
+    * patterns match, both of which are in database order...
+    */
+
+    i    = fb.length > 0 ? fb.buffer[0] : MIME_NUM_BYTES - 1;
+    cptr = findex->candidates + findex->first[i];
+    cend = findex->candidates + findex->first[i + 1];
+    nptr = findex->named;
+    nend = findex->named + findex->num_named;
+
+    while (cptr < cend || nptr < nend)
     {
-      if (!best || type->priority > best->priority)
-        best = type;
+      if (cptr < cend && (nptr >= nend || *cptr <= *nptr))
+      {
+        if (nptr < nend && *nptr == *cptr)
+	  nptr ++;
+
+        tindex = findex->types + *cptr++;
+      }
+      else
+      {
+        tindex = findex->types + *nptr++;
+
+        for (i = 0; i < tindex->num_patterns; i ++)
+	  if (mime_patmatch(base, tindex->patterns[i]))
+	    break;
+
+        if (i >= tindex->num_patterns)
+	  continue;
+      }
+
+      type = tindex->type;
+
+      if (mime_check_rules(base, &fb, type->rules))
+      {
+	if (!best || type->priority > best->priority)
+	  best = type;
+      }
     }
+  }
+  else
+  {
+    for (type = (mime_type_t *)cupsArrayFirst(mime->types);
+	 type;
+	 type = (mime_type_t *)cupsArrayNext(mime->types))
+      if (mime_check_rules(base, &fb, type->rules))
+      {
+	if (!best || type->priority > best->priority)
+	  best = type;
+      }
+  }
 
  /*
   * Finally, close the file and return a match (if any)...
@@ -775,22 +901,7 @@ mime_check_rules(
 	  break;
 
       case MIME_MAGIC_ASCII :
-         /*
-	  * Load the buffer if necessary...
-	  */
-
-          if (fb->offset < 0 || rules->offset < fb->offset ||
-	      (rules->offset + rules->length) > (fb->offset + fb->length))
-	  {
-	   /*
-	    * Reload file buffer...
-	    */
-
-            cupsFileSeek(fb->fp, rules->offset);
-	    fb->length = cupsFileRead(fb->fp, (char *)fb->buffer,
-	                              sizeof(fb->buffer));
-	    fb->offset = rules->offset;
-	  }
+          mime_load_buffer(fb, rules->offset, rules->length);
 
          /*
 	  * Test for ASCII printable characters plus standard control chars.
@@ -801,6 +912,16 @@ mime_check_rules(
 	  else
 	    n = rules->length;
 
+	  if (rules->offset >= (fb->offset + fb->length))
+	  {
+	   /*
+	    * Nothing to test past the end of the file...
+	    */
+
+	    result = 0;
+	    break;
+	  }
+
           bufptr = fb->buffer + rules->offset - fb->offset;
 	  while (n > 0)
 	    if ((*bufptr >= 32 && *bufptr <= 126) ||
@@ -817,22 +938,7 @@ mime_check_rules(
 	  break;
 
       case MIME_MAGIC_PRINTABLE :
-         /*
-	  * Load the buffer if necessary...
-	  */
-
-          if (fb->offset < 0 || rules->offset < fb->offset ||
-	      (rules->offset + rules->length) > (fb->offset + fb->length))
-	  {
-	   /*
-	    * Reload file buffer...
-	    */
-
-            cupsFileSeek(fb->fp, rules->offset);
-	    fb->length = cupsFileRead(fb->fp, (char *)fb->buffer,
-	                              sizeof(fb->buffer));
-	    fb->offset = rules->offset;
-	  }
+          mime_load_buffer(fb, rules->offset, rules->length);
 
          /*
 	  * Test for 8-bit printable characters plus standard control chars.
@@ -843,6 +949,16 @@ mime_check_rules(
 	  else
 	    n = rules->length;
 
+	  if (rules->offset >= (fb->offset + fb->length))
+	  {
+	   /*
+	    * Nothing to test past the end of the file...
+	    */
+
+	    result = 0;
+	    break;
+	  }
+
           bufptr = fb->buffer + rules->offset - fb->offset;
 
 	  while (n > 0)
@@ -864,42 +980,24 @@ mime_check_rules(
           DEBUG_printf(("5mime_check_rules: regex(%d, \"%s\")", rules->offset,
 	                rules->value.stringv));
 
-         /*
-	  * Load the buffer if necessary...
-	  */
-
-          if (fb->offset < 0 || rules->offset < fb->offset ||
-	      (rules->offset + rules->length) > (fb->offset + fb->length))
-	  {
-	   /*
-	    * Reload file buffer...
-	    */
-
-            cupsFileSeek(fb->fp, rules->offset);
-	    fb->length = cupsFileRead(fb->fp, (char *)fb->buffer,
-	                              sizeof(fb->buffer));
-	    fb->offset = rules->offset;
-
-            DEBUG_printf(("5mime_check_rules: loaded %d byte fb->buffer at %d, starts "
-	                  "with \"%c%c%c%c\".",
-	                  fb->length, fb->offset, fb->buffer[0], fb->buffer[1],
-			  fb->buffer[2], fb->buffer[3]));
-	  }
+          mime_load_buffer(fb, rules->offset, rules->length);
 
          /*
 	  * Compare the buffer against the string.  If the file is too
 	  * short then don't compare - it can't match...
 	  */
 
-          if (fb->length > 0)
+          if ((n = fb->offset + fb->length - rules->offset) > 0)
           {
             char temp[MIME_MAX_BUFFER + 1];
 					/* Temporary buffer */
 
-            memcpy(temp, fb->buffer, fb->length);
-            temp[fb->length] = '\0';
+            memcpy(temp, fb->buffer + rules->offset - fb->offset, n);
+            temp[n] = '\0';
             result = !regexec(&(rules->value.rev), temp, 0, NULL, 0);
           }
+	  else
+	    result = 0;
 
           DEBUG_printf(("5mime_check_rules: result=%d", result));
 	  break;
@@ -908,27 +1006,7 @@ mime_check_rules(
           DEBUG_printf(("5mime_check_rules: string(%d, \"%s\")", rules->offset,
 	                rules->value.stringv));
 
-         /*
-	  * Load the buffer if necessary...
-	  */
-
-          if (fb->offset < 0 || rules->offset < fb->offset ||
-	      (rules->offset + rules->length) > (fb->offset + fb->length))
-	  {
-	   /*
-	    * Reload file buffer...
-	    */
-
-            cupsFileSeek(fb->fp, rules->offset);
-	    fb->length = cupsFileRead(fb->fp, (char *)fb->buffer,
-	                              sizeof(fb->buffer));
-	    fb->offset = rules->offset;
-
-            DEBUG_printf(("5mime_check_rules: loaded %d byte fb->buffer at %d, starts "
-	                  "with \"%c%c%c%c\".",
-	                  fb->length, fb->offset, fb->buffer[0], fb->buffer[1],
-			  fb->buffer[2], fb->buffer[3]));
-	  }
+          mime_load_buffer(fb, rules->offset, rules->length);
 
          /*
 	  * Compare the buffer against the string.  If the file is too
@@ -944,22 +1022,7 @@ mime_check_rules(
 	  break;
 
       case MIME_MAGIC_ISTRING :
-         /*
-	  * Load the buffer if necessary...
-	  */
-
-          if (fb->offset < 0 || rules->offset < fb->offset ||
-	      (rules->offset + rules->length) > (fb->offset + fb->length))
-	  {
-	   /*
-	    * Reload file buffer...
-	    */
-
-            cupsFileSeek(fb->fp, rules->offset);
-	    fb->length = cupsFileRead(fb->fp, (char *)fb->buffer,
-	                              sizeof(fb->buffer));
-	    fb->offset = rules->offset;
-	  }
+          mime_load_buffer(fb, rules->offset, rules->length);
 
          /*
 	  * Compare the buffer against the string.  If the file is too
@@ -975,28 +1038,14 @@ mime_check_rules(
 	  break;
 
       case MIME_MAGIC_CHAR :
-         /*
-	  * Load the buffer if necessary...
-	  */
-
-          if (fb->offset < 0 || rules->offset < fb->offset)
-	  {
-	   /*
-	    * Reload file buffer...
-	    */
-
-            cupsFileSeek(fb->fp, rules->offset);
-	    fb->length = cupsFileRead(fb->fp, (char *)fb->buffer,
-	                              sizeof(fb->buffer));
-	    fb->offset = rules->offset;
-	  }
+          mime_load_buffer(fb, rules->offset, 1);
 
 	 /*
 	  * Compare the character values; if the file is too short, it
 	  * can't match...
 	  */
 
-	  if (fb->length < 1)
+	  if ((rules->offset + 1) > (fb->offset + fb->length))
 	    result = 0;
 	  else
 	    result = (fb->buffer[rules->offset - fb->offset] ==
@@ -1004,29 +1053,14 @@ mime_check_rules(
 	  break;
 
       case MIME_MAGIC_SHORT :
-         /*
-	  * Load the buffer if necessary...
-	  */
-
-          if (fb->offset < 0 || rules->offset < fb->offset ||
-	      (rules->offset + 2) > (fb->offset + fb->length))
-	  {
-	   /*
-	    * Reload file buffer...
-	    */
-
-            cupsFileSeek(fb->fp, rules->offset);
-	    fb->length = cupsFileRead(fb->fp, (char *)fb->buffer,
-	                              sizeof(fb->buffer));
-	    fb->offset = rules->offset;
-	  }
+          mime_load_buffer(fb, rules->offset, 2);
 
 	 /*
 	  * Compare the short values; if the file is too short, it
 	  * can't match...
 	  */
 
-	  if (fb->length < 2)
+	  if ((rules->offset + 2) > (fb->offset + fb->length))
 	    result = 0;
 	  else
 	  {
@@ -1037,29 +1071,14 @@ mime_check_rules(
 	  break;
 
       case MIME_MAGIC_INT :
-         /*
-	  * Load the buffer if necessary...
-	  */
-
-          if (fb->offset < 0 || rules->offset < fb->offset ||
-	      (rules->offset + 4) > (fb->offset + fb->length))
-	  {
-	   /*
-	    * Reload file buffer...
-	    */
-
-            cupsFileSeek(fb->fp, rules->offset);
-	    fb->length = cupsFileRead(fb->fp, (char *)fb->buffer,
-	                              sizeof(fb->buffer));
-	    fb->offset = rules->offset;
-	  }
+          mime_load_buffer(fb, rules->offset, 4);
 
 	 /*
 	  * Compare the int values; if the file is too short, it
 	  * can't match...
 	  */
 
-	  if (fb->length < 4)
+	  if ((rules->offset + 4) > (fb->offset + fb->length))
 	    result = 0;
 	  else
 	  {
@@ -1081,40 +1100,27 @@ mime_check_rules(
 	  break;
 
       case MIME_MAGIC_CONTAINS :
-         /*
-	  * Load the buffer if necessary...
-	  */
-
-          if (fb->offset < 0 || rules->offset < fb->offset ||
-	      (rules->offset + rules->region) > (fb->offset + fb->length))
-	  {
-	   /*
-	    * Reload file buffer...
-	    */
-
-            cupsFileSeek(fb->fp, rules->offset);
-	    fb->length = cupsFileRead(fb->fp, (char *)fb->buffer,
-	                              sizeof(fb->buffer));
-	    fb->offset = rules->offset;
-	  }
+          mime_load_buffer(fb, rules->offset, rules->region);
 
          /*
 	  * Compare the buffer against the string.  If the file is too
 	  * short then don't compare - it can't match...
 	  */
 
-	  if ((rules->offset + rules->length) > (fb->offset + fb->length))
-	    result = 0;
-	  else
+          result = 0;
+	  n      = fb->offset + fb->length - rules->offset;
+
+	  if (rules->length <= n)
 	  {
-	    if (fb->length > rules->region)
+	    if (n > rules->region)
 	      region = rules->region - rules->length;
 	    else
-	      region = fb->length - rules->length;
+	      region = n - rules->length;
+
+            bufptr = fb->buffer + rules->offset - fb->offset;
 
 	    for (n = 0; n < region; n ++)
-	      if ((result = (memcmp(fb->buffer + rules->offset - fb->offset + n,
-	                            rules->value.stringv,
+	      if ((result = (memcmp(bufptr + n, rules->value.stringv,
 				    rules->length) == 0)) != 0)
 		break;
           }
@@ -1159,6 +1165,312 @@ mime_check_rules(
 }
 
 
+/*
+ * 'mime_first_bytes()' - Compute the possible first bytes for a rule list.
+ *
+ * The bytes array gets a non-zero value for each first byte (or
+ * MIME_NUM_BYTES - 1 for an empty file) that might satisfy the rules when no
+ * filename pattern matches.  Rules that can't be narrowed down allow any
+ * first byte.
+ */
+
+static void
+mime_first_bytes(mime_magic_t  *rules,	/* I - Rules to check */
+                 unsigned char *bytes)	/* O - Possible first bytes */
+{
+  int		i;			/* Looping var */
+  int		logic;			/* Logic to apply */
+  unsigned char	result[MIME_NUM_BYTES];	/* Bytes for current rule */
+
+
+  if (rules->parent == NULL)
+    logic = MIME_MAGIC_OR;
+  else
+    logic = rules->parent->op;
+
+  memset(bytes, logic == MIME_MAGIC_AND, MIME_NUM_BYTES);
+
+  for (; rules; rules = rules->next)
+  {
+    memset(result, 0, sizeof(result));
+
+    if (rules->invert)
+      memset(result, 1, sizeof(result));
+    else
+    {
+      switch (rules->op)
+      {
+	case MIME_MAGIC_MATCH :
+	   /*
+	    * Filename patterns are checked separately...
+	    */
+
+	    break;
+
+	case MIME_MAGIC_ASCII :
+	case MIME_MAGIC_PRINTABLE :
+	    if (rules->offset > 0 || rules->length <= 0)
+	    {
+	      memset(result, 1, sizeof(result));
+	      break;
+	    }
+
+	    for (i = 0; i < 256; i ++)
+	      result[i] = (i >= 32 && i <= 126) || (i >= 8 && i <= 13) ||
+	                  i == 26 || i == 27 ||
+			  (i >= 128 && rules->op == MIME_MAGIC_PRINTABLE);
+	    break;
+
+	case MIME_MAGIC_STRING :
+	case MIME_MAGIC_ISTRING :
+	    if (rules->offset > 0 || rules->length <= 0)
+	    {
+	      memset(result, 1, sizeof(result));
+	      break;
+	    }
+
+	    i         = rules->value.stringv[0] & 255;
+	    result[i] = 1;
+
+	    if (rules->op == MIME_MAGIC_ISTRING)
+	    {
+	      if (i >= 'a' && i <= 'z')
+		result[i - 'a' + 'A'] = 1;
+	      else if (i >= 'A' && i <= 'Z')
+		result[i - 'A' + 'a'] = 1;
+	    }
+	    break;
+
+	case MIME_MAGIC_CHAR :
+	    if (rules->offset > 0)
+	      memset(result, 1, sizeof(result));
+	    else
+	      result[rules->value.charv] = 1;
+	    break;
+
+	case MIME_MAGIC_SHORT :
+	    if (rules->offset > 0)
+	      memset(result, 1, sizeof(result));
+	    else
+	      result[(rules->value.shortv >> 8) & 255] = 1;
+	    break;
+
+	case MIME_MAGIC_INT :
+	    if (rules->offset > 0)
+	      memset(result, 1, sizeof(result));
+	    else
+	      result[(rules->value.intv >> 24) & 255] = 1;
+	    break;
+
+	case MIME_MAGIC_LOCALE :
+	case MIME_MAGIC_CONTAINS :
+	case MIME_MAGIC_REGEX :
+	    memset(result, 1, sizeof(result));
+	    break;
+
+	default :
+	    if (rules->child != NULL)
+	      mime_first_bytes(rules->child, result);
+	    break;
+      }
+    }
+
+    for (i = 0; i < MIME_NUM_BYTES; i ++)
+      if (logic == MIME_MAGIC_AND)
+        bytes[i] &= result[i];
+      else
+        bytes[i] |= result[i];
+  }
+}
+
+
+/*
+ * 'mime_get_patterns()' - Get the filename patterns in a rule list.
+ */
+
+static int				/* O - Number of patterns */
+mime_get_patterns(
+    mime_magic_t *rules,		/* I - Rules to check */
+    const char   **patterns)		/* O - Patterns or NULL to count */
+{
+  int	count;				/* Number of patterns */
+
+
+  for (count = 0; rules; rules = rules->next)
+  {
+    if (rules->op == MIME_MAGIC_MATCH)
+    {
+      if (patterns)
+        patterns[count] = rules->value.matchv;
+
+      count ++;
+    }
+    else if (rules->child)
+      count += mime_get_patterns(rules->child,
+                                 patterns ? patterns + count : NULL);
+  }
+
+  return (count);
+}
+
+
+/*
+ * 'mime_index_types()' - Compile the type detection rules.
+ *
+ * The compiled rules are cached in the MIME database until a type or rule is
+ * added or removed.
+ */
+
+static _mime_fileindex_t *		/* O - Compiled rules or NULL */
+mime_index_types(mime_t *mime)		/* I - MIME database */
+{
+  _mime_fileindex_t	*findex;	/* Compiled rules */
+  _mime_typeindex_t	*tindex;	/* Compiled rules for type */
+  mime_type_t		*type;		/* Current type */
+  const char		**patterns;	/* Current filename patterns */
+  unsigned char		*bytes;		/* Possible first bytes for each type */
+  int			i,		/* Looping var */
+			byte,		/* Current first byte */
+			num_types,	/* Number of types */
+			num_patterns,	/* Number of filename patterns */
+			num_candidates;	/* Number of candidate types */
+
+
+  if (mime->fileindex && mime->fileindex->generation == mime_generation)
+    return (mime->fileindex);
+
+  _mimeDeleteFileIndex(mime);
+
+  if ((num_types = cupsArrayCount(mime->types)) == 0)
+    return (NULL);
+
+  for (type = (mime_type_t *)cupsArrayFirst(mime->types), num_patterns = 0;
+       type;
+       type = (mime_type_t *)cupsArrayNext(mime->types))
+    num_patterns += mime_get_patterns(type->rules, NULL);
+
+  if ((findex = calloc(1, sizeof(_mime_fileindex_t))) == NULL)
+    return (NULL);
+
+  findex->types    = calloc((size_t)num_types, sizeof(_mime_typeindex_t));
+  findex->patterns = calloc((size_t)num_patterns + 1, sizeof(char *));
+  findex->named    = calloc((size_t)num_types, sizeof(int));
+  bytes            = calloc((size_t)num_types, MIME_NUM_BYTES);
+
+  if (!findex->types || !findex->patterns || !findex->named || !bytes)
+    goto error;
+
+ /*
+  * Compute the possible first bytes and filename patterns for each type...
+  */
+
+  for (type = (mime_type_t *)cupsArrayFirst(mime->types), i = 0,
+           patterns = findex->patterns;
+       type && i < num_types;
+       type = (mime_type_t *)cupsArrayNext(mime->types), i ++)
+  {
+    tindex               = findex->types + i;
+    tindex->type         = type;
+    tindex->patterns     = patterns;
+    tindex->num_patterns = mime_get_patterns(type->rules, patterns);
+    patterns             += tindex->num_patterns;
+
+    if (tindex->num_patterns > 0)
+      findex->named[findex->num_named ++] = i;
+
+    if (type->rules)
+      mime_first_bytes(type->rules, bytes + i * MIME_NUM_BYTES);
+  }
+
+  findex->num_types = num_types = i;
+
+ /*
+  * Then build the list of candidate types for each first byte...
+  */
+
+  for (byte = 0, num_candidates = 0; byte < MIME_NUM_BYTES; byte ++)
+    for (i = 0; i < num_types; i ++)
+      if (bytes[i * MIME_NUM_BYTES + byte])
+        num_candidates ++;
+
+  if ((findex->candidates = calloc((size_t)num_candidates + 1,
+                                   sizeof(int))) == NULL)
+    goto error;
+
+  for (byte = 0, num_candidates = 0; byte < MIME_NUM_BYTES; byte ++)
+  {
+    findex->first[byte] = num_candidates;
+
+    for (i = 0; i < num_types; i ++)
+      if (bytes[i * MIME_NUM_BYTES + byte])
+        findex->candidates[num_candidates ++] = i;
+  }
+
+  findex->first[MIME_NUM_BYTES] = num_candidates;
+  findex->generation            = mime_generation;
+
+  free(bytes);
+
+  DEBUG_printf(("4mime_index_types: %d types, %d patterns, %d candidates.",
+                num_types, num_patterns, num_candidates));
+
+  return (mime->fileindex = findex);
+
+ /*
+  * If we get here, we ran out of memory and will check all types...
+  */
+
+  error:
+
+  free(bytes);
+
+  mime->fileindex = findex;
+  _mimeDeleteFileIndex(mime);
+
+  return (NULL);
+}
+
+
+/*
+ * 'mime_load_buffer()' - Load the file buffer for a rule.
+ *
+ * Rules that fit in the first MIME_MAX_BUFFER bytes of the file use the
+ * buffer loaded by mimeFileType(), which holds the whole file when it is
+ * shorter than that.
+ */
+
+static void
+mime_load_buffer(_mime_filebuf_t *fb,	/* I - File buffer */
+                 int             offset,/* I - Offset of data */
+		 int             length)/* I - Length of data */
+{
+  if (offset >= fb->offset &&
+      (offset + length) <= (fb->offset + fb->length))
+    return;
+
+  if (fb->offset == 0 && fb->length < (int)sizeof(fb->buffer))
+    return;
+
+  if ((offset + length) <= (int)sizeof(fb->buffer))
+    offset = 0;
+
+  if (offset == fb->offset)
+    return;
+
+  cupsFileSeek(fb->fp, offset);
+
+  if ((fb->length = (int)cupsFileRead(fb->fp, (char *)fb->buffer,
+                                      sizeof(fb->buffer))) < 0)
+    fb->length = 0;
+
+  fb->offset = offset;
+
+  DEBUG_printf(("5mime_load_buffer: loaded %d byte fb->buffer at %d, starts "
+                "with \"%c%c%c%c\".", fb->length, fb->offset, fb->buffer[0],
+		fb->buffer[1], fb->buffer[2], fb->buffer[3]));
+}
+
+
 /*
  * 'mime_patmatch()' - Pattern matching.
  */
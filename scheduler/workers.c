@@ -0,0 +1,445 @@
+/*
+ * "$Id$"
+ *
+ *   Response worker threads for the CUPS scheduler.
+ *
+ *   Copyright 2013 by Apple Inc.
+ *
+ *   These coded instructions, statements, and computer programs are the
+ *   property of Apple Inc. and are protected by Federal copyright
+ *   law.  Distribution and use rights are outlined in the file "LICENSE.txt"
+ *   which should have been included with this file.  If this file is
+ *   file is missing or damaged, see the license at "http://www.cups.org/".
+ *
+ * Contents:
+ *
+ *   cupsdQueueResponse()   - Queue a response for encoding by a worker.
+ *   cupsdReleaseResponse() - Release the worker data for a response.
+ *   cupsdStartWorkers()    - Start the response worker threads.
+ *   cupsdStopWorkers()     - Stop the response worker threads.
+ *   finish_work()          - Finish a response that has been encoded.
+ *   free_work()            - Free response worker data.
+ *   has_shared()           - Determine whether a message shares collections.
+ *   run_worker()           - Encode responses in a worker thread.
+ *   write_cb()             - Append IPP data to an encoded response.
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "cupsd.h"
+
+
+/*
+ * Design Notes for Response Workers
+ * ---------------------------------
+ *
+ * The scheduler state (printers, jobs, arrays with their internal cursors,
+ * lazily built attribute indices) is only safe to use from the main loop, so
+ * IPP operations are still processed there.  What the workers take over is
+ * encoding large responses to read-only operations, which otherwise happens
+ * one attribute at a time in cupsdWriteClient() while every other client
+ * waits.
+ *
+ * A response is handed to a worker only when it does not share any collection
+ * values with scheduler data, since ippWriteIO() updates the state of each
+ * collection it writes.  Attribute names and values are otherwise only read.
+ *
+ * Work is passed to and from the workers as pointers written to pipes, so the
+ * main loop just selects on the "done" pipe.  A client that is closed while
+ * its response is being encoded gives up the response and the worker data is
+ * freed when the worker is done with it.
+ */
+
+
+/*
+ * Local globals...
+ */
+
+static int		NumWorkers = 0;	/* Number of worker threads */
+static int		WorkPipes[2] = { -1, -1 },
+					/* Pipes for queued work */
+			DonePipes[2] = { -1, -1 };
+					/* Pipes for finished work */
+
+
+/*
+ * Local functions...
+ */
+
+static void	finish_work(void *data);
+static void	free_work(cupsd_work_t *work);
+static int	has_shared(ipp_t *ipp);
+static void	*run_worker(void *arg);
+static ssize_t	write_cb(cupsd_work_t *work, ipp_uchar_t *buffer,
+		         size_t bytes);
+
+
+/*
+ * 'cupsdQueueResponse()' - Queue a response for encoding by a worker.
+ *
+ * Returns 1 if the response was queued and 0 if it should be written by the
+ * main loop as usual.
+ */
+
+int					/* O - 1 if queued, 0 otherwise */
+cupsdQueueResponse(cupsd_client_t *con)	/* I - Client connection */
+{
+  cupsd_work_t	*work;			/* Response worker data */
+  off_t		length;			/* Length of response */
+
+
+  if (!NumWorkers || !con->request || !con->response || con->file >= 0 ||
+      con->work)
+    return (0);
+
+ /*
+  * Only encode large responses to read-only operations...
+  */
+
+  switch (con->request->request.op.operation_id)
+  {
+    case IPP_OP_GET_JOBS :
+    case IPP_OP_GET_JOB_ATTRIBUTES :
+    case IPP_OP_GET_PRINTER_ATTRIBUTES :
+    case IPP_OP_CUPS_GET_PRINTERS :
+    case IPP_OP_CUPS_GET_CLASSES :
+        break;
+
+    default :
+        return (0);
+  }
+
+  if ((length = httpGetLength2(con->http)) < CUPSD_WORKER_MIN ||
+      has_shared(con->response))
+    return (0);
+
+  if ((work = calloc(1, sizeof(cupsd_work_t))) == NULL)
+    return (0);
+
+  if ((work->data = malloc((size_t)length)) == NULL)
+  {
+    free(work);
+    return (0);
+  }
+
+  work->con      = con;
+  work->response = con->response;
+  work->datasize = (size_t)length;
+  work->busy     = 1;
+
+  if (write(WorkPipes[1], &work, sizeof(work)) != sizeof(work))
+  {
+    free_work(work);
+    return (0);
+  }
+
+  cupsdLogClient(con, CUPSD_LOG_DEBUG,
+                 "Encoding " CUPS_LLFMT " byte response in worker thread.",
+		 CUPS_LLCAST length);
+
+  con->work = work;
+
+ /*
+  * Keep watching for the client to close the connection, but don't write
+  * anything until the worker is done...
+  */
+
+  cupsdAddSelect(httpGetFd(con->http), (cupsd_selfunc_t)cupsdReadClient, NULL,
+                 con);
+
+  return (1);
+}
+
+
+/*
+ * 'cupsdReleaseResponse()' - Release the worker data for a response.
+ *
+ * If the response is still being encoded, the worker data takes ownership of
+ * the response and is freed once the worker is done.
+ */
+
+void
+cupsdReleaseResponse(
+    cupsd_client_t *con)		/* I - Client connection */
+{
+  cupsd_work_t	*work;			/* Response worker data */
+
+
+  if ((work = con->work) == NULL)
+    return;
+
+  con->work = NULL;
+
+  if (work->busy)
+  {
+    work->con     = NULL;
+    con->response = NULL;
+  }
+  else
+  {
+    work->response = NULL;
+
+    free_work(work);
+  }
+}
+
+
+/*
+ * 'cupsdStartWorkers()' - Start the response worker threads.
+ */
+
+void
+cupsdStartWorkers(void)
+{
+  int	i,				/* Looping var */
+	count;				/* Number of workers to start */
+
+
+  if (NumWorkers > 0)
+    return;
+
+  if ((count = (int)sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+    count = 1;
+  else if (count > CUPSD_WORKER_MAX)
+    count = CUPSD_WORKER_MAX;
+
+  if (cupsdOpenPipe(WorkPipes))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to create pipes for response workers - %s",
+		    strerror(errno));
+    return;
+  }
+
+  if (cupsdOpenPipe(DonePipes))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to create pipes for response workers - %s",
+		    strerror(errno));
+    cupsdClosePipe(WorkPipes);
+    return;
+  }
+
+ /*
+  * Never block the main loop when queuing work; if the pipe is full the
+  * response is just written the usual way...
+  */
+
+  fcntl(WorkPipes[1], F_SETFL, fcntl(WorkPipes[1], F_GETFL) | O_NONBLOCK);
+
+  for (i = 0; i < count; i ++)
+    if (_cupsThreadCreate((_cups_thread_func_t)run_worker, NULL))
+      NumWorkers ++;
+    else
+      break;
+
+  if (!NumWorkers)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to start response workers.");
+    cupsdClosePipe(WorkPipes);
+    cupsdClosePipe(DonePipes);
+    return;
+  }
+
+  cupsdAddSelect(DonePipes[0], (cupsd_selfunc_t)finish_work, NULL, NULL);
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG, "Started %d response workers.",
+                  NumWorkers);
+}
+
+
+/*
+ * 'cupsdStopWorkers()' - Stop the response worker threads.
+ *
+ * All clients must be closed before calling this function.
+ */
+
+void
+cupsdStopWorkers(void)
+{
+  cupsd_work_t	*work;			/* Response worker data */
+  ssize_t	bytes;			/* Bytes read */
+
+
+  if (!NumWorkers)
+    return;
+
+  cupsdRemoveSelect(DonePipes[0]);
+
+ /*
+  * Closing the queue tells the workers to exit once they are done; each
+  * worker writes a NULL pointer to the done pipe before exiting...
+  */
+
+  close(WorkPipes[1]);
+  WorkPipes[1] = -1;
+
+  while (NumWorkers > 0)
+  {
+    if ((bytes = read(DonePipes[0], &work, sizeof(work))) < 0 &&
+        (errno == EINTR || errno == EAGAIN))
+      continue;
+    else if (bytes != sizeof(work))
+      break;
+
+    if (work)
+      free_work(work);
+    else
+      NumWorkers --;
+  }
+
+  cupsdClosePipe(WorkPipes);
+  cupsdClosePipe(DonePipes);
+
+  NumWorkers = 0;
+}
+
+
+/*
+ * 'finish_work()' - Finish a response that has been encoded.
+ */
+
+static void
+finish_work(void *data)			/* I - Callback data (unused) */
+{
+  cupsd_work_t		*work;		/* Response worker data */
+  cupsd_client_t	*con;		/* Client connection */
+
+
+  (void)data;
+
+  if (read(DonePipes[0], &work, sizeof(work)) != sizeof(work) || !work)
+    return;
+
+  work->busy = 0;
+
+  if ((con = work->con) == NULL)
+  {
+   /*
+    * Client went away while we were encoding...
+    */
+
+    free_work(work);
+    return;
+  }
+
+  if (work->error || work->datalen != work->datasize)
+  {
+    cupsdLogClient(con, CUPSD_LOG_ERROR,
+                   "Unable to encode IPP response in worker thread.");
+    cupsdCloseClient(con);
+    return;
+  }
+
+  cupsdAddSelect(httpGetFd(con->http), (cupsd_selfunc_t)cupsdReadClient,
+		 (cupsd_selfunc_t)cupsdWriteClient, con);
+}
+
+
+/*
+ * 'free_work()' - Free response worker data.
+ */
+
+static void
+free_work(cupsd_work_t *work)		/* I - Response worker data */
+{
+  ippDelete(work->response);
+  free(work->data);
+  free(work);
+}
+
+
+/*
+ * 'has_shared()' - Determine whether a message shares collections.
+ */
+
+static int				/* O - 1 if shared, 0 otherwise */
+has_shared(ipp_t *ipp)			/* I - IPP message */
+{
+  ipp_attribute_t	*attr;		/* Current attribute */
+  int			i;		/* Looping var */
+
+
+  for (attr = ipp->attrs; attr; attr = attr->next)
+  {
+    if ((attr->value_tag & IPP_TAG_CUPS_MASK) != IPP_TAG_BEGIN_COLLECTION)
+      continue;
+
+    for (i = 0; i < attr->num_values; i ++)
+      if (attr->values[i].collection->use > 1 ||
+          has_shared(attr->values[i].collection))
+        return (1);
+  }
+
+  return (0);
+}
+
+
+/*
+ * 'run_worker()' - Encode responses in a worker thread.
+ */
+
+static void *				/* O - Thread exit status (unused) */
+run_worker(void *arg)			/* I - Thread data (unused) */
+{
+  cupsd_work_t	*work;			/* Response worker data */
+#ifdef HAVE_PTHREAD_H
+  sigset_t	mask;			/* Signal mask */
+
+
+ /*
+  * Nobody joins the workers, and signals belong to the main loop...
+  */
+
+  pthread_detach(pthread_self());
+
+  sigfillset(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+#endif /* HAVE_PTHREAD_H */
+
+  (void)arg;
+
+  while (read(WorkPipes[0], &work, sizeof(work)) == sizeof(work))
+  {
+    work->response->state = IPP_STATE_IDLE;
+
+    if (ippWriteIO(work, (ipp_iocb_t)write_cb, 1, NULL, work->response) !=
+            IPP_STATE_DATA)
+      work->error = 1;
+
+    if (write(DonePipes[1], &work, sizeof(work)) != sizeof(work))
+      break;
+  }
+
+  work = NULL;
+
+  while (write(DonePipes[1], &work, sizeof(work)) < 0 && errno == EINTR);
+
+  return (NULL);
+}
+
+
+/*
+ * 'write_cb()' - Append IPP data to an encoded response.
+ */
+
+static ssize_t				/* O - Number of bytes written */
+write_cb(cupsd_work_t *work,		/* I - Response worker data */
+         ipp_uchar_t  *buffer,		/* I - Data to write */
+	 size_t       bytes)		/* I - Number of bytes */
+{
+  if (work->datalen + bytes > work->datasize)
+    return (-1);
+
+  memcpy(work->data + work->datalen, buffer, bytes);
+  work->datalen += bytes;
+
+  return ((ssize_t)bytes);
+}
+
+
+/*
+ * End of "$Id$".
+ */
@@ -0,0 +1,339 @@
+#!/bin/sh
+#
+# "$Id$"
+#
+#   Test the Location and Allow/Deny checks in the scheduler.
+#
+#   Usage:
+#
+#     cd test; ./auth-rules.sh
+#
+#   Clients on the loopback interface are always allowed, so a private
+#   scheduler is started on port 8632 (or $CUPS_TESTPORT) listening on the
+#   first non-loopback IPv4 and IPv6 addresses of this host, which can be
+#   overridden with $CUPS_TESTADDR4 and $CUPS_TESTADDR6.  The cupsd.conf file
+#   has overlapping locations and CIDR, dotted, and non-contiguous masks built
+#   from those addresses.  Each resource is then requested with HEAD and GET
+#   over both address families, and the HTTP status codes are compared with
+#   those returned by the linear search in CUPS 2.0b1 and earlier.
+#
+#   Copyright 2007-2014 by Apple Inc.
+#
+#   These coded instructions, statements, and computer programs are the
+#   property of Apple Inc. and are protected by Federal copyright
+#   law.  Distribution and use rights are outlined in the file "LICENSE.txt"
+#   which should have been included with this file.  If this file is
+#   file is missing or damaged, see the license at "http://www.cups.org/".
+#
+
+port=${CUPS_TESTPORT:-8632}
+
+cwd=`pwd`
+root=`dirname $cwd`
+user=`whoami`
+BASE=/tmp/cups-$user-rules
+
+if test ! -x $root/scheduler/cupsd -o ! -x $root/cups/testhttp; then
+	echo "Please run \"make\" and \"make unittests\" first."
+	exit 1
+fi
+
+#
+# Find the addresses to test with...
+#
+
+getaddr() {
+	(ip -o -$1 addr show scope global 2>/dev/null; ifconfig -a 2>/dev/null) | \
+	    awk '{for (i = 1; i < NF; i ++) if ($i == "'$2'") {
+	              a = $(i + 1); sub(/^addr:/, "", a); sub(/\/.*/, "", a);
+		      if (a !~ /^(127\.|::1$|fe80:)/ && a !~ /%/) {print a; exit}}}'
+}
+
+addr4=${CUPS_TESTADDR4:-`getaddr 4 inet`}
+addr6=${CUPS_TESTADDR6:-`getaddr 6 inet6`}
+
+if test "x$addr4" = x -a "x$addr6" = x; then
+	echo "SKIP: No non-loopback addresses to test with."
+	exit 0
+fi
+
+#
+# The IPv4 masks are built from the IPv4 address, or a documentation address
+# that is never used when there is none...
+#
+
+eval `echo ${addr4:-192.0.2.1} | awk -F. '{
+    printf "host4=%s ", $0;
+    printf "net4=%d.%d.%d.0 ", $1, $2, $3;
+    printf "other4=%d.0.0.0 ", ($1 == 10) ? 11 : 10;
+    printf "holes4=%d.0.%d.%d ", $1, $3, $4;
+    printf "miss4=%d.0.%d.%d\n", $1, $3, ($4 == 1) ? 2 : 1}'`
+
+host6=${addr6:-::1}
+
+#
+# Create the test directories...
+#
+
+rm -rf $BASE
+mkdir -p $BASE/bin $BASE/log $BASE/spool/temp $BASE/ssl
+mkdir -p $BASE/share/banners $BASE/share/mime
+chmod 700 $BASE/spool/temp
+ln -s $root/conf/mime.types $BASE/mime.types
+
+cat >$BASE/cups-files.conf <<EOF
+Printcap
+User $user
+ServerRoot $BASE
+StateDir $BASE
+ServerBin $BASE/bin
+CacheDir $BASE/share
+DataDir $BASE/share
+DocumentRoot $root/doc
+RequestRoot $BASE/spool
+TempDir $BASE/spool/temp
+ServerKeychain $BASE/ssl
+AccessLog /dev/null
+ErrorLog $BASE/log/error_log
+PageLog /dev/null
+EOF
+
+(
+	echo "Listen localhost:$port"
+	test "x$addr4" != x && echo "Listen $addr4:$port"
+	test "x$addr6" != x && echo "Listen [$addr6]:$port"
+) >$BASE/cupsd.conf
+
+cat >>$BASE/cupsd.conf <<EOF
+Browsing Off
+LogLevel warn
+
+<Location />
+Order Allow,Deny
+Allow all
+</Location>
+
+# Queue names are compared without case, other paths with case...
+<Location /printers/Deny>
+Order Allow,Deny
+</Location>
+<Location /classes/deny>
+Order Allow,Deny
+</Location>
+<Location /CaseSensitive>
+Order Allow,Deny
+</Location>
+<Location /nest>
+Order Allow,Deny
+</Location>
+<Location /nest/open>
+Order Allow,Deny
+Allow all
+</Location>
+
+# Locations with the same path and different limits...
+<Location /limit>
+Order Allow,Deny
+Allow all
+<Limit HEAD>
+Order Allow,Deny
+</Limit>
+</Location>
+<Location /limix>
+Order Allow,Deny
+<Limit GET>
+Order Allow,Deny
+Allow all
+</Limit>
+</Location>
+<Location /dup>
+<Limit GET>
+Order Allow,Deny
+</Limit>
+</Location>
+<Location /dup>
+<Limit HEAD>
+Order Allow,Deny
+Allow all
+</Limit>
+</Location>
+
+# CIDR masks, including /0, /32, and /128...
+<Location /v4all>
+Order Deny,Allow
+Deny 0.0.0.0/0
+</Location>
+<Location /v6all>
+Order Deny,Allow
+Deny [::]/0
+</Location>
+<Location /v6any>
+Order Allow,Deny
+Allow [::]/0
+</Location>
+<Location /v4host>
+Order Allow,Deny
+Allow $host4/32
+</Location>
+<Location /v4net>
+Order Allow,Deny
+Allow $net4/24
+</Location>
+<Location /v4deny>
+Order Allow,Deny
+Allow all
+Deny $host4
+</Location>
+<Location /v6host>
+Order Allow,Deny
+Allow [$host6]/128
+</Location>
+<Location /v6deny>
+Order Allow,Deny
+Allow all
+Deny [$host6]/128
+</Location>
+
+# Dotted IPv4 netmasks...
+<Location /dotted>
+Order Allow,Deny
+Allow $net4/255.255.255.0
+</Location>
+<Location /dotted-miss>
+Order Allow,Deny
+Allow $other4/255.0.0.0
+</Location>
+<Location /dotted-deny>
+Order Deny,Allow
+Deny $net4/255.255.255.0
+</Location>
+
+# Non-contiguous masks...
+<Location /holes>
+Order Allow,Deny
+Allow $holes4/255.0.255.255
+</Location>
+<Location /holes-miss>
+Order Allow,Deny
+Allow $miss4/255.0.255.255
+</Location>
+<Location /holes-deny>
+Order Deny,Allow
+Deny $holes4/255.0.255.255
+Allow $other4/8
+</Location>
+<Location /holes-mixed>
+Order Deny,Allow
+Deny $holes4/255.0.255.255
+Allow $host4
+Allow [$host6]
+</Location>
+EOF
+
+#
+# Start the scheduler...
+#
+
+if test "x$LD_LIBRARY_PATH" = x; then
+	LD_LIBRARY_PATH="$root/cups:$root/scheduler"
+else
+	LD_LIBRARY_PATH="$root/cups:$root/scheduler:$LD_LIBRARY_PATH"
+fi
+
+export LD_LIBRARY_PATH
+
+DYLD_LIBRARY_PATH="$LD_LIBRARY_PATH"
+export DYLD_LIBRARY_PATH
+
+$root/scheduler/cupsd -c $BASE/cupsd.conf -s $BASE/cups-files.conf -f &
+cupsd=$!
+
+i=0
+while test $i -lt 20; do
+	if $root/systemv/lpstat -h localhost:$port -r 2>/dev/null | grep -q "is running"; then
+		break
+	fi
+	sleep 1
+	i=`expr $i + 1`
+done
+
+if test $i = 20; then
+	echo "Unable to start cupsd, see $BASE/log/error_log."
+	kill $cupsd 2>/dev/null
+	exit 1
+fi
+
+#
+# Request each resource and compare the HEAD/GET status codes; "-" is used
+# for a missing address family...
+#
+
+request() {
+	if test "x$1" = x; then
+		echo "-"
+		return
+	fi
+
+	$root/cups/testhttp -o /dev/null "http://$1:$port$2" | \
+	    awk '/^(HEAD|GET) OK:$/ {printf "%s200", sep; sep = "/"}
+	         /^(HEAD|GET) failed/ {sub(/\.+$/, "", $5); printf "%s%s", sep, $5; sep = "/"}'
+}
+
+cat <<EOF | awk '{if ("'$addr4'" == "") $2 = "-"; if ("'$addr6'" == "") $3 = "-"; print}' >$BASE/expected
+/ 200/200 200/200
+/printers/Deny 403/403 403/403
+/printers/deny 403/403 403/403
+/printers/DENY 403/403 403/403
+/printers/deny.ppd 403/403 403/403
+/printers/denyx 403/403 403/403
+/printers/den 200/404 200/404
+/classes/DENY 403/403 403/403
+/classes/Deny/x 403/403 403/403
+/CaseSensitive 403/403 403/403
+/casesensitive 404/404 404/404
+/CaseSensitive/x 403/403 403/403
+/nest/x 403/403 403/403
+/nest/open 404/404 404/404
+/nest/openx 404/404 404/404
+/nest/OPEN 403/403 403/403
+/limit 404/404 404/404
+/limix 403/404 403/404
+/dup 404/404 404/404
+/v4all 403/403 404/404
+/v6all 403/403 403/403
+/v6any 404/404 404/404
+/v4host 404/404 403/403
+/v4net 404/404 403/403
+/v4deny 403/403 404/404
+/v6host 403/403 404/404
+/v6deny 404/404 403/403
+/dotted 404/404 403/403
+/dotted-miss 403/403 403/403
+/dotted-deny 403/403 404/404
+/holes 404/404 403/403
+/holes-miss 403/403 403/403
+/holes-deny 403/403 404/404
+/holes-mixed 404/404 404/404
+EOF
+
+for path in `awk '{print $1}' $BASE/expected`; do
+	echo "$path `request "$addr4" $path` `request "${addr6:+[$addr6]}" $path`"
+done >$BASE/actual
+
+kill $cupsd
+wait $cupsd 2>/dev/null
+
+if cmp -s $BASE/expected $BASE/actual; then
+	echo "PASS: `wc -l <$BASE/actual | tr -d ' '` locations checked."
+	rm -rf $BASE
+	exit 0
+else
+	echo "FAIL: Unexpected HTTP status (path IPv4 IPv6):"
+	diff $BASE/expected $BASE/actual
+	echo "See $BASE/log/error_log for details."
+	exit 1
+fi
+
+#
+# End of "$Id$".
+#
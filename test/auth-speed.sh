@@ -0,0 +1,169 @@
+#!/bin/sh
+#
+# "$Id$"
+#
+#   Measure the cost of Location and Allow/Deny checks in the scheduler.
+#
+#   Usage:
+#
+#     cd test; ./auth-speed.sh [locations [requests]]
+#
+#   A cupsd.conf with the given number of <Location /rule-N> blocks (1000 by
+#   default) is generated, and the "/" location gets the same number of Allow
+#   lines for networks that never match before the loopback addresses that
+#   do.  A private scheduler is started on port 8632 (or $CUPS_TESTPORT) and
+#   four testspeed children send the requests (100000 in total by default).
+#   The scheduler's CPU time is then reported in clock ticks when /proc is
+#   available.
+#
+#   To compare builds, run the script from each source tree.
+#
+#   Copyright 2007-2014 by Apple Inc.
+#
+#   These coded instructions, statements, and computer programs are the
+#   property of Apple Inc. and are protected by Federal copyright
+#   law.  Distribution and use rights are outlined in the file "LICENSE.txt"
+#   which should have been included with this file.  If this file is
+#   file is missing or damaged, see the license at "http://www.cups.org/".
+#
+
+locations=${1:-1000}
+requests=${2:-100000}
+port=${CUPS_TESTPORT:-8632}
+
+cwd=`pwd`
+root=`dirname $cwd`
+user=`whoami`
+BASE=/tmp/cups-$user-speed
+
+if test ! -x $root/scheduler/testspeed; then
+	echo "Please run \"make\" and \"make unittests\" first."
+	exit 1
+fi
+
+#
+# Create the test directories...
+#
+
+rm -rf $BASE
+mkdir -p $BASE/bin $BASE/log $BASE/spool/temp $BASE/ssl
+mkdir -p $BASE/share/banners $BASE/share/mime
+chmod 700 $BASE/spool/temp
+ln -s $root/conf/mime.types $BASE/mime.types
+
+cat >$BASE/cups-files.conf <<EOF
+Printcap
+User $user
+ServerRoot $BASE
+StateDir $BASE
+ServerBin $BASE/bin
+CacheDir $BASE/share
+DataDir $BASE/share
+DocumentRoot $root/doc
+RequestRoot $BASE/spool
+TempDir $BASE/spool/temp
+ServerKeychain $BASE/ssl
+AccessLog /dev/null
+ErrorLog $BASE/log/error_log
+PageLog /dev/null
+EOF
+
+#
+# Generate the locations and Allow lines...
+#
+
+echo "Generating $locations locations with $locations Allow lines..."
+
+cat >$BASE/cupsd.conf <<EOF
+Listen localhost:$port
+Browsing Off
+LogLevel warn
+MaxClients 100
+<Location />
+Order Allow,Deny
+EOF
+
+i=0
+while test $i -lt $locations; do
+	echo "Allow 10.`expr $i / 250`.`expr $i % 250`.0/24"
+	i=`expr $i + 1`
+done >>$BASE/cupsd.conf
+
+cat >>$BASE/cupsd.conf <<EOF
+Allow 127.0.0.1
+Allow ::1
+</Location>
+EOF
+
+i=0
+while test $i -lt $locations; do
+	cat <<EOF
+<Location /rule-$i>
+Order Allow,Deny
+Allow 172.16.`expr $i / 250`.`expr $i % 250`
+</Location>
+EOF
+	i=`expr $i + 1`
+done >>$BASE/cupsd.conf
+
+#
+# Start the scheduler...
+#
+
+if test "x$LD_LIBRARY_PATH" = x; then
+	LD_LIBRARY_PATH="$root/cups:$root/scheduler"
+else
+	LD_LIBRARY_PATH="$root/cups:$root/scheduler:$LD_LIBRARY_PATH"
+fi
+
+export LD_LIBRARY_PATH
+
+DYLD_LIBRARY_PATH="$LD_LIBRARY_PATH"
+export DYLD_LIBRARY_PATH
+
+$root/scheduler/cupsd -c $BASE/cupsd.conf -s $BASE/cups-files.conf -f &
+cupsd=$!
+
+i=0
+while test $i -lt 20; do
+	if $root/systemv/lpstat -h localhost:$port -r 2>/dev/null | grep -q "is running"; then
+		break
+	fi
+	sleep 1
+	i=`expr $i + 1`
+done
+
+if test $i = 20; then
+	echo "Unable to start cupsd, see $BASE/log/error_log."
+	kill $cupsd 2>/dev/null
+	exit 1
+fi
+
+#
+# Run testspeed and report the CPU time used by the scheduler...
+#
+
+cputime() {
+	if test -f /proc/$cupsd/stat; then
+		awk '{print $14 + $15}' /proc/$cupsd/stat
+	else
+		ps -o time= -p $cupsd
+	fi
+}
+
+before=`cputime`
+$root/scheduler/testspeed -c 4 -r `expr $requests / 4` localhost:$port | tail -1
+after=`cputime`
+
+if test -f /proc/$cupsd/stat; then
+	echo "Scheduler CPU time: `expr $after - $before` ticks"
+else
+	echo "Scheduler CPU time: $before to $after"
+fi
+
+kill $cupsd
+wait $cupsd 2>/dev/null
+
+#
+# End of "$Id$".
+#
@@ -0,0 +1,315 @@
+#!/bin/sh
+#
+# "$Id$"
+#
+#   Test the records appended to printers.conf and classes.conf by the
+#   scheduler.
+#
+#   Usage:
+#
+#     cd test; ./conf-records.sh
+#
+#   A private scheduler is started on port 8633 (or $CUPS_TESTPORT) and then
+#   killed and restarted to check that:
+#
+#     - only the last copy of a printer or class is loaded, and the file is
+#       rewritten without the older copies;
+#     - a changed printer is appended to printers.conf;
+#     - a truncated record at the end of the file is ignored;
+#     - the file is rewritten once it holds too many old copies.
+#
+#   Copyright 2007-2014 by Apple Inc.
+#
+#   These coded instructions, statements, and computer programs are the
+#   property of Apple Inc. and are protected by Federal copyright
+#   law.  Distribution and use rights are outlined in the file "LICENSE.txt"
+#   which should have been included with this file.  If this file is
+#   file is missing or damaged, see the license at "http://www.cups.org/".
+#
+
+port=${CUPS_TESTPORT:-8633}
+
+cwd=`pwd`
+root=`dirname $cwd`
+user=`whoami`
+BASE=/tmp/cups-$user-records
+
+if test ! -x $root/scheduler/cupsd -o ! -x $root/test/ipptool; then
+	echo "Please run \"make\" first."
+	exit 1
+fi
+
+#
+# Create the test directories...
+#
+
+rm -rf $BASE
+mkdir -p $BASE/bin $BASE/log $BASE/spool/temp $BASE/ssl $BASE/cache
+mkdir -p $BASE/share/banners $BASE/share/mime
+chmod 700 $BASE/spool/temp
+ln -s $root/conf/mime.types $BASE/mime.types
+
+cat >$BASE/cups-files.conf <<EOF
+Printcap
+User $user
+FileDevice Yes
+ServerRoot $BASE
+StateDir $BASE
+ServerBin $BASE/bin
+CacheDir $BASE/cache
+DataDir $BASE/share
+DocumentRoot $root/doc
+RequestRoot $BASE/spool
+TempDir $BASE/spool/temp
+ServerKeychain $BASE/ssl
+AccessLog /dev/null
+ErrorLog $BASE/log/error_log
+PageLog /dev/null
+EOF
+
+cat >$BASE/cupsd.conf <<EOF
+Listen localhost:$port
+Browsing Off
+LogLevel debug
+DirtyCleanInterval 0
+<Location />
+Order Allow,Deny
+Allow 127.0.0.1
+Allow ::1
+</Location>
+<Policy default>
+<Limit All>
+Order Deny,Allow
+</Limit>
+</Policy>
+EOF
+
+cat >$BASE/printers.conf <<EOF
+<Printer test>
+Info Old
+DeviceURI file:/dev/null
+State Stopped
+Accepting Yes
+</Printer>
+<Printer test>
+Info New
+DeviceURI file:/dev/null
+State Stopped
+Accepting Yes
+</Printer>
+EOF
+
+cat >$BASE/classes.conf <<EOF
+<Class group>
+Info Old
+Printer test
+State Stopped
+Accepting Yes
+</Class>
+<Class group>
+Info New
+Printer test
+State Stopped
+Accepting Yes
+</Class>
+EOF
+
+#
+# Set up the environment for the scheduler and commands...
+#
+
+if test "x$LD_LIBRARY_PATH" = x; then
+	LD_LIBRARY_PATH="$root/cups:$root/scheduler"
+else
+	LD_LIBRARY_PATH="$root/cups:$root/scheduler:$LD_LIBRARY_PATH"
+fi
+
+export LD_LIBRARY_PATH
+
+DYLD_LIBRARY_PATH="$LD_LIBRARY_PATH"
+export DYLD_LIBRARY_PATH
+
+CUPS_SERVER=localhost:$port
+export CUPS_SERVER
+
+CUPS_SERVERROOT=$BASE
+export CUPS_SERVERROOT
+
+printers=$BASE/printers.conf
+classes=$BASE/classes.conf
+status=0
+
+fail() {
+	echo "FAIL: $*"
+	status=1
+}
+
+start_cupsd() {
+	$root/scheduler/cupsd -c $BASE/cupsd.conf -s $BASE/cups-files.conf -f &
+	cupsd=$!
+
+	i=0
+	while test $i -lt 20; do
+		if $root/systemv/lpstat -r 2>/dev/null | grep -q "is running"; then
+			return
+		fi
+		sleep 1
+		i=`expr $i + 1`
+	done
+
+	echo "Unable to start cupsd, see $BASE/log/error_log."
+	kill $cupsd 2>/dev/null
+	exit 1
+}
+
+stop_cupsd() {
+	sleep 1
+	kill $1 $cupsd
+	wait $cupsd 2>/dev/null
+}
+
+lines() {
+	grep -c "$1" $BASE/log/error_log
+}
+
+records() {
+	grep -c "^<$1 $2>" $3
+}
+
+info() {
+	$root/systemv/lpstat -l -p $1 | awk '/Description:/ {print $2, $3}'
+}
+
+#
+# Load files holding two copies of the same printer and class...
+#
+
+echo "Loading duplicate records..."
+
+start_cupsd
+
+if test "`info test`" != "New "; then
+	fail "Printer description is \"`info test`\" instead of \"New\"."
+fi
+
+if test "`info group`" != "New "; then
+	fail "Class description is \"`info group`\" instead of \"New\"."
+fi
+
+if test `$root/systemv/lpstat -a | wc -l` != 2; then
+	fail "Expected 2 destinations, got \"`$root/systemv/lpstat -a`\"."
+fi
+
+if grep -q "^Info Old" $printers; then
+	fail "printers.conf not rewritten after loading duplicate printers."
+fi
+
+if grep -q "^Info Old" $classes; then
+	fail "classes.conf not rewritten after loading duplicate classes."
+fi
+
+#
+# Change the printer and restart without letting the scheduler rewrite the
+# file...
+#
+
+echo "Appending a changed printer..."
+
+sleep 1
+count=`records Printer test $printers`
+
+$root/systemv/lpadmin -p test -D "Appended"
+
+stop_cupsd -KILL
+
+if test `records Printer test $printers` != `expr $count + 1`; then
+	fail "Changed printer not appended to printers.conf."
+fi
+
+start_cupsd
+
+if test "`info test`" != "Appended "; then
+	fail "Printer description is \"`info test`\" instead of \"Appended\"."
+fi
+
+if grep -q "^Info New" $printers; then
+	fail "printers.conf not rewritten after loading an appended printer."
+fi
+
+#
+# Truncate the last record and restart...
+#
+
+echo "Ignoring a truncated record..."
+
+stop_cupsd -KILL
+
+cat >>$printers <<EOF
+<Printer test>
+Info Truncated
+DeviceURI file:/dev/null
+EOF
+
+start_cupsd
+
+if test "`info test`" != "Appended "; then
+	fail "Printer description is \"`info test`\" after a truncated record."
+fi
+
+if grep -q Truncated $printers; then
+	fail "Truncated record still in printers.conf."
+fi
+
+#
+# Change the printer enough times to force a rewrite...
+#
+
+echo "Compacting printers.conf..."
+
+before=`lines "Saving printers.conf"`
+most=0
+i=1
+
+while test $i -le 100; do
+	$root/systemv/lpadmin -p test -D "Info$i"
+
+	count=`records Printer test $printers`
+	if test $count -gt $most; then
+		most=$count
+	fi
+
+	i=`expr $i + 1`
+done
+
+sleep 1
+
+if test `lines "Saving printers.conf"` = $before; then
+	fail "printers.conf not rewritten after 100 changes."
+fi
+
+# The printer and class share a limit of 2 + 64 old copies...
+if test $most -gt 68; then
+	fail "printers.conf held $most copies of the printer."
+fi
+
+stop_cupsd -KILL
+start_cupsd
+
+if test "`info test`" != "Info100 "; then
+	fail "Printer description is \"`info test`\" instead of \"Info100\"."
+fi
+
+stop_cupsd
+
+if test $status = 0; then
+	echo "PASS: printers.conf and classes.conf record tests."
+	rm -rf $BASE
+else
+	echo "See $BASE/log/error_log for details."
+fi
+
+exit $status
+
+#
+# End of "$Id$".
+#
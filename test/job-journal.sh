@@ -0,0 +1,398 @@
+#!/bin/sh
+#
+# "$Id$"
+#
+#   Test the job.journal file used by the scheduler.
+#
+#   Usage:
+#
+#     cd test; ./job-journal.sh
+#
+#   A private scheduler is started on port 8633 (or $CUPS_TESTPORT) with a
+#   stopped printer so that jobs stay queued.  The scheduler is then killed
+#   and restarted to check that:
+#
+#     - the journal is replayed, including job deletions;
+#     - a torn record at the end of the journal is ignored and compacted away;
+#     - the journal is compacted once it holds too many stale records;
+#     - an existing job.cache file is migrated to a new journal.
+#
+#   Copyright 2007-2014 by Apple Inc.
+#
+#   These coded instructions, statements, and computer programs are the
+#   property of Apple Inc. and are protected by Federal copyright
+#   law.  Distribution and use rights are outlined in the file "LICENSE.txt"
+#   which should have been included with this file.  If this file is
+#   file is missing or damaged, see the license at "http://www.cups.org/".
+#
+
+port=${CUPS_TESTPORT:-8633}
+
+cwd=`pwd`
+root=`dirname $cwd`
+user=`whoami`
+BASE=/tmp/cups-$user-journal
+
+if test ! -x $root/scheduler/cupsd -o ! -x $root/test/ipptool; then
+	echo "Please run \"make\" first."
+	exit 1
+fi
+
+#
+# Create the test directories...
+#
+
+rm -rf $BASE
+mkdir -p $BASE/bin $BASE/log $BASE/spool/temp $BASE/ssl $BASE/cache
+mkdir -p $BASE/share/banners $BASE/share/mime
+chmod 700 $BASE/spool/temp
+ln -s $root/conf/mime.types $BASE/mime.types
+
+cat >$BASE/cups-files.conf <<EOF
+Printcap
+User $user
+FileDevice Yes
+ServerRoot $BASE
+StateDir $BASE
+ServerBin $BASE/bin
+CacheDir $BASE/cache
+DataDir $BASE/share
+DocumentRoot $root/doc
+RequestRoot $BASE/spool
+TempDir $BASE/spool/temp
+ServerKeychain $BASE/ssl
+AccessLog /dev/null
+ErrorLog $BASE/log/error_log
+PageLog /dev/null
+EOF
+
+cat >$BASE/cupsd.conf <<EOF
+Listen localhost:$port
+Browsing Off
+LogLevel debug
+DirtyCleanInterval 0
+<Location />
+Order Allow,Deny
+Allow 127.0.0.1
+Allow ::1
+</Location>
+<Policy default>
+<Limit All>
+Order Deny,Allow
+</Limit>
+</Policy>
+EOF
+
+cat >$BASE/printers.conf <<EOF
+<Printer test>
+DeviceURI file:/dev/null
+State Stopped
+StateMessage Holding jobs for the journal test.
+Accepting Yes
+</Printer>
+EOF
+
+#
+# Set up the environment for the scheduler and commands...
+#
+
+if test "x$LD_LIBRARY_PATH" = x; then
+	LD_LIBRARY_PATH="$root/cups:$root/scheduler"
+else
+	LD_LIBRARY_PATH="$root/cups:$root/scheduler:$LD_LIBRARY_PATH"
+fi
+
+export LD_LIBRARY_PATH
+
+DYLD_LIBRARY_PATH="$LD_LIBRARY_PATH"
+export DYLD_LIBRARY_PATH
+
+CUPS_SERVER=localhost:$port
+export CUPS_SERVER
+
+CUPS_SERVERROOT=$BASE
+export CUPS_SERVERROOT
+
+journal=$BASE/cache/job.journal
+status=0
+
+fail() {
+	echo "FAIL: $*"
+	status=1
+}
+
+start_cupsd() {
+	$root/scheduler/cupsd -c $BASE/cupsd.conf -s $BASE/cups-files.conf -f &
+	cupsd=$!
+
+	i=0
+	while test $i -lt 20; do
+		if $root/systemv/lpstat -r 2>/dev/null | grep -q "is running"; then
+			return
+		fi
+		sleep 1
+		i=`expr $i + 1`
+	done
+
+	echo "Unable to start cupsd, see $BASE/log/error_log."
+	kill $cupsd 2>/dev/null
+	exit 1
+}
+
+stop_cupsd() {
+	sleep 1
+	kill $1 $cupsd
+	wait $cupsd 2>/dev/null
+}
+
+lines() {
+	grep -c "$1" $BASE/log/error_log
+}
+
+submit() {
+	$root/systemv/lp -d test "$@" $root/test/testfile.txt | \
+	    awk '{print $4}' | sed -e '1,$s/^test-//'
+}
+
+queue() {
+	$root/systemv/lpstat -W not-completed -o test | awk '{printf "%s ", $1}'
+	printf "/"
+	$root/systemv/lpstat -W completed -o test | awk '{printf " %s", $1}'
+}
+
+#
+# Queue some jobs, then restart the scheduler without letting it rewrite the
+# journal...
+#
+
+echo "Replaying the journal..."
+
+start_cupsd
+
+job1=`submit`
+job2=`submit -H hold`
+job3=`submit`
+job4=`submit`
+job5=`submit -q 10`
+
+cat >$BASE/purge.test <<EOF
+{
+	NAME "Purge job $job4"
+	OPERATION Cancel-Job
+	GROUP operation-attributes-tag
+	ATTR charset attributes-charset utf-8
+	ATTR naturalLanguage attributes-natural-language en
+	ATTR uri printer-uri \$uri
+	ATTR integer job-id $job4
+	ATTR name requesting-user-name \$user
+	ATTR boolean purge-job true
+	STATUS successful-ok
+}
+EOF
+
+$root/systemv/cancel $job3
+
+if ! $root/test/ipptool ipp://localhost:$port/printers/test \
+    $BASE/purge.test >/dev/null; then
+	fail "Unable to purge job $job4."
+fi
+
+expected=`queue`
+echo "    Queue: $expected"
+
+stop_cupsd -KILL
+
+if test ! -s $journal; then
+	fail "No job.journal file."
+fi
+
+before=`lines "Loading from journal"`
+start_cupsd
+
+if test `lines "Loading from journal"` != `expr $before + 4`; then
+	fail "Expected 4 jobs from the journal."
+fi
+
+if test "`queue`" != "$expected"; then
+	fail "Queue is \"`queue`\" after restart."
+fi
+
+#
+# Tear the last record and restart...
+#
+
+echo "Recovering from a torn record..."
+
+$root/systemv/lp -i $job5 -q 20 >/dev/null
+
+stop_cupsd -KILL
+
+size=`wc -c <$journal`
+dd if=$journal of=$journal.N bs=1 count=`expr $size - 3` 2>/dev/null
+mv $journal.N $journal
+
+before=`lines "Saving job.journal"`
+start_cupsd
+
+if test `lines "Ignoring incomplete records"` != 1; then
+	fail "Torn record not detected."
+fi
+
+if test `lines "Saving job.journal"` = $before; then
+	fail "Journal not compacted after a torn record."
+fi
+
+if test "`queue`" != "$expected"; then
+	fail "Queue is \"`queue`\" after a torn record."
+fi
+
+stop_cupsd -KILL
+start_cupsd
+
+if test `lines "Ignoring incomplete records"` != 1; then
+	fail "Torn record still present after compaction."
+fi
+
+#
+# Change a job enough times to force a compaction...
+#
+
+echo "Compacting the journal..."
+
+cat >$BASE/priority.test <<EOF
+{
+	NAME "Set job-priority to 30"
+	OPERATION Set-Job-Attributes
+	GROUP operation-attributes-tag
+	ATTR charset attributes-charset utf-8
+	ATTR naturalLanguage attributes-natural-language en
+	ATTR uri printer-uri \$uri
+	ATTR integer job-id $job1
+	ATTR name requesting-user-name \$user
+	GROUP job-attributes-tag
+	ATTR integer job-priority 30
+	STATUS successful-ok
+}
+{
+	NAME "Set job-priority to 40"
+	OPERATION Set-Job-Attributes
+	GROUP operation-attributes-tag
+	ATTR charset attributes-charset utf-8
+	ATTR naturalLanguage attributes-natural-language en
+	ATTR uri printer-uri \$uri
+	ATTR integer job-id $job1
+	ATTR name requesting-user-name \$user
+	GROUP job-attributes-tag
+	ATTR integer job-priority 40
+	STATUS successful-ok
+}
+EOF
+
+size=`wc -c <$journal`
+before=`lines "Saving job.journal"`
+
+if ! $root/test/ipptool -i 0.001 -n 600 ipp://localhost:$port/printers/test \
+    $BASE/priority.test >/dev/null; then
+	fail "Unable to change job-priority."
+fi
+
+sleep 1
+
+if test `lines "Saving job.journal"` = $before; then
+	fail "Journal not compacted after 1200 changes."
+fi
+
+if test `wc -c <$journal` -gt `expr $size + 40000`; then
+	fail "Journal is `wc -c <$journal` bytes after compaction."
+fi
+
+stop_cupsd -KILL
+start_cupsd
+
+if test "`queue`" != "$expected"; then
+	fail "Queue is \"`queue`\" after compaction."
+fi
+
+#
+# Replace the journal with a job.cache file from an older scheduler...
+#
+
+echo "Migrating job.cache..."
+
+stop_cupsd
+
+rm -f $journal
+cat >$BASE/cache/job.cache <<EOF
+# Job cache file for CUPS v2.0b1
+NextJobId 100
+<Job $job1>
+State 3
+Priority 40
+Username $user
+Destination test
+DestType 0
+NumFiles 1
+File 1 text/plain 0
+</Job>
+<Job $job2>
+State 4
+HoldUntil 0
+Priority 50
+Username $user
+Destination test
+DestType 0
+NumFiles 1
+File 1 text/plain 0
+</Job>
+<Job $job3>
+State 7
+Priority 50
+Username $user
+Destination test
+DestType 0
+NumFiles 0
+</Job>
+<Job $job5>
+State 3
+Priority 20
+Username $user
+Destination test
+DestType 0
+NumFiles 1
+File 1 text/plain 0
+</Job>
+EOF
+
+start_cupsd
+
+if test `lines "Loading job cache file"` != 1; then
+	fail "job.cache not loaded."
+fi
+
+if test -f $BASE/cache/job.cache -o ! -s $journal; then
+	fail "job.cache not replaced by job.journal."
+fi
+
+if test "`queue`" != "$expected"; then
+	fail "Queue is \"`queue`\" after migration."
+fi
+
+job6=`submit`
+if test "x$job6" != x100; then
+	fail "NextJobId from job.cache not used (got job $job6)."
+fi
+
+stop_cupsd
+
+if test $status = 0; then
+	echo "PASS: job.journal tests."
+	rm -rf $BASE
+else
+	echo "See $BASE/log/error_log for details."
+fi
+
+exit $status
+
+#
+# End of "$Id$".
+#
@@ -0,0 +1,326 @@
+#!/bin/sh
+#
+# "$Id$"
+#
+#   Test the ppds.dat file used by cups-driverd.
+#
+#   Usage:
+#
+#     cd test; ./ppds-dat.sh
+#
+#   A private data directory with PPD files and a driver information file is
+#   listed with cups-driverd to check that:
+#
+#     - ppds.dat is written and then loaded without rescanning any file, so
+#       every PPD was found through the name order records;
+#     - PPDs looked up by make, make-and-model, product, device ID, language,
+#       and scheme are listed in the same order as CUPS 2.0b1 and earlier;
+#     - changed, added, and removed files update ppds.dat;
+#     - empty, short, truncated, and foreign-version files are rejected and
+#       rebuilt.
+#
+#   Copyright 2007-2014 by Apple Inc.
+#
+#   These coded instructions, statements, and computer programs are the
+#   property of Apple Inc. and are protected by Federal copyright
+#   law.  Distribution and use rights are outlined in the file "LICENSE.txt"
+#   which should have been included with this file.  If this file is
+#   file is missing or damaged, see the license at "http://www.cups.org/".
+#
+
+cwd=`pwd`
+root=`dirname $cwd`
+user=`whoami`
+BASE=/tmp/cups-$user-ppds
+
+if test ! -x $root/scheduler/cups-driverd; then
+	echo "Please run \"make\" first."
+	exit 1
+fi
+
+#
+# Create the test directories...
+#
+
+rm -rf $BASE
+mkdir -p $BASE/bin/driver $BASE/cache $BASE/share/model/acme
+mkdir -p $BASE/share/model/other
+
+ppd() {
+	file=$1
+	make=$2
+	nickname=$3
+	language=$4
+	device_id=$5
+	shift 5
+
+	(
+		echo "*PPD-Adobe: \"4.3\""
+		echo "*Manufacturer: \"$make\""
+		echo "*ModelName: \"$nickname\""
+		echo "*NickName: \"$nickname\""
+		echo "*LanguageVersion: $language"
+		echo "*PSVersion: \"(3010.000) 0\""
+		test "x$device_id" != x && echo "*1284DeviceID: \"$device_id\""
+		for product in "$@"; do
+			echo "*Product: \"($product)\""
+		done
+	) >$BASE/share/model/$file
+}
+
+drv() {
+	(
+		echo "#media \"Letter/US Letter\" 612 792"
+		echo "Manufacturer \"Acme\""
+		echo "Version 1.0"
+		echo "*MediaSize Letter"
+		echo "Attribute \"Product\" \"\" \"(Jet)\""
+		for model in "$@"; do
+			echo "{"
+			echo "  ModelName \"Jet $model\""
+			echo "  PCFileName \"j$model.ppd\""
+			echo "  Attribute \"1284DeviceID\" \"\" \"MFG:Acme;MDL:Jet $model;\""
+			echo "}"
+		done
+	) >$BASE/share/model/acme/jets.drv
+}
+
+# Makes that differ only in case, numbered models, the same model in several
+# languages, and duplicate models in different files...
+ppd acme/ij2.ppd Acme "Acme InkJet 2" Spanish "MFG:Acme;MDL:InkJet 2;" \
+    "InkJet 2"
+ppd acme/l9.ppd acme "Acme Laser 9" English "MFG:ACME;MDL:Laser 9;" "Laser 9"
+ppd acme/l10.ppd Acme "Acme Laser 10" English \
+    "MFG:Acme;MDL:Laser 10;CMD:PCL,PJL;" "Laser 10" "Laser 10N"
+ppd acme/l10-fr.ppd Acme "Acme Laser 10" French \
+    "MFG:Acme;MDL:Laser 10;CMD:PCL,PJL;" "Laser 10"
+ppd acme/l10-de.ppd ACME "Acme Laser 10" German "MFG:Acme;MDL:Laser 10;" \
+    "Laser 10"
+ppd acme/l100.ppd Acme "Acme Laser 100" English \
+    "MFG:Acme;MDL:Laser 100;CMD:POSTSCRIPT;" "Laser 100"
+ppd acme/l100b.ppd Acme "Acme Laser 100" English \
+    "MFG:Acme;MDL:Laser 100;CMD:POSTSCRIPT;" "Laser 100"
+ppd acme/l1000.ppd Acme "Acme Laser 1000 Series" English "" "Laser 1000" \
+    "Laser 1000dn"
+ppd alpha.ppd Alpha "Alpha Mono" Japanese "MFG:Alpha;MDL:Mono;" "Mono"
+ppd other/beta.ppd "Beta Corp" "Beta Corp Laser 10" English \
+    "MFG:Beta;MDL:Laser 10;" "Laser 10"
+ppd other/zeta.ppd Zeta "Zeta Color 5" English "MFG:Zeta;MDL:Color 5;" \
+    "Color 5"
+drv 3 20
+
+#
+# Set up the environment for cups-driverd...
+#
+
+if test "x$LD_LIBRARY_PATH" = x; then
+	LD_LIBRARY_PATH="$root/cups:$root/ppdc"
+else
+	LD_LIBRARY_PATH="$root/cups:$root/ppdc:$LD_LIBRARY_PATH"
+fi
+
+export LD_LIBRARY_PATH
+
+DYLD_LIBRARY_PATH="$LD_LIBRARY_PATH"
+export DYLD_LIBRARY_PATH
+
+CUPS_CACHEDIR=$BASE/cache
+export CUPS_CACHEDIR
+
+CUPS_DATADIR=$BASE/share
+export CUPS_DATADIR
+
+CUPS_SERVERBIN=$BASE/bin
+export CUPS_SERVERBIN
+
+ppds=$BASE/cache/ppds.dat
+status=0
+
+fail() {
+	echo "FAIL: $*"
+	status=1
+}
+
+#
+# Each query is a limit and the options for the list command, followed by the
+# PPD names that are expected in order without the directory and extension...
+#
+
+cat >$BASE/expected1 <<EOF
+0 | ij2 j3 j20 l9 l10-de l10 l10-fr l100 l100b l1000 alpha beta raw zeta
+4 | ij2 j3 j20 l9
+0 ppd-make=ACME | ij2 j3 j20 l9 l10-de l10 l10-fr l100 l100b l1000
+0 ppd-make-and-model='Acme Laser 10' | l10-de l10 l10-fr l100 l100b l1000
+0 ppd-make-and-model='Laser 10' | l10-de l10 l10-fr l100 l100b l1000 beta
+0 ppd-product='Laser 10' | l10-de l10 l10-fr beta l100 l100b l1000
+0 ppd-product='laser 1000DN' | l1000
+0 ppd-device-id='MFG:Acme;MDL:Laser 10;CMD:PCL;' | l10-de l10 l10-fr l100 l100b
+0 ppd-device-id='MFG:acme;MDL:jet 3;' | j3
+0 ppd-natural-language=fr ppd-make=Acme | l10-fr ij2 j3 j20 l9 l10-de l10 l100 l100b l1000
+0 exclude-schemes=drv | ij2 l9 l10-de l10 l10-fr l100 l100b l1000 alpha beta raw zeta
+1 include-schemes=drv | j3
+EOF
+
+cat >$BASE/expected2 <<EOF
+0 | ij2 j3 j20 j100 l9 l10-de l10 l10-fr l11 l100 l100b l1000 alpha beta raw
+4 | ij2 j3 j20 j100
+0 ppd-make=ACME | ij2 j3 j20 j100 l9 l10-de l10 l10-fr l11 l100 l100b l1000
+0 ppd-make-and-model='Acme Laser 10' | l10-de l10 l10-fr l100 l100b l1000
+0 ppd-make-and-model='Laser 10' | l10-de l10 l10-fr l100 l100b l1000 beta
+0 ppd-product='Laser 10' | l10-de l10 l10-fr beta l100 l100b l1000
+0 ppd-product='laser 1000DN' | l1000
+0 ppd-device-id='MFG:Acme;MDL:Laser 10;CMD:PCL;' | l10-de l10 l10-fr l100 l100b
+0 ppd-device-id='MFG:acme;MDL:jet 3;' | j3
+0 ppd-natural-language=fr ppd-make=Acme | l10-fr ij2 j3 j20 j100 l9 l10-de l10 l11 l100 l100b l1000
+0 exclude-schemes=drv | ij2 l9 l10-de l10 l10-fr l11 l100 l100b l1000 alpha beta raw
+1 include-schemes=drv | j3
+EOF
+
+#
+# Run each query and compare the results...
+#
+
+query() {
+	sed -e '1,$s/ |.*//' $BASE/$1 | while read limit options; do
+		printf "%s | " "$limit${options:+ $options}"
+		$root/scheduler/cups-driverd list 0 $limit "$options" 2>/dev/null | \
+		    sed -e '1,$s/ (.*//' -e '1,$s/.*\///' -e '1,$s/\.ppd$//' | \
+		    awk '{printf "%s%s", sep, $0; sep = " "}'
+		echo ""
+	done >$BASE/actual
+
+	if ! cmp -s $BASE/$1 $BASE/actual; then
+		fail "Unexpected PPDs $2 (-expected +actual):"
+		diff $BASE/$1 $BASE/actual | sed -n -e '1,$s/^</-/p' -e '1,$s/^>/+/p'
+	fi
+}
+
+#
+# Scan the PPD files, recording whether ppds.dat was read and written...
+#
+
+scan() {
+	$root/scheduler/cups-driverd list 0 1 "" 2>$BASE/log >/dev/null
+
+	nread=`grep "Read \"$ppds\"" $BASE/log | awk '{print $5}'`
+	nwrote=`grep "Wrote \"$ppds\"" $BASE/log | awk '{print $5}'`
+}
+
+echo "Creating ppds.dat..."
+
+scan
+
+if test "x$nread" != x; then
+	fail "Read a ppds.dat file that does not exist."
+fi
+
+if test "x$nwrote" = x -o ! -s $ppds; then
+	fail "No ppds.dat file written."
+fi
+
+count=$nwrote
+
+scan
+
+if test "x$nread" != "x$count"; then
+	fail "Read \"$nread\" PPDs from ppds.dat, expected \"$count\"."
+fi
+
+if test "x$nwrote" != x; then
+	fail "Rewrote ppds.dat with no changes."
+fi
+
+query expected1 "from ppds.dat"
+
+#
+# Change, add, and remove some files...
+#
+
+echo "Updating ppds.dat..."
+
+ppd acme/l100b.ppd Acme "Acme Laser 100 Plus" English \
+    "MFG:Acme;MDL:Laser 100 Plus;" "Laser 100" "Laser 100 Plus"
+ppd acme/l11.ppd Acme "Acme Laser 11" English "MFG:Acme;MDL:Laser 11;" \
+    "Laser 11"
+rm -f $BASE/share/model/other/zeta.ppd
+drv 3 20 100
+
+scan
+
+if test "x$nread" != "x$count" -o "x$nwrote" = x; then
+	fail "ppds.dat not updated after changes."
+fi
+
+count=$nwrote
+
+scan
+
+if test "x$nread" != "x$count" -o "x$nwrote" != x; then
+	fail "Updated ppds.dat not reused."
+fi
+
+query expected2 "after changes"
+
+#
+# Damage ppds.dat in different ways and make sure it is rebuilt...
+#
+
+echo "Rebuilding damaged ppds.dat files..."
+
+size=`wc -c <$ppds`
+
+for damage in empty short truncated padded version; do
+	case $damage in
+		empty)
+			cp /dev/null $ppds
+			;;
+		short)
+			dd if=$ppds of=$ppds.N bs=1 count=16 2>/dev/null
+			mv $ppds.N $ppds
+			;;
+		truncated)
+			dd if=$ppds of=$ppds.N bs=1 count=`expr $size - 1` \
+			    2>/dev/null
+			mv $ppds.N $ppds
+			;;
+		padded)
+			dd if=/dev/zero bs=1 count=2 2>/dev/null >>$ppds
+			;;
+		version)
+			# Change the "PPD8" sync word to the "PPD7" used by
+			# CUPS 2.0b1 and earlier, in either byte order...
+			if test "`dd if=$ppds bs=1 count=1 2>/dev/null`" = 8; then
+				offset=0
+			else
+				offset=3
+			fi
+			printf 7 | dd of=$ppds bs=1 seek=$offset conv=notrunc \
+			    2>/dev/null
+			;;
+	esac
+
+	scan
+
+	if test "x$nread" != x; then
+		fail "Read $damage ppds.dat file."
+	fi
+
+	if test "x$nwrote" != "x$count" -o "`wc -c <$ppds`" != $size; then
+		fail "$damage ppds.dat file not rebuilt."
+	fi
+
+	query expected2 "after rebuilding $damage ppds.dat"
+done
+
+if test $status = 0; then
+	echo "PASS: ppds.dat tests."
+	rm -rf $BASE
+else
+	echo "See $BASE/log for details."
+fi
+
+exit $status
+
+#
+# End of "$Id$".
+#
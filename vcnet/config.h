@@ -327,6 +327,29 @@
 /* #undef HAVE_WAIT3 */
 
 
+/*
+ * Do we have the posix_spawn() function?
+ */
+
+/* #undef HAVE_POSIX_SPAWN */
+
+
+/*
+ * Do we have the Linux zero-copy functions?
+ */
+
+/* #undef HAVE_SYS_SENDFILE_H */
+/* #undef HAVE_SENDFILE */
+/* #undef HAVE_SPLICE */
+
+
+/*
+ * Do we have inotify?
+ */
+
+/* #undef HAVE_SYS_INOTIFY_H */
+
+
 /*
  * Do we have the mallinfo function and malloc.h?
  */
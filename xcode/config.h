@@ -262,6 +262,29 @@
 #define HAVE_WAIT3 1
 
 
+/*
+ * Do we have the posix_spawn() function?
+ */
+
+#define HAVE_POSIX_SPAWN 1
+
+
+/*
+ * Do we have the Linux zero-copy functions?
+ */
+
+/* #undef HAVE_SYS_SENDFILE_H */
+/* #undef HAVE_SENDFILE */
+/* #undef HAVE_SPLICE */
+
+
+/*
+ * Do we have inotify?
+ */
+
+/* #undef HAVE_SYS_INOTIFY_H */
+
+
 /*
  * Do we have the mallinfo function and malloc.h?
  */